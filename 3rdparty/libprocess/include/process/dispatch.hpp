@@ -16,6 +16,8 @@
 #include <functional>
 #include <memory> // TODO(benh): Replace shared_ptr with unique_ptr.
 #include <string>
+#include <type_traits>
+#include <vector>
 
 #include <process/process.hpp>
 
@@ -67,6 +69,16 @@ void dispatch(
     const Option<const std::type_info*>& functionType = None());
 
 
+// Dispatches the function like the routine above unless a function
+// that was dispatched to the process with the same tag hasn't been
+// run yet, in which case the function gets dropped (see 'coalesce').
+void dispatch(
+    const UPID& pid,
+    const std::string& tag,
+    const std::shared_ptr<std::function<void(ProcessBase*)>>& f,
+    const Option<const std::type_info*>& functionType = None());
+
+
 // NOTE: This struct is used by the public `dispatch(const UPID& pid, F&& f)`
 // function. See comments there for the reason why we need this.
 template <typename R>
@@ -416,6 +428,164 @@ auto dispatch(const UPID& pid, F&& f)
   return internal::Dispatch<R>()(pid, std::forward<F>(f));
 }
 
+
+// Dispatches a method that is idempotent, i.e., for which another
+// invocation right after the first one has nothing left to do (e.g.,
+// a method that allocates all available resources), unless another
+// dispatch of the method with the same 'tag' to the process is still
+// queued, in which case the two get coalesced into one invocation.
+// The tag is cleared right before the method gets invoked, so the
+// method always runs (at least once) after each call to 'coalesce'.
+//
+// NOTE: Unlike the tag the method is not compared, dispatches of
+// different methods should use different tags.
+template <typename T>
+void coalesce(
+    const PID<T>& pid,
+    const std::string& tag,
+    void (T::*method)())
+{
+  std::shared_ptr<std::function<void(ProcessBase*)>> f(
+      new std::function<void(ProcessBase*)>(
+          [=](ProcessBase* process) {
+            assert(process != nullptr);
+            T* t = dynamic_cast<T*>(process);
+            assert(t != nullptr);
+            (t->*method)();
+          }));
+
+  internal::dispatch(pid, tag, f, &typeid(method));
+}
+
+template <typename T>
+void coalesce(
+    const Process<T>& process,
+    const std::string& tag,
+    void (T::*method)())
+{
+  coalesce(process.self(), tag, method);
+}
+
+template <typename T>
+void coalesce(
+    const Process<T>* process,
+    const std::string& tag,
+    void (T::*method)())
+{
+  coalesce(process->self(), tag, method);
+}
+
+
+// A batch of dispatches of methods returning void (or of callable
+// objects, whose results get ignored) to a single process, which get
+// delivered to the process as a single DispatchEvent when the batch
+// is sent, and are then run back to back in the order they were
+// added. Compared to dispatching each of them this saves an event
+// (and its allocations) and a push onto the event queue of the
+// process per dispatch, e.g., when dispatching to the same process in
+// a loop:
+//
+// Batch<Master> batch(master);
+// foreach (const Offer& offer, offers) {
+//   batch.add(&Master::offer, offer);
+// }
+// batch.send();
+//
+// NOTE: Since the dispatches are delivered as a single event, test
+// filters (e.g., FUTURE_DISPATCH) can't match individual methods of
+// a batch.
+template <typename T>
+class Batch
+{
+public:
+  explicit Batch(const PID<T>& _pid) : pid(_pid) {}
+  explicit Batch(const Process<T>& process) : pid(process.self()) {}
+  explicit Batch(const Process<T>* process) : pid(process->self()) {}
+
+  Batch(const Batch&) = delete;
+  Batch& operator=(const Batch&) = delete;
+
+  // Sends the dispatches that have been added since the last 'send'.
+  ~Batch()
+  {
+    send();
+  }
+
+  void add(void (T::*method)())
+  {
+    functions.push_back([=](T* t) {
+      (t->*method)();
+    });
+  }
+
+#define TEMPLATE(Z, N, DATA)                                            \
+  template <ENUM_PARAMS(N, typename P),                                 \
+            ENUM_PARAMS(N, typename A)>                                 \
+  void add(                                                             \
+      void (T::*method)(ENUM_PARAMS(N, P)),                             \
+      ENUM_BINARY_PARAMS(N, A, a))                                      \
+  {                                                                     \
+    functions.push_back([=](T* t) {                                     \
+      (t->*method)(ENUM_PARAMS(N, a));                                  \
+    });                                                                 \
+  }
+
+  REPEAT_FROM_TO(1, 11, TEMPLATE, _) // Args A0 -> A9.
+#undef TEMPLATE
+
+  template <typename F>
+  void add(F&& f)
+  {
+    typename std::decay<F>::type f_ = std::forward<F>(f);
+
+    // NOTE: The lambda is mutable since 'f' might only be callable
+    // when it's not const (e.g., a mutable lambda).
+    functions.push_back([=](T*) mutable {
+      f_();
+    });
+  }
+
+  // Returns the number of dispatches that haven't been sent yet.
+  size_t size() const
+  {
+    return functions.size();
+  }
+
+  // Delivers the dispatches that have been added since the last
+  // 'send' to the process, if there are any.
+  void send()
+  {
+    if (functions.empty()) {
+      return;
+    }
+
+    std::shared_ptr<std::vector<std::function<void(T*)>>> functions_(
+        new std::vector<std::function<void(T*)>>());
+
+    functions_->swap(functions);
+
+    // Assume that the next batch will be about as large.
+    functions.reserve(functions_->size());
+
+    std::shared_ptr<std::function<void(ProcessBase*)>> f(
+        new std::function<void(ProcessBase*)>(
+            [=](ProcessBase* process) {
+              assert(process != nullptr);
+              T* t = dynamic_cast<T*>(process);
+              assert(t != nullptr);
+              for (const std::function<void(T*)>& function : *functions_) {
+                function(t);
+              }
+            }));
+
+    internal::dispatch(pid, f);
+  }
+
+private:
+  const PID<T> pid;
+  std::vector<std::function<void(T*)>> functions;
+};
+
 } // namespace process {
 
 #endif // __PROCESS_DISPATCH_HPP__
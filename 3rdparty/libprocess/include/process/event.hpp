@@ -13,6 +13,9 @@
 #ifndef __PROCESS_EVENT_HPP__
 #define __PROCESS_EVENT_HPP__
 
+#include <stdint.h>
+
+#include <atomic>
 #include <memory> // TODO(benh): Replace shared_ptr with unique_ptr.
 
 #include <process/future.hpp>
@@ -47,6 +50,11 @@ struct EventVisitor
 
 struct Event
 {
+  Event() : next(nullptr), enqueued(0) {}
+
+  // NOTE: the copy does not belong to any event queue.
+  Event(const Event&) : next(nullptr), enqueued(0) {}
+
   virtual ~Event() {}
 
   virtual void visit(EventVisitor* visitor) const = 0;
@@ -81,6 +89,21 @@ struct Event
     }
     return *result;
   }
+
+private:
+  friend class EventQueue;
+  friend class ProcessBase;
+  friend class ProcessManager;
+
+  // Link to the next event in the event queue of the receiving
+  // process (the queue is intrusive to avoid allocating a node for
+  // each event).
+  std::atomic<Event*> next;
+
+  // Time (in nanoseconds, see ProcessStatistics::now) at which the
+  // event was enqueued if the event was sampled for the process
+  // statistics, otherwise 0.
+  int64_t enqueued;
 };
 
 
@@ -62,6 +62,50 @@ struct wrap;
 template <typename T>
 struct unwrap;
 
+
+// The callbacks of one kind that have been registered on a future.
+// Most futures only ever get one callback of each kind (e.g., the
+// 'onAny' callback added by 'then'), so the first callback is stored
+// inline rather than in a vector, which saves an allocation.
+template <typename C>
+class Callbacks
+{
+public:
+  Callbacks() : count(0) {}
+
+  bool empty() const { return count == 0; }
+
+  size_t size() const { return count; }
+
+  const C& operator[](size_t i) const
+  {
+    return i == 0 ? first : rest[i - 1];
+  }
+
+  void push_back(C&& callback)
+  {
+    if (count == 0) {
+      first = std::move(callback);
+    } else {
+      rest.push_back(std::move(callback));
+    }
+
+    count++;
+  }
+
+  void clear()
+  {
+    first = nullptr;
+    rest.clear();
+    count = 0;
+  }
+
+private:
+  C first;
+  std::vector<C> rest;
+  size_t count;
+};
+
 } // namespace internal {
 
 
@@ -451,11 +495,11 @@ private:
     //   3. Error, the state is FAILED; 'error()' stores the message.
     Result<T> result;
 
-    std::vector<DiscardCallback> onDiscardCallbacks;
-    std::vector<ReadyCallback> onReadyCallbacks;
-    std::vector<FailedCallback> onFailedCallbacks;
-    std::vector<DiscardedCallback> onDiscardedCallbacks;
-    std::vector<AnyCallback> onAnyCallbacks;
+    internal::Callbacks<DiscardCallback> onDiscardCallbacks;
+    internal::Callbacks<ReadyCallback> onReadyCallbacks;
+    internal::Callbacks<FailedCallback> onFailedCallbacks;
+    internal::Callbacks<DiscardedCallback> onDiscardedCallbacks;
+    internal::Callbacks<AnyCallback> onAnyCallbacks;
   };
 
   // Sets the value for this future, unless the future is already set,
@@ -480,7 +524,7 @@ namespace internal {
 //
 // TODO(*): Invoke callbacks in another execution context.
 template <typename C, typename... Arguments>
-void run(const std::vector<C>& callbacks, Arguments&&... arguments)
+void run(const Callbacks<C>& callbacks, Arguments&&... arguments)
 {
   for (size_t i = 0; i < callbacks.size(); ++i) {
     callbacks[i](std::forward<Arguments>(arguments)...);
@@ -985,7 +1029,7 @@ bool Future<T>::discard()
 {
   bool result = false;
 
-  std::vector<DiscardCallback> callbacks;
+  internal::Callbacks<DiscardCallback> callbacks;
   synchronized (data->lock) {
     if (!data->discard && data->state == PENDING) {
       result = data->discard = true;
@@ -1141,7 +1185,7 @@ const Future<T>& Future<T>::onDiscard(DiscardCallback&& callback) const
     if (data->discard) {
       run = true;
     } else if (data->state == PENDING) {
-      data->onDiscardCallbacks.emplace_back(std::move(callback));
+      data->onDiscardCallbacks.push_back(std::move(callback));
     }
   }
 
@@ -1163,7 +1207,7 @@ const Future<T>& Future<T>::onReady(ReadyCallback&& callback) const
     if (data->state == READY) {
       run = true;
     } else if (data->state == PENDING) {
-      data->onReadyCallbacks.emplace_back(std::move(callback));
+      data->onReadyCallbacks.push_back(std::move(callback));
     }
   }
 
@@ -1185,7 +1229,7 @@ const Future<T>& Future<T>::onFailed(FailedCallback&& callback) const
     if (data->state == FAILED) {
       run = true;
     } else if (data->state == PENDING) {
-      data->onFailedCallbacks.emplace_back(std::move(callback));
+      data->onFailedCallbacks.push_back(std::move(callback));
     }
   }
 
@@ -1207,7 +1251,7 @@ const Future<T>& Future<T>::onDiscarded(DiscardedCallback&& callback) const
     if (data->state == DISCARDED) {
       run = true;
     } else if (data->state == PENDING) {
-      data->onDiscardedCallbacks.emplace_back(std::move(callback));
+      data->onDiscardedCallbacks.push_back(std::move(callback));
     }
   }
 
@@ -1227,7 +1271,7 @@ const Future<T>& Future<T>::onAny(AnyCallback&& callback) const
 
   synchronized (data->lock) {
     if (data->state == PENDING) {
-      data->onAnyCallbacks.emplace_back(std::move(callback));
+      data->onAnyCallbacks.push_back(std::move(callback));
     } else {
       run = true;
     }
@@ -0,0 +1,239 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __PROCESS_HISTOGRAM_HPP__
+#define __PROCESS_HISTOGRAM_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <process/statistics.hpp>
+
+#include <stout/option.hpp>
+
+namespace process {
+
+// A histogram of values in logarithmically sized buckets (like an HDR
+// histogram), which provides approximate Statistics of the recorded
+// values in fixed memory.
+//
+// Every power of two range is split into SUB_BUCKETS linear buckets,
+// so the percentiles have a relative error of at most 1 / (2 *
+// SUB_BUCKETS) (about 1.6%), while the count, the minimum and the
+// maximum are exact. Recording a value is O(1), computing the
+// Statistics is O(buckets) and histograms can be merged, unlike a
+// TimeSeries which needs to copy and sort all of its values.
+//
+// The histogram is meant for non-negative values, such as durations
+// and sizes. Values below 2^MIN_EXPONENT (including all non-positive
+// values) are only accounted for as 0 (or the minimum, if larger) and
+// values above 2^MAX_EXPONENT only as the maximum. Infinite and NaN
+// values are ignored.
+class Histogram
+{
+public:
+  Histogram() : count(0), min(0), max(0) {}
+
+  void record(double value)
+  {
+    // NOTE: the bucket of an infinite value is undefined (see
+    // 'index') and it would turn the interpolated percentiles into
+    // NaNs, so we drop non-finite values like NaNs.
+    if (!std::isfinite(value)) {
+      return;
+    }
+
+    // NOTE: we only allocate the buckets once there is a value, since
+    // many histograms never get any.
+    if (buckets.empty()) {
+      buckets.resize(BUCKETS, 0);
+    }
+
+    buckets[index(value)]++;
+
+    min = count == 0 ? value : std::min(min, value);
+    max = count == 0 ? value : std::max(max, value);
+
+    count++;
+  }
+
+  void merge(const Histogram& that)
+  {
+    if (that.count == 0) {
+      return;
+    }
+
+    if (buckets.empty()) {
+      buckets.resize(BUCKETS, 0);
+    }
+
+    for (size_t i = 0; i < BUCKETS; i++) {
+      buckets[i] += that.buckets[i];
+    }
+
+    min = count == 0 ? that.min : std::min(min, that.min);
+    max = count == 0 ? that.max : std::max(max, that.max);
+
+    count += that.count;
+  }
+
+  void clear()
+  {
+    std::fill(buckets.begin(), buckets.end(), 0);
+    count = 0;
+    min = 0;
+    max = 0;
+  }
+
+  size_t size() const
+  {
+    return count;
+  }
+
+  // Returns Statistics for the recorded values, or None() if fewer
+  // than 2 values have been recorded (like Statistics::from).
+  Option<Statistics<double>> statistics() const
+  {
+    if (count < 2) {
+      return None();
+    }
+
+    Statistics<double> statistics;
+
+    statistics.count = count;
+
+    statistics.min = min;
+    statistics.max = max;
+
+    statistics.p50 = percentile(0.5);
+    statistics.p90 = percentile(0.90);
+    statistics.p95 = percentile(0.95);
+    statistics.p99 = percentile(0.99);
+    statistics.p999 = percentile(0.999);
+    statistics.p9999 = percentile(0.9999);
+
+    return statistics;
+  }
+
+  static const int MIN_EXPONENT = -16;
+  static const int MAX_EXPONENT = 48;
+
+  static const size_t SUB_BUCKETS = 32;
+
+private:
+  // One bucket for each sub-range of each power of two range, plus
+  // one for the values below and one for the values above them.
+  static const size_t BUCKETS =
+    (MAX_EXPONENT - MIN_EXPONENT) * SUB_BUCKETS + 2;
+
+  // NOTE: the value must be finite, since the exponent that 'frexp'
+  // returns for an infinite value is unspecified.
+  static size_t index(double value)
+  {
+    int exponent = 0;
+
+    // Splits the value into a mantissa in [0.5, 1) and an exponent.
+    const double mantissa = std::frexp(value, &exponent);
+
+    if (value <= 0 || exponent <= MIN_EXPONENT) {
+      return 0;
+    } else if (exponent > MAX_EXPONENT) {
+      return BUCKETS - 1;
+    }
+
+    const size_t sub = static_cast<size_t>((mantissa * 2 - 1) * SUB_BUCKETS);
+
+    return 1 + (exponent - MIN_EXPONENT - 1) * SUB_BUCKETS +
+      std::min(sub, SUB_BUCKETS - 1);
+  }
+
+  // Returns the value that represents the values in the bucket (the
+  // middle of its range), limited to the recorded minimum and maximum.
+  double representative(size_t index) const
+  {
+    double value = 0;
+
+    if (index == BUCKETS - 1) {
+      value = max;
+    } else if (index > 0) {
+      const int exponent = (index - 1) / SUB_BUCKETS + MIN_EXPONENT + 1;
+      const size_t sub = (index - 1) % SUB_BUCKETS;
+
+      // The bucket covers [2^(exponent - 1) * (1 + sub / SUB_BUCKETS),
+      // 2^(exponent - 1) * (1 + (sub + 1) / SUB_BUCKETS)).
+      value = std::ldexp(1 + (sub + 0.5) / SUB_BUCKETS, exponent - 1);
+    }
+
+    return std::max(min, std::min(max, value));
+  }
+
+  // Returns the value with the specified rank (i.e., the index into
+  // the sorted values).
+  double value(size_t rank) const
+  {
+    if (rank == 0) {
+      return min;
+    } else if (rank >= count - 1) {
+      return max;
+    }
+
+    size_t seen = 0;
+
+    for (size_t i = 0; i < BUCKETS; i++) {
+      seen += buckets[i];
+      if (seen > rank) {
+        return representative(i);
+      }
+    }
+
+    return max;
+  }
+
+  // Returns the requested percentile, interpolating linearly between
+  // the values adjacent to its rank as Statistics does.
+  double percentile(double percentile) const
+  {
+    if (percentile <= 0.0) {
+      return min;
+    }
+
+    if (percentile >= 1.0) {
+      return max;
+    }
+
+    const double position = percentile * (count - 1);
+    const size_t rank = static_cast<size_t>(std::floor(position));
+    const double delta = position - rank;
+
+    const double lower = value(rank);
+
+    if (delta == 0) {
+      return lower;
+    }
+
+    return lower + delta * (value(rank + 1) - lower);
+  }
+
+  std::vector<uint64_t> buckets;
+
+  size_t count;
+  double min;
+  double max;
+};
+
+} // namespace process {
+
+#endif // __PROCESS_HISTOGRAM_HPP__
@@ -251,49 +251,10 @@ typedef hashmap<std::string,
                 CaseInsensitiveEqual> Headers;
 
 
-struct Request
-{
-  std::string method;
-
-  // TODO(benh): Add major/minor version.
-
-  // For client requests, the URL should be a URI.
-  // For server requests, the URL may be a URI or a relative reference.
-  URL url;
-
-  Headers headers;
-
-  // TODO(bmahler): Add a 'query' field which contains both
-  // the URL query and the parsed form data from the body.
-
-  std::string body;
-
-  // TODO(bmahler): Ensure this is consistent with the 'Connection'
-  // header; perhaps make this a function that checks the header.
-  bool keepAlive;
-
-  // For server requests, this contains the address of the client.
-  // Note that this may correspond to a proxy or load balancer address.
-  network::Address client;
-
-  /**
-   * Returns whether the encoding is considered acceptable in the
-   * response. See RFC 2616 section 14.3 for details.
-   */
-  bool acceptsEncoding(const std::string& encoding) const;
-
-  /**
-   * Returns whether the media type is considered acceptable in the
-   * response. See RFC 2616, section 14.1 for the details.
-   */
-  bool acceptsMediaType(const std::string& mediaType) const;
-};
-
-
 // Represents an asynchronous in-memory unbuffered Pipe, currently
-// used for streaming HTTP responses via chunked encoding. Note that
-// being an in-memory pipe means that this cannot be used across OS
-// processes.
+// used for streaming HTTP responses via chunked encoding and the
+// bodies of HTTP requests as they arrive. Note that being an
+// in-memory pipe means that this cannot be used across OS processes.
 //
 // Much like unix pipes, data is read until end-of-file is
 // encountered; this occurs when the write-end of the pipe is
@@ -341,6 +302,12 @@ public:
     // is closed.
     Future<std::string> read();
 
+    // Performs a series of asynchronous reads, until EOF is reached.
+    // Returns the concatenated result of the reads.
+    // Returns Failure if the writer failed, or the read-end
+    // is closed.
+    Future<std::string> readAll();
+
     // Closing the read-end of the pipe before the write-end closes
     // or fails will notify the writer that the reader is no longer
     // interested. Returns false if the read-end was already closed.
@@ -445,6 +412,67 @@ private:
 };
 
 
+struct Request
+{
+  Request()
+    : keepAlive(false),
+      type(BODY) {}
+
+  std::string method;
+
+  // TODO(benh): Add major/minor version.
+
+  // For client requests, the URL should be a URI.
+  // For server requests, the URL may be a URI or a relative reference.
+  URL url;
+
+  Headers headers;
+
+  // TODO(bmahler): Add a 'query' field which contains both
+  // the URL query and the parsed form data from the body.
+
+  std::string body;
+
+  // TODO(bmahler): Ensure this is consistent with the 'Connection'
+  // header; perhaps make this a function that checks the header.
+  bool keepAlive;
+
+  // For server requests, this contains the address of the client.
+  // Note that this may correspond to a proxy or load balancer address.
+  network::Address client;
+
+  // Server requests are either of type:
+  //
+  // BODY: The whole body is in 'body'.
+  //
+  // PIPE: The body is read from the Pipe 'reader' as it arrives
+  //       (i.e., it's not buffered). Only the handlers of endpoints
+  //       that are routed with request streaming enabled receive
+  //       requests of this type (see ProcessBase::RouteOptions).
+  //
+  // Client requests are always of type BODY.
+  enum
+  {
+    BODY,
+    PIPE
+  } type;
+
+  Option<Pipe::Reader> reader;
+
+  /**
+   * Returns whether the encoding is considered acceptable in the
+   * response. See RFC 2616 section 14.3 for details.
+   */
+  bool acceptsEncoding(const std::string& encoding) const;
+
+  /**
+   * Returns whether the media type is considered acceptable in the
+   * response. See RFC 2616, section 14.1 for the details.
+   */
+  bool acceptsMediaType(const std::string& mediaType) const;
+};
+
+
 struct Response
 {
   Response()
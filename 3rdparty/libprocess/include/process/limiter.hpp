@@ -13,19 +13,25 @@
 #ifndef __PROCESS_LIMITER_HPP__
 #define __PROCESS_LIMITER_HPP__
 
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
 #include <deque>
 
+#include <process/clock.hpp>
 #include <process/defer.hpp>
 #include <process/delay.hpp>
 #include <process/dispatch.hpp>
 #include <process/id.hpp>
 #include <process/future.hpp>
 #include <process/process.hpp>
-#include <process/timeout.hpp>
 
 #include <stout/duration.hpp>
 #include <stout/foreach.hpp>
+#include <stout/none.hpp>
 #include <stout/nothing.hpp>
+#include <stout/option.hpp>
 
 namespace process {
 
@@ -34,6 +40,16 @@ class RateLimiterProcess;
 
 // Provides an abstraction that rate limits the number of "permits"
 // that can be acquired over some duration.
+//
+// The permits are handed out by a token bucket that holds up to
+// 'burst' permits (1 by default, i.e., no burst) and gets refilled at
+// the rate of the limiter, so up to 'burst' permits can be acquired
+// at once after the limiter was idle for long enough. A permit that
+// is available is acquired without a dispatch to the process of the
+// limiter (i.e., 'acquire' returns a ready future), while permits
+// that need to wait get queued by the process in the order in which
+// they were acquired.
+//
 // NOTE: Currently, each libprocess Process should use a separate
 // RateLimiter instance. This is because if multiple processes share
 // a RateLimiter instance, by the time a process acts on the Future
@@ -42,8 +58,8 @@ class RateLimiterProcess;
 class RateLimiter
 {
 public:
-  RateLimiter(int permits, const Duration& duration);
-  explicit RateLimiter(double permitsPerSecond);
+  RateLimiter(int permits, const Duration& duration, int burst = 1);
+  explicit RateLimiter(double permitsPerSecond, int burst = 1);
   virtual ~RateLimiter();
 
   // Returns a future that becomes ready when the permit is acquired.
@@ -62,19 +78,29 @@ private:
 class RateLimiterProcess : public Process<RateLimiterProcess>
 {
 public:
-  RateLimiterProcess(int permits, const Duration& duration)
-    : ProcessBase(ID::generate("__limiter__"))
+  RateLimiterProcess(int permits, const Duration& duration, int _burst = 1)
+    : ProcessBase(ID::generate("__limiter__")),
+      burst(_burst),
+      next(0),
+      waiting(0)
   {
     CHECK_GT(permits, 0);
     CHECK_GT(duration.secs(), 0);
+    CHECK_GT(burst, 0);
     permitsPerSecond = permits / duration.secs();
+    interval = std::max<int64_t>(1, Seconds(1).ns() / permitsPerSecond);
   }
 
-  explicit RateLimiterProcess(double _permitsPerSecond)
+  explicit RateLimiterProcess(double _permitsPerSecond, int _burst = 1)
     : ProcessBase(ID::generate("__limiter__")),
-      permitsPerSecond(_permitsPerSecond)
+      permitsPerSecond(_permitsPerSecond),
+      burst(_burst),
+      next(0),
+      waiting(0)
   {
     CHECK_GT(permitsPerSecond, 0);
+    CHECK_GT(burst, 0);
+    interval = std::max<int64_t>(1, Seconds(1).ns() / permitsPerSecond);
   }
 
   virtual void finalize()
@@ -84,59 +110,101 @@ public:
       delete promise;
     }
     promises.clear();
+    waiting.store(0);
   }
 
-  Future<Nothing> acquire()
+  // Acquires a permit if one is available and no earlier acquisition
+  // is waiting for one. Unlike the other functions this one may be
+  // called directly (i.e., without a dispatch) from any thread.
+  bool tryAcquire()
   {
-    if (!promises.empty()) {
-      // Need to wait for others to get permits first.
-      Promise<Nothing>* promise = new Promise<Nothing>();
-      promises.push_back(promise);
-      return promise->future()
-        .onDiscard(defer(self(), &Self::discard, promise->future()));
-    }
+    return waiting.load() == 0 && take().isNone();
+  }
 
-    if (timeout.remaining() > Seconds(0)) {
-      // Need to wait a bit longer, but first one in the queue.
-      Promise<Nothing>* promise = new Promise<Nothing>();
-      promises.push_back(promise);
-      delay(timeout.remaining(), self(), &Self::_acquire);
-      return promise->future()
-        .onDiscard(defer(self(), &Self::discard, promise->future()));
-    }
+  // Queues an acquisition, which the caller has already counted in
+  // 'waiting' (see 'RateLimiter::acquire').
+  void acquire(Promise<Nothing>* promise)
+  {
+    promise->future()
+      .onDiscard(defer(self(), &Self::discard, promise->future()));
 
-    // No need to wait!
-    timeout = Seconds(1) / permitsPerSecond;
-    return Nothing();
+    promises.push_back(promise);
+
+    // Unless there are others to get permits first (in which case
+    // '_acquire' is already pending), see if there is a permit now.
+    if (promises.size() == 1) {
+      _acquire();
+    }
   }
 
 private:
+  friend class RateLimiter;
+
   // Not copyable, not assignable.
   RateLimiterProcess(const RateLimiterProcess&);
   RateLimiterProcess& operator=(const RateLimiterProcess&);
 
+  // Takes a permit out of the bucket if there is one, otherwise
+  // returns how long it takes until there is one.
+  //
+  // NOTE: Rather than the number of permits in the bucket we keep the
+  // time at which the bucket will be full again in 'next' (also known
+  // as the "generic cell rate algorithm"), so that a permit can be
+  // taken with a single compare-and-swap.
+  Option<Duration> take()
+  {
+    const int64_t now = Clock::now().duration().ns();
+
+    int64_t full = next.load();
+
+    while (true) {
+      // The bucket has a permit once it's at most 'burst - 1'
+      // permits short of being full.
+      const int64_t available = full - (burst - 1) * interval;
+
+      if (now < available) {
+        return Nanoseconds(available - now);
+      }
+
+      if (next.compare_exchange_weak(full, std::max(full, now) + interval)) {
+        return None();
+      }
+    }
+  }
+
   void _acquire()
   {
     CHECK(!promises.empty());
 
-    // Keep removing the top of the queue until we find a promise
-    // whose future is not discarded.
+    // Keep removing the top of the queue while there are permits (we
+    // might have more than one after waiting if there is a burst),
+    // skipping the promises whose futures were discarded.
     while (!promises.empty()) {
       Promise<Nothing>* promise = promises.front();
-      promises.pop_front();
-      if (!promise->future().isDiscarded()) {
-        promise->set(Nothing());
+
+      if (promise->future().isDiscarded()) {
+        promises.pop_front();
         delete promise;
-        timeout = Seconds(1) / permitsPerSecond;
+        waiting.fetch_sub(1);
+        continue;
+      }
+
+      Option<Duration> remaining = take();
+
+      if (remaining.isSome()) {
+        // Repeat when the next permit is available.
+        delay(remaining.get(), self(), &Self::_acquire);
         break;
-      } else {
-        delete promise;
       }
-    }
 
-    // Repeat if necessary.
-    if (!promises.empty()) {
-      delay(timeout.remaining(), self(), &Self::_acquire);
+      promises.pop_front();
+      promise->set(Nothing());
+      delete promise;
+
+      // NOTE: We only stop counting the acquisition after setting its
+      // promise, so that an acquisition that doesn't need to wait can't
+      // complete before it (see 'tryAcquire').
+      waiting.fetch_sub(1);
     }
   }
 
@@ -151,22 +219,39 @@ private:
 
   double permitsPerSecond;
 
-  Timeout timeout;
+  // The number of permits that the bucket holds.
+  const int64_t burst;
+
+  // Nanoseconds between two permits.
+  int64_t interval;
+
+  // The time (in nanoseconds since the epoch) at which the bucket
+  // will be full again, see 'take'.
+  std::atomic<int64_t> next;
+
+  // The number of acquisitions that had to wait for a permit and have
+  // not been satisfied (or discarded) yet, which is read by
+  // 'tryAcquire'. This includes the acquisitions that have been
+  // dispatched but not queued yet.
+  std::atomic<size_t> waiting;
 
   std::deque<Promise<Nothing>*> promises;
 };
 
 
-inline RateLimiter::RateLimiter(int permits, const Duration& duration)
+inline RateLimiter::RateLimiter(
+    int permits,
+    const Duration& duration,
+    int burst)
 {
-  process = new RateLimiterProcess(permits, duration);
+  process = new RateLimiterProcess(permits, duration, burst);
   spawn(process);
 }
 
 
-inline RateLimiter::RateLimiter(double permitsPerSecond)
+inline RateLimiter::RateLimiter(double permitsPerSecond, int burst)
 {
-  process = new RateLimiterProcess(permitsPerSecond);
+  process = new RateLimiterProcess(permitsPerSecond, burst);
   spawn(process);
 }
 
@@ -181,7 +266,21 @@ inline RateLimiter::~RateLimiter()
 
 inline Future<Nothing> RateLimiter::acquire() const
 {
-  return dispatch(process, &RateLimiterProcess::acquire);
+  if (process->tryAcquire()) {
+    return Nothing();
+  }
+
+  // Count the acquisition as waiting before dispatching it, so that
+  // the acquisitions that follow it queue behind it rather than take
+  // the next permit directly.
+  process->waiting.fetch_add(1);
+
+  Promise<Nothing>* promise = new Promise<Nothing>();
+  Future<Nothing> future = promise->future();
+
+  dispatch(process, &RateLimiterProcess::acquire, promise);
+
+  return future;
 }
 
 } // namespace process {
@@ -13,13 +13,21 @@
 #ifndef __PROCESS_METRICS_GAUGE_HPP__
 #define __PROCESS_METRICS_GAUGE_HPP__
 
+#include <atomic>
 #include <memory>
 #include <string>
 
+#include <process/clock.hpp>
 #include <process/defer.hpp>
+#include <process/future.hpp>
+#include <process/time.hpp>
 
 #include <process/metrics/metric.hpp>
 
+#include <stout/duration.hpp>
+#include <stout/option.hpp>
+#include <stout/synchronized.hpp>
+
 namespace process {
 namespace metrics {
 
@@ -31,19 +39,108 @@ public:
   // 'name' is the unique name for the instance of Gauge being constructed.
   // It will be the key exposed in the JSON endpoint.
   // 'f' is the deferred object called when the Metric value is requested.
-  Gauge(const std::string& name, const Deferred<Future<double>()>& f)
-    : Metric(name, None()), data(new Data(f)) {}
+  // 'staleness' is how long a value can be reused: if it's set, 'f' is
+  // only called when the last value is older than 'staleness' (and
+  // its evaluation is not still in progress), which keeps snapshots
+  // from queueing a dispatch behind the work of a busy process every
+  // time they are taken.
+  Gauge(const std::string& name,
+        const Deferred<Future<double>()>& f,
+        const Option<Duration>& staleness = None())
+    : Metric(name, None()), data(new Data(f, staleness)) {}
 
   virtual ~Gauge() {}
 
-  virtual Future<double> value() const { return data->f(); }
+  virtual Future<double> value() const
+  {
+    if (data->staleness.isNone()) {
+      return data->f();
+    }
+
+    const Time now = Clock::now();
+
+    synchronized (data->lock) {
+      if (data->last.isSome() &&
+          (data->last->isPending() ||
+           now - data->evaluated <= data->staleness.get())) {
+        return data->last.get();
+      }
+    }
+
+    Future<double> value = data->f();
+
+    synchronized (data->lock) {
+      data->last = value;
+      data->evaluated = now;
+    }
+
+    return value;
+  }
 
 private:
   struct Data
   {
-    explicit Data(const Deferred<Future<double>()>& _f) : f(_f) {}
+    Data(const Deferred<Future<double>()>& _f,
+         const Option<Duration>& _staleness)
+      : f(_f), staleness(_staleness) {}
 
     const Deferred<Future<double>()> f;
+    const Option<Duration> staleness;
+
+    std::atomic_flag lock = ATOMIC_FLAG_INIT;
+
+    // The last value (which might still be pending) and when it was
+    // requested, if there is a 'staleness'.
+    Option<Future<double>> last;
+    Time evaluated;
+  };
+
+  std::shared_ptr<Data> data;
+};
+
+
+// A Gauge whose value is published by its owner (e.g., whenever the
+// value changes) rather than evaluated when a snapshot is taken, so
+// getting its value never dispatches to the owner.
+class PushGauge : public Metric
+{
+public:
+  // 'name' is the unique name for the instance of PushGauge being
+  // constructed. It will be the key exposed in the JSON endpoint.
+  explicit PushGauge(const std::string& name)
+    : Metric(name, None()), data(new Data()) {}
+
+  virtual ~PushGauge() {}
+
+  virtual Future<double> value() const
+  {
+    return data->value.load();
+  }
+
+  PushGauge& operator=(double value)
+  {
+    data->value.store(value);
+    return *this;
+  }
+
+  PushGauge& operator+=(double value)
+  {
+    double current = data->value.load();
+    while (!data->value.compare_exchange_weak(current, current + value)) {}
+    return *this;
+  }
+
+  PushGauge& operator-=(double value)
+  {
+    return *this += -value;
+  }
+
+private:
+  struct Data
+  {
+    Data() : value(0) {}
+
+    std::atomic<double> value;
   };
 
   std::shared_ptr<Data> data;
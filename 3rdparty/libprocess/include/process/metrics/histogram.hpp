@@ -0,0 +1,160 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __PROCESS_METRICS_HISTOGRAM_HPP__
+#define __PROCESS_METRICS_HISTOGRAM_HPP__
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <process/clock.hpp>
+#include <process/future.hpp>
+#include <process/histogram.hpp>
+#include <process/statistics.hpp>
+
+#include <process/metrics/metric.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/foreach.hpp>
+#include <stout/option.hpp>
+#include <stout/synchronized.hpp>
+
+namespace process {
+namespace metrics {
+
+// A Metric that records a distribution of values (e.g., durations) in
+// a process::Histogram rather than keeping them in a TimeSeries, so
+// that its Statistics take fixed memory and can be computed without
+// sorting the values.
+//
+// If a 'window' is specified the Statistics only cover (roughly) the
+// values recorded during the last 'window': the histogram is split
+// into SLICES histograms that each cover 'window / SLICES' and the
+// oldest of which gets reset when a new slice starts, so the
+// Statistics cover between 'window * (SLICES - 1) / SLICES' and
+// 'window'. Otherwise they cover all recorded values.
+class Histogram : public Metric
+{
+public:
+  Histogram(const std::string& name, const Option<Duration>& window = None())
+    : Metric(name, None()),
+      data(new Data(window)) {}
+
+  virtual ~Histogram() {}
+
+  // Returns the last recorded value.
+  virtual Future<double> value() const
+  {
+    Future<double> value;
+
+    synchronized (data->lock) {
+      if (data->lastValue.isSome()) {
+        value = data->lastValue.get();
+      } else {
+        value = Failure("No value");
+      }
+    }
+
+    return value;
+  }
+
+  virtual Option<Statistics<double>> statistics() const
+  {
+    process::Histogram histogram;
+
+    const int64_t current = data->slice(Clock::now());
+
+    synchronized (data->lock) {
+      foreach (const Slice& slice, data->slices) {
+        if (slice.index > current - static_cast<int64_t>(SLICES)) {
+          histogram.merge(slice.histogram);
+        }
+      }
+    }
+
+    return histogram.statistics();
+  }
+
+  void record(double value)
+  {
+    const int64_t current = data->slice(Clock::now());
+
+    synchronized (data->lock) {
+      Slice& slice = data->slices[current % SLICES];
+
+      if (slice.index != current) {
+        slice.histogram.clear();
+        slice.index = current;
+      }
+
+      slice.histogram.record(value);
+
+      data->lastValue = value;
+    }
+  }
+
+private:
+  static const size_t SLICES = 4;
+
+  struct Slice
+  {
+    Slice() : index(0) {}
+
+    // The index of the period of 'window / SLICES' that the histogram
+    // covers, counted from the epoch.
+    int64_t index;
+    process::Histogram histogram;
+  };
+
+  struct Data
+  {
+    explicit Data(const Option<Duration>& window)
+      : slices(window.isSome() ? SLICES : 1)
+    {
+      if (window.isSome()) {
+        duration = std::max<int64_t>(1, window.get().ns() / SLICES);
+      }
+    }
+
+    // Returns the index of the slice that covers 'time', which is
+    // always 0 if there is no window.
+    int64_t slice(const Time& time) const
+    {
+      if (duration.isNone()) {
+        return 0;
+      }
+
+      return time.duration().ns() / duration.get();
+    }
+
+    std::atomic_flag lock = ATOMIC_FLAG_INIT;
+
+    // Duration of each slice in nanoseconds, if there is a window.
+    Option<int64_t> duration;
+
+    std::vector<Slice> slices;
+
+    Option<double> lastValue;
+  };
+
+  std::shared_ptr<Data> data;
+};
+
+} // namespace metrics {
+} // namespace process {
+
+#endif // __PROCESS_METRICS_HISTOGRAM_HPP__
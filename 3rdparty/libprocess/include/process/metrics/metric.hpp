@@ -41,7 +41,9 @@ public:
     return data->name;
   }
 
-  Option<Statistics<double>> statistics() const
+  // Returns the Statistics of the history of this metric, or None()
+  // if there is no window (or not enough history).
+  virtual Option<Statistics<double>> statistics() const
   {
     Option<Statistics<double>> statistics = None();
 
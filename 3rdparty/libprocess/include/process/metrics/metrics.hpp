@@ -13,7 +13,10 @@
 #ifndef __PROCESS_METRICS_METRICS_HPP__
 #define __PROCESS_METRICS_METRICS_HPP__
 
+#include <list>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <process/dispatch.hpp>
 #include <process/future.hpp>
@@ -24,6 +27,7 @@
 #include <process/metrics/metric.hpp>
 
 #include <stout/hashmap.hpp>
+#include <stout/lambda.hpp>
 #include <stout/nothing.hpp>
 #include <stout/option.hpp>
 
@@ -65,6 +69,20 @@ private:
   MetricsProcess(const MetricsProcess&);
   MetricsProcess& operator=(const MetricsProcess&);
 
+  // The value and statistics of a metric when a snapshot was taken.
+  struct Sample
+  {
+    std::string name;
+    Future<double> value;
+    Option<Statistics<double>> statistics;
+  };
+
+  // Gets the values and statistics of all metrics, waiting at most
+  // 'timeout' for the values (the values that are still pending
+  // after that are left out of the snapshot).
+  Future<std::shared_ptr<std::vector<Sample>>> sample(
+      const Option<Duration>& timeout);
+
   Future<http::Response> _snapshot(
       const http::Request& request,
       const Option<std::string>& /* principal */);
@@ -72,10 +90,15 @@ private:
   static std::list<Future<double>> _snapshotTimeout(
       const std::list<Future<double>>& futures);
 
-  static Future<hashmap<std::string, double>> __snapshot(
-      const Option<Duration>& timeout,
-      const hashmap<std::string, Future<double>>& metrics,
-      const hashmap<std::string, Option<Statistics<double>>>& statistics);
+  static hashmap<std::string, double> __snapshot(
+      const std::shared_ptr<std::vector<Sample>>& samples);
+
+  // Calls 'f' with the name and value of each field of a snapshot of
+  // the samples (i.e., the value and the statistics of each metric),
+  // skipping any field whose name was already used.
+  static void fields(
+      const std::vector<Sample>& samples,
+      const lambda::function<void(const std::string&, double)>& f);
 
   // The Owned<Metric> is an explicit copy of the Metric passed to 'add'.
   hashmap<std::string, Owned<Metric>> metrics;
@@ -15,8 +15,11 @@
 
 #include <stdint.h>
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <queue>
+#include <set>
 #include <vector>
 
 #include <process/address.hpp>
@@ -39,7 +42,9 @@
 namespace process {
 
 // Forward declaration.
+class EventQueue;
 class Logging;
+class ProcessStatistics;
 class Sequence;
 
 namespace firewall {
@@ -74,6 +79,16 @@ public:
 
   UPID self() const { return pid; }
 
+  /**
+   * Returns the number of events currently on the event queue,
+   * including the event that is being processed (if any).
+   *
+   * Unlike `eventCount` this does not need to inspect the events, so
+   * it is cheap enough to be called often and from any thread (e.g.,
+   * to monitor whether a process is backed up).
+   */
+  size_t eventQueueSize() const;
+
 protected:
   /**
    * Invoked when an event is serviced.
@@ -253,6 +268,23 @@ protected:
   typedef lambda::function<Future<http::Response>(const http::Request&)>
   HttpRequestHandler;
 
+  /**
+   * Options for the HTTP endpoints set up by `route`.
+   */
+  struct RouteOptions
+  {
+    RouteOptions() : requestStreaming(false) {}
+
+    /**
+     * If enabled, the handler gets invoked as soon as the headers of
+     * a request have been received, and the request is of type
+     * `PIPE` so that the body can be read (e.g., parsed
+     * incrementally) from `http::Request::reader` as it arrives,
+     * rather than being buffered in `http::Request::body` first.
+     */
+    bool requestStreaming;
+  };
+
   /**
    * Sets up a handler for HTTP requests with the specified name.
    *
@@ -262,7 +294,8 @@ protected:
   void route(
       const std::string& name,
       const Option<std::string>& help,
-      const HttpRequestHandler& handler);
+      const HttpRequestHandler& handler,
+      const RouteOptions& options = RouteOptions());
 
   /**
    * @copydoc process::ProcessBase::route
@@ -271,14 +304,15 @@ protected:
   void route(
       const std::string& name,
       const Option<std::string>& help,
-      Future<http::Response> (T::*method)(const http::Request&))
+      Future<http::Response> (T::*method)(const http::Request&),
+      const RouteOptions& options = RouteOptions())
   {
     // Note that we use dynamic_cast here so a process can use
     // multiple inheritance if it sees so fit (e.g., to implement
     // multiple callback interfaces).
     HttpRequestHandler handler =
       lambda::bind(method, dynamic_cast<T*>(this), lambda::_1);
-    route(name, help, handler);
+    route(name, help, handler, options);
   }
 
   /**
@@ -305,7 +339,8 @@ protected:
       const std::string& name,
       const std::string& realm,
       const Option<std::string>& help,
-      const AuthenticatedHttpRequestHandler& handler);
+      const AuthenticatedHttpRequestHandler& handler,
+      const RouteOptions& options = RouteOptions());
 
   /**
    * @copydoc process::ProcessBase::route
@@ -317,14 +352,15 @@ protected:
       const Option<std::string>& help,
       Future<http::Response> (T::*method)(
           const http::Request&,
-          const Option<std::string>&))
+          const Option<std::string>&),
+      const RouteOptions& options = RouteOptions())
   {
     // Note that we use dynamic_cast here so a process can use
     // multiple inheritance if it sees so fit (e.g., to implement
     // multiple callback interfaces).
     AuthenticatedHttpRequestHandler handler =
       lambda::bind(method, dynamic_cast<T*>(this), lambda::_1, lambda::_2);
-    route(name, realm, help, handler);
+    route(name, realm, help, handler, options);
   }
 
   /**
@@ -361,15 +397,19 @@ protected:
   template <typename T>
   size_t eventCount()
   {
-    size_t count = 0U;
-
-    synchronized (mutex) {
-      count = std::count_if(events.begin(), events.end(), isEventType<T>);
-    }
-
-    return count;
+    return eventCount(isEventType<T>);
   }
 
+  /**
+   * Adds a gauge with the specified name to the metrics (i.e.,
+   * `/metrics/snapshot`) that reports the size of the event queue of
+   * this process (see `eventQueueSize`). Unlike a `metrics::Gauge`,
+   * getting its value does not dispatch to this process, so the gauge
+   * can still be read while the process is backed up. The gauge is
+   * removed when the process terminates.
+   */
+  void exposeEventQueueSize(const std::string& name);
+
 private:
   friend class SocketManager;
   friend class ProcessManager;
@@ -377,7 +417,7 @@ private:
   friend void* schedule(void*);
 
   // Process states.
-  enum
+  enum State
   {
     BOTTOM,
     READY,
@@ -385,7 +425,9 @@ private:
     BLOCKED,
     TERMINATING,
     TERMINATED
-  } state;
+  };
+
+  std::atomic<State> state;
 
   template <typename T>
   static bool isEventType(const Event* event)
@@ -393,9 +435,9 @@ private:
     return event->is<T>();
   }
 
-  // Mutex protecting internals.
-  // TODO(benh): Consider replacing with a spinlock, on multi-core systems.
-  std::recursive_mutex mutex;
+  // Returns the number of events on the event queue for which
+  // 'predicate' returns true.
+  size_t eventCount(bool (*predicate)(const Event*));
 
   // Enqueue the specified message, request, or function call.
   void enqueue(Event* event, bool inject = false);
@@ -423,6 +465,8 @@ private:
 
     Option<std::string> realm;
     Option<AuthenticatedHttpRequestHandler> authenticatedHandler;
+
+    RouteOptions options;
   };
 
   // Handlers for messages and HTTP requests.
@@ -446,8 +490,30 @@ private:
   // Static assets(s) to provide.
   std::map<std::string, Asset> assets;
 
-  // Queue of received events, requires lock()ed access!
-  std::deque<Event*> events;
+  // Queue of received events (see event_queue.hpp).
+  std::unique_ptr<EventQueue> events;
+
+  // Functions dispatched to this process while it was running and had
+  // no other events queued, which get run right after the current
+  // event instead of going through the event queue (see
+  // ProcessManager::resume). Only accessed by the running thread.
+  std::vector<std::shared_ptr<lambda::function<void(ProcessBase*)>>>
+    continuations;
+
+  // Tags of the dispatches to this process that are waiting to be
+  // coalesced with (see 'coalesce' in dispatch.hpp), i.e., that have
+  // been dispatched but not run yet.
+  std::set<std::string> coalescing;
+  std::atomic_flag coalescingLock = ATOMIC_FLAG_INIT;
+
+  // Name of the gauge that reports the size of the event queue, if
+  // the process exposes it (see 'exposeEventQueueSize').
+  Option<std::string> eventQueueSizeGauge;
+
+  // Statistics about the events this process has handled, or nullptr
+  // unless the process statistics are enabled (see
+  // process_statistics.hpp).
+  std::unique_ptr<ProcessStatistics> statistics;
 
   // Active references.
   std::atomic_long refs;
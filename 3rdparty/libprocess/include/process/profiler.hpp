@@ -13,6 +13,7 @@
 #ifndef __PROCESS_PROFILER_HPP__
 #define __PROCESS_PROFILER_HPP__
 
+#include <memory>
 #include <string>
 
 #include <process/future.hpp>
@@ -27,6 +28,7 @@ public:
   Profiler(const Option<std::string>& _authenticationRealm)
     : ProcessBase("profiler"),
       started(false),
+      sampling(false),
       authenticationRealm(_authenticationRealm) {}
 
   virtual ~Profiler() {}
@@ -44,6 +46,11 @@ protected:
             authenticationRealm.get(),
             STOP_HELP(),
             &Profiler::stop);
+
+      route("/sample",
+            authenticationRealm.get(),
+            SAMPLE_HELP(),
+            &Profiler::sample);
     } else {
       route("/start",
             START_HELP(),
@@ -56,12 +63,28 @@ protected:
             [this](const http::Request& request) {
               return Profiler::stop(request, None());
             });
+
+      route("/sample",
+            SAMPLE_HELP(),
+            [this](const http::Request& request) {
+              return Profiler::sample(request, None());
+            });
+    }
+  }
+
+  virtual void finalize()
+  {
+    // Respond with what got sampled so far rather than leaving the
+    // request hanging.
+    if (sampling) {
+      _sample();
     }
   }
 
 private:
   static const std::string START_HELP();
   static const std::string STOP_HELP();
+  static const std::string SAMPLE_HELP();
 
   // HTTP endpoints.
 
@@ -77,8 +100,27 @@ private:
       const http::Request& request,
       const Option<std::string>& /* principal */);
 
+  // Samples the stacks of the threads that consume CPU for a while
+  // and returns them in the "folded" format of flame graph tools (see
+  // sampler.hpp). Takes the optional request parameters 'duration'
+  // and 'frequency'.
+  Future<http::Response> sample(
+      const http::Request& request,
+      const Option<std::string>& /* principal */);
+
+  // Stops the sampling started by 'sample' and responds to the
+  // request that started it with the samples.
+  void _sample();
+
   bool started;
 
+  // Whether the sampling profiler is running.
+  bool sampling;
+
+  // The response to the request that started the sampling profiler,
+  // if it's running.
+  std::unique_ptr<Promise<http::Response>> samples;
+
   // The authentication realm that the profiler's HTTP endpoints will be
   // installed into.
   Option<std::string> authenticationRealm;
@@ -19,6 +19,7 @@
 #endif // __WINDOWS__
 
 #include <memory>
+#include <vector>
 
 #include <process/address.hpp>
 #include <process/future.hpp>
@@ -87,6 +88,17 @@ public:
    */
   Kind kind() const { return impl->kind(); }
 
+  /**
+   * A contiguous range of data to send.
+   *
+   * @see process::network::Socket::Impl::send
+   */
+  struct Buffer
+  {
+    const char* data;
+    size_t size;
+  };
+
   /**
    * Interface for a `Socket`.
    *
@@ -157,6 +169,19 @@ public:
     virtual Future<size_t> send(const char* data, size_t size) = 0;
     virtual Future<size_t> sendfile(int fd, off_t offset, size_t size) = 0;
 
+    /**
+     * An overload of `send`, which sends (some of) the data in the
+     * specified buffers, in order, as if they were one contiguous
+     * buffer. Implementations that support vectored I/O send them
+     * with a single system call, the default implementation only
+     * sends the first (non-empty) buffer. The buffers must remain
+     * valid until the returned future has been satisfied.
+     *
+     * @return The number of bytes sent, which might be less than the
+     *     total size of the buffers.
+     */
+    virtual Future<size_t> send(const std::vector<Buffer>& buffers);
+
     /**
      * An overload of `recv`, which receives data based on the specified
      * 'size' parameter.
@@ -308,6 +333,11 @@ public:
     return impl->sendfile(fd, offset, size);
   }
 
+  Future<size_t> send(const std::vector<Buffer>& buffers) const
+  {
+    return impl->send(buffers);
+  }
+
   Future<std::string> recv(const Option<ssize_t>& size = None())
   {
     return impl->recv(size);
@@ -31,8 +31,8 @@ struct Statistics
 {
   // Returns Statistics for the given TimeSeries, or None() if the
   // TimeSeries is empty.
-  // TODO(dhamon): Consider adding a histogram abstraction for better
-  // performance.
+  // NOTE: this copies and sorts all of the values, see Histogram
+  // (histogram.hpp) for approximate Statistics in O(buckets).
   static Option<Statistics<T> > from(const TimeSeries<T>& timeseries)
   {
     std::vector<typename TimeSeries<T>::Value> values_ = timeseries.get();
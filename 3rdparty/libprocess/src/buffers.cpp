@@ -0,0 +1,254 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#include <atomic>
+#include <vector>
+
+#include <process/defer.hpp>
+#include <process/future.hpp>
+
+#include <process/metrics/gauge.hpp>
+#include <process/metrics/metrics.hpp>
+
+#include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/synchronized.hpp>
+#include <stout/thread_local.hpp>
+
+#include "buffers.hpp"
+
+using std::vector;
+
+namespace process {
+namespace buffers {
+
+namespace {
+
+std::atomic<uint64_t> acquired(0);
+std::atomic<uint64_t> reused(0);
+std::atomic<uint64_t> outstanding(0);
+std::atomic<uint64_t> pooled(0);
+
+
+// A pool of free buffers by their size.
+struct Pool
+{
+  Pool() : bytes(0) {}
+
+  ~Pool()
+  {
+    foreachvalue (const vector<char*>& list, buffers) {
+      foreach (char* data, list) {
+        delete[] data;
+      }
+    }
+
+    pooled.fetch_sub(bytes);
+  }
+
+  // Returns a buffer of the size if there is one in the pool.
+  char* take(size_t size)
+  {
+    auto iterator = buffers.find(size);
+    if (iterator == buffers.end() || iterator->second.empty()) {
+      return nullptr;
+    }
+
+    char* data = iterator->second.back();
+    iterator->second.pop_back();
+    bytes -= size;
+    return data;
+  }
+
+  // Puts a buffer into the pool unless that exceeds 'limit' bytes.
+  bool put(char* data, size_t size, size_t limit)
+  {
+    if (bytes + size > limit) {
+      return false;
+    }
+
+    buffers[size].push_back(data);
+    bytes += size;
+    return true;
+  }
+
+  hashmap<size_t, vector<char*>> buffers;
+
+  // Number of bytes in the buffers in the pool.
+  size_t bytes;
+};
+
+
+// The pool of each thread, which doesn't need synchronization and
+// gets drained when the thread exits.
+//
+// NOTE: THREAD_LOCAL only supports POD types (see thread_local.hpp)
+// so we use 'thread_local' directly for the pool, and a POD to tell
+// whether it's already been destroyed (e.g., when a buffer gets
+// released by the destructor of another thread local object).
+struct LocalPool : Pool
+{
+  ~LocalPool();
+};
+
+thread_local LocalPool __pool__;
+
+THREAD_LOCAL bool __pool_destroyed__ = false;
+
+
+LocalPool::~LocalPool()
+{
+  __pool_destroyed__ = true;
+}
+
+
+Pool* local()
+{
+  return __pool_destroyed__ ? nullptr : &__pool__;
+}
+
+
+// The pool that all threads share, which the buffers that don't fit
+// into the pool of the thread that releases them go to. This is what
+// gets them back to the threads that acquire the buffers when those
+// are not the threads that release them (e.g., a buffer that a socket
+// receives into gets acquired by the process that calls 'recv' but
+// released by the event loop once the data has been received).
+std::atomic_flag lock = ATOMIC_FLAG_INIT;
+Pool* shared = new Pool();
+
+
+// The gauges added by 'initialize' (see below).
+metrics::Gauge* hitRate = nullptr;
+metrics::Gauge* outstandingBytes = nullptr;
+metrics::Gauge* pooledBytes = nullptr;
+
+
+void release(char* data, size_t size)
+{
+  outstanding.fetch_sub(size);
+
+  if (size <= MAX_BUFFER_SIZE) {
+    Pool* pool = local();
+
+    bool kept =
+      pool != nullptr && pool->put(data, size, MAX_THREAD_POOLED_BYTES);
+
+    if (!kept) {
+      synchronized (lock) {
+        kept = shared->put(data, size, MAX_POOLED_BYTES);
+      }
+    }
+
+    if (kept) {
+      pooled.fetch_add(size);
+      return;
+    }
+  }
+
+  delete[] data;
+}
+
+} // namespace {
+
+
+boost::shared_array<char> acquire(size_t size)
+{
+  acquired.fetch_add(1);
+  outstanding.fetch_add(size);
+
+  Pool* pool = local();
+
+  char* data = pool != nullptr ? pool->take(size) : nullptr;
+
+  if (data == nullptr) {
+    synchronized (lock) {
+      data = shared->take(size);
+    }
+  }
+
+  if (data != nullptr) {
+    pooled.fetch_sub(size);
+    reused.fetch_add(1);
+  } else {
+    data = new char[size];
+  }
+
+  return boost::shared_array<char>(
+      data,
+      [size](char* data) { release(data, size); });
+}
+
+
+Statistics statistics()
+{
+  Statistics statistics;
+  statistics.acquired = acquired.load();
+  statistics.reused = reused.load();
+  statistics.outstanding = outstanding.load();
+  statistics.pooled = pooled.load();
+  return statistics;
+}
+
+
+void initialize()
+{
+  // NOTE: The gauges read atomics so they don't need a process to
+  // dispatch to, and libprocess isn't running any process yet.
+  hitRate = new metrics::Gauge(
+      "libprocess/buffers/hit_rate",
+      defer([]() -> Future<double> {
+        const uint64_t total = acquired.load();
+        if (total == 0) {
+          return Failure("No buffers have been acquired");
+        }
+
+        return static_cast<double>(reused.load()) / total;
+      }));
+
+  outstandingBytes = new metrics::Gauge(
+      "libprocess/buffers/outstanding_bytes",
+      defer([]() -> Future<double> {
+        return static_cast<double>(outstanding.load());
+      }));
+
+  pooledBytes = new metrics::Gauge(
+      "libprocess/buffers/pooled_bytes",
+      defer([]() -> Future<double> {
+        return static_cast<double>(pooled.load());
+      }));
+
+  metrics::add(*hitRate);
+  metrics::add(*outstandingBytes);
+  metrics::add(*pooledBytes);
+}
+
+
+void finalize()
+{
+  const vector<metrics::Gauge*> gauges =
+    {hitRate, outstandingBytes, pooledBytes};
+
+  foreach (metrics::Gauge* gauge, gauges) {
+    if (gauge != nullptr) {
+      metrics::remove(*gauge);
+      delete gauge;
+    }
+  }
+
+  hitRate = nullptr;
+  outstandingBytes = nullptr;
+  pooledBytes = nullptr;
+}
+
+} // namespace buffers {
+} // namespace process {
@@ -0,0 +1,80 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __PROCESS_BUFFERS_HPP__
+#define __PROCESS_BUFFERS_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boost/shared_array.hpp>
+
+namespace process {
+namespace buffers {
+
+// A pool of the buffers that libprocess reads data from sockets and
+// files into. Rather than allocating (and faulting in) a new buffer
+// for every read, e.g., for each 'Socket::recv' of an HTTP connection
+// or each 'io::read', the buffers are reference counted and go back
+// into a pool once the last reference to them is dropped, from which
+// the next buffer of the same size gets taken.
+//
+// Each thread has its own pool of up to MAX_THREAD_POOLED_BYTES, so
+// that a thread that both acquires and releases buffers doesn't need
+// to synchronize with other threads, and the buffers that don't fit
+// go to a pool of up to MAX_POOLED_BYTES that all threads share.
+// Buffers larger than MAX_BUFFER_SIZE are never pooled.
+
+const size_t MAX_BUFFER_SIZE = 1024 * 1024;
+const size_t MAX_THREAD_POOLED_BYTES = 1024 * 1024;
+const size_t MAX_POOLED_BYTES = 16 * 1024 * 1024;
+
+
+// Returns a buffer of 'size' bytes, which is taken from a pool if
+// possible. Note that its contents are undefined.
+boost::shared_array<char> acquire(size_t size);
+
+
+struct Statistics
+{
+  // Number of buffers that have been acquired.
+  uint64_t acquired;
+
+  // Number of acquired buffers that were taken from a pool rather
+  // than allocated.
+  uint64_t reused;
+
+  // Number of bytes in the buffers that have been acquired and are
+  // still referenced.
+  uint64_t outstanding;
+
+  // Number of bytes in the buffers that are in a pool.
+  uint64_t pooled;
+};
+
+
+Statistics statistics();
+
+
+// Adds the 'libprocess/buffers/*' metrics. Called once during the
+// initialization of libprocess.
+void initialize();
+
+
+// Removes the metrics added by 'initialize'. Called during the
+// finalization of libprocess.
+void finalize();
+
+} // namespace buffers {
+} // namespace process {
+
+#endif // __PROCESS_BUFFERS_HPP__
@@ -12,10 +12,13 @@
 
 #include <glog/logging.h>
 
+#include <algorithm>
+#include <limits>
 #include <list>
 #include <map>
 #include <mutex>
 #include <set>
+#include <vector>
 
 #include <process/clock.hpp>
 #include <process/pid.hpp>
@@ -25,7 +28,10 @@
 
 #include <stout/duration.hpp>
 #include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
 #include <stout/lambda.hpp>
+#include <stout/none.hpp>
+#include <stout/option.hpp>
 #include <stout/synchronized.hpp>
 #include <stout/try.hpp>
 #include <stout/unreachable.hpp>
@@ -36,13 +42,423 @@ using std::list;
 using std::map;
 using std::recursive_mutex;
 using std::set;
+using std::vector;
 
 namespace process {
 
-// We store the timers in a map of lists indexed by the timeout of the
-// timer so that we can have two timers that have the same timeout. We
-// exploit that the map is SORTED!
-static map<Time, list<Timer>>* timers = new map<Time, list<Timer>>();
+// A hierarchical timing wheel (see "Hashed and Hierarchical Timing
+// Wheels" by Varghese and Lauck) for storing the pending timers.
+//
+// Time is divided into "ticks" of one millisecond and the timers are
+// bucketed by the tick of their timeout into 'LEVELS' wheels of
+// 'SLOTS' slots each: the slots of the lowest wheel span a single
+// tick, and each slot of a higher wheel spans a whole revolution of
+// the wheel below it. A timer is stored in the lowest wheel that
+// covers the distance between the current position of the wheels and
+// its tick (and in an 'overflow' list if no wheel does, i.e., for
+// timers more than ~2 years in the future). As the wheels advance the
+// timers in the slots of the higher wheels get "cascaded" down into
+// the lower wheels, until they are expired from the lowest wheel.
+//
+// This makes adding and canceling a timer constant time (rather than
+// logarithmic in the number of timers, as with a sorted map), while
+// finding the next slot that needs to be processed only takes a look
+// at a bitmap of occupied slots for each wheel.
+//
+// NOTE: a timer is never expired before its timeout has elapsed, the
+// ticks only determine how the timers are bucketed.
+class Timers
+{
+public:
+  Timers() : position(0), size_(0) {}
+
+  ~Timers()
+  {
+    clear();
+  }
+
+  void add(uint64_t id, const Timer& timer, const Time& now)
+  {
+    // If there are no timers we can move the wheels forward to the
+    // current time without having to process any slots.
+    if (size_ == 0) {
+      position = std::max(position, ticks(now));
+    }
+
+    Entry* entry = new Entry(id, timer);
+    entries[id] = entry;
+    size_++;
+
+    insert(entry);
+  }
+
+  // Returns true if the timer was pending (and is now removed).
+  bool remove(uint64_t id)
+  {
+    Option<Entry*> entry = entries.get(id);
+    if (entry.isNone()) {
+      return false;
+    }
+
+    entries.erase(id);
+    size_--;
+
+    unlink(entry.get());
+    delete entry.get();
+
+    return true;
+  }
+
+  void clear()
+  {
+    foreachvalue (Entry* entry, entries) {
+      delete entry;
+    }
+
+    entries.clear();
+    size_ = 0;
+
+    for (size_t level = 0; level < LEVELS; level++) {
+      for (size_t slot = 0; slot < SLOTS; slot++) {
+        slots[level][slot] = nullptr;
+      }
+      occupied[level] = 0;
+    }
+
+    overflow = nullptr;
+  }
+
+  size_t size() const
+  {
+    return size_;
+  }
+
+  // Removes the timers that have timed out by 'now' and appends them
+  // to 'expired' in the order of their timeouts.
+  void expire(const Time& now, list<Timer>* expired)
+  {
+    // NOTE: if the time went backwards (i.e., 'now' is before the
+    // current position) we still need to look at the current slot
+    // since it has the timers with timeouts before the position.
+    const int64_t target = std::max(position, ticks(now));
+
+    while (size_ > 0) {
+      const int64_t tick = nextTick();
+
+      if (tick > target) {
+        break;
+      }
+
+      position = tick;
+
+      cascade();
+
+      // NOTE: only the slot of the current tick (i.e., 'target') can
+      // have timers that have not timed out yet.
+      vector<Entry*> timedout;
+
+      Entry* entry = slots[0][position & MASK];
+      while (entry != nullptr) {
+        Entry* next = entry->next;
+        if (entry->timer.timeout().time() <= now) {
+          entries.erase(entry->id);
+          size_--;
+          unlink(entry);
+          timedout.push_back(entry);
+        }
+        entry = next;
+      }
+
+      std::stable_sort(
+          timedout.begin(),
+          timedout.end(),
+          [](const Entry* left, const Entry* right) {
+            return left->timer.timeout().time() <
+              right->timer.timeout().time();
+          });
+
+      foreach (Entry* entry, timedout) {
+        expired->push_back(entry->timer);
+        delete entry;
+      }
+
+      if (position == target) {
+        break;
+      }
+    }
+
+    // All the slots up to 'target' have been processed.
+    position = target;
+  }
+
+  // Returns the time when the timers next need to be processed, or
+  // None if there are no timers. This is the time of the earliest
+  // timer if it is in the current tick, and otherwise the start of
+  // the next slot that needs to be processed (which is a lower bound
+  // on the time of the earliest timer).
+  Option<Time> next() const
+  {
+    if (size_ == 0) {
+      return None();
+    }
+
+    const int64_t tick = nextTick();
+
+    if (tick == position) {
+      return earliest(slots[0][position & MASK]);
+    }
+
+    return start(tick);
+  }
+
+  // Returns the time of the earliest timer, or None if there are no
+  // timers. Note that this needs to look at all the timers in the
+  // first occupied slot of each wheel.
+  Option<Time> earliest() const
+  {
+    Option<Time> result = None();
+
+    for (size_t level = 0; level < LEVELS; level++) {
+      Option<size_t> slot = first(level);
+      if (slot.isSome()) {
+        Time time = earliest(slots[level][slot.get()]);
+        if (result.isNone() || time < result.get()) {
+          result = time;
+        }
+      }
+    }
+
+    // The timers in the overflow list are always later than the
+    // timers in the wheels.
+    if (result.isNone() && overflow != nullptr) {
+      result = earliest(overflow);
+    }
+
+    return result;
+  }
+
+private:
+  static constexpr size_t BITS = 6;
+  static constexpr size_t SLOTS = 1 << BITS;
+  static constexpr int64_t MASK = SLOTS - 1;
+  static constexpr size_t LEVELS = 6;
+
+  // Used as the level of the entries in the overflow list.
+  static constexpr size_t OVERFLOW = LEVELS;
+
+  struct Entry
+  {
+    Entry(uint64_t _id, const Timer& _timer)
+      : id(_id), timer(_timer), level(0), slot(0),
+        previous(nullptr), next(nullptr) {}
+
+    const uint64_t id;
+    const Timer timer;
+
+    size_t level;
+    size_t slot;
+
+    // The head of a list points back to the tail of the list so
+    // that entries can be appended in constant time.
+    Entry* previous;
+    Entry* next;
+  };
+
+  static int64_t ticks(const Time& time)
+  {
+    return time.duration().ns() / Milliseconds(1).ns();
+  }
+
+  static Time start(int64_t tick)
+  {
+    return Time::epoch() + Milliseconds(tick);
+  }
+
+  static Time earliest(const Entry* entry)
+  {
+    CHECK_NOTNULL(entry);
+
+    Time time = entry->timer.timeout().time();
+    for (; entry != nullptr; entry = entry->next) {
+      time = std::min(time, entry->timer.timeout().time());
+    }
+    return time;
+  }
+
+  // Returns the first occupied slot of the wheel at 'level' that is
+  // not behind the current position, if any. Only the lowest wheel
+  // can have timers in the slot of the current position since those
+  // timers would have otherwise been stored in a lower wheel.
+  Option<size_t> first(size_t level) const
+  {
+    const size_t current = (position >> (BITS * level)) & MASK;
+    const size_t start = level == 0 ? current : current + 1;
+
+    if (start == SLOTS) {
+      return None();
+    }
+
+    const uint64_t candidates = occupied[level] & (~uint64_t(0) << start);
+
+    if (candidates == 0) {
+      return None();
+    }
+
+    return static_cast<size_t>(__builtin_ctzll(candidates));
+  }
+
+  // Returns the first tick at (or after) the current position at
+  // which a slot needs to be processed, i.e., expired for the lowest
+  // wheel or cascaded for the higher wheels and the overflow list.
+  int64_t nextTick() const
+  {
+    int64_t result = std::numeric_limits<int64_t>::max();
+
+    for (size_t level = 0; level < LEVELS; level++) {
+      Option<size_t> slot = first(level);
+      if (slot.isSome()) {
+        const size_t shift = BITS * (level + 1);
+        int64_t tick = ((position >> shift) << shift) +
+          (static_cast<int64_t>(slot.get()) << (BITS * level));
+        result = std::min(result, tick);
+      }
+    }
+
+    if (overflow != nullptr) {
+      const size_t shift = BITS * LEVELS;
+      int64_t tick = ((position >> shift) + 1) << shift;
+      result = std::min(result, tick);
+    }
+
+    return result;
+  }
+
+  // Cascades the timers in the slots of the higher wheels (and the
+  // overflow list) that start at the current position, from the top
+  // down since the timers of a higher wheel might need to be cascaded
+  // again into a lower wheel.
+  void cascade()
+  {
+    if (overflow != nullptr && aligned(LEVELS)) {
+      Entry* entry = overflow;
+      overflow = nullptr;
+      reinsert(entry);
+    }
+
+    for (size_t level = LEVELS - 1; level > 0; level--) {
+      if (aligned(level)) {
+        const size_t slot = (position >> (BITS * level)) & MASK;
+        Entry* entry = slots[level][slot];
+        if (entry != nullptr) {
+          slots[level][slot] = nullptr;
+          occupied[level] &= ~(uint64_t(1) << slot);
+          reinsert(entry);
+        }
+      }
+    }
+  }
+
+  // Returns true if the current position is at the start of a slot
+  // of the wheel at 'level'.
+  bool aligned(size_t level) const
+  {
+    return (position & ((int64_t(1) << (BITS * level)) - 1)) == 0;
+  }
+
+  void reinsert(Entry* entry)
+  {
+    while (entry != nullptr) {
+      Entry* next = entry->next;
+      insert(entry);
+      entry = next;
+    }
+  }
+
+  void insert(Entry* entry)
+  {
+    // Timers that are already expired go into the current slot.
+    const int64_t tick =
+      std::max(position, ticks(entry->timer.timeout().time()));
+
+    entry->level = OVERFLOW;
+    entry->slot = 0;
+
+    for (size_t level = 0; level < LEVELS; level++) {
+      const size_t shift = BITS * (level + 1);
+      if ((tick >> shift) == (position >> shift)) {
+        entry->level = level;
+        entry->slot = (tick >> (BITS * level)) & MASK;
+        break;
+      }
+    }
+
+    Entry** head = bucket(entry);
+
+    // NOTE: we append so that the timers with the same timeout get
+    // expired in the order in which they were added.
+    entry->next = nullptr;
+
+    if (*head == nullptr) {
+      entry->previous = entry;
+      *head = entry;
+    } else {
+      Entry* tail = (*head)->previous;
+      tail->next = entry;
+      entry->previous = tail;
+      (*head)->previous = entry;
+    }
+
+    if (entry->level != OVERFLOW) {
+      occupied[entry->level] |= uint64_t(1) << entry->slot;
+    }
+  }
+
+  void unlink(Entry* entry)
+  {
+    Entry** head = bucket(entry);
+
+    if (*head == entry) {
+      *head = entry->next;
+      if (entry->next != nullptr) {
+        entry->next->previous = entry->previous;
+      }
+    } else {
+      entry->previous->next = entry->next;
+      if (entry->next != nullptr) {
+        entry->next->previous = entry->previous;
+      } else {
+        (*head)->previous = entry->previous;
+      }
+    }
+
+    if (*head == nullptr && entry->level != OVERFLOW) {
+      occupied[entry->level] &= ~(uint64_t(1) << entry->slot);
+    }
+  }
+
+  // Returns the head of the list that the entry belongs to.
+  Entry** bucket(Entry* entry)
+  {
+    return entry->level == OVERFLOW
+      ? &overflow
+      : &slots[entry->level][entry->slot];
+  }
+
+  // The first tick that has not been processed yet.
+  int64_t position;
+
+  Entry* slots[LEVELS][SLOTS] = {};
+  uint64_t occupied[LEVELS] = {};
+  Entry* overflow = nullptr;
+
+  // For finding (and canceling) a timer by its id.
+  hashmap<uint64_t, Entry*> entries;
+
+  size_t size_;
+};
+
+
+static Timers* timers = new Timers();
 static recursive_mutex* timers_mutex = new recursive_mutex();
 
 
@@ -77,32 +493,36 @@ lambda::function<void(const list<Timer>&)>* callback =
 set<Time>* ticks = new set<Time>();
 
 
-// Helper for determining the time when the next timer elapses,
+// Helper for determining when the timers next need to be processed,
 // or None if no timers are pending, or the clock is paused and no
 // timers are expired. Note that we don't manipulate 'timers' directly
 // so that it's clear from the callsite that the use of 'timers' is
 // within a 'synchronized' block.
-//
-// TODO(benh): Create a generic 'Timers' abstraction which hides this
-// and more away (i.e., all manipulations of 'timers' below).
-Option<Time> next(const map<Time, list<Timer>>& timers)
+Option<Time> next(const Timers& timers)
 {
-  if (!timers.empty()) {
-    Time first = timers.begin()->first;
-
-    // If the clock is paused and no timers are expired, the
-    // timers cannot fire until the clock is advanced, so we
-    // return None() here. Note that we pass nullptr to ensure
-    // that this looks at the global clock, since this can be
-    // called from a Process context through Clock::timer.
-    if (Clock::paused() && first > Clock::now(nullptr)) {
-      return None();
-    }
-
-    return first;
+  const Option<Time> next = timers.next();
+
+  // If the clock is paused and no timers are expired, the timers
+  // cannot fire until the clock is advanced, so we return None()
+  // here. Note that we pass nullptr to ensure that this looks at the
+  // global clock, since this can be called from a Process context.
+  //
+  // NOTE: 'next' is not necessarily the time of a timer (see
+  // 'Timers::next'), but it is never later than the earliest timer.
+  if (next.isSome() && Clock::paused() && next.get() > Clock::now(nullptr)) {
+    return None();
   }
 
-  return None();
+  return next;
+}
+
+
+// Helper for determining whether no timers are expired at the
+// current (paused) time.
+bool settled(const Timers& timers)
+{
+  const Option<Time> earliest = timers.earliest();
+  return earliest.isNone() || earliest.get() > *clock::current;
 }
 
 
@@ -110,28 +530,35 @@ Option<Time> next(const map<Time, list<Timer>>& timers)
 void tick(const Time& time);
 
 
+// Helper for scheduling a clock tick at the specified time, unless
+// there is a 'tick' scheduled for an earlier time already (to avoid
+// excessive pending timers).
+void scheduleTick(const Time& time, set<Time>* ticks)
+{
+  if (ticks->empty() || time < (*ticks->begin())) {
+    ticks->insert(time);
+
+    // The delay can be negative if the timer is expired, this
+    // is expected will result in a 'tick' firing immediately.
+    const Duration delay = time - Clock::now(nullptr);
+    EventLoop::delay(delay, lambda::bind(tick, time));
+  }
+}
+
+
 // Helper for scheduling the next clock tick, if applicable. Note
 // that we don't manipulate 'timers' or 'ticks' directly so that
 // it's clear from the callsite that this needs to be called within
 // a 'synchronized' block.
 // TODO(bmahler): Consider taking an optional 'now' to avoid
 // excessive syscalls via Clock::now(nullptr).
-void scheduleTick(const map<Time, list<Timer>>& timers, set<Time>* ticks)
+void scheduleTick(const Timers& timers, set<Time>* ticks)
 {
   // Determine when the next 'tick' should fire.
   const Option<Time> next = clock::next(timers);
 
   if (next.isSome()) {
-    // Don't schedule a 'tick' if there is a 'tick' scheduled for
-    // an earlier time, to avoid excessive pending timers.
-    if (ticks->empty() || next.get() < (*ticks->begin())) {
-      ticks->insert(next.get());
-
-      // The delay can be negative if the timer is expired, this
-      // is expected will result in a 'tick' firing immediately.
-      const Duration delay = next.get() - Clock::now(nullptr);
-      EventLoop::delay(delay, lambda::bind(tick, next.get()));
-    }
+    scheduleTick(next.get(), ticks);
   }
 }
 
@@ -151,29 +578,15 @@ void tick(const Time& time)
 
     VLOG(3) << "Handling timers up to " << now;
 
-    foreachkey (const Time& timeout, *timers) {
-      if (timeout > now) {
-        break;
-      }
-
-      VLOG(3) << "Have timeout(s) at " << timeout;
+    timers->expire(now, &timedout);
 
-      // Need to toggle 'settling' so that we don't prematurely say
-      // we're settled until after the timers are executed below,
-      // outside of the critical section.
-      if (clock::paused) {
-        clock::settling = true;
-      }
-
-      timedout.splice(timedout.end(), (*timers)[timeout]);
+    // Need to toggle 'settling' so that we don't prematurely say
+    // we're settled until after the timers are executed below,
+    // outside of the critical section.
+    if (clock::paused && !timedout.empty()) {
+      clock::settling = true;
     }
 
-    // Now erase the range of timers that timed out.
-    timers->erase(timers->begin(), timers->upper_bound(now));
-
-    // Okay, so the timeout for the next timer should not have fired.
-    CHECK(timers->empty() || (timers->begin()->first > now));
-
     // Remove this tick from the scheduled 'ticks', it may have
     // been removed already if the clock was paused / manipulated
     // in the interim.
@@ -189,9 +602,7 @@ void tick(const Time& time)
   // that will expire before the paused time and we've finished
   // executing expired timers.
   synchronized (timers_mutex) {
-    if (clock::paused &&
-        (timers->size() == 0 ||
-         timers->begin()->first > *clock::current)) {
+    if (clock::paused && clock::settled(*timers)) {
       VLOG(3) << "Clock has settled";
       clock::settling = false;
     }
@@ -218,8 +629,8 @@ void Clock::finalize()
 
     // This, along with the `timers_mutex`, is all that is required to clean
     // up any pending timers.  Timers are triggered via "ticks".  However,
-    // we do not need to clear `ticks` because a "tick" with an empty `timers`
-    // map will effectively be a no-op.
+    // we do not need to clear `ticks` because a "tick" with empty `timers`
+    // will effectively be a no-op.
     timers->clear();
   }
 }
@@ -279,17 +690,16 @@ Timer Clock::timer(
 
   // Add the timer.
   synchronized (timers_mutex) {
-    if (timers->size() == 0 ||
-        timer.timeout().time() < timers->begin()->first) {
-      // Need to interrupt the loop to update/set timer repeat.
-      (*timers)[timer.timeout().time()].push_back(timer);
+    const Time now = Clock::now(nullptr);
 
-      // Schedule another "tick" if necessary.
-      clock::scheduleTick(*timers, clock::ticks);
-    } else {
-      // Timer repeat is adequate, just add the timeout.
-      CHECK(timers->size() >= 1);
-      (*timers)[timer.timeout().time()].push_back(timer);
+    timers->add(timer.id, timer, now);
+
+    // Schedule a "tick" for this timer if it's earlier than all the
+    // currently scheduled "ticks" (which are never later than any of
+    // the other timers). If the clock is paused only "ticks" that
+    // fire immediately are scheduled (see 'clock::next').
+    if (!clock::paused || timer.timeout().time() <= now) {
+      clock::scheduleTick(timer.timeout().time(), clock::ticks);
     }
   }
 
@@ -301,17 +711,8 @@ bool Clock::cancel(const Timer& timer)
 {
   bool canceled = false;
   synchronized (timers_mutex) {
-    // Check if the timeout is still pending, and if so, erase it. In
-    // addition, erase an empty list if we just removed the last
-    // timeout.
-    Time time = timer.timeout().time();
-    if (timers->count(time) > 0) {
-      canceled = true;
-      (*timers)[time].remove(timer);
-      if ((*timers)[time].empty()) {
-        timers->erase(time);
-      }
-    }
+    // Check if the timeout is still pending, and if so, erase it.
+    canceled = timers->remove(timer.id);
   }
 
   return canceled;
@@ -458,8 +859,7 @@ bool Clock::settled()
     if (clock::settling) {
       VLOG(3) << "Clock still not settled";
       return false;
-    } else if (timers->size() == 0 ||
-               timers->begin()->first > *clock::current) {
+    } else if (clock::settled(*timers)) {
       VLOG(3) << "Clock is settled";
       return true;
     }
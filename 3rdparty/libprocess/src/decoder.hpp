@@ -17,18 +17,24 @@
 
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <deque>
 #include <string>
 #include <vector>
 
 #include <process/http.hpp>
+#include <process/message.hpp>
+#include <process/pid.hpp>
 #include <process/socket.hpp>
 
 #include <stout/foreach.hpp>
 #include <stout/gzip.hpp>
+#include <stout/numify.hpp>
 #include <stout/option.hpp>
 #include <stout/try.hpp>
 
+#include "framing.hpp"
+
 
 namespace process {
 
@@ -37,8 +43,22 @@ namespace process {
 class DataDecoder
 {
 public:
-  explicit DataDecoder(const network::Socket& _s)
-    : s(_s), failure(false), request(nullptr)
+  // Requests with a body of more than this size (or of unknown size)
+  // get streamed if streaming is enabled (see below).
+  static const size_t STREAMING_THRESHOLD = 64 * 1024;
+
+  // If 'streaming' is true, requests with a large body (see
+  // STREAMING_THRESHOLD), except for libprocess messages and
+  // compressed requests, are returned as soon as their headers are
+  // decoded. They have the type PIPE and the decoder writes their
+  // body to the pipe as it decodes it, rather than buffering it.
+  explicit DataDecoder(const network::Socket& _s, bool _streaming = false)
+    : s(_s),
+      failure(false),
+      binary(false),
+      boundary(true),
+      streaming(_streaming),
+      request(nullptr)
   {
     settings.on_message_begin = &DataDecoder::on_message_begin;
 
@@ -62,13 +82,39 @@ public:
     parser.data = this;
   }
 
+  ~DataDecoder()
+  {
+    // Let the reader of a streamed request know that the rest of the
+    // body isn't going to arrive (e.g., the socket got closed).
+    if (writer.isSome()) {
+      writer->fail("Failed to decode the body of the request");
+    }
+  }
+
   std::deque<http::Request*> decode(const char* data, size_t length)
   {
-    size_t parsed = http_parser_execute(&parser, &settings, data, length);
+    size_t parsed = 0;
+
+    while (parsed < length && !failure) {
+      // Once the binary framing has been accepted the peer can switch
+      // to it at any message boundary (see framing.hpp).
+      if (!partial.empty() ||
+          (binary && boundary && framing::framed(data[parsed]))) {
+        parsed += frames(data + parsed, length - parsed);
+        continue;
+      }
 
-    if (parsed != length) {
-      // TODO(bmahler): joyent/http-parser exposes error reasons.
-      failure = true;
+      parsed += http_parser_execute(
+          &parser, &settings, data + parsed, length - parsed);
+
+      if (HTTP_PARSER_ERRNO(&parser) == HPE_PAUSED) {
+        // We paused at the end of a message (see
+        // 'on_message_complete') so check for a frame.
+        http_parser_pause(&parser, 0);
+      } else if (parsed != length) {
+        // TODO(bmahler): joyent/http-parser exposes error reasons.
+        failure = true;
+      }
     }
 
     if (!requests.empty()) {
@@ -80,6 +126,29 @@ public:
     return std::deque<http::Request*>();
   }
 
+  // Returns the messages that the previous calls to 'decode' got out
+  // of binary frames (see 'upgrade'). Since a peer only switches to
+  // binary frames once, these follow the requests that were returned
+  // by those same calls.
+  std::deque<Message*> messages()
+  {
+    std::deque<Message*> result;
+    result.swap(decoded);
+    return result;
+  }
+
+  // Accepts binary frames (see framing.hpp) from the peer, starting
+  // at any message boundary from now on.
+  void upgrade()
+  {
+    binary = true;
+  }
+
+  bool upgraded() const
+  {
+    return binary;
+  }
+
   bool failed() const
   {
     return failure;
@@ -91,16 +160,152 @@ public:
   }
 
 private:
+  // Decodes the binary frames at the start of the data, stopping at
+  // anything that's not a frame and buffering an incomplete frame at
+  // the end. Fails the decoding once a frame is declared to be larger
+  // than 'framing::MAX_FRAME_SIZE', rather than buffering it. Returns
+  // how much of the data was consumed.
+  size_t frames(const char* data, size_t length)
+  {
+    size_t consumed = 0;
+
+    // Complete the buffered frame first, copying no more than what's
+    // missing from it (note that at first that's only the header).
+    while (!partial.empty() && consumed < length) {
+      const size_t size = partial.size() < framing::HEADER_SIZE
+        ? framing::HEADER_SIZE
+        : framing::HEADER_SIZE + framing::extract(partial.data() + 1);
+
+      const size_t missing = std::min(size - partial.size(), length - consumed);
+
+      partial.append(data + consumed, missing);
+      consumed += missing;
+
+      if (partial.size() >= framing::HEADER_SIZE &&
+          framing::extract(partial.data() + 1) > framing::MAX_FRAME_SIZE) {
+        failure = true;
+        return consumed;
+      }
+
+      if (partial.size() >= framing::HEADER_SIZE &&
+          partial.size() ==
+            framing::HEADER_SIZE + framing::extract(partial.data() + 1)) {
+        if (!handle(partial.data())) {
+          return consumed;
+        }
+        partial.clear();
+      }
+    }
+
+    while (partial.empty() &&
+           consumed < length &&
+           framing::framed(data[consumed])) {
+      const size_t available = length - consumed;
+
+      if (available >= framing::HEADER_SIZE &&
+          framing::extract(data + consumed + 1) > framing::MAX_FRAME_SIZE) {
+        failure = true;
+        return consumed;
+      }
+
+      if (available < framing::HEADER_SIZE ||
+          available - framing::HEADER_SIZE <
+            framing::extract(data + consumed + 1)) {
+        partial.assign(data + consumed, available);
+        return length;
+      }
+
+      if (!handle(data + consumed)) {
+        return consumed;
+      }
+
+      consumed += framing::HEADER_SIZE + framing::extract(data + consumed + 1);
+    }
+
+    return consumed;
+  }
+
+  // Handles a complete frame, returns false if it's malformed.
+  bool handle(const char* frame)
+  {
+    const uint32_t length = framing::extract(frame + 1);
+    const char* data = frame + framing::HEADER_SIZE;
+
+    switch (frame[0]) {
+      case framing::DEFINE: {
+        if (length < sizeof(uint32_t)) {
+          break;
+        }
+
+        const uint32_t symbol = framing::extract(data);
+
+        if (symbol > symbols.size() || symbol >= framing::MAX_SYMBOLS) {
+          break;
+        }
+
+        if (symbol == symbols.size()) {
+          symbols.emplace_back();
+        }
+
+        symbols[symbol].value.assign(
+            data + sizeof(uint32_t),
+            length - sizeof(uint32_t));
+
+        symbols[symbol].pid = None();
+
+        return true;
+      }
+      case framing::MESSAGE: {
+        if (length < framing::MESSAGE_SYMBOLS_SIZE) {
+          break;
+        }
+
+        const uint32_t from = framing::extract(data);
+        const uint32_t to = framing::extract(data + 4);
+        const uint32_t name = framing::extract(data + 8);
+
+        if (from >= symbols.size() ||
+            to >= symbols.size() ||
+            name >= symbols.size()) {
+          break;
+        }
+
+        // Only parse the sender's PID once for all of its messages.
+        if (symbols[from].pid.isNone()) {
+          symbols[from].pid = UPID(symbols[from].value);
+        }
+
+        Message* message = new Message();
+        message->name = symbols[name].value;
+        message->from = symbols[from].pid.get();
+        message->to.id = symbols[to].value;
+        message->body.assign(
+            data + framing::MESSAGE_SYMBOLS_SIZE,
+            length - framing::MESSAGE_SYMBOLS_SIZE);
+
+        decoded.push_back(message);
+
+        return true;
+      }
+    }
+
+    failure = true;
+    return false;
+  }
+
   static int on_message_begin(http_parser* p)
   {
     DataDecoder* decoder = (DataDecoder*) p->data;
 
     CHECK(!decoder->failure);
 
+    decoder->boundary = false;
+
     decoder->header = HEADER_FIELD;
     decoder->field.clear();
     decoder->value.clear();
     decoder->query.clear();
+    decoder->url.clear();
 
     CHECK(decoder->request == nullptr);
 
@@ -154,14 +359,25 @@ private:
   {
     DataDecoder* decoder = (DataDecoder*) p->data;
     CHECK_NOTNULL(decoder->request);
-    int result = 0;
+
+    // NOTE: The URL can arrive in pieces when it's split across the
+    // data passed to 'decode', so we only parse it once it's complete
+    // (see 'on_headers_complete').
+    decoder->url.append(data, length);
+    return 0;
+  }
 
 #if (HTTP_PARSER_VERSION_MAJOR >= 2)
-    // Reworked parsing for version >= 2.0.
+  // Reworked parsing for version >= 2.0.
+  static int parse_url(DataDecoder* decoder)
+  {
     http_parser_url url;
-    result = http_parser_parse_url(data, length, 0, &url);
+    int result = http_parser_parse_url(
+        decoder->url.data(), decoder->url.size(), 0, &url);
 
     if (result == 0) {
+      const char* data = decoder->url.data();
+
       if (url.field_set & (1 << UF_PATH)) {
         decoder->request->url.path.append(
             data + url.field_data[UF_PATH].off,
@@ -183,10 +399,10 @@ private:
             url.field_data[UF_QUERY].len);
       }
     }
-#endif
 
     return result;
   }
+#endif
 
   static int on_header_field(http_parser* p, const char* data, size_t length)
   {
@@ -225,17 +441,85 @@ private:
     decoder->field.clear();
     decoder->value.clear();
 
+#if (HTTP_PARSER_VERSION_MAJOR >= 2)
+    // NOTE: Returning 1 here would tell the parser to skip the body,
+    // any other non-zero value is an error.
+    if (parse_url(decoder) != 0) {
+      return -1;
+    }
+#endif
+
     decoder->request->method =
       http_method_str((http_method) decoder->parser.method);
 
     decoder->request->keepAlive = http_should_keep_alive(&decoder->parser);
 
+    if (decoder->streaming && stream(*decoder->request)) {
+      Try<hashmap<std::string, std::string>> decoded =
+        http::query::decode(decoder->query);
+
+      if (decoded.isError()) {
+        return -1;
+      }
+
+      decoder->request->url.query = decoded.get();
+
+      http::Pipe pipe;
+      decoder->writer = pipe.writer();
+
+      decoder->request->type = http::Request::PIPE;
+      decoder->request->reader = pipe.reader();
+
+      decoder->requests.push_back(decoder->request);
+      decoder->request = nullptr;
+    }
+
     return 0;
   }
 
+  // Returns whether the body of the request should be streamed.
+  static bool stream(const http::Request& request)
+  {
+    // Libprocess messages are delivered as a whole.
+    if (request.headers.contains("Libprocess-From")) {
+      return false;
+    }
+
+    Option<std::string> agent = request.headers.get("User-Agent");
+    if (agent.isSome() && agent->find("libprocess/") == 0) {
+      return false;
+    }
+
+    // Compressed bodies are decompressed as a whole.
+    if (request.headers.contains("Content-Encoding")) {
+      return false;
+    }
+
+    if (request.headers.contains("Transfer-Encoding")) {
+      return true;
+    }
+
+    Option<std::string> length = request.headers.get("Content-Length");
+    if (length.isNone()) {
+      return false;
+    }
+
+    Try<size_t> size = numify<size_t>(length.get());
+
+    return size.isSome() && size.get() > STREAMING_THRESHOLD;
+  }
+
   static int on_body(http_parser* p, const char* data, size_t length)
   {
     DataDecoder* decoder = (DataDecoder*) p->data;
+
+    if (decoder->writer.isSome()) {
+      // NOTE: The write fails if the reader closed the pipe, which
+      // means that the rest of the body can be dropped.
+      decoder->writer->write(std::string(data, length));
+      return 0;
+    }
+
     CHECK_NOTNULL(decoder->request);
     decoder->request->body.append(data, length);
     return 0;
@@ -245,6 +529,19 @@ private:
   {
     DataDecoder* decoder = (DataDecoder*) p->data;
 
+    if (decoder->writer.isSome()) {
+      decoder->writer->close();
+      decoder->writer = None();
+
+      decoder->boundary = true;
+
+      if (decoder->binary) {
+        http_parser_pause(p, 1);
+      }
+
+      return 0;
+    }
+
     // Parse the query key/values.
     Try<hashmap<std::string, std::string>> decoded =
       http::query::decode(decoder->query);
@@ -272,6 +569,15 @@ private:
 
     decoder->requests.push_back(decoder->request);
     decoder->request = nullptr;
+
+    decoder->boundary = true;
+
+    // Stop parsing so that 'decode' can check whether the next
+    // message is a binary frame.
+    if (decoder->binary) {
+      http_parser_pause(p, 1);
+    }
+
     return 0;
   }
 
@@ -279,6 +585,34 @@ private:
 
   bool failure;
 
+  // Whether binary frames are accepted (see 'upgrade').
+  bool binary;
+
+  // Whether we're in between two messages.
+  bool boundary;
+
+  // Whether the bodies of large requests get streamed.
+  const bool streaming;
+
+  // The write end of the pipe of the request that's being streamed.
+  Option<http::Pipe::Writer> writer;
+
+  // An incomplete binary frame.
+  std::string partial;
+
+  // The strings that the peer has defined for its binary frames.
+  struct Symbol
+  {
+    std::string value;
+
+    // The value parsed as a PID, once it's been used as a sender.
+    Option<UPID> pid;
+  };
+
+  std::vector<Symbol> symbols;
+
+  std::deque<Message*> decoded;
+
   http_parser parser;
   http_parser_settings settings;
 
@@ -291,6 +625,7 @@ private:
   std::string field;
   std::string value;
   std::string query;
+  std::string url;
 
   http::Request* request;
 
@@ -14,13 +14,19 @@
 #define __ENCODER_HPP__
 
 #include <stdint.h>
+#include <stdio.h>
 #include <time.h>
 
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include <sstream>
+#include <string>
+#include <vector>
 
 #include <process/http.hpp>
 #include <process/process.hpp>
+#include <process/socket.hpp>
 
 #include <stout/foreach.hpp>
 #include <stout/gzip.hpp>
@@ -28,11 +34,18 @@
 #include <stout/numify.hpp>
 #include <stout/os.hpp>
 
+#include "framing.hpp"
+
 
 namespace process {
 
 const uint32_t GZIP_MINIMUM_BODY_LENGTH = 1024;
 
+// Terminates the (single) chunk of a message's body as well as the
+// chunked body itself (see 'MessageEncoder').
+const char MESSAGE_TRAILER[] = "\r\n0\r\n\r\n";
+const size_t MESSAGE_TRAILER_SIZE = sizeof(MESSAGE_TRAILER) - 1;
+
 // Forward declarations.
 class Encoder;
 
@@ -43,7 +56,8 @@ public:
   enum Kind
   {
     DATA,
-    FILE
+    FILE,
+    MESSAGE
   };
 
   explicit Encoder(const network::Socket& _s) : s(_s) {}
@@ -104,11 +118,150 @@ private:
 };
 
 
-class MessageEncoder : public DataEncoder
+// The (sending) state of the framing of the messages sent on a
+// connection, see framing.hpp.
+//
+// NOTE: Only the MessageEncoder that is currently being sent on the
+// connection gets to 'encode' (i.e., one at a time and in the order
+// in which the messages go out), while the response to the offer
+// gets read concurrently.
+class MessageFraming
+{
+public:
+  MessageFraming() : accepted(false), offered(false), symbols(0) {}
+
+  // Returns true once the receiver has accepted the binary framing.
+  bool binary() const
+  {
+    return accepted.load();
+  }
+
+  // Returns true exactly once, for the first message that gets sent
+  // with the HTTP framing, which then makes the offer.
+  bool offer()
+  {
+    if (offered) {
+      return false;
+    }
+
+    offered = true;
+    return true;
+  }
+
+  // Consumes data read from the connection, which starts with the
+  // acknowledgement of the offer if the receiver accepted it. Returns
+  // false once it is known whether the offer was accepted, after
+  // which any other data is meant to be ignored.
+  bool received(const char* data, size_t length)
+  {
+    const size_t size = std::min(
+        length,
+        framing::ACCEPT_SIZE - acknowledgement.size());
+
+    acknowledgement.append(data, size);
+
+    if (acknowledgement.compare(
+            0,
+            acknowledgement.size(),
+            framing::ACCEPT,
+            acknowledgement.size()) != 0) {
+      return false;
+    }
+
+    if (acknowledgement.size() == framing::ACCEPT_SIZE) {
+      accepted.store(true);
+      return false;
+    }
+
+    return true;
+  }
+
+  // Appends the binary framing of the message, but for the body, to
+  // 'out', preceded by definitions of any of its strings that don't
+  // have a symbol yet.
+  void encode(const Message& message, std::string* out)
+  {
+    // Start over if we'd run out of symbols in the middle of the
+    // message, since the message's symbols must all be valid.
+    if (symbols > framing::MAX_SYMBOLS - 3) {
+      pids.clear();
+      strings.clear();
+      symbols = 0;
+    }
+
+    const uint32_t from = intern(message.from, out);
+    const uint32_t to = intern(message.to.id, out);
+    const uint32_t name = intern(message.name, out);
+
+    out->push_back(framing::MESSAGE);
+    framing::append(
+        framing::MESSAGE_SYMBOLS_SIZE + message.body.size(), out);
+    framing::append(from, out);
+    framing::append(to, out);
+    framing::append(name, out);
+  }
+
+private:
+  uint32_t intern(const UPID& pid, std::string* out)
+  {
+    auto iterator = pids.find(pid);
+    if (iterator != pids.end()) {
+      return iterator->second;
+    }
+
+    const uint32_t symbol = define(pid, out);
+    pids[pid] = symbol;
+    return symbol;
+  }
+
+  uint32_t intern(const std::string& value, std::string* out)
+  {
+    auto iterator = strings.find(value);
+    if (iterator != strings.end()) {
+      return iterator->second;
+    }
+
+    const uint32_t symbol = define(value, out);
+    strings[value] = symbol;
+    return symbol;
+  }
+
+  uint32_t define(const std::string& value, std::string* out)
+  {
+    const uint32_t symbol = symbols++;
+
+    out->push_back(framing::DEFINE);
+    framing::append(sizeof(symbol) + value.size(), out);
+    framing::append(symbol, out);
+    out->append(value);
+
+    return symbol;
+  }
+
+  std::atomic_bool accepted;
+
+  // The acknowledgement read so far.
+  std::string acknowledgement;
+
+  bool offered;
+
+  // The symbols of the strings (and of the PIDs, to avoid turning the
+  // sender of every message into a string) defined so far.
+  hashmap<UPID, uint32_t> pids;
+  hashmap<std::string, uint32_t> strings;
+  uint32_t symbols;
+};
+
+
+class MessageEncoder : public Encoder
 {
 public:
   MessageEncoder(const network::Socket& s, Message* _message)
-    : DataEncoder(s, encode(_message)), message(_message) {}
+    : Encoder(s),
+      message(_message),
+      encoded(false),
+      trailer(0),
+      index(0) {}
 
   virtual ~MessageEncoder()
   {
@@ -117,44 +270,203 @@ public:
     }
   }
 
+  virtual Kind kind() const
+  {
+    return Encoder::MESSAGE;
+  }
+
+  // Returns the message that is being sent.
+  const Message* get() const
+  {
+    return message;
+  }
+
+  // Appends the buffers holding the remaining data to 'buffers',
+  // which refer directly to the message's body rather than a copy of
+  // it, and returns the size of that data. Like 'DataEncoder::next'
+  // this consumes all of the remaining data, use 'backup' for what
+  // didn't get sent.
+  //
+  // The message gets encoded by the first call, with the binary
+  // framing if the connection's 'framing' (if any) has switched to
+  // it and with the HTTP framing otherwise.
+  size_t next(
+      std::vector<network::Socket::Buffer>* buffers,
+      MessageFraming* framing = nullptr)
+  {
+    if (!encoded) {
+      encode(framing);
+    }
+
+    const std::string* body = message != nullptr ? &message->body : nullptr;
+
+    // The message consists of the header, the body (as one chunk in
+    // the HTTP framing), and the trailer (terminating the chunked
+    // body), if any.
+    const size_t sizes[] = {
+      header.size(),
+      body != nullptr ? body->size() : 0,
+      trailer
+    };
+
+    const char* data[] = {
+      header.data(),
+      body != nullptr ? body->data() : nullptr,
+      MESSAGE_TRAILER
+    };
+
+    size_t offset = index;
+
+    for (size_t i = 0; i < 3; i++) {
+      if (offset < sizes[i]) {
+        buffers->push_back({data[i] + offset, sizes[i] - offset});
+        offset = 0;
+      } else {
+        offset -= sizes[i];
+      }
+    }
+
+    const size_t remaining = size() - index;
+
+    index = size();
+
+    return remaining;
+  }
+
+  virtual void backup(size_t length)
+  {
+    if (index >= length) {
+      index -= length;
+    }
+  }
+
+  // NOTE: until the message gets encoded (see 'next') this is the size
+  // of its HTTP framing without the offer of the binary framing, since
+  // the framing only gets chosen once it's sent on a connection.
+  virtual size_t remaining() const
+  {
+    if (!encoded) {
+      const size_t body = message != nullptr ? message->body.size() : 0;
+      return encode(message, false, false).size() +
+             body +
+             (body > 0 ? MESSAGE_TRAILER_SIZE : 0);
+    }
+
+    return size() - index;
+  }
+
   static std::string encode(Message* message)
   {
-    std::ostringstream out;
+    std::string data = encode(message, true, false);
+
+    if (message != nullptr && message->body.size() > 0) {
+      data.append(MESSAGE_TRAILER, MESSAGE_TRAILER_SIZE);
+    }
+
+    return data;
+  }
+
+private:
+  void encode(MessageFraming* framing)
+  {
+    encoded = true;
+
+    // NOTE: A body that's too large for a frame (see
+    // 'framing::MAX_FRAME_SIZE') gets sent with the HTTP framing which
+    // the receiver accepts at any time.
+    if (framing != nullptr &&
+        framing->binary() &&
+        message != nullptr &&
+        message->body.size() <=
+          framing::MAX_FRAME_SIZE - framing::MESSAGE_SYMBOLS_SIZE) {
+      framing->encode(*message, &header);
+      return;
+    }
+
+    header = encode(message, false, framing != nullptr && framing->offer());
+
+    if (message != nullptr && message->body.size() > 0) {
+      trailer = MESSAGE_TRAILER_SIZE;
+    }
+  }
+
+  // Returns the HTTP framing of everything but the trailer, with the
+  // body only if 'includeBody' is true and with the offer of the
+  // binary framing if 'offer' is true.
+  static std::string encode(Message* message, bool includeBody, bool offer)
+  {
+    std::string out;
 
     if (message != nullptr) {
-      out << "POST ";
+      const std::string from = message->from;
+
+      out.reserve(
+          128 +
+          message->to.id.size() +
+          message->name.size() +
+          2 * from.size() +
+          (includeBody ? message->body.size() : 0));
+
+      out.append("POST ");
       // Nothing keeps the 'id' component of a PID from being an empty
       // string which would create a malformed path that has two
       // '//' unless we check for it explicitly.
       // TODO(benh): Make the 'id' part of a PID optional so when it's
       // missing it's clear that we're simply addressing an ip:port.
       if (message->to.id != "") {
-        out << "/" << message->to.id;
+        out.append("/");
+        out.append(message->to.id);
       }
 
-      out << "/" << message->name << " HTTP/1.1\r\n"
-          << "User-Agent: libprocess/" << message->from << "\r\n"
-          << "Libprocess-From: " << message->from << "\r\n"
-          << "Connection: Keep-Alive\r\n"
-          << "Host: \r\n";
+      out.append("/");
+      out.append(message->name);
+      out.append(" HTTP/1.1\r\n");
+      out.append("User-Agent: libprocess/");
+      out.append(from);
+      out.append("\r\n");
+      out.append("Libprocess-From: ");
+      out.append(from);
+      out.append("\r\n");
+      out.append("Connection: Keep-Alive\r\n");
+      out.append("Host: \r\n");
+
+      if (offer) {
+        out.append(framing::OFFER_HEADER);
+        out.append(": ");
+        out.append(framing::OFFER);
+        out.append("\r\n");
+      }
 
       if (message->body.size() > 0) {
-        out << "Transfer-Encoding: chunked\r\n\r\n"
-            << std::hex << message->body.size() << "\r\n";
-        out.write(message->body.data(), message->body.size());
-        out << "\r\n"
-            << "0\r\n"
-            << "\r\n";
+        char size[32];
+        snprintf(size, sizeof(size), "%zx", message->body.size());
+
+        out.append("Transfer-Encoding: chunked\r\n\r\n");
+        out.append(size);
+        out.append("\r\n");
+
+        if (includeBody) {
+          out.append(message->body);
+        }
       } else {
-        out << "\r\n";
+        out.append("\r\n");
       }
     }
 
-    return out.str();
+    return out;
+  }
+
+  size_t size() const
+  {
+    const size_t body = message != nullptr ? message->body.size() : 0;
+    return header.size() + body + trailer;
   }
 
-private:
   Message* message;
+  bool encoded;
+  std::string header;
+  size_t trailer;
+  size_t index;
 };
 
 
@@ -0,0 +1,478 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include <process/future.hpp>
+#include <process/io.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/lambda.hpp>
+#include <stout/numify.hpp>
+#include <stout/os.hpp>
+#include <stout/option.hpp>
+#include <stout/stringify.hpp>
+#include <stout/synchronized.hpp>
+#include <stout/thread_local.hpp>
+#include <stout/try.hpp>
+
+#include <stout/os/strerror.hpp>
+
+#include "epoll.hpp"
+#include "event_loop.hpp"
+
+using std::string;
+using std::vector;
+
+namespace process {
+namespace epoll {
+
+std::vector<Loop*>* loops = new std::vector<Loop*>();
+
+THREAD_LOCAL Loop* __loop__ = nullptr;
+
+
+// The 'epoll_event.data' of the eventfd used to interrupt a loop.
+// File descriptors are registered with their generation in the upper
+// 32 bits and the file descriptor in the lower 32 bits, so they can
+// never collide with this value.
+static const uint64_t WAKEUP = ~uint64_t(0);
+
+
+// Returns the current monotonic time in seconds, for the delays.
+static double monotonic()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+
+Loop::Loop()
+  : efd(::epoll_create1(EPOLL_CLOEXEC)),
+    wakeup(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+    stopping(false),
+    generation(0)
+{
+  PCHECK(efd >= 0) << "Failed to create epoll instance";
+  PCHECK(wakeup >= 0) << "Failed to create eventfd";
+
+  // NOTE: unlike the other file descriptors the eventfd is registered
+  // level-triggered since it's read (i.e., reset) before the queued
+  // functions are swapped out (see 'drain').
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.u64 = WAKEUP;
+
+  PCHECK(::epoll_ctl(efd, EPOLL_CTL_ADD, wakeup, &event) == 0)
+    << "Failed to register eventfd";
+}
+
+
+Loop::~Loop()
+{
+  ::close(wakeup);
+  ::close(efd);
+}
+
+
+void Loop::run()
+{
+  __loop__ = this;
+
+  struct epoll_event events[MAX_EVENTS];
+
+  while (!stopping.load()) {
+    int count = ::epoll_wait(efd, events, MAX_EVENTS, timeout());
+
+    if (count < 0) {
+      PCHECK(errno == EINTR) << "Failed to epoll_wait";
+      continue;
+    }
+
+    bool interrupted = false;
+
+    for (int i = 0; i < count; i++) {
+      if (events[i].data.u64 == WAKEUP) {
+        interrupted = true;
+      } else {
+        handle(events[i].data.u64, events[i].events);
+      }
+    }
+
+    // Invoke the queued functions after the I/O events of this batch
+    // so that a file descriptor that is being watched as part of one
+    // of the functions doesn't get an event of this batch.
+    if (interrupted) {
+      drain();
+    }
+
+    expire();
+  }
+
+  __loop__ = nullptr;
+}
+
+
+void Loop::stop()
+{
+  stopping.store(true);
+
+  eventfd_write(wakeup, 1);
+}
+
+
+void Loop::dispatch(lambda::function<void()>&& function)
+{
+  if (__loop__ == this) {
+    function();
+    return;
+  }
+
+  bool interrupt = false;
+
+  synchronized (mutex) {
+    // Only interrupt the loop if there weren't any functions queued
+    // already, otherwise the loop has been interrupted and has not
+    // swapped out the queued functions yet.
+    interrupt = functions.empty();
+    functions.push(std::move(function));
+  }
+
+  if (interrupt) {
+    eventfd_write(wakeup, 1);
+  }
+}
+
+
+void Loop::delay(
+    const Duration& duration,
+    lambda::function<void()>&& function)
+{
+  CHECK_EQ(this, __loop__);
+
+  delays.emplace(monotonic() + duration.secs(), std::move(function));
+}
+
+
+void Loop::watch(int fd, const std::shared_ptr<Waiter>& waiter)
+{
+  CHECK_EQ(this, __loop__);
+
+  if (!descriptors.contains(fd)) {
+    Descriptor descriptor;
+    descriptor.generation = ++generation;
+    descriptor.armed = 0;
+    descriptors.put(fd, descriptor);
+  }
+
+  Descriptor* descriptor = &descriptors.at(fd);
+  descriptor->waiters.push_back(waiter);
+
+  arm(fd, descriptor);
+}
+
+
+void Loop::unwatch(int fd, const std::shared_ptr<Waiter>& waiter)
+{
+  CHECK_EQ(this, __loop__);
+
+  if (descriptors.contains(fd)) {
+    vector<std::shared_ptr<Waiter>>& waiters = descriptors.at(fd).waiters;
+
+    for (auto it = waiters.begin(); it != waiters.end(); ++it) {
+      if (*it == waiter) {
+        waiters.erase(it);
+        waiter->promise.discard();
+        break;
+      }
+    }
+
+    // NOTE: we leave the file descriptor armed if there are no more
+    // waiters, once it's ready the event just gets ignored.
+    if (waiters.empty()) {
+      descriptors.erase(fd);
+    }
+  }
+}
+
+
+void Loop::arm(int fd, Descriptor* descriptor)
+{
+  uint32_t interest = 0;
+
+  foreach (const std::shared_ptr<Waiter>& waiter, descriptor->waiters) {
+    if (waiter->events & io::READ) {
+      interest |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (waiter->events & io::WRITE) {
+      interest |= EPOLLOUT;
+    }
+  }
+
+  // Nothing to do if the file descriptor is armed already for all of
+  // the requested events.
+  if ((descriptor->armed & interest) == interest) {
+    return;
+  }
+
+  interest |= descriptor->armed;
+
+  struct epoll_event event;
+  event.events = interest | EPOLLET | EPOLLONESHOT;
+  event.data.u64 = (uint64_t(descriptor->generation) << 32) | uint32_t(fd);
+
+  // NOTE: re-arming a registration checks whether the file descriptor
+  // is ready already, so we can't miss an edge that happened while
+  // the registration was disarmed. If the file descriptor has not
+  // been registered yet, or it was closed (which removes it from the
+  // epoll instance) and then reused, there is nothing to modify and
+  // we need to add it instead.
+  int result = ::epoll_ctl(efd, EPOLL_CTL_MOD, fd, &event);
+
+  if (result < 0 && errno == ENOENT) {
+    result = ::epoll_ctl(efd, EPOLL_CTL_ADD, fd, &event);
+  }
+
+  if (result == 0) {
+    descriptor->armed = interest;
+    return;
+  }
+
+  // Either the file descriptor does not support polling (EPERM), in
+  // which case it's always ready (e.g., a regular file), or it's not
+  // valid, in which case the waiters can only fail.
+  const int error = errno;
+
+  vector<std::shared_ptr<Waiter>> waiters;
+  std::swap(waiters, descriptor->waiters);
+  descriptors.erase(fd);
+
+  foreach (const std::shared_ptr<Waiter>& waiter, waiters) {
+    if (error == EPERM) {
+      waiter->promise.set(waiter->events);
+    } else {
+      waiter->promise.fail(
+          "Failed to poll file descriptor " + stringify(fd) + ": " +
+          os::strerror(error));
+    }
+  }
+}
+
+
+void Loop::handle(uint64_t data, uint32_t events)
+{
+  const int fd = static_cast<int>(data & 0xffffffff);
+  const uint32_t generation = static_cast<uint32_t>(data >> 32);
+
+  // Ignore the event if nobody is waiting on the file descriptor
+  // anymore, or if it's for a stale registration of a file
+  // description that was closed after the file descriptor was
+  // duplicated (e.g., into a forked child), since then the
+  // registration can outlive the file descriptor (see epoll(7)).
+  if (!descriptors.contains(fd) ||
+      descriptors.at(fd).generation != generation) {
+    return;
+  }
+
+  Descriptor* descriptor = &descriptors.at(fd);
+
+  // The registration is disarmed after reporting an event.
+  descriptor->armed = 0;
+
+  short ready = 0;
+
+  if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+    ready |= io::READ;
+  }
+
+  if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+    ready |= io::WRITE;
+  }
+
+  vector<std::shared_ptr<Waiter>> satisfied;
+  vector<std::shared_ptr<Waiter>> waiters;
+
+  foreach (const std::shared_ptr<Waiter>& waiter, descriptor->waiters) {
+    if (waiter->events & ready) {
+      satisfied.push_back(waiter);
+    } else {
+      waiters.push_back(waiter);
+    }
+  }
+
+  if (waiters.empty()) {
+    descriptors.erase(fd);
+  } else {
+    descriptor->waiters = waiters;
+    arm(fd, descriptor);
+  }
+
+  // NOTE: the promises are satisfied last since their callbacks can
+  // watch this file descriptor again.
+  foreach (const std::shared_ptr<Waiter>& waiter, satisfied) {
+    waiter->promise.set(static_cast<short>(waiter->events & ready));
+  }
+}
+
+
+void Loop::drain()
+{
+  eventfd_t value;
+  eventfd_read(wakeup, &value);
+
+  std::queue<lambda::function<void()>> run;
+
+  synchronized (mutex) {
+    std::swap(run, functions);
+  }
+
+  // We invoke the functions outside of the mutex since they can take
+  // arbitrarily long and might call 'dispatch' themselves (see also
+  // 'handle_async' in libev.cpp).
+  while (!run.empty()) {
+    run.front()();
+    run.pop();
+  }
+}
+
+
+int Loop::timeout()
+{
+  if (delays.empty()) {
+    return -1;
+  }
+
+  const double remaining = delays.begin()->first - monotonic();
+
+  if (remaining <= 0) {
+    return 0;
+  }
+
+  // Round up so that we don't wake up right before the delay expires.
+  return static_cast<int>(std::ceil(remaining * 1000));
+}
+
+
+void Loop::expire()
+{
+  if (delays.empty()) {
+    return;
+  }
+
+  const double now = monotonic();
+
+  // NOTE: the delayed functions can add new delays.
+  while (!delays.empty() && delays.begin()->first <= now) {
+    lambda::function<void()> function = std::move(delays.begin()->second);
+    delays.erase(delays.begin());
+    function();
+  }
+}
+
+} // namespace epoll {
+
+
+void EventLoop::initialize()
+{
+  size_t count = 1;
+
+  // Allow the number of event loop threads to be configured so that
+  // processes with a very large number of connections (e.g., a
+  // master with tens of thousands of agents) can spread the socket
+  // I/O across multiple cores.
+  constexpr char env_var[] = "LIBPROCESS_NUM_EVENT_LOOP_THREADS";
+  Option<string> value = os::getenv(env_var);
+  if (value.isSome()) {
+    constexpr size_t maxval = 128;
+    Try<size_t> number = numify<size_t>(value.get().c_str());
+    if (number.isSome() && number.get() > 0 && number.get() <= maxval) {
+      VLOG(1) << "Using " << number.get() << " event loop threads";
+      count = number.get();
+    } else {
+      LOG(WARNING) << "Ignoring invalid value " << value.get()
+                   << " for " << env_var
+                   << ", using default value " << count
+                   << ". Valid values are integers in the range 1 to "
+                   << maxval;
+    }
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    epoll::loops->push_back(new epoll::Loop());
+  }
+}
+
+
+void EventLoop::delay(
+    const Duration& duration,
+    const lambda::function<void()>& function)
+{
+  epoll::Loop* loop = epoll::loops->front();
+
+  loop->dispatch([=]() {
+    lambda::function<void()> f = function;
+    loop->delay(duration, std::move(f));
+  });
+}
+
+
+double EventLoop::time()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_REALTIME, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+
+void EventLoop::run()
+{
+  // The first loop runs on this thread, the other loops each get
+  // their own thread.
+  vector<std::thread> threads;
+
+  for (size_t i = 1; i < epoll::loops->size(); i++) {
+    threads.emplace_back(&epoll::Loop::run, (*epoll::loops)[i]);
+  }
+
+  epoll::loops->front()->run();
+
+  foreach (std::thread& thread, threads) {
+    thread.join();
+  }
+}
+
+
+void EventLoop::stop()
+{
+  foreach (epoll::Loop* loop, *epoll::loops) {
+    loop->stop();
+  }
+}
+
+} // namespace process {
@@ -0,0 +1,147 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __EPOLL_HPP__
+#define __EPOLL_HPP__
+
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+#include <process/future.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/lambda.hpp>
+#include <stout/thread_local.hpp>
+
+namespace process {
+namespace epoll {
+
+// A native Linux event loop built directly on epoll.
+//
+// File descriptors are registered edge-triggered and "one-shot": a
+// registration reports readiness (at most) once and then stays
+// disarmed until it's re-armed for the next 'io::poll', which means
+// that a file descriptor only costs a single 'epoll_ctl' per poll
+// and never gets reported again while nobody is waiting on it. The
+// events are processed in batches of up to 'MAX_EVENTS' per call to
+// 'epoll_wait'.
+//
+// There can be more than one loop, each run by its own thread, in
+// which case the file descriptors are sharded across the loops (see
+// 'epoll::loop(fd)') so that socket I/O is not limited to a single
+// core. All delays (i.e., 'EventLoop::delay') are run by the first
+// loop.
+class Loop
+{
+public:
+  Loop();
+  ~Loop();
+
+  // Runs the loop until 'stop' is called.
+  void run();
+
+  // Asynchronously tells the loop to stop and then returns.
+  void stop();
+
+  // Invokes the function in this loop, immediately if this is already
+  // the thread running this loop.
+  void dispatch(lambda::function<void()>&& function);
+
+  // Invokes the function in this loop after the specified duration.
+  void delay(const Duration& duration, lambda::function<void()>&& function);
+
+  // A pending 'io::poll' on a file descriptor.
+  struct Waiter
+  {
+    explicit Waiter(short _events) : events(_events) {}
+
+    const short events; // The requested io::READ and/or io::WRITE.
+    Promise<short> promise;
+  };
+
+  // Satisfies the waiter's promise once the file descriptor is ready
+  // for any of the waiter's events. Must be called within this loop.
+  void watch(int fd, const std::shared_ptr<Waiter>& waiter);
+
+  // Discards the waiter's promise, unless it has been satisfied
+  // already. Must be called within this loop.
+  void unwatch(int fd, const std::shared_ptr<Waiter>& waiter);
+
+private:
+  // The waiters of a file descriptor.
+  struct Descriptor
+  {
+    // Distinguishes a registration of this file descriptor from a
+    // stale registration of an earlier file description that was
+    // assigned the same file descriptor (see 'handle').
+    uint32_t generation;
+
+    // The epoll events the file descriptor is currently armed for,
+    // or 0 if it's disarmed.
+    uint32_t armed;
+
+    std::vector<std::shared_ptr<Waiter>> waiters;
+  };
+
+  static const int MAX_EVENTS = 1024;
+
+  void arm(int fd, Descriptor* descriptor);
+  void handle(uint64_t data, uint32_t events);
+  void drain();
+  int timeout();
+  void expire();
+
+  const int efd; // The epoll file descriptor.
+  const int wakeup; // An eventfd for interrupting 'epoll_wait'.
+
+  std::atomic_bool stopping;
+
+  // Only accessed by the thread running this loop.
+  hashmap<int, Descriptor> descriptors;
+  uint32_t generation;
+
+  // The delayed functions, by the (monotonic) time at which they
+  // need to be invoked. Only accessed by the thread running this
+  // loop.
+  std::multimap<double, lambda::function<void()>> delays;
+
+  // Functions to be invoked in this loop (see 'dispatch').
+  std::mutex mutex;
+  std::queue<lambda::function<void()>> functions;
+};
+
+
+// The event loops, created by 'EventLoop::initialize'.
+extern std::vector<Loop*>* loops;
+
+
+// The loop that runs on the calling thread, if any.
+extern THREAD_LOCAL Loop* __loop__;
+
+
+// Returns the loop responsible for the file descriptor.
+inline Loop* loop(int fd)
+{
+  return (*loops)[static_cast<size_t>(fd) % loops->size()];
+}
+
+} // namespace epoll {
+} // namespace process {
+
+#endif // __EPOLL_HPP__
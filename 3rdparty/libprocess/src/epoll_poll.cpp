@@ -0,0 +1,72 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#include <memory>
+
+#include <process/future.hpp>
+#include <process/io.hpp>
+#include <process/process.hpp> // For process::initialize.
+
+#include "epoll.hpp"
+
+namespace process {
+namespace io {
+namespace internal {
+
+void pollDiscard(
+    epoll::Loop* loop,
+    int fd,
+    const std::weak_ptr<epoll::Loop::Waiter>& waiter)
+{
+  // Discarding inside the loop prevents racing with the file
+  // descriptor becoming ready.
+  loop->dispatch([=]() {
+    // If `waiter` cannot be locked the poll has completed already.
+    std::shared_ptr<epoll::Loop::Waiter> shared = waiter.lock();
+    if (shared) {
+      loop->unwatch(fd, shared);
+    }
+  });
+}
+
+} // namespace internal {
+
+
+Future<short> poll(int fd, short events)
+{
+  process::initialize();
+
+  epoll::Loop* loop = epoll::loop(fd);
+
+  std::shared_ptr<epoll::Loop::Waiter> waiter(
+      new epoll::Loop::Waiter(events));
+
+  Future<short> future = waiter->promise.future();
+
+  // NOTE: the function is invoked immediately if we're already in
+  // the loop responsible for this file descriptor.
+  loop->dispatch([=]() {
+    loop->watch(fd, waiter);
+  });
+
+  // Using a `weak_ptr` avoids a cycle between the waiter's promise and
+  // the callbacks of its future.
+  return future
+    .onDiscard(lambda::bind(
+        &internal::pollDiscard,
+        loop,
+        fd,
+        std::weak_ptr<epoll::Loop::Waiter>(waiter)));
+}
+
+} // namespace io {
+} // namespace process {
@@ -0,0 +1,271 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __EVENT_QUEUE_HPP__
+#define __EVENT_QUEUE_HPP__
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <process/event.hpp>
+
+#include <stout/synchronized.hpp>
+
+namespace process {
+
+// The queue of events of a process (i.e., its "mailbox").
+//
+// Events can be enqueued from any thread without taking a lock: the
+// queue is an intrusive multi-producer single-consumer queue (based
+// on Dmitry Vyukov's MPSC node-based queue) which links the events
+// through 'Event::next', so enqueueing is a single atomic exchange.
+// Only the thread currently running the process (the consumer) may
+// dequeue events.
+//
+// The queue also keeps track of the number of "outstanding" events,
+// i.e., events that have been enqueued but not yet finished by the
+// consumer. A process needs to be scheduled exactly when this number
+// goes from zero to one, which lets producers decide whether they are
+// responsible for scheduling the process without any locking. The
+// count starts at one on behalf of the process' initialization, which
+// is finished once the process has been initialized.
+//
+// The events currently on the queue can be inspected from any thread
+// (e.g., for the '/__processes__' endpoint). Inspection is
+// synchronized only with the consumer, never with the producers.
+class EventQueue
+{
+public:
+  EventQueue() : outstanding(1)
+  {
+    initialize(&events);
+    initialize(&injected);
+  }
+
+  ~EventQueue()
+  {
+    clear();
+  }
+
+  // Enqueues the event, or if 'inject' is true enqueues it in front
+  // of all non-injected events. Returns true if the queue was empty,
+  // in which case the caller is responsible for scheduling the
+  // process. Can be called from any thread.
+  bool enqueue(Event* event, bool inject = false)
+  {
+    push(inject ? &injected : &events, event);
+
+    // NOTE: we only count the event after it has been pushed so that
+    // the consumer always finds at least as many events on the queue
+    // as have been counted (see 'dequeue').
+    return outstanding.fetch_add(1) == 0;
+  }
+
+  // Returns the next event. Must only be called by the consumer and
+  // only if 'finish' returned false (i.e., there is an outstanding
+  // event).
+  Event* dequeue()
+  {
+    while (true) {
+      synchronized (mutex) {
+        Event* event = pop(&injected);
+
+        if (event == nullptr) {
+          event = pop(&events);
+        }
+
+        if (event != nullptr) {
+          return event;
+        }
+      }
+
+      // A producer has counted an event that it has not finished
+      // linking into the queue yet, which only takes a couple of
+      // instructions, so just give it a chance to run.
+      std::this_thread::yield();
+    }
+  }
+
+  // Marks the event most recently dequeued (or the initialization of
+  // the process) as finished. Returns true if there are no more
+  // outstanding events, in which case the process must no longer be
+  // considered running since the next enqueue will schedule it. Must
+  // only be called by the consumer.
+  bool finish()
+  {
+    return outstanding.fetch_sub(1) == 1;
+  }
+
+  // Deletes all events currently on the queue. Must only be called by
+  // the consumer. Note that this does not change the number of
+  // outstanding events, so the process will never get scheduled again
+  // (which is what we want when terminating a process).
+  void clear()
+  {
+    synchronized (mutex) {
+      Event* event = nullptr;
+      while ((event = pop(&injected)) != nullptr ||
+             (event = pop(&events)) != nullptr) {
+        delete event;
+      }
+    }
+  }
+
+  // Visits each event currently on the queue, in the order in which
+  // the events will be dequeued. Can be called from any thread.
+  void visit(EventVisitor* visitor)
+  {
+    synchronized (mutex) {
+      visit(&injected, visitor);
+      visit(&events, visitor);
+    }
+  }
+
+  // Returns the number of events on the queue for which 'predicate'
+  // returns true. Can be called from any thread.
+  size_t count(bool (*predicate)(const Event*))
+  {
+    size_t count = 0;
+
+    synchronized (mutex) {
+      count += this->count(&injected, predicate);
+      count += this->count(&events, predicate);
+    }
+
+    return count;
+  }
+
+  // Returns the number of outstanding events, i.e., the number of
+  // events on the queue plus the event being processed (if any).
+  // Can be called from any thread.
+  size_t size() const
+  {
+    return outstanding.load();
+  }
+
+private:
+  // Placeholder for the consumer end of an empty queue.
+  struct Stub : Event
+  {
+    virtual void visit(EventVisitor*) const {}
+  };
+
+  struct Queue
+  {
+    // The most recently enqueued event, exchanged by producers.
+    std::atomic<Event*> head;
+
+    // The next event to dequeue, only accessed by the consumer.
+    Event* tail;
+
+    Stub stub;
+  };
+
+  static void initialize(Queue* queue)
+  {
+    queue->stub.next.store(nullptr);
+    queue->head.store(&queue->stub);
+    queue->tail = &queue->stub;
+  }
+
+  static void push(Queue* queue, Event* event)
+  {
+    event->next.store(nullptr, std::memory_order_relaxed);
+    Event* previous = queue->head.exchange(event);
+    previous->next.store(event, std::memory_order_release);
+  }
+
+  // Returns nullptr if the queue is empty or a producer is in the
+  // middle of linking an event into the queue.
+  static Event* pop(Queue* queue)
+  {
+    Event* tail = queue->tail;
+    Event* next = tail->next.load(std::memory_order_acquire);
+
+    if (tail == &queue->stub) {
+      if (next == nullptr) {
+        return nullptr;
+      }
+
+      queue->tail = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next != nullptr) {
+      queue->tail = next;
+      return tail;
+    }
+
+    if (tail != queue->head.load()) {
+      return nullptr;
+    }
+
+    // 'tail' is the last event on the queue, put the stub back so
+    // that we can unlink it.
+    push(queue, &queue->stub);
+
+    next = tail->next.load(std::memory_order_acquire);
+
+    if (next != nullptr) {
+      queue->tail = next;
+      return tail;
+    }
+
+    return nullptr;
+  }
+
+  static void visit(Queue* queue, EventVisitor* visitor)
+  {
+    Event* event = queue->tail;
+    while (event != nullptr) {
+      if (event != &queue->stub) {
+        event->visit(visitor);
+      }
+      event = event->next.load(std::memory_order_acquire);
+    }
+  }
+
+  static size_t count(Queue* queue, bool (*predicate)(const Event*))
+  {
+    size_t count = 0;
+
+    Event* event = queue->tail;
+    while (event != nullptr) {
+      if (event != &queue->stub && predicate(event)) {
+        count++;
+      }
+      event = event->next.load(std::memory_order_acquire);
+    }
+
+    return count;
+  }
+
+  Queue events;
+
+  // Events that should be dequeued before all other events, e.g., a
+  // 'TerminateEvent' that should not wait for the events in front of
+  // it. Kept separately since producers can only add to the back.
+  Queue injected;
+
+  std::atomic_size_t outstanding;
+
+  // Synchronizes the consumer with threads inspecting the queue (so
+  // that an event doesn't get deleted while it's being inspected).
+  // Producers never acquire this mutex.
+  std::mutex mutex;
+};
+
+} // namespace process {
+
+#endif // __EVENT_QUEUE_HPP__
@@ -0,0 +1,123 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __FRAMING_HPP__
+#define __FRAMING_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+namespace process {
+namespace framing {
+
+// A compact binary framing for the messages sent between libprocess
+// instances, which is negotiated per connection with the HTTP framing
+// (see 'MessageEncoder') as the fallback.
+//
+// The sender offers the binary framing by including the 'OFFER'
+// header in the first (HTTP) message that it sends on a connection.
+// A receiver that supports the binary framing too acknowledges the
+// offer by writing 'ACCEPT' back on the connection, after which it
+// accepts binary frames in place of HTTP requests. The sender
+// switches to binary frames once it has read the acknowledgement,
+// which can be anywhere in the stream of messages, so the receiver
+// checks for a frame at every message boundary. Older versions of
+// libprocess never make the offer and never accept it (they ignore
+// the header) so they keep sending and receiving HTTP. Note that
+// senders ignore anything but the acknowledgement that they read on
+// the connections they send messages on.
+//
+// A frame starts with a 1 byte kind, which is never the start of an
+// HTTP request, and the 32 bit length of the rest of the frame. All
+// integers are in network byte order:
+//
+//   DEFINE:  [kind][length][symbol][string ...]
+//   MESSAGE: [kind][length][from][to][name][body ...]
+//
+// Rather than including the sender's PID, the receiver's ID and the
+// name in every message these strings are interned: a DEFINE frame
+// binds a string to a (32 bit) symbol, which is what the MESSAGE
+// frames that follow refer to. Symbols are numbered sequentially
+// starting from 0, and once the sender has used up 'MAX_SYMBOLS' it
+// starts over and redefines them, which bounds the size of the symbol
+// tables on both ends of a connection.
+
+const char OFFER_HEADER[] = "Libprocess-Framing";
+const char OFFER[] = "binary/1";
+
+const char ACCEPT[] =
+  "HTTP/1.1 101 Switching Protocols\r\n"
+  "Upgrade: libprocess-binary/1\r\n"
+  "Connection: Upgrade\r\n"
+  "\r\n";
+
+const size_t ACCEPT_SIZE = sizeof(ACCEPT) - 1;
+
+
+enum Kind : uint8_t
+{
+  DEFINE = 0x01,
+  MESSAGE = 0x02
+};
+
+
+// The kind and the length.
+const size_t HEADER_SIZE = 5;
+
+// The from, to and name symbols.
+const size_t MESSAGE_SYMBOLS_SIZE = 12;
+
+const uint32_t MAX_SYMBOLS = 64 * 1024;
+
+// The largest length of a frame that the receiver accepts, which
+// bounds how much it buffers for a single frame. Larger messages get
+// sent with the HTTP framing instead.
+const uint32_t MAX_FRAME_SIZE = 64 * 1024 * 1024;
+
+
+// Returns true if a message starting with this byte is a binary
+// frame, rather than an HTTP request.
+inline bool framed(char c)
+{
+  return c == DEFINE || c == MESSAGE;
+}
+
+
+inline void append(uint32_t value, std::string* out)
+{
+  const char bytes[] = {
+    static_cast<char>(value >> 24),
+    static_cast<char>(value >> 16),
+    static_cast<char>(value >> 8),
+    static_cast<char>(value)
+  };
+
+  out->append(bytes, sizeof(bytes));
+}
+
+
+inline uint32_t extract(const char* data)
+{
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+
+  return (static_cast<uint32_t>(bytes[0]) << 24) |
+         (static_cast<uint32_t>(bytes[1]) << 16) |
+         (static_cast<uint32_t>(bytes[2]) << 8) |
+         static_cast<uint32_t>(bytes[3]);
+}
+
+} // namespace framing {
+} // namespace process {
+
+#endif // __FRAMING_HPP__
@@ -412,6 +412,34 @@ Future<string> Pipe::Reader::read()
 }
 
 
+// Continues reading from the pipe until EOF, see Pipe::Reader::readAll.
+static Future<string> _readAll(
+    Pipe::Reader reader,
+    const std::shared_ptr<string>& buffer,
+    const string& read)
+{
+  if (read.empty()) { // EOF.
+    return *buffer;
+  }
+
+  buffer->append(read);
+
+  return reader.read()
+    .then(lambda::bind(&_readAll, reader, buffer, lambda::_1));
+}
+
+
+Future<string> Pipe::Reader::readAll()
+{
+  Pipe::Reader reader = *this;
+
+  std::shared_ptr<string> buffer(new string());
+
+  return reader.read()
+    .then(lambda::bind(&_readAll, reader, buffer, lambda::_1));
+}
+
+
 bool Pipe::Reader::close()
 {
   bool closed = false;
@@ -901,12 +929,8 @@ string encode(const Request& request)
 }
 
 
-// Forward declarations.
-Future<string> _convert(
-    Pipe::Reader reader,
-    const std::shared_ptr<string>& buffer,
-    const string& read);
-Response __convert(
+// Forward declaration.
+Response _convert(
     const Response& pipeResponse,
     const string& body);
 
@@ -915,36 +939,17 @@ Response __convert(
 // 'PIPE' response can be read completely.
 Future<Response> convert(const Response& pipeResponse)
 {
-  std::shared_ptr<string> buffer(new string());
-
   CHECK_EQ(Response::PIPE, pipeResponse.type);
   CHECK_SOME(pipeResponse.reader);
 
   Pipe::Reader reader = pipeResponse.reader.get();
 
-  return reader.read()
-    .then(lambda::bind(&_convert, reader, buffer, lambda::_1))
-    .then(lambda::bind(&__convert, pipeResponse, lambda::_1));
-}
-
-
-Future<string> _convert(
-    Pipe::Reader reader,
-    const std::shared_ptr<string>& buffer,
-    const string& read)
-{
-  if (read.empty()) { // EOF.
-    return *buffer;
-  }
-
-  buffer->append(read);
-
-  return reader.read()
-    .then(lambda::bind(&_convert, reader, buffer, lambda::_1));
+  return reader.readAll()
+    .then(lambda::bind(&_convert, pipeResponse, lambda::_1));
 }
 
 
-Response __convert(const Response& pipeResponse, const string& body)
+Response _convert(const Response& pipeResponse, const string& body)
 {
   Response bodyResponse = pipeResponse;
   bodyResponse.type = Response::BODY;
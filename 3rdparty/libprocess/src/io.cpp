@@ -27,6 +27,12 @@
 #include <stout/os/write.hpp>
 #include <stout/try.hpp>
 
+#include "buffers.hpp"
+
+#ifdef ENABLE_IO_URING
+#include "io_uring.hpp"
+#endif // ENABLE_IO_URING
+
 using std::string;
 
 namespace process {
@@ -84,6 +90,15 @@ void read(
 
     if (length < 0) {
       if (net::is_restartable_error(error) || net::is_retryable_error(error)) {
+#ifdef ENABLE_IO_URING
+        // Rather than polling, let the kernel wait for the file
+        // descriptor and then do the read.
+        if (flags == NONE && io_uring::available()) {
+          promise->associate(io_uring::read(fd, data, size));
+          return;
+        }
+#endif // ENABLE_IO_URING
+
         // Restart the read operation.
         Future<short> future =
           io::poll(fd, process::io::READ).onAny(
@@ -143,6 +158,15 @@ void write(
 
     if (length < 0) {
       if (net::is_restartable_error(error) || net::is_retryable_error(error)) {
+#ifdef ENABLE_IO_URING
+        // Rather than polling, let the kernel wait for the file
+        // descriptor and then do the write.
+        if (io_uring::available()) {
+          promise->associate(io_uring::write(fd, data, size));
+          return;
+        }
+#endif // ENABLE_IO_URING
+
         // Restart the write operation.
         Future<short> future =
           io::poll(fd, process::io::WRITE).onAny(
@@ -379,7 +403,7 @@ void _splice(
 
 Future<Nothing> splice(int from, int to, size_t chunk)
 {
-  boost::shared_array<char> data(new char[chunk]);
+  boost::shared_array<char> data = buffers::acquire(chunk);
 
   // Rather than having internal::_splice return a future and
   // implementing internal::_splice as a chain of io::read and
@@ -436,7 +460,7 @@ Future<string> read(int fd)
   // TODO(benh): Wrap up this data as a struct, use 'Owner'.
   // TODO(bmahler): For efficiency, use a rope for the buffer.
   std::shared_ptr<string> buffer(new string());
-  boost::shared_array<char> data(new char[BUFFERED_READ_SIZE]);
+  boost::shared_array<char> data = buffers::acquire(BUFFERED_READ_SIZE);
 
   // NOTE: We wrap `os::close` in a lambda to disambiguate on Windows.
   return internal::_read(fd, buffer, data, BUFFERED_READ_SIZE)
@@ -593,7 +617,7 @@ Future<string> peek(int fd, size_t limit)
   }
 
   // TODO(benh): Wrap up this data as a struct, use 'Owner'.
-  boost::shared_array<char> data(new char[BUFFERED_READ_SIZE]);
+  boost::shared_array<char> data = buffers::acquire(BUFFERED_READ_SIZE);
 
   return io::peek(fd, data.get(), BUFFERED_READ_SIZE, limit)
     .then([=](size_t length) -> Future<string> {
@@ -0,0 +1,683 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/io_uring.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include <process/future.hpp>
+
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/lambda.hpp>
+#include <stout/stringify.hpp>
+#include <stout/synchronized.hpp>
+#include <stout/try.hpp>
+
+#include <stout/os/strerror.hpp>
+
+#include "io_uring.hpp"
+
+using std::deque;
+using std::vector;
+
+namespace process {
+namespace io_uring {
+
+// NOTE: glibc doesn't provide wrappers for the io_uring system calls
+// and we don't want to depend on liburing, so we invoke them directly.
+static int setup(unsigned entries, io_uring_params* params)
+{
+  return ::syscall(__NR_io_uring_setup, entries, params);
+}
+
+
+static int enter(int fd, unsigned submit, unsigned complete, unsigned flags)
+{
+  return ::syscall(
+      __NR_io_uring_enter, fd, submit, complete, flags, nullptr, 0);
+}
+
+
+static int register_(int fd, unsigned opcode, void* arg, unsigned count)
+{
+  return ::syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+
+class Ring
+{
+public:
+  static Try<Ring*> create();
+
+  Future<size_t> submit(
+      uint8_t opcode,
+      int fd,
+      void* data,
+      size_t size,
+      uint32_t flags);
+
+private:
+  struct Operation
+  {
+    uint8_t opcode;
+    int fd;
+    void* data;
+    uint32_t size;
+    uint32_t flags; // The 'msg_flags' or 'accept_flags'.
+
+    // The completions (of the poll and of the operation itself) that
+    // are yet to be reaped.
+    int completions;
+
+    int result; // The result of the operation itself.
+    int error; // The error that the poll failed with, if any.
+
+    bool submitted; // Whether the operation is on the ring.
+    bool canceled; // Whether the future has been discarded.
+
+    Promise<size_t> promise;
+  };
+
+  // The 'user_data' of an operation is its id shifted by one with the
+  // lowest bit set for the poll that is linked to the operation. The
+  // cancellations use 0.
+  static const uint64_t POLL = 1;
+  static const uint64_t CANCEL = 0;
+
+  // The number of completion queue entries an operation reserves:
+  // one for the poll, one for the operation itself and one for a
+  // possible cancellation. Bounding the operations on the ring by the
+  // size of the completion queue guarantees that the completion queue
+  // never overflows.
+  static const unsigned RESERVED = 3;
+
+  static const unsigned ENTRIES = 256;
+
+  Ring() : flushing(false), ids(0), inflight(0) {}
+
+  void run();
+  void reap();
+  void flush();
+  void cancel(uint64_t id);
+  bool prepare(uint64_t id, Operation* operation);
+  void complete(Operation* operation);
+
+  // Returns the next submission queue entry (zeroed), which the
+  // kernel will see once we publish the tail.
+  io_uring_sqe* next();
+  void publish();
+
+  // Returns the number of entries on the submission queue which the
+  // kernel hasn't consumed yet.
+  unsigned pending();
+
+  int fd;
+
+  // The submission queue.
+  unsigned* sqHead;
+  unsigned* sqTail;
+  unsigned sqMask;
+  unsigned sqEntries;
+  unsigned* sqArray;
+  io_uring_sqe* sqes;
+  unsigned tail; // The next (not yet published) tail.
+
+  // The completion queue, only accessed by the reaping thread.
+  unsigned* cqHead;
+  unsigned* cqTail;
+  unsigned cqMask;
+  unsigned cqEntries;
+  io_uring_cqe* cqes;
+
+  std::mutex mutex;
+
+  // Whether some thread is currently submitting the pending entries.
+  bool flushing;
+
+  uint64_t ids;
+  hashmap<uint64_t, Operation*> operations;
+
+  // The number of completion queue entries that are reserved by the
+  // operations (and cancellations) on the ring.
+  unsigned inflight;
+
+  // The operations that didn't fit onto the ring, by id.
+  deque<uint64_t> backlog;
+};
+
+
+Try<Ring*> Ring::create()
+{
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+
+  int fd = setup(ENTRIES, &params);
+  if (fd < 0) {
+    return ErrnoError("Failed to set up io_uring");
+  }
+
+  // Make sure that the kernel supports all the operations we use.
+  const size_t length =
+    sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+
+  vector<char> buffer(length, 0);
+  io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+
+  if (register_(fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+    ErrnoError error("Failed to probe io_uring operations");
+    ::close(fd);
+    return error;
+  }
+
+  foreach (uint8_t opcode, vector<uint8_t>({IORING_OP_POLL_ADD,
+                                            IORING_OP_ASYNC_CANCEL,
+                                            IORING_OP_READ,
+                                            IORING_OP_WRITE,
+                                            IORING_OP_SEND,
+                                            IORING_OP_ACCEPT})) {
+    if (opcode > probe->last_op ||
+        !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED)) {
+      ::close(fd);
+      return Error(
+          "io_uring operation " + stringify((int) opcode) +
+          " is not supported");
+    }
+  }
+
+  size_t sqLength = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  size_t cqLength =
+    params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+  // NOTE: With 'IORING_FEAT_SINGLE_MMAP' both queues share a mapping.
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    sqLength = cqLength = std::max(sqLength, cqLength);
+  }
+
+  void* sq = ::mmap(
+      nullptr,
+      sqLength,
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE,
+      fd,
+      IORING_OFF_SQ_RING);
+
+  if (sq == MAP_FAILED) {
+    ErrnoError error("Failed to map the io_uring submission queue");
+    ::close(fd);
+    return error;
+  }
+
+  void* cq = sq;
+
+  if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+    cq = ::mmap(
+        nullptr,
+        cqLength,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        fd,
+        IORING_OFF_CQ_RING);
+
+    if (cq == MAP_FAILED) {
+      ErrnoError error("Failed to map the io_uring completion queue");
+      ::munmap(sq, sqLength);
+      ::close(fd);
+      return error;
+    }
+  }
+
+  void* sqes = ::mmap(
+      nullptr,
+      params.sq_entries * sizeof(io_uring_sqe),
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE,
+      fd,
+      IORING_OFF_SQES);
+
+  if (sqes == MAP_FAILED) {
+    ErrnoError error("Failed to map the io_uring submission queue entries");
+    if (cq != sq) {
+      ::munmap(cq, cqLength);
+    }
+    ::munmap(sq, sqLength);
+    ::close(fd);
+    return error;
+  }
+
+  char* s = static_cast<char*>(sq);
+  char* c = static_cast<char*>(cq);
+
+  Ring* ring = new Ring();
+  ring->fd = fd;
+  ring->sqHead = reinterpret_cast<unsigned*>(s + params.sq_off.head);
+  ring->sqTail = reinterpret_cast<unsigned*>(s + params.sq_off.tail);
+  ring->sqMask = *reinterpret_cast<unsigned*>(s + params.sq_off.ring_mask);
+  ring->sqEntries = params.sq_entries;
+  ring->sqArray = reinterpret_cast<unsigned*>(s + params.sq_off.array);
+  ring->sqes = static_cast<io_uring_sqe*>(sqes);
+  ring->tail = *ring->sqTail;
+  ring->cqHead = reinterpret_cast<unsigned*>(c + params.cq_off.head);
+  ring->cqTail = reinterpret_cast<unsigned*>(c + params.cq_off.tail);
+  ring->cqMask = *reinterpret_cast<unsigned*>(c + params.cq_off.ring_mask);
+  ring->cqEntries = params.cq_entries;
+  ring->cqes = reinterpret_cast<io_uring_cqe*>(c + params.cq_off.cqes);
+
+  // NOTE: The ring (like the event loop) lives for the lifetime of
+  // the process, so the thread is never joined.
+  std::thread thread(&Ring::run, ring);
+  thread.detach();
+
+  return ring;
+}
+
+
+Future<size_t> Ring::submit(
+    uint8_t opcode,
+    int fd,
+    void* data,
+    size_t size,
+    uint32_t flags)
+{
+  Operation* operation = new Operation();
+  operation->opcode = opcode;
+  operation->fd = fd;
+  operation->data = data;
+  operation->size = static_cast<uint32_t>(std::min(size, (size_t) INT_MAX));
+  operation->flags = flags;
+  operation->completions = 0;
+  operation->result = 0;
+  operation->error = 0;
+  operation->submitted = false;
+  operation->canceled = false;
+
+  // NOTE: The operation may be completed (and deleted) by the reaping
+  // thread as soon as we release the lock, so get the future first.
+  Future<size_t> future = operation->promise.future();
+
+  uint64_t id;
+  bool flush = false;
+
+  synchronized (mutex) {
+    id = ++ids;
+    operations[id] = operation;
+
+    if (!backlog.empty() || !prepare(id, operation)) {
+      backlog.push_back(id);
+    } else if (!flushing) {
+      flushing = flush = true;
+    }
+  }
+
+  // Concurrent submissions end up being submitted by whichever
+  // thread got here first (see 'flush').
+  if (flush) {
+    this->flush();
+  }
+
+  future.onDiscard(lambda::bind(&Ring::cancel, this, id));
+
+  return future;
+}
+
+
+void Ring::run()
+{
+  while (true) {
+    if (enter(fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+        errno != EINTR &&
+        errno != EAGAIN &&
+        errno != EBUSY) {
+      PLOG(FATAL) << "Failed to wait for io_uring completions";
+    }
+
+    reap();
+  }
+}
+
+
+void Ring::reap()
+{
+  vector<Operation*> completed;
+  bool flush = false;
+
+  synchronized (mutex) {
+    unsigned head = *cqHead;
+    unsigned last = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+    for (; head != last; head++) {
+      const io_uring_cqe* cqe = &cqes[head & cqMask];
+
+      CHECK_GT(inflight, 0u);
+      inflight--;
+
+      if (cqe->user_data == CANCEL) {
+        continue;
+      }
+
+      const uint64_t id = cqe->user_data >> 1;
+
+      CHECK(operations.contains(id));
+      Operation* operation = operations.at(id);
+
+      if (cqe->user_data & POLL) {
+        if (cqe->res < 0) {
+          operation->error = cqe->res;
+        }
+      } else {
+        operation->result = cqe->res;
+      }
+
+      if (--operation->completions > 0) {
+        continue;
+      }
+
+      // A spurious wakeup, try again (unless we've been discarded).
+      if ((operation->result == -EAGAIN || operation->result == -EINTR) &&
+          !operation->canceled) {
+        operation->submitted = false;
+        operation->error = 0;
+
+        // Release the reservation for a cancellation, 'prepare' makes
+        // a new one.
+        inflight--;
+
+        if (!prepare(id, operation)) {
+          backlog.push_back(id);
+        }
+        continue;
+      }
+
+      operations.erase(id);
+
+      // Release the reservation for a cancellation that never happened.
+      if (!operation->canceled) {
+        inflight--;
+      }
+
+      completed.push_back(operation);
+    }
+
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+    // Now that there is room again, move operations off the backlog.
+    while (!backlog.empty()) {
+      const uint64_t id = backlog.front();
+
+      if (!operations.contains(id)) {
+        backlog.pop_front(); // Discarded while on the backlog.
+        continue;
+      }
+
+      if (!prepare(id, operations.at(id))) {
+        break;
+      }
+
+      backlog.pop_front();
+    }
+
+    if (pending() > 0 && !flushing) {
+      flushing = flush = true;
+    }
+  }
+
+  if (flush) {
+    this->flush();
+  }
+
+  // NOTE: We satisfy the promises without holding the lock since the
+  // callbacks might very well submit new operations.
+  foreach (Operation* operation, completed) {
+    complete(operation);
+    delete operation;
+  }
+}
+
+
+void Ring::flush()
+{
+  while (true) {
+    unsigned count;
+
+    synchronized (mutex) {
+      count = pending();
+      if (count == 0) {
+        flushing = false;
+        return;
+      }
+    }
+
+    if (enter(fd, count, 0, 0) < 0 &&
+        errno != EINTR &&
+        errno != EAGAIN &&
+        errno != EBUSY) {
+      PLOG(FATAL) << "Failed to submit to io_uring";
+    }
+  }
+}
+
+
+void Ring::cancel(uint64_t id)
+{
+  Operation* discarded = nullptr;
+
+  synchronized (mutex) {
+    if (!operations.contains(id)) {
+      return;
+    }
+
+    Operation* operation = operations.at(id);
+
+    if (operation->canceled) {
+      return;
+    }
+
+    operation->canceled = true;
+
+    if (!operation->submitted) {
+      // Still on the backlog, so nothing to cancel in the kernel.
+      operations.erase(id);
+      discarded = operation;
+    } else {
+      // Canceling the poll (which is where the operation will be
+      // waiting) also cancels the linked operation. If the poll has
+      // completed already the operation itself can't block since the
+      // file descriptor is non-blocking.
+      while (pending() == sqEntries) {
+        enter(fd, sqEntries, 0, 0);
+      }
+
+      io_uring_sqe* sqe = next();
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->fd = -1;
+      sqe->addr = (id << 1) | POLL;
+      sqe->user_data = CANCEL;
+      publish();
+
+      // NOTE: The cancellation uses the completion queue entry that
+      // the operation reserved for it (see 'RESERVED').
+
+      // NOTE: Unlike other submissions we submit the cancellation
+      // right away (rather than possibly leaving it to a concurrent
+      // 'flush') so that once the discard returns the operation can
+      // no longer consume any data that arrives afterwards (unless it
+      // was already performed).
+      while (pending() > 0) {
+        if (enter(fd, pending(), 0, 0) < 0 &&
+            errno != EINTR &&
+            errno != EAGAIN &&
+            errno != EBUSY) {
+          PLOG(FATAL) << "Failed to submit to io_uring";
+        }
+      }
+    }
+  }
+
+  if (discarded != nullptr) {
+    discarded->promise.discard();
+    delete discarded;
+  }
+}
+
+
+bool Ring::prepare(uint64_t id, Operation* operation)
+{
+  if (inflight + RESERVED > cqEntries || sqEntries - pending() < 2) {
+    return false;
+  }
+
+  io_uring_sqe* sqe = next();
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = operation->fd;
+  sqe->flags = IOSQE_IO_LINK;
+#ifdef IORING_FEAT_POLL_32BITS
+  sqe->poll32_events =
+#else
+  sqe->poll_events =
+#endif
+    (operation->opcode == IORING_OP_READ ||
+     operation->opcode == IORING_OP_ACCEPT) ? POLLIN : POLLOUT;
+  sqe->user_data = (id << 1) | POLL;
+
+  sqe = next();
+  sqe->opcode = operation->opcode;
+  sqe->fd = operation->fd;
+  sqe->addr = reinterpret_cast<uint64_t>(operation->data);
+  sqe->len = operation->size;
+  sqe->off = -1; // Use (and update) the file position, like read(2).
+  sqe->msg_flags = operation->flags; // Aliases 'accept_flags'.
+  sqe->user_data = id << 1;
+
+  publish();
+
+  operation->completions = 2;
+  operation->submitted = true;
+
+  inflight += RESERVED;
+
+  return true;
+}
+
+
+void Ring::complete(Operation* operation)
+{
+  if (operation->result >= 0) {
+    operation->promise.set(static_cast<size_t>(operation->result));
+  } else if (operation->canceled) {
+    operation->promise.discard();
+  } else {
+    // If the poll failed the operation itself just reports that it
+    // was canceled, so report why the poll failed instead.
+    int error = operation->result;
+    if (error == -ECANCELED && operation->error < 0) {
+      error = operation->error;
+    }
+
+    operation->promise.fail(os::strerror(-error));
+  }
+}
+
+
+io_uring_sqe* Ring::next()
+{
+  const unsigned index = tail & sqMask;
+
+  io_uring_sqe* sqe = &sqes[index];
+  memset(sqe, 0, sizeof(io_uring_sqe));
+
+  sqArray[index] = index;
+  tail++;
+
+  return sqe;
+}
+
+
+void Ring::publish()
+{
+  __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+}
+
+
+unsigned Ring::pending()
+{
+  return tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+}
+
+
+static Ring* ring()
+{
+  static Ring* ring = []() -> Ring* {
+    Try<Ring*> ring = Ring::create();
+    if (ring.isError()) {
+      LOG(INFO) << "Not using io_uring: " << ring.error();
+      return nullptr;
+    }
+    return ring.get();
+  }();
+
+  return ring;
+}
+
+
+bool available()
+{
+  return ring() != nullptr;
+}
+
+
+Future<size_t> read(int fd, void* data, size_t size)
+{
+  return ring()->submit(IORING_OP_READ, fd, data, size, 0);
+}
+
+
+Future<size_t> write(int fd, const void* data, size_t size)
+{
+  return ring()->submit(
+      IORING_OP_WRITE, fd, const_cast<void*>(data), size, 0);
+}
+
+
+Future<size_t> send(int fd, const void* data, size_t size)
+{
+  return ring()->submit(
+      IORING_OP_SEND, fd, const_cast<void*>(data), size, MSG_NOSIGNAL);
+}
+
+
+Future<int> accept(int fd)
+{
+  return ring()->submit(
+      IORING_OP_ACCEPT, fd, nullptr, 0, SOCK_NONBLOCK | SOCK_CLOEXEC)
+    .then([](size_t s) { return static_cast<int>(s); });
+}
+
+} // namespace io_uring {
+} // namespace process {
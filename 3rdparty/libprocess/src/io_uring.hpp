@@ -0,0 +1,56 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __IO_URING_HPP__
+#define __IO_URING_HPP__
+
+#include <stddef.h>
+
+#include <process/future.hpp>
+
+namespace process {
+namespace io_uring {
+
+// Asynchronous I/O on non-blocking file descriptors through a single
+// io_uring shared by the whole library.
+//
+// Each operation is submitted as a poll linked to the operation
+// itself, so the kernel both waits for the file descriptor to become
+// ready and then performs the read, write, send or accept without
+// going through the event loop. Submissions from concurrent callers
+// are batched into a single 'io_uring_enter' and the completions are
+// reaped in batches by a dedicated thread, which is also where the
+// returned futures get satisfied.
+//
+// Discarding a returned future cancels the operation. Note that the
+// future only transitions once the kernel is done with the operation
+// (i.e., with the caller's buffer), and that an operation which was
+// already performed when the discard arrived still gets satisfied.
+
+// Returns true if the kernel supports all the operations we need,
+// setting up the ring on the first call. If this returns false the
+// caller must fall back to polling.
+bool available();
+
+Future<size_t> read(int fd, void* data, size_t size);
+Future<size_t> write(int fd, const void* data, size_t size);
+
+// Sends on a socket without raising SIGPIPE (i.e., 'MSG_NOSIGNAL').
+Future<size_t> send(int fd, const void* data, size_t size);
+
+// Returns a non-blocking, close-on-exec socket.
+Future<int> accept(int fd);
+
+} // namespace io_uring {
+} // namespace process {
+
+#endif // __IO_URING_HPP__
@@ -43,6 +43,12 @@ public:
   virtual Future<size_t> recv(char* data, size_t size);
   // Send does not currently support discard. See implementation.
   virtual Future<size_t> send(const char* data, size_t size);
+
+  // NOTE: SSL sockets use the default implementations of the other
+  // 'send' overloads (e.g., the vectored one sends one buffer at a
+  // time since the data needs to get encrypted anyway).
+  using Socket::Impl::send;
+
   virtual Future<size_t> sendfile(int fd, off_t offset, size_t size);
   virtual Try<Nothing> listen(int backlog);
   virtual Future<Socket> accept();
@@ -13,6 +13,7 @@
 #include <glog/logging.h>
 
 #include <list>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -29,6 +30,9 @@
 #include <stout/error.hpp>
 #include <stout/foreach.hpp>
 #include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/jsonify.hpp>
+#include <stout/lambda.hpp>
 #include <stout/numify.hpp>
 #include <stout/option.hpp>
 #include <stout/os.hpp>
@@ -181,24 +185,53 @@ Future<Nothing> MetricsProcess::remove(const string& name)
 Future<hashmap<string, double>> MetricsProcess::snapshot(
     const Option<Duration>& timeout)
 {
-  hashmap<string, Future<double>> futures;
-  hashmap<string, Option<Statistics<double>>> statistics;
+  return sample(timeout)
+    .then(lambda::bind(__snapshot, lambda::_1));
+}
+
+
+Future<std::shared_ptr<vector<MetricsProcess::Sample>>> MetricsProcess::sample(
+    const Option<Duration>& timeout)
+{
+  std::shared_ptr<vector<Sample>> samples(new vector<Sample>());
+  samples->reserve(metrics.size());
+
+  list<Future<double>> futures;
+
+  foreachpair (const string& name, const Owned<Metric>& metric, metrics) {
+    CHECK_NOTNULL(metric.get());
 
-  foreachkey (const string& metric, metrics) {
-    CHECK_NOTNULL(metrics[metric].get());
-    futures[metric] = metrics[metric]->value();
+    Sample sample;
+    sample.name = name;
+    sample.value = metric->value();
     // TODO(dhamon): It would be nice to compute these asynchronously.
-    statistics[metric] = metrics[metric]->statistics();
+    sample.statistics = metric->statistics();
+
+    futures.push_back(sample.value);
+    samples->push_back(sample);
   }
 
+  Future<list<Future<double>>> values = await(futures);
+
   if (timeout.isSome()) {
-    return await(futures.values())
-      .after(timeout.get(), lambda::bind(_snapshotTimeout, futures.values()))
-      .then(lambda::bind(__snapshot, timeout, futures, statistics));
-  } else {
-    return await(futures.values())
-      .then(lambda::bind(__snapshot, timeout, futures, statistics));
+    values = values
+      .after(timeout.get(), lambda::bind(_snapshotTimeout, futures));
   }
+
+  return values
+    .then([=]() {
+      if (timeout.isSome()) {
+        foreach (const Sample& sample, *samples) {
+          if (sample.value.isPending()) {
+            VLOG(1) << "Exceeded timeout of " << timeout.get()
+                    << " when attempting to get metric '" << sample.name
+                    << "'";
+          }
+        }
+      }
+
+      return samples;
+    });
 }
 
 
@@ -228,10 +261,18 @@ Future<http::Response> MetricsProcess::_snapshot(
     acquire = limiter.get()->acquire();
   }
 
-  return acquire.then(defer(self(), &Self::snapshot, timeout))
-      .then([request](const hashmap<string, double>& metrics)
+  // NOTE: we write the samples straight into the response rather than
+  // collecting them into a map first (like 'snapshot').
+  return acquire.then(defer(self(), &Self::sample, timeout))
+      .then([request](const std::shared_ptr<vector<Sample>>& samples)
             -> http::Response {
-        return http::OK(jsonify(metrics), request.url.query.get("jsonp"));
+        auto write = [&samples](JSON::ObjectWriter* writer) {
+          fields(*samples, [writer](const string& name, double value) {
+            writer->field(name, value);
+          });
+        };
+
+        return http::OK(jsonify(write), request.url.query.get("jsonp"));
       });
 }
 
@@ -245,40 +286,57 @@ list<Future<double>> MetricsProcess::_snapshotTimeout(
 }
 
 
-Future<hashmap<string, double>> MetricsProcess::__snapshot(
-    const Option<Duration>& timeout,
-    const hashmap<string, Future<double>>& metrics,
-    const hashmap<string, Option<Statistics<double>>>& statistics)
+hashmap<string, double> MetricsProcess::__snapshot(
+    const std::shared_ptr<vector<Sample>>& samples)
 {
   hashmap<string, double> snapshot;
 
-  foreachpair (const string& key, const Future<double>& value, metrics) {
+  fields(*samples, [&snapshot](const string& name, double value) {
+    snapshot[name] = value;
+  });
+
+  return snapshot;
+}
+
+
+void MetricsProcess::fields(
+    const vector<Sample>& samples,
+    const lambda::function<void(const string&, double)>& f)
+{
+  // The names of the fields so far. A metric can be named like a
+  // statistic of another metric (e.g., 'foo/p50'), in which case we
+  // only use the first of these fields since the JSON snapshot must
+  // not have duplicate keys.
+  hashset<string> names;
+
+  auto field = [&names, &f](const string& name, double value) {
+    if (names.insert(name).second) {
+      f(name, value);
+    }
+  };
+
+  foreach (const Sample& sample, samples) {
     // TODO(dhamon): Maybe add the failure message for this metric to the
     // response if value.isFailed().
-    if (value.isPending()) {
-      CHECK_SOME(timeout);
-      VLOG(1) << "Exceeded timeout of " << timeout.get()
-              << " when attempting to get metric '" << key << "'";
-    } else if (value.isReady()) {
-      snapshot[key] = value.get();
+    if (sample.value.isReady()) {
+      field(sample.name, sample.value.get());
     }
 
-    Option<Statistics<double>> statistics_ = statistics.get(key).get();
-
-    if (statistics_.isSome()) {
-      snapshot[key + "/count"] = statistics_.get().count;
-      snapshot[key + "/min"] = statistics_.get().min;
-      snapshot[key + "/max"] = statistics_.get().max;
-      snapshot[key + "/p50"] = statistics_.get().p50;
-      snapshot[key + "/p90"] = statistics_.get().p90;
-      snapshot[key + "/p95"] = statistics_.get().p95;
-      snapshot[key + "/p99"] = statistics_.get().p99;
-      snapshot[key + "/p999"] = statistics_.get().p999;
-      snapshot[key + "/p9999"] = statistics_.get().p9999;
+    if (sample.statistics.isSome()) {
+      const Statistics<double>& statistics = sample.statistics.get();
+      const string& name = sample.name;
+
+      field(name + "/count", statistics.count);
+      field(name + "/min", statistics.min);
+      field(name + "/max", statistics.max);
+      field(name + "/p50", statistics.p50);
+      field(name + "/p90", statistics.p90);
+      field(name + "/p95", statistics.p95);
+      field(name + "/p99", statistics.p99);
+      field(name + "/p999", statistics.p999);
+      field(name + "/p9999", statistics.p9999);
     }
   }
-
-  return snapshot;
 }
 
 }  // namespace internal {
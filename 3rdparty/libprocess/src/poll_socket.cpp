@@ -14,13 +14,23 @@
 #ifdef __WINDOWS__
 #include <stout/windows.hpp>
 #else
+#include <limits.h>
+#include <string.h>
+
 #include <netinet/tcp.h>
+
+#include <sys/uio.h>
 #endif // __WINDOWS__
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
 #include <process/io.hpp>
 #include <process/network.hpp>
 #include <process/socket.hpp>
 
+#include <stout/foreach.hpp>
 #include <stout/os/sendfile.hpp>
 #include <stout/os/strerror.hpp>
 #include <stout/os.hpp>
@@ -28,6 +38,10 @@
 #include "config.hpp"
 #include "poll_socket.hpp"
 
+#ifdef ENABLE_IO_URING
+#include "io_uring.hpp"
+#endif // ENABLE_IO_URING
+
 using std::string;
 
 namespace process {
@@ -50,14 +64,8 @@ Try<Nothing> PollSocketImpl::listen(int backlog)
 
 namespace internal {
 
-Future<Socket> accept(int fd)
+Future<Socket> accepted(int s)
 {
-  Try<int> accepted = network::accept(fd);
-  if (accepted.isError()) {
-    return Failure(accepted.error());
-  }
-
-  int s = accepted.get();
   Try<Nothing> nonblock = os::nonblock(s);
   if (nonblock.isError()) {
     LOG_IF(INFO, VLOG_IS_ON(1)) << "Failed to accept, nonblock: "
@@ -99,11 +107,29 @@ Future<Socket> accept(int fd)
   return socket.get();
 }
 
+
+Future<Socket> accept(int fd)
+{
+  Try<int> accepted = network::accept(fd);
+  if (accepted.isError()) {
+    return Failure(accepted.error());
+  }
+
+  return internal::accepted(accepted.get());
+}
+
 } // namespace internal {
 
 
 Future<Socket> PollSocketImpl::accept()
 {
+#ifdef ENABLE_IO_URING
+  if (io_uring::available()) {
+    return io_uring::accept(get())
+      .then(lambda::bind(&internal::accepted, lambda::_1));
+  }
+#endif // ENABLE_IO_URING
+
   return io::poll(get(), io::READ)
     .then(lambda::bind(&internal::accept, get()));
 }
@@ -235,11 +261,59 @@ Future<size_t> socket_send_file(int s, int fd, off_t offset, size_t size)
   }
 }
 
+
+#ifndef __WINDOWS__
+Future<size_t> socket_send_buffers(
+    int s,
+    const std::shared_ptr<std::vector<struct iovec>>& iovecs)
+{
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = iovecs->data();
+  message.msg_iovlen = iovecs->size();
+
+  while (true) {
+    ssize_t length = ::sendmsg(s, &message, MSG_NOSIGNAL);
+
+    int error = errno;
+
+    if (length < 0 && net::is_restartable_error(error)) {
+      // Interrupted, try again now.
+      continue;
+    } else if (length < 0 && net::is_retryable_error(error)) {
+      // Might block, try again later.
+      return io::poll(s, io::WRITE)
+        .then(lambda::bind(&internal::socket_send_buffers, s, iovecs));
+    } else if (length <= 0) {
+      // Socket error or closed.
+      if (length < 0) {
+        const string error = os::strerror(errno);
+        VLOG(1) << "Socket error while sending: " << error;
+        return Failure(ErrnoError("Socket send failed"));
+      }
+
+      VLOG(1) << "Socket closed while sending";
+      return length;
+    } else {
+      CHECK(length > 0);
+
+      return length;
+    }
+  }
+}
+#endif // __WINDOWS__
+
 } // namespace internal {
 
 
 Future<size_t> PollSocketImpl::send(const char* data, size_t size)
 {
+#ifdef ENABLE_IO_URING
+  if (io_uring::available()) {
+    return io_uring::send(get(), data, size);
+  }
+#endif // ENABLE_IO_URING
+
   return io::poll(get(), io::WRITE)
     .then(lambda::bind(&internal::socket_send_data, get(), data, size));
 }
@@ -251,5 +325,39 @@ Future<size_t> PollSocketImpl::sendfile(int fd, off_t offset, size_t size)
     .then(lambda::bind(&internal::socket_send_file, get(), fd, offset, size));
 }
 
+
+Future<size_t> PollSocketImpl::send(const std::vector<Socket::Buffer>& buffers)
+{
+#ifdef __WINDOWS__
+  return Socket::Impl::send(buffers);
+#else
+  std::shared_ptr<std::vector<struct iovec>> iovecs(
+      new std::vector<struct iovec>());
+
+  iovecs->reserve(std::min(buffers.size(), (size_t) IOV_MAX));
+
+  foreach (const Socket::Buffer& buffer, buffers) {
+    if (iovecs->size() == (size_t) IOV_MAX) {
+      break;
+    }
+
+    if (buffer.size > 0) {
+      struct iovec iovec;
+      iovec.iov_base = const_cast<char*>(buffer.data);
+      iovec.iov_len = buffer.size;
+      iovecs->push_back(iovec);
+    }
+  }
+
+  if (iovecs->empty()) {
+    return 0u;
+  }
+
+  // NOTE: Unlike 'send' above we try to send right away since the
+  // socket is usually writable, and only poll if it isn't.
+  return internal::socket_send_buffers(get(), iovecs);
+#endif // __WINDOWS__
+}
+
 } // namespace network {
 } // namespace process {
@@ -27,6 +27,8 @@
 #include <arpa/inet.h>
 #endif // __WINDOWS__
 
+#include <boost/shared_array.hpp>
+
 #include <glog/logging.h>
 
 #ifndef __WINDOWS__
@@ -85,6 +87,7 @@
 #include <process/time.hpp>
 #include <process/timer.hpp>
 
+#include <process/metrics/gauge.hpp>
 #include <process/metrics/metrics.hpp>
 
 #include <stout/duration.hpp>
@@ -102,15 +105,21 @@
 #include <stout/unreachable.hpp>
 
 #include "authenticator_manager.hpp"
+#include "buffers.hpp"
 #include "config.hpp"
 #include "decoder.hpp"
 #include "encoder.hpp"
 #include "event_loop.hpp"
+#include "event_queue.hpp"
+#include "framing.hpp"
 #include "gate.hpp"
 #ifdef USE_SSL_SOCKET
 #include "openssl.hpp"
 #endif
 #include "process_reference.hpp"
+#include "process_statistics.hpp"
+#include "process_table.hpp"
+#include "sampler.hpp"
 
 namespace firewall = process::firewall;
 namespace metrics = process::metrics;
@@ -123,6 +132,7 @@ using process::http::Forbidden;
 using process::http::InternalServerError;
 using process::http::NotFound;
 using process::http::OK;
+using process::http::Pipe;
 using process::http::Request;
 using process::http::Response;
 using process::http::ServiceUnavailable;
@@ -325,12 +335,30 @@ public:
 
   Encoder* next(int s);
 
+  // Moves messages queued to be sent on the socket to 'encoders'
+  // (i.e., the messages at the front of the queue, up to 'limit'
+  // messages in total) so that they can be sent together. Returns
+  // the framing of the messages sent on the socket, if any.
+  std::shared_ptr<MessageFraming> coalesce(
+      int s,
+      vector<MessageEncoder*>* encoders,
+      size_t limit);
+
   void close(int s);
 
   void exited(const Address& address);
   void exited(ProcessBase* process);
 
 private:
+  // Adds a message to the queue of messages to send on the socket,
+  // ahead of the queued bulk messages between other processes if it's
+  // a small message (see PRIORITY_MESSAGE_SIZE).
+  void enqueue(int s, MessageEncoder* encoder);
+
+  // Closes the parallel sockets to the socket address (see
+  // 'parallels').
+  void close_parallels(const Address& address);
+
   // TODO(bmahler): Leverage a bidirectional multimap instead, or
   // hide the complexity of manipulating 'links' through methods.
   struct
@@ -363,6 +391,12 @@ private:
       Socket socket,
       Message* message);
 
+  // Starts receiving on a socket that we've connected in order to
+  // send messages, which reads the response to our offer of the
+  // binary framing (see framing.hpp) if it's enabled and otherwise
+  // ignores any data.
+  void negotiate(const Socket& socket);
+
   // Collection of all active sockets (both inbound and outbound).
   map<int, Socket> sockets;
 
@@ -385,8 +419,23 @@ private:
   // (and thus generate ExitedEvents).
   map<Address, int> persists;
 
+  // Map from socket address and index to the outbound sockets that we
+  // send messages on in parallel to the persistent or temporary
+  // socket (which has index 0) if there are multiple sockets per peer
+  // (see 'lane'). These are only kept open while there is a
+  // persistent socket to the same address and are otherwise treated
+  // like temporary sockets.
+  map<pair<Address, size_t>, int> parallels;
+
+  // Map from the parallel sockets to their index.
+  map<int, size_t> indexes;
+
   // Map from outbound socket to outgoing queue.
-  map<int, queue<Encoder*>> outgoing;
+  map<int, deque<Encoder*>> outgoing;
+
+  // Map from outbound socket to the framing of the messages that we
+  // send on it (see 'negotiate').
+  hashmap<int, std::shared_ptr<MessageFraming>> framings;
 
   // HTTP proxies.
   map<int, HttpProxy*> proxies;
@@ -422,6 +471,27 @@ public:
       Event* event,
       ProcessBase* sender = nullptr);
 
+  // Queues a dispatched function to run right after the current event
+  // of the process that is running on this thread (rather than
+  // delivering it as a DispatchEvent) if that's the process with the
+  // specified pid and it has no other events queued, in which case
+  // running the function next preserves the order of its events.
+  // Returns false if the function still needs to get delivered.
+  bool continuation(
+      const UPID& pid,
+      const std::shared_ptr<lambda::function<void(ProcessBase*)>>& f,
+      const Option<const std::type_info*>& functionType);
+
+  // Records that a dispatch with the specified tag to the process
+  // with the specified pid is queued. Returns false if one already
+  // was (or the process doesn't exist), in which case the dispatch
+  // can be dropped (see 'coalesce' in dispatch.hpp).
+  bool coalesce(const UPID& pid, const string& tag);
+
+  // Records that the dispatch with the specified tag to the process
+  // is about to run (or got dropped).
+  void coalesced(const UPID& pid, const string& tag);
+
   UPID spawn(ProcessBase* process, bool manage);
   void resume(ProcessBase* process);
   void cleanup(ProcessBase* process);
@@ -445,23 +515,53 @@ public:
   // The /__processes__ route.
   Future<Response> __processes__(const Request&);
 
+  // Returns the statistics of all local processes (see
+  // process_statistics.hpp), keyed by their ID.
+  JSON::Array statistics();
+
+  // Returns the statistics summed up over all processes, including
+  // the processes that have already terminated.
+  void statistics(ProcessStatistics* totals);
+
 private:
   // Delegate process name to receive root HTTP requests.
   const Option<string> delegate;
 
-  // Map of all local spawned and running processes.
-  map<string, ProcessBase*> processes;
+  // Table of all local spawned and running processes. Lookups (see
+  // 'use') don't take any lock, but all other accesses, including
+  // adding and removing processes, are protected by processes_mutex.
+  ProcessTable processes;
   std::recursive_mutex processes_mutex;
 
+  // Sum of the statistics of all terminated processes (protected by
+  // processes_mutex).
+  ProcessStatistics retired;
+
   // Gates for waiting threads (protected by processes_mutex).
   map<ProcessBase*, Gate*> gates;
 
-  // Queue of runnable processes (implemented using list).
-  list<ProcessBase*> runq;
-  std::recursive_mutex runq_mutex;
+  // Queue of runnable processes owned by a single worker thread.
+  // Each worker services its own queue first and only steals from
+  // the other workers' queues when it runs out of work, so enqueueing
+  // and dequeueing rarely contend on the same lock.
+  struct RunQueue
+  {
+    std::mutex mutex;
+    deque<ProcessBase*> processes;
+  };
+
+  // Run queues, one per worker thread (indexed by '__worker__').
+  vector<std::unique_ptr<RunQueue>> runqs;
+
+  // Used to spread processes enqueued by non-worker threads (e.g.,
+  // the event loop thread) across the run queues.
+  std::atomic_ulong next_runq;
 
-  // Number of running processes, to support Clock::settle operation.
-  std::atomic_long running;
+  // Number of processes that are either on a run queue or currently
+  // running, to support Clock::settle operation. We use a single
+  // counter so that a process being moved from a run queue to a
+  // worker is never observed as being in neither place.
+  std::atomic_long pending;
 
   // Stores the thread handles so that we can join during shutdown.
   vector<std::thread*> threads;
@@ -484,6 +584,25 @@ static Socket* __s__ = nullptr;
 // Local socket address.
 static Address __address__;
 
+// Whether we offer and accept the binary framing of messages (see
+// framing.hpp).
+static bool binary_framing = true;
+
+// The number of sockets that we send messages to a peer (i.e., a
+// remote socket address) on, see 'lane'.
+static std::atomic_size_t sockets_per_peer(1);
+
+// Messages with a body of at most this size get sent ahead of larger
+// ("bulk") messages that are queued to be sent on the same socket,
+// unless those are between the same processes.
+static const size_t PRIORITY_MESSAGE_SIZE = 16 * 1024;
+
+// Whether we record statistics about the events that each process
+// handles, and how many of the events enqueued by each thread we time
+// (see ProcessStatistics).
+static bool process_statistics = false;
+static long process_statistics_sample_interval = 16;
+
 // Active SocketManager (eventually will probably be thread-local).
 static SocketManager* socket_manager = nullptr;
 
@@ -493,6 +612,11 @@ static ProcessManager* process_manager = nullptr;
 // Scheduling gate that threads wait at when there is nothing to run.
 static Gate* gate = new Gate();
 
+// Number of worker threads that are waiting (or about to wait) at the
+// scheduling gate, so that we only open the gate when there is
+// actually a worker to wake up (see ProcessManager::enqueue).
+static std::atomic_long idle_workers(0);
+
 // Used for authenticating HTTP requests.
 static AuthenticatorManager* authenticator_manager = nullptr;
 
@@ -517,9 +641,17 @@ PID<Logging> _logging;
 // Per thread process pointer.
 THREAD_LOCAL ProcessBase* __process__ = nullptr;
 
+// Per thread index of the worker's run queue (-1 if the thread is not
+// a libprocess worker thread).
+static THREAD_LOCAL long __worker__ = -1;
+
 // Per thread executor pointer.
 THREAD_LOCAL Executor* _executor_ = nullptr;
 
+// Per thread count of the events enqueued since the last one that was
+// sampled for the process statistics (see ProcessBase::enqueue).
+static THREAD_LOCAL long __unsampled__ = 0;
+
 
 namespace http {
 
@@ -673,7 +805,7 @@ namespace internal {
 
 void decode_recv(
     const Future<size_t>& length,
-    char* data,
+    const boost::shared_array<char>& data,
     size_t size,
     Socket socket,
     DataDecoder* decoder)
@@ -684,25 +816,24 @@ void decode_recv(
     }
 
     socket_manager->close(socket);
-    delete[] data;
     delete decoder;
     return;
   }
 
   if (length.get() == 0) {
     socket_manager->close(socket);
-    delete[] data;
     delete decoder;
     return;
   }
 
-  // Decode as much of the data as possible into HTTP requests.
-  const deque<Request*> requests = decoder->decode(data, length.get());
+  // Decode as much of the data as possible into HTTP requests, and
+  // messages if the peer switched to the binary framing.
+  const deque<Request*> requests = decoder->decode(data.get(), length.get());
+  const deque<Message*> messages = decoder->messages();
 
-  if (requests.empty() && decoder->failed()) {
+  if (requests.empty() && messages.empty() && decoder->failed()) {
      VLOG(1) << "Decoder error while receiving";
      socket_manager->close(socket);
-     delete[] data;
      delete decoder;
      return;
   }
@@ -715,18 +846,43 @@ void decode_recv(
       VLOG(1) << "Failed to get peer address while receiving: "
               << address.error();
       socket_manager->close(socket);
-      delete[] data;
       delete decoder;
       return;
     }
 
     foreach (Request* request, requests) {
       request->client = address.get();
+
+      // Accept the binary framing if the peer offers it, which it
+      // only does once (see framing.hpp).
+      if (binary_framing && !decoder->upgraded()) {
+        Option<string> offer = request->headers.get(framing::OFFER_HEADER);
+        if (offer.isSome() && offer.get() == framing::OFFER) {
+          decoder->upgrade();
+          socket_manager->send(
+              new DataEncoder(
+                  socket,
+                  string(framing::ACCEPT, framing::ACCEPT_SIZE)),
+              true);
+        }
+      }
+
       process_manager->handle(decoder->socket(), request);
     }
   }
 
-  socket.recv(data, size)
+  foreach (Message* message, messages) {
+    message->to.address = __address__;
+
+    VLOG(2) << "Decoded message name '" << message->name
+            << "' for " << message->to << " from " << message->from;
+
+    // TODO(benh): Use the sender PID when delivering in order to
+    // capture happens-before timing relationships for testing.
+    process_manager->deliver(message->to, new MessageEvent(message));
+  }
+
+  socket.recv(data.get(), size)
     .onAny(lambda::bind(&decode_recv, lambda::_1, data, size, socket, decoder));
 }
 
@@ -780,11 +936,13 @@ void on_accept(const Future<Socket>& socket)
     socket_manager->accepted(socket.get());
 
     const size_t size = 80 * 1024;
-    char* data = new char[size];
+    boost::shared_array<char> data = buffers::acquire(size);
 
-    DataDecoder* decoder = new DataDecoder(socket.get());
+    // Stream the bodies of large requests to the endpoints that
+    // handle them incrementally (see ProcessBase::RouteOptions).
+    DataDecoder* decoder = new DataDecoder(socket.get(), true);
 
-    socket.get().recv(data, size)
+    socket.get().recv(data.get(), size)
       .onAny(lambda::bind(
           &internal::decode_recv,
           lambda::_1,
@@ -812,6 +970,186 @@ void install(vector<Owned<FirewallRule>>&& rules)
 
 } // namespace firewall {
 
+
+// A gauge that reports the size of the event queue of a process (see
+// ProcessBase::exposeEventQueueSize). The size is read directly rather
+// than by dispatching to the process, which would queue behind the
+// very events that we want to count.
+class EventQueueSizeGauge : public metrics::Metric
+{
+public:
+  EventQueueSizeGauge(const string& name, const UPID& _pid)
+    : Metric(name, None()), pid(_pid) {}
+
+  virtual ~EventQueueSizeGauge() {}
+
+  virtual Future<double> value() const
+  {
+    ProcessReference process = process_manager->use(pid);
+
+    if (!process) {
+      return Failure("Process " + stringify(pid) + " has terminated");
+    }
+
+    return static_cast<double>(process->eventQueueSize());
+  }
+
+private:
+  const UPID pid;
+};
+
+
+// The ProcessStatisticsProcess provides an endpoint and metrics for the
+// statistics about the events that processes handle (see
+// process_statistics.hpp). This is only started during the
+// initialization of libprocess if the statistics are enabled.
+class ProcessStatisticsProcess : public Process<ProcessStatisticsProcess>
+{
+public:
+  ProcessStatisticsProcess()
+    : ProcessBase("__process_statistics__"),
+      messages(
+          "libprocess/events/messages",
+          defer(self(), &ProcessStatisticsProcess::_messages)),
+      dispatches(
+          "libprocess/events/dispatches",
+          defer(self(), &ProcessStatisticsProcess::_dispatches)),
+      http_requests(
+          "libprocess/events/http_requests",
+          defer(self(), &ProcessStatisticsProcess::_http_requests)),
+      exited(
+          "libprocess/events/exited",
+          defer(self(), &ProcessStatisticsProcess::_exited)),
+      sampled(
+          "libprocess/events/sampled",
+          defer(self(), &ProcessStatisticsProcess::_sampled)),
+      queue_time_secs(
+          "libprocess/events/queue_time_secs",
+          defer(self(), &ProcessStatisticsProcess::_queue_time_secs)),
+      handler_time_secs(
+          "libprocess/events/handler_time_secs",
+          defer(self(), &ProcessStatisticsProcess::_handler_time_secs)) {}
+
+  virtual ~ProcessStatisticsProcess() {}
+
+protected:
+  virtual void initialize()
+  {
+    // TODO(dhamon): Check return values.
+    metrics::add(messages);
+    metrics::add(dispatches);
+    metrics::add(http_requests);
+    metrics::add(exited);
+    metrics::add(sampled);
+    metrics::add(queue_time_secs);
+    metrics::add(handler_time_secs);
+
+    route("/", help(), &ProcessStatisticsProcess::statistics);
+  }
+
+  virtual void finalize()
+  {
+    metrics::remove(messages);
+    metrics::remove(dispatches);
+    metrics::remove(http_requests);
+    metrics::remove(exited);
+    metrics::remove(sampled);
+    metrics::remove(queue_time_secs);
+    metrics::remove(handler_time_secs);
+  }
+
+private:
+  static string help()
+  {
+    return HELP(
+      TLDR(
+          "Shows statistics about the events that each process handled."),
+      DESCRIPTION(
+          "Only a sample of the events get timed (see",
+          "LIBPROCESS_PROCESS_STATISTICS_SAMPLE_INTERVAL).",
+          "",
+          ">        events           Number of events of each type",
+          ">        sampled_events   Number of events that got timed",
+          ">        queue_time_ms    Mean and maximum time that the sampled"
+          " events waited in the event queue",
+          ">        handler_time_ms  Mean and maximum time that the process"
+          " took to handle the sampled events"));
+  }
+
+  Future<http::Response> statistics(const http::Request& request)
+  {
+    return http::OK(
+        process_manager->statistics(),
+        request.url.query.get("jsonp"));
+  }
+
+  // Gauge handlers, which sum up the statistics over all processes
+  // (including the processes that have terminated).
+  Future<double> _messages()
+  {
+    return total(&ProcessStatistics::messages);
+  }
+
+  Future<double> _dispatches()
+  {
+    return total(&ProcessStatistics::dispatches);
+  }
+
+  Future<double> _http_requests()
+  {
+    return total(&ProcessStatistics::requests);
+  }
+
+  Future<double> _exited()
+  {
+    return total(&ProcessStatistics::exits);
+  }
+
+  Future<double> _sampled()
+  {
+    return total(&ProcessStatistics::samples);
+  }
+
+  Future<double> _queue_time_secs()
+  {
+    return mean(&ProcessStatistics::queued);
+  }
+
+  Future<double> _handler_time_secs()
+  {
+    return mean(&ProcessStatistics::handled);
+  }
+
+  static double total(std::atomic<uint64_t> ProcessStatistics::*counter)
+  {
+    ProcessStatistics totals;
+    process_manager->statistics(&totals);
+    return (totals.*counter).load();
+  }
+
+  // Returns the mean of the sampled times in seconds.
+  static Future<double> mean(std::atomic<uint64_t> ProcessStatistics::*time)
+  {
+    ProcessStatistics totals;
+    process_manager->statistics(&totals);
+
+    if (totals.samples.load() == 0) {
+      return Failure("No events have been sampled");
+    }
+
+    return (totals.*time).load() / 1e9 / totals.samples.load();
+  }
+
+  metrics::Gauge messages;
+  metrics::Gauge dispatches;
+  metrics::Gauge http_requests;
+  metrics::Gauge exited;
+  metrics::Gauge sampled;
+  metrics::Gauge queue_time_secs;
+  metrics::Gauge handler_time_secs;
+};
+
+
 bool initialize(
     const Option<string>& delegate,
     const Option<string>& authenticationRealm)
@@ -918,6 +1256,55 @@ bool initialize(
     }
   }
 
+  // Check environment for whether to use the binary framing.
+  value = os::getenv("LIBPROCESS_ENABLE_BINARY_FRAMING");
+  if (value.isSome()) {
+    if (value.get() == "0" || value.get() == "false") {
+      binary_framing = false;
+    } else if (value.get() != "1" && value.get() != "true") {
+      LOG(WARNING) << "Ignoring invalid value " << value.get()
+                   << " for LIBPROCESS_ENABLE_BINARY_FRAMING"
+                   << ", the binary framing remains enabled";
+    }
+  }
+
+  value = os::getenv("LIBPROCESS_SOCKETS_PER_PEER");
+  if (value.isSome()) {
+    Try<size_t> count = numify<size_t>(value.get());
+    if (count.isSome() && count.get() > 0 && count.get() <= 64) {
+      sockets_per_peer = count.get();
+    } else {
+      LOG(WARNING) << "Ignoring invalid value " << value.get()
+                   << " for LIBPROCESS_SOCKETS_PER_PEER"
+                   << ", using default value " << sockets_per_peer.load();
+    }
+  }
+
+  // Check environment for whether to record process statistics.
+  value = os::getenv("LIBPROCESS_ENABLE_PROCESS_STATISTICS");
+  if (value.isSome()) {
+    if (value.get() == "1" || value.get() == "true") {
+      process_statistics = true;
+    } else if (value.get() != "0" && value.get() != "false") {
+      LOG(WARNING) << "Ignoring invalid value " << value.get()
+                   << " for LIBPROCESS_ENABLE_PROCESS_STATISTICS"
+                   << ", the process statistics remain disabled";
+    }
+  }
+
+  value = os::getenv("LIBPROCESS_PROCESS_STATISTICS_SAMPLE_INTERVAL");
+  if (value.isSome()) {
+    Try<long> interval = numify<long>(value.get().c_str());
+    if (interval.isSome() && interval.get() > 0) {
+      process_statistics_sample_interval = interval.get();
+    } else {
+      LOG(WARNING) << "Ignoring invalid value " << value.get()
+                   << " for LIBPROCESS_PROCESS_STATISTICS_SAMPLE_INTERVAL"
+                   << ", using default value "
+                   << process_statistics_sample_interval;
+    }
+  }
+
   // Create a "server" socket for communicating.
   Try<Socket> create = Socket::create();
   if (create.isError()) {
@@ -1042,6 +1429,9 @@ bool initialize(
   // Initialize the global metrics process.
   metrics::initialize(authenticationRealm);
 
+  // Add the metrics of the pool of read buffers.
+  buffers::initialize();
+
   // Create the global logging process.
   _logging = spawn(new Logging(authenticationRealm), true);
 
@@ -1051,6 +1441,11 @@ bool initialize(
   // Create the global system statistics process.
   spawn(new System(), true);
 
+  // Create the global process statistics process.
+  if (process_statistics) {
+    spawn(new ProcessStatisticsProcess(), true);
+  }
+
   // Create the global HTTP authentication router.
   authenticator_manager = new AuthenticatorManager();
 
@@ -1080,6 +1475,10 @@ void finalize()
   // during clean up, so we make sure the clock is running normally.
   Clock::resume();
 
+  // Remove the metrics of the pool of read buffers while the metrics
+  // process is still running.
+  buffers::finalize();
+
   // This will terminate any existing processes created via `spawn()`,
   // like `gc`, `help`, `Logging()`, `Profiler()`, and `System()`.
   // NOTE: This will also stop the event loop.
@@ -1400,26 +1799,59 @@ namespace internal {
 void ignore_recv_data(
     const Future<size_t>& length,
     Socket socket,
-    char* data,
+    const boost::shared_array<char>& data,
     size_t size)
 {
   if (length.isDiscarded() || length.isFailed()) {
     socket_manager->close(socket);
-    delete[] data;
     return;
   }
 
   if (length.get() == 0) {
     socket_manager->close(socket);
-    delete[] data;
     return;
   }
 
-  socket.recv(data, size)
+  socket.recv(data.get(), size)
     .onAny(lambda::bind(&ignore_recv_data, lambda::_1, socket, data, size));
 }
 
 
+// Like 'ignore_recv_data' but first reads the response to our offer
+// of the binary framing.
+void framing_recv(
+    const Future<size_t>& length,
+    Socket socket,
+    const boost::shared_array<char>& data,
+    size_t size,
+    const std::shared_ptr<MessageFraming>& framing)
+{
+  if (length.isDiscarded() || length.isFailed()) {
+    socket_manager->close(socket);
+    return;
+  }
+
+  if (length.get() == 0) {
+    socket_manager->close(socket);
+    return;
+  }
+
+  if (framing->received(data.get(), length.get())) {
+    socket.recv(data.get(), size)
+      .onAny(lambda::bind(
+          &framing_recv,
+          lambda::_1,
+          socket,
+          data,
+          size,
+          framing));
+  } else {
+    socket.recv(data.get(), size)
+      .onAny(lambda::bind(&ignore_recv_data, lambda::_1, socket, data, size));
+  }
+}
+
+
 // Forward declaration.
 void send(Encoder* encoder, Socket socket);
 
@@ -1488,16 +1920,7 @@ void SocketManager::link_connect(
     return;
   }
 
-  size_t size = 80 * 1024;
-  char* data = new char[size];
-
-  socket.recv(data, size)
-    .onAny(lambda::bind(
-        &internal::ignore_recv_data,
-        lambda::_1,
-        socket,
-        data,
-        size));
+  negotiate(socket);
 
   // In order to avoid a race condition where internal::send() is
   // called after SocketManager::link() but before the socket is
@@ -1518,6 +1941,47 @@ void SocketManager::link_connect(
 }
 
 
+void SocketManager::negotiate(const Socket& socket)
+{
+  // Note that we don't expect to receive anything other than the
+  // acknowledgement of the binary framing (or HTTP '202 Accepted'
+  // responses from peers that don't know that they're talking to
+  // libprocess), which we otherwise ignore.
+  size_t size = 80 * 1024;
+  boost::shared_array<char> data = buffers::acquire(size);
+
+  if (!binary_framing) {
+    socket.recv(data.get(), size)
+      .onAny(lambda::bind(
+          &internal::ignore_recv_data,
+          lambda::_1,
+          socket,
+          data,
+          size));
+    return;
+  }
+
+  std::shared_ptr<MessageFraming> framing(new MessageFraming());
+
+  synchronized (mutex) {
+    // The socket might have been closed already, in which case the
+    // receive below fails right away.
+    if (sockets.count(socket) > 0) {
+      framings[socket] = framing;
+    }
+  }
+
+  socket.recv(data.get(), size)
+    .onAny(lambda::bind(
+        &internal::framing_recv,
+        lambda::_1,
+        socket,
+        data,
+        size,
+        framing));
+}
+
+
 void SocketManager::link(
     ProcessBase* process,
     const UPID& to,
@@ -1536,6 +2000,7 @@ void SocketManager::link(
 
   Option<Socket> socket = None();
   bool connect = false;
+  bool reconnect = false;
 
   synchronized (mutex) {
     // Check if the socket address is remote.
@@ -1588,6 +2053,7 @@ void SocketManager::link(
         swap_implementing_socket(existing, socket.get());
 
         connect = true;
+        reconnect = true;
       }
     }
 
@@ -1598,6 +2064,13 @@ void SocketManager::link(
     }
   }
 
+  // The parallel sockets are likely as stale as the persistent socket
+  // that the linker wants to replace, so we replace them as well (they
+  // get created again when there are messages to send on them).
+  if (reconnect) {
+    close_parallels(to.address);
+  }
+
   if (connect) {
     CHECK_SOME(socket);
     socket->connect(to.address)
@@ -1674,6 +2147,93 @@ void _send(
     size_t size);
 
 
+// The maximum number of messages we send with a single (vectored)
+// write. Each message takes up to three buffers, which keeps us well
+// below IOV_MAX.
+static const size_t MAX_COALESCED_MESSAGES = 64;
+
+
+void _send_messages(
+    const Future<size_t>& length,
+    Socket socket,
+    const vector<MessageEncoder*>& encoders,
+    const vector<size_t>& sizes);
+
+
+void send_messages(vector<MessageEncoder*>&& encoders, Socket socket)
+{
+  // Send any other messages that are queued for this socket along
+  // with these.
+  std::shared_ptr<MessageFraming> framing =
+    socket_manager->coalesce(socket, &encoders, MAX_COALESCED_MESSAGES);
+
+  vector<Socket::Buffer> buffers;
+  buffers.reserve(3 * encoders.size());
+
+  vector<size_t> sizes;
+  sizes.reserve(encoders.size());
+
+  foreach (MessageEncoder* encoder, encoders) {
+    sizes.push_back(encoder->next(&buffers, framing.get()));
+  }
+
+  socket.send(buffers)
+    .onAny(lambda::bind(
+        &internal::_send_messages,
+        lambda::_1,
+        socket,
+        std::move(encoders),
+        std::move(sizes)));
+}
+
+
+void _send_messages(
+    const Future<size_t>& length,
+    Socket socket,
+    const vector<MessageEncoder*>& encoders,
+    const vector<size_t>& sizes)
+{
+  if (length.isDiscarded() || length.isFailed()) {
+    socket_manager->close(socket);
+
+    foreach (MessageEncoder* encoder, encoders) {
+      delete encoder;
+    }
+    return;
+  }
+
+  // Update the encoders with the amount sent, deleting the messages
+  // that were sent completely.
+  vector<MessageEncoder*> remaining;
+
+  size_t sent = length.get();
+
+  for (size_t i = 0; i < encoders.size(); i++) {
+    const size_t size = std::min(sent, sizes[i]);
+    sent -= size;
+
+    encoders[i]->backup(sizes[i] - size);
+
+    if (encoders[i]->remaining() == 0) {
+      delete encoders[i];
+    } else {
+      remaining.push_back(encoders[i]);
+    }
+  }
+
+  if (!remaining.empty()) {
+    send_messages(std::move(remaining), socket);
+    return;
+  }
+
+  // Check for more stuff to send on socket.
+  Encoder* next = socket_manager->next(socket);
+  if (next != nullptr) {
+    send(next, socket);
+  }
+}
+
+
 void send(Encoder* encoder, Socket socket)
 {
   switch (encoder->kind()) {
@@ -1702,6 +2262,10 @@ void send(Encoder* encoder, Socket socket)
             size));
       break;
     }
+    case Encoder::MESSAGE: {
+      send_messages({static_cast<MessageEncoder*>(encoder)}, socket);
+      break;
+    }
   }
 }
 
@@ -1751,7 +2315,7 @@ void SocketManager::send(Encoder* encoder, bool persist)
       }
 
       if (outgoing.count(socket) > 0) {
-        outgoing[socket].push(encoder);
+        outgoing[socket].push_back(encoder);
         encoder = nullptr;
       } else {
         // Initialize the outgoing queue.
@@ -1856,24 +2420,42 @@ void SocketManager::send_connect(
 
   Encoder* encoder = new MessageEncoder(socket, message);
 
-  // Receive and ignore data from this socket. Note that we don't
-  // expect to receive anything other than HTTP '202 Accepted'
-  // responses which we just ignore.
-  size_t size = 80 * 1024;
-  char* data = new char[size];
-
-  socket.recv(data, size)
-    .onAny(lambda::bind(
-        &internal::ignore_recv_data,
-        lambda::_1,
-        socket,
-        data,
-        size));
+  negotiate(socket);
 
   internal::send(encoder, socket);
 }
 
 
+// Returns the index of the socket to the receiver's socket address
+// that a message gets sent on. Every pair of sender and receiver uses
+// the same socket so that the messages between them keep their order,
+// while the messages between other processes can be sent in parallel
+// on the other sockets (i.e., without waiting for a large message
+// ahead of them).
+static size_t lane(const Message& message)
+{
+  const size_t count = sockets_per_peer.load();
+
+  if (count <= 1) {
+    return 0;
+  }
+
+  std::hash<UPID> hash;
+
+  return (hash(message.from) * 31 + hash(message.to)) % count;
+}
+
+
+// Tests can declare this function and use it to change the number of
+// sockets per peer (see LIBPROCESS_SOCKETS_PER_PEER). Messages sent
+// before and after the change might not keep their order.
+void set_sockets_per_peer(size_t count)
+{
+  CHECK_GT(count, 0u);
+  sockets_per_peer = count;
+}
+
+
 void SocketManager::send(Message* message, const Socket::Kind& kind)
 {
   CHECK(message != nullptr);
@@ -1884,11 +2466,24 @@ void SocketManager::send(Message* message, const Socket::Kind& kind)
   bool connect = false;
 
   synchronized (mutex) {
+    const size_t index = lane(*message);
+
     // Check if there is already a socket.
     bool persist = persists.count(address) > 0;
-    bool temp = temps.count(address) > 0;
-    if (persist || temp) {
-      int s = persist ? persists[address] : temps[address];
+
+    Option<int> existing = None();
+    if (index > 0) {
+      if (parallels.count({address, index}) > 0) {
+        existing = parallels[{address, index}];
+      }
+    } else if (persist) {
+      existing = persists[address];
+    } else if (temps.count(address) > 0) {
+      existing = temps[address];
+    }
+
+    if (existing.isSome()) {
+      int s = existing.get();
       CHECK(sockets.count(s) > 0);
       socket = sockets.at(s);
 
@@ -1899,7 +2494,7 @@ void SocketManager::send(Message* message, const Socket::Kind& kind)
       }
 
       if (outgoing.count(socket.get()) > 0) {
-        outgoing[socket.get()].push(new MessageEncoder(socket.get(), message));
+        enqueue(socket.get(), new MessageEncoder(socket.get(), message));
         return;
       } else {
         // Initialize the outgoing queue.
@@ -1907,8 +2502,9 @@ void SocketManager::send(Message* message, const Socket::Kind& kind)
       }
 
     } else {
-      // No persistent or temporary socket to the socket address
-      // currently exists, so we create a temporary one.
+      // No socket to the socket address currently exists, so we
+      // create a temporary one (or a parallel one, which is only
+      // temporary if there isn't a persistent socket).
       // The kind of socket we create is passed in as an argument.
       // This allows us to support downgrading the connection type
       // from SSL to POLL if enabled.
@@ -1925,9 +2521,18 @@ void SocketManager::send(Message* message, const Socket::Kind& kind)
       sockets.emplace(s, socket.get());
 
       addresses[s] = address;
-      temps[address] = s;
 
-      dispose.insert(s);
+      if (index > 0) {
+        parallels[{address, index}] = s;
+        indexes[s] = index;
+
+        if (!persist) {
+          dispose.insert(s);
+        }
+      } else {
+        temps[address] = s;
+        dispose.insert(s);
+      }
 
       // Initialize the outgoing queue.
       outgoing[s];
@@ -1955,14 +2560,87 @@ void SocketManager::send(Message* message, const Socket::Kind& kind)
 }
 
 
-Encoder* SocketManager::next(int s)
+void SocketManager::enqueue(int s, MessageEncoder* encoder)
 {
-  HttpProxy* proxy = nullptr; // Non-null if needs to be terminated.
-
   synchronized (mutex) {
-    // We cannot assume 'sockets.count(s) > 0' here because it's
-    // possible that 's' has been removed with a call to
-    // SocketManager::close. For example, it could be the case that a
+    deque<Encoder*>& queued = outgoing[s];
+
+    const Message* message = encoder->get();
+
+    if (message == nullptr || message->body.size() > PRIORITY_MESSAGE_SIZE) {
+      queued.push_back(encoder);
+      return;
+    }
+
+    // Move the message ahead of the bulk messages at the back of the
+    // queue, but not ahead of any message between the same processes.
+    //
+    // NOTE: The message that's currently being sent (if any) is no
+    // longer in the queue, so we never get ahead of a partially sent
+    // message.
+    auto position = queued.end();
+
+    while (position != queued.begin()) {
+      const Encoder* previous = *(position - 1);
+
+      if (previous->kind() != Encoder::MESSAGE) {
+        break;
+      }
+
+      const Message* other =
+        static_cast<const MessageEncoder*>(previous)->get();
+
+      if (other == nullptr ||
+          other->body.size() <= PRIORITY_MESSAGE_SIZE ||
+          (other->from == message->from && other->to == message->to)) {
+        break;
+      }
+
+      --position;
+    }
+
+    queued.insert(position, encoder);
+  }
+}
+
+
+std::shared_ptr<MessageFraming> SocketManager::coalesce(
+    int s,
+    vector<MessageEncoder*>* encoders,
+    size_t limit)
+{
+  synchronized (mutex) {
+    // See the comment in 'next' for why the socket might be gone.
+    if (sockets.count(s) == 0 || outgoing.count(s) == 0) {
+      return nullptr;
+    }
+
+    deque<Encoder*>& queued = outgoing[s];
+
+    while (encoders->size() < limit &&
+           !queued.empty() &&
+           queued.front()->kind() == Encoder::MESSAGE) {
+      encoders->push_back(static_cast<MessageEncoder*>(queued.front()));
+      queued.pop_front();
+    }
+
+    if (framings.contains(s)) {
+      return framings[s];
+    }
+  }
+
+  return nullptr;
+}
+
+
+Encoder* SocketManager::next(int s)
+{
+  HttpProxy* proxy = nullptr; // Non-null if needs to be terminated.
+
+  synchronized (mutex) {
+    // We cannot assume 'sockets.count(s) > 0' here because it's
+    // possible that 's' has been removed with a call to
+    // SocketManager::close. For example, it could be the case that a
     // socket has gone to CLOSE_WAIT and the call to read in
     // io::read returned 0 causing SocketManager::close to get
     // invoked. Later a call to 'send' or 'sendfile' (e.g., in
@@ -1979,7 +2657,7 @@ Encoder* SocketManager::next(int s)
       if (!outgoing[s].empty()) {
         // More messages!
         Encoder* encoder = outgoing[s].front();
-        outgoing[s].pop();
+        outgoing[s].pop_front();
         return encoder;
       } else {
         // No more messages ... erase the outgoing queue.
@@ -1991,11 +2669,20 @@ Encoder* SocketManager::next(int s)
           // sending HTTP responses back on. Clean up either way.
           if (addresses.count(s) > 0) {
             const Address& address = addresses[s];
-            CHECK(temps.count(address) > 0 && temps[address] == s);
-            temps.erase(address);
+            if (indexes.count(s) > 0) {
+              const pair<Address, size_t> parallel(address, indexes[s]);
+              CHECK(parallels.count(parallel) > 0 && parallels[parallel] == s);
+              parallels.erase(parallel);
+              indexes.erase(s);
+            } else {
+              CHECK(temps.count(address) > 0 && temps[address] == s);
+              temps.erase(address);
+            }
             addresses.erase(s);
           }
 
+          framings.erase(s);
+
           if (proxies.count(s) > 0) {
             proxy = proxies[s];
             proxies.erase(s);
@@ -2041,6 +2728,13 @@ void SocketManager::close(int s)
 {
   HttpProxy* proxy = nullptr; // Non-null if needs to be terminated.
 
+  // Non-none if the parallel sockets to this address need to be closed.
+  Option<Address> parallel = None();
+
+  // Non-none if the persistent socket needs to be closed because one
+  // of the parallel sockets alongside it got closed.
+  Option<int> persistent = None();
+
   synchronized (mutex) {
     // This socket might not be active if it was already asked to get
     // closed (e.g., a write on the socket failed so we try and close
@@ -2053,7 +2747,7 @@ void SocketManager::close(int s)
         while (!outgoing[s].empty()) {
           Encoder* encoder = outgoing[s].front();
           delete encoder;
-          outgoing[s].pop();
+          outgoing[s].pop_front();
         }
 
         outgoing.erase(s);
@@ -2067,6 +2761,22 @@ void SocketManager::close(int s)
         if (persists.count(address) > 0 && persists[address] == s) {
           persists.erase(address);
           exited(address); // Generate ExitedEvent(s)!
+          parallel = address;
+        } else if (indexes.count(s) > 0) {
+          parallels.erase({address, indexes[s]});
+          indexes.erase(s);
+
+          // The messages that were queued on (or in flight through)
+          // this socket are lost, so if it was open alongside a
+          // persistent socket we have to treat the link as lost as
+          // well, otherwise the linkers could miss messages without
+          // getting an ExitedEvent.
+          if (persists.count(address) > 0) {
+            persistent = persists[address];
+            persists.erase(address);
+            exited(address); // Generate ExitedEvent(s)!
+            parallel = address;
+          }
         } else if (temps.count(address) > 0 && temps[address] == s) {
           temps.erase(address);
         }
@@ -2074,6 +2784,8 @@ void SocketManager::close(int s)
         addresses.erase(s);
       }
 
+      framings.erase(s);
+
       // Clean up any proxy associated with this socket.
       if (proxies.count(s) > 0) {
         proxy = proxies[s];
@@ -2113,6 +2825,16 @@ void SocketManager::close(int s)
     terminate(proxy);
   }
 
+  if (persistent.isSome()) {
+    close(persistent.get());
+  }
+
+  // The parallel sockets are only kept open along with a persistent
+  // socket.
+  if (parallel.isSome()) {
+    close_parallels(parallel.get());
+  }
+
   // Note that we don't actually:
   //
   //   close(s);
@@ -2133,6 +2855,24 @@ void SocketManager::close(int s)
 }
 
 
+void SocketManager::close_parallels(const Address& address)
+{
+  vector<int> parallel;
+
+  synchronized (mutex) {
+    for (auto iterator = parallels.lower_bound({address, 0});
+         iterator != parallels.end() && iterator->first.first == address;
+         ++iterator) {
+      parallel.push_back(iterator->second);
+    }
+  }
+
+  foreach (int s, parallel) {
+    close(s);
+  }
+}
+
+
 void SocketManager::exited(const Address& address)
 {
   // TODO(benh): It would be cleaner if this routine could call back
@@ -2259,17 +2999,26 @@ void SocketManager::swap_implementing_socket(
     addresses.erase(from_fd);
 
     // If this address is a temporary link.
-    if (temps.count(addresses[to_fd]) > 0) {
+    if (temps.count(addresses[to_fd]) > 0 &&
+        temps[addresses[to_fd]] == from_fd) {
       temps[addresses[to_fd]] = to_fd;
       // No need to erase as we're changing the value, not the key.
     }
 
     // If this address is a persistent link.
-    if (persists.count(addresses[to_fd]) > 0) {
+    if (persists.count(addresses[to_fd]) > 0 &&
+        persists[addresses[to_fd]] == from_fd) {
       persists[addresses[to_fd]] = to_fd;
       // No need to erase as we're changing the value, not the key.
     }
 
+    // If this is a parallel socket.
+    if (indexes.count(from_fd) > 0) {
+      indexes[to_fd] = indexes[from_fd];
+      indexes.erase(from_fd);
+      parallels[{addresses[to_fd], indexes[to_fd]}] = to_fd;
+    }
+
     // Move any encoders queued against this link to the new socket.
     outgoing[to_fd] = std::move(outgoing[from_fd]);
     outgoing.erase(from_fd);
@@ -2286,28 +3035,43 @@ void SocketManager::swap_implementing_socket(
 ProcessManager::ProcessManager(const Option<string>& _delegate)
   : delegate(_delegate)
 {
-  running.store(0);
+  next_runq.store(0);
+  pending.store(0);
 }
 
 
 ProcessManager::~ProcessManager()
 {
-  ProcessBase* process = nullptr;
-  // Terminate the first process in the queue. Events are deleted
-  // and the process is erased in ProcessManager::cleanup(). Don't
-  // hold the lock or process the whole map as terminating one process
-  // might trigger other terminations. Deal with them one at a time.
+  // Terminate the processes in the order of their IDs. Events are
+  // deleted and the process is erased in ProcessManager::cleanup().
+  // Don't hold the lock while terminating as terminating one process
+  // might trigger other terminations (or spawn other processes), so
+  // we take a snapshot of the processes, sort it once and terminate
+  // them one at a time (skipping those that are gone already), and
+  // then start over until there are no processes left.
+  //
+  // NOTE: '_' sorts before lowercase letters, so system processes
+  // like '__gc__' are not necessarily terminated last.
+  vector<UPID> pids;
+
   do {
+    pids.clear();
+
     synchronized (processes_mutex) {
-      process = !processes.empty() ? processes.begin()->second : nullptr;
+      foreach (ProcessBase* process, processes.values()) {
+        pids.push_back(process->pid);
+      }
     }
-    if (process != nullptr) {
+
+    std::sort(pids.begin(), pids.end());
+
+    foreach (const UPID& pid, pids) {
       // Terminate this process but do not inject the message,
       // i.e. allow it to finish its work first.
-      process::terminate(process, false);
-      process::wait(process);
+      process::terminate(pid, false);
+      process::wait(pid);
     }
-  } while (process != nullptr);
+  } while (!pids.empty());
 
   // Send signal to all processing threads to stop running.
   joining_threads.store(true);
@@ -2368,23 +3132,39 @@ long ProcessManager::init_threads()
 
   threads.reserve(num_worker_threads + 1);
 
+  // Create a run queue for each of the processing threads. This must
+  // be done before any of the threads are started.
+  runqs.reserve(num_worker_threads);
+  for (long i = 0; i < num_worker_threads; i++) {
+    runqs.emplace_back(new RunQueue());
+  }
+
   struct
   {
-    void operator()() const
+    void operator()(long index) const
     {
+      __worker__ = index;
+
       do {
         ProcessBase* process = process_manager->dequeue();
         if (process == nullptr) {
+          // Announce that we might go idle _before_ checking the run
+          // queues again so that a concurrent enqueue either gets
+          // seen by the 'dequeue' below or opens the gate.
+          idle_workers.fetch_add(1);
           Gate::state_t old = gate->approach();
           process = process_manager->dequeue();
           if (process == nullptr) {
             if (joining_threads.load()) {
+              idle_workers.fetch_sub(1);
               break;
             }
             gate->arrive(old); // Wait at gate if idle.
+            idle_workers.fetch_sub(1);
             continue;
           } else {
             gate->leave();
+            idle_workers.fetch_sub(1);
           }
         }
         process_manager->resume(process);
@@ -2399,7 +3179,7 @@ long ProcessManager::init_threads()
   // Create processing threads.
   for (long i = 0; i < num_worker_threads; i++) {
     // Retain the thread handles so that we can join when shutting down.
-    threads.emplace_back(new std::thread(worker));
+    threads.emplace_back(new std::thread(worker, i));
   }
 
   // Create a thread for the event loop.
@@ -2412,20 +3192,35 @@ long ProcessManager::init_threads()
 ProcessReference ProcessManager::use(const UPID& pid)
 {
   if (pid.address == __address__) {
-    synchronized (processes_mutex) {
-      if (processes.count(pid.id) > 0) {
-        // Note that the ProcessReference constructor _must_ get
-        // called while holding the lock on processes so that waiting
-        // for references is atomic (i.e., race free).
-        return ProcessReference(processes[pid.id]);
-      }
-    }
+    // Note that the ProcessReference constructor _must_ get called
+    // from within the lookup so that waiting for references is
+    // atomic (i.e., race free), since a process only gets removed
+    // from the table once all of the lookups that found it are done
+    // (see ProcessManager::cleanup).
+    return processes.find(pid.id, [](ProcessBase* process) {
+      return ProcessReference(process);
+    });
   }
 
   return ProcessReference(nullptr);
 }
 
 
+// Deletes a request that doesn't get delivered to a process. The
+// reader of a streamed request gets closed first, so that the
+// DataDecoder drops the rest of the body instead of writing it into a
+// pipe that nothing reads.
+static void drop(Request* request)
+{
+  if (request->reader.isSome()) {
+    Pipe::Reader reader = request->reader.get();
+    reader.close();
+  }
+
+  delete request;
+}
+
+
 void ProcessManager::handle(
     const Socket& socket,
     Request* request)
@@ -2487,7 +3282,7 @@ void ProcessManager::handle(
     dispatch(proxy, &HttpProxy::enqueue, BadRequest(), *request);
 
     // Cleanup request.
-    delete request;
+    drop(request);
     return;
   }
 
@@ -2504,7 +3299,7 @@ void ProcessManager::handle(
     dispatch(proxy, &HttpProxy::enqueue, NotFound(), *request);
 
     // Cleanup request.
-    delete request;
+    drop(request);
     return;
   }
 
@@ -2557,7 +3352,7 @@ void ProcessManager::handle(
             *request);
 
         // Cleanup request.
-        delete request;
+        drop(request);
         return;
       }
     }
@@ -2592,7 +3387,7 @@ void ProcessManager::handle(
   dispatch(proxy, &HttpProxy::enqueue, NotFound(), *request);
 
   // Cleanup request.
-  delete request;
+  drop(request);
 }
 
 
@@ -2637,15 +3432,73 @@ bool ProcessManager::deliver(
 }
 
 
+bool ProcessManager::continuation(
+    const UPID& pid,
+    const std::shared_ptr<lambda::function<void(ProcessBase*)>>& f,
+    const Option<const std::type_info*>& functionType)
+{
+  ProcessBase* process = __process__;
+
+  // NOTE: the event being processed is still outstanding so a size of
+  // one means that no other events are queued.
+  if (process == nullptr ||
+      process->pid != pid ||
+      process->state != ProcessBase::RUNNING ||
+      process->events->size() != 1) {
+    return false;
+  }
+
+  // Let the filter see the function as if it had been delivered, so
+  // that dispatches to the running process can still be expected or
+  // dropped (e.g., by tests).
+  synchronized (filterer_mutex) {
+    if (filterer != nullptr && filterer->filter(
+            DispatchEvent(pid, f, functionType))) {
+      return true;
+    }
+  }
+
+  process->continuations.push_back(f);
+
+  return true;
+}
+
+
+bool ProcessManager::coalesce(const UPID& pid, const string& tag)
+{
+  ProcessReference process = use(pid);
+
+  if (!process) {
+    return false;
+  }
+
+  synchronized (process->coalescingLock) {
+    return process->coalescing.insert(tag).second;
+  }
+}
+
+
+void ProcessManager::coalesced(const UPID& pid, const string& tag)
+{
+  ProcessReference process = use(pid);
+
+  if (!process) {
+    return;
+  }
+
+  synchronized (process->coalescingLock) {
+    process->coalescing.erase(tag);
+  }
+}
+
+
 UPID ProcessManager::spawn(ProcessBase* process, bool manage)
 {
   CHECK(process != nullptr);
 
   synchronized (processes_mutex) {
-    if (processes.count(process->pid.id) > 0) {
+    if (!processes.insert(process)) {
       return UPID();
-    } else {
-      processes[process->pid.id] = process;
     }
   }
 
@@ -2673,6 +3526,11 @@ void ProcessManager::resume(ProcessBase* process)
 {
   __process__ = process;
 
+  // Attribute the samples of the sampling profiler to the process.
+  if (sampler::running.load(std::memory_order_relaxed)) {
+    sampler::label(process->pid.id);
+  }
+
   VLOG(2) << "Resuming " << process->pid << " at " << Clock::now();
 
   bool terminate = false;
@@ -2681,98 +3539,182 @@ void ProcessManager::resume(ProcessBase* process)
   CHECK(process->state == ProcessBase::BOTTOM ||
         process->state == ProcessBase::READY);
 
+  // Marks the current event (or the initialization of the process)
+  // as finished and determines whether the process should block
+  // because there are no more events. Note that we need to update the
+  // state _before_ finishing because as soon as there are no more
+  // outstanding events the next enqueue will schedule the process.
+  auto finish = [process]() {
+    process->state = ProcessBase::BLOCKED;
+
+    if (process->events->finish()) {
+      return true;
+    }
+
+    process->state = ProcessBase::RUNNING;
+    return false;
+  };
+
+  // Runs the functions that got dispatched to the process while it
+  // was serving the current event (and the functions that those
+  // dispatch in turn) before any other events, as if they had been
+  // queued next (see ProcessManager::continuation). Returns true if
+  // the process should terminate.
+  auto continuations = [process]() {
+    bool terminate = false;
+
+    for (size_t i = 0;
+         !terminate && i < process->continuations.size();
+         i++) {
+      // NOTE: we can't hold on to a reference to the function since
+      // running it can add more functions to 'continuations'.
+      std::shared_ptr<lambda::function<void(ProcessBase*)>> f =
+        process->continuations[i];
+
+      if (process->statistics) {
+        process->statistics->dispatched();
+      }
+
+      try {
+        (*f)(process);
+      } catch (const std::exception& e) {
+        std::cerr << "libprocess: " << process->pid
+                  << " terminating due to "
+                  << e.what() << std::endl;
+        terminate = true;
+      } catch (...) {
+        std::cerr << "libprocess: " << process->pid
+                  << " terminating due to unknown exception" << std::endl;
+        terminate = true;
+      }
+    }
+
+    process->continuations.clear();
+
+    return terminate;
+  };
+
   if (process->state == ProcessBase::BOTTOM) {
     process->state = ProcessBase::RUNNING;
     try { process->initialize(); }
     catch (...) { terminate = true; }
+
+    if (terminate) {
+      process->continuations.clear();
+    } else if (continuations()) {
+      // Like an exception while serving an event (see below).
+      terminate = true;
+      cleanup(process);
+    } else {
+      blocked = finish();
+    }
+  } else {
+    process->state = ProcessBase::RUNNING;
   }
 
   while (!terminate && !blocked) {
-    Event* event = nullptr;
+    Event* event = process->events->dequeue();
 
-    synchronized (process->mutex) {
-      if (process->events.size() > 0) {
-        event = process->events.front();
-        process->events.pop_front();
-        process->state = ProcessBase::RUNNING;
-      } else {
-        process->state = ProcessBase::BLOCKED;
-        blocked = true;
-      }
-    }
+    CHECK(event != nullptr);
+
+    bool filter = false;
 
-    if (!blocked) {
-      CHECK(event != nullptr);
+    // Determine if we should filter this event.
+    synchronized (filterer_mutex) {
+      if (filterer != nullptr) {
+        struct FilterVisitor : EventVisitor
+        {
+          explicit FilterVisitor(bool* _filter) : filter(_filter) {}
 
-      // Determine if we should filter this event.
-      synchronized (filterer_mutex) {
-        if (filterer != nullptr) {
-          bool filter = false;
-          struct FilterVisitor : EventVisitor
+          virtual void visit(const MessageEvent& event)
           {
-            explicit FilterVisitor(bool* _filter) : filter(_filter) {}
+            *filter = filterer->filter(event);
+          }
 
-            virtual void visit(const MessageEvent& event)
-            {
-              *filter = filterer->filter(event);
-            }
+          virtual void visit(const DispatchEvent& event)
+          {
+            *filter = filterer->filter(event);
+          }
 
-            virtual void visit(const DispatchEvent& event)
-            {
-              *filter = filterer->filter(event);
-            }
+          virtual void visit(const HttpEvent& event)
+          {
+            *filter = filterer->filter(event);
+          }
 
-            virtual void visit(const HttpEvent& event)
-            {
-              *filter = filterer->filter(event);
-            }
+          virtual void visit(const ExitedEvent& event)
+          {
+            *filter = filterer->filter(event);
+          }
 
-            virtual void visit(const ExitedEvent& event)
-            {
-              *filter = filterer->filter(event);
-            }
+          bool* filter;
+        } visitor(&filter);
 
-            bool* filter;
-          } visitor(&filter);
+        event->visit(&visitor);
+      }
+    }
 
-          event->visit(&visitor);
+    if (filter) {
+      delete event;
+      blocked = finish();
+      continue; // Try and execute the next event.
+    }
 
-          if (filter) {
-            delete event;
-            continue; // Try and execute the next event.
-          }
-        }
-      }
+    // Determine if we should terminate.
+    terminate = event->is<TerminateEvent>();
 
-      // Determine if we should terminate.
-      terminate = event->is<TerminateEvent>();
+    int64_t dequeued = 0;
 
-      // Now service the event.
-      try {
-        process->serve(*event);
-      } catch (const std::exception& e) {
-        std::cerr << "libprocess: " << process->pid
-                  << " terminating due to "
-                  << e.what() << std::endl;
-        terminate = true;
-      } catch (...) {
-        std::cerr << "libprocess: " << process->pid
-                  << " terminating due to unknown exception" << std::endl;
-        terminate = true;
+    if (process->statistics) {
+      process->statistics->count(*event);
+
+      if (event->enqueued != 0) {
+        dequeued = ProcessStatistics::now();
       }
+    }
 
-      delete event;
+    // Now service the event.
+    try {
+      process->serve(*event);
+    } catch (const std::exception& e) {
+      std::cerr << "libprocess: " << process->pid
+                << " terminating due to "
+                << e.what() << std::endl;
+      terminate = true;
+    } catch (...) {
+      std::cerr << "libprocess: " << process->pid
+                << " terminating due to unknown exception" << std::endl;
+      terminate = true;
+    }
 
-      if (terminate) {
-        cleanup(process);
-      }
+    if (dequeued != 0) {
+      process->statistics->sample(
+          dequeued - event->enqueued,
+          ProcessStatistics::now() - dequeued);
+    }
+
+    delete event;
+
+    if (terminate) {
+      process->continuations.clear();
+    } else {
+      terminate = continuations();
+    }
+
+    if (terminate) {
+      // NOTE: we never finish the terminate event so that the process
+      // never gets scheduled again.
+      cleanup(process);
+    } else {
+      blocked = finish();
     }
   }
 
+  sampler::unlabel();
+
   __process__ = nullptr;
 
-  CHECK_GE(running.load(), 1);
-  running.fetch_sub(1);
+  CHECK_GE(pending.load(), 1);
+  pending.fetch_sub(1);
 }
 
 
@@ -2790,29 +3732,28 @@ void ProcessManager::cleanup(ProcessBase* process)
   // the process we are cleaning up will get dropped (since it's
   // terminating) and eliminates the potential of enqueueing them on
   // another process that gets spawned with the same PID.
-  deque<Event*> events;
-
-  synchronized (process->mutex) {
-    process->state = ProcessBase::TERMINATING;
-    events = process->events;
-    process->events.clear();
-  }
-
-  // Delete pending events.
-  while (!events.empty()) {
-    Event* event = events.front();
-    events.pop_front();
-    delete event;
-  }
+  process->state = ProcessBase::TERMINATING;
+  process->events->clear();
 
   // Remove help strings for all installed routes for this process.
   dispatch(help, &Help::remove, process->pid.id);
 
+  // Remove the gauge of the event queue size, if it was exposed.
+  if (process->eventQueueSizeGauge.isSome()) {
+    metrics::remove(
+        EventQueueSizeGauge(process->eventQueueSizeGauge.get(), process->pid));
+  }
+
   // Possible gate non-libprocess threads are waiting at.
   Gate* gate = nullptr;
 
   // Remove process.
   synchronized (processes_mutex) {
+    // Remove the process first so that no new references can get
+    // created. Once this returns every lookup that found the process
+    // has already taken its reference, which we wait for below.
+    processes.erase(process->pid.id);
+
     // Wait for all process references to get cleaned up.
     while (process->refs.load() > 0) {
 #if defined(__i386__) || defined(__x86_64__)
@@ -2820,21 +3761,24 @@ void ProcessManager::cleanup(ProcessBase* process)
 #endif
     }
 
-    synchronized (process->mutex) {
-      CHECK(process->events.empty());
-
-      processes.erase(process->pid.id);
+    // Delete any events that were enqueued by threads that had not
+    // yet observed the terminating state (such threads must have been
+    // holding a reference, which we've waited for above).
+    process->events->clear();
+
+    // Lookup gate to wake up waiting threads.
+    map<ProcessBase*, Gate*>::iterator it = gates.find(process);
+    if (it != gates.end()) {
+      gate = it->second;
+      // N.B. The last thread that leaves the gate also free's it.
+      gates.erase(it);
+    }
 
-      // Lookup gate to wake up waiting threads.
-      map<ProcessBase*, Gate*>::iterator it = gates.find(process);
-      if (it != gates.end()) {
-        gate = it->second;
-        // N.B. The last thread that leaves the gate also free's it.
-        gates.erase(it);
-      }
+    CHECK(process->refs.load() == 0);
+    process->state = ProcessBase::TERMINATED;
 
-      CHECK(process->refs.load() == 0);
-      process->state = ProcessBase::TERMINATED;
+    if (process->statistics) {
+      retired.add(*process->statistics);
     }
 
     // Note that we don't remove the process from the clock during
@@ -2889,9 +3833,22 @@ void ProcessManager::link(
     // Since the pid is local we want to get a reference to it's
     // underlying process so that while we are invoking the link
     // manager we don't miss sending a possible ExitedEvent.
-    if (ProcessReference _ = use(to)) {
-      socket_manager->link(process, to, remote);
-    } else {
+    //
+    // NOTE: unlike other lookups this needs to be synchronized on
+    // processes, since ProcessManager::cleanup removes a process
+    // before telling the socket manager that it exited. Otherwise we
+    // could send an ExitedEvent (which might cause the process to get
+    // deleted) before the socket manager is done with the process.
+    bool linked = false;
+
+    synchronized (processes_mutex) {
+      if (ProcessReference _ = use(to)) {
+        socket_manager->link(process, to, remote);
+        linked = true;
+      }
+    }
+
+    if (!linked) {
       // Since the pid isn't valid it's process must have already died
       // (or hasn't been spawned yet) so send a process exit message.
       process->enqueue(new ExitedEvent(to));
@@ -2937,8 +3894,9 @@ bool ProcessManager::wait(const UPID& pid)
 
   // Try and approach the gate if necessary.
   synchronized (processes_mutex) {
-    if (processes.count(pid.id) > 0) {
-      process = processes[pid.id];
+    process = processes.get(pid.id);
+
+    if (process != nullptr) {
       CHECK(process->state != ProcessBase::TERMINATED);
 
       // Check and see if a gate already exists.
@@ -2952,23 +3910,30 @@ bool ProcessManager::wait(const UPID& pid)
       // Check if it is runnable in order to donate this thread.
       if (process->state == ProcessBase::BOTTOM ||
           process->state == ProcessBase::READY) {
-        synchronized (runq_mutex) {
-          list<ProcessBase*>::iterator it =
-            find(runq.begin(), runq.end(), process);
-          if (it != runq.end()) {
-            // Found it! Remove it from the run queue since we'll be
-            // donating our thread and also increment 'running' before
-            // leaving this 'runq' protected critical section so that
-            // everyone that is waiting for the processes to settle
-            // continue to wait (otherwise they could see nothing in
-            // 'runq' and 'running' equal to 0 between when we exit
-            // this critical section and increment 'running').
-            runq.erase(it);
-            running.fetch_add(1);
-          } else {
-            // Another thread has resumed the process ...
-            process = nullptr;
+        bool found = false;
+        foreach (const std::unique_ptr<RunQueue>& runq, runqs) {
+          synchronized (runq->mutex) {
+            deque<ProcessBase*>::iterator it = find(
+                runq->processes.begin(), runq->processes.end(), process);
+            if (it != runq->processes.end()) {
+              // Found it! Remove it from the run queue since we'll be
+              // donating our thread. Note that the process is still
+              // accounted for in 'pending' (it gets decremented once
+              // we're done resuming it) so everyone that is waiting
+              // for the processes to settle continues to wait.
+              runq->processes.erase(it);
+              found = true;
+            }
           }
+
+          if (found) {
+            break;
+          }
+        }
+
+        if (!found) {
+          // Another thread has resumed the process ...
+          process = nullptr;
         }
       } else {
         // Process is not runnable, so no need to donate ...
@@ -3033,7 +3998,13 @@ string ProcessManager::absolutePath(const string& path)
     return path;
   }
 
-  if (processes.find(decode.get()) != processes.end()) {
+  bool found = false;
+
+  synchronized (processes_mutex) {
+    found = processes.get(decode.get()) != nullptr;
+  }
+
+  if (found) {
     // Return path when the first token is a process id.
     return path;
   } else {
@@ -3057,39 +4028,56 @@ void ProcessManager::enqueue(ProcessBase* process)
 
   // TODO(benh): Check and see if this process has it's own thread. If
   // it does, push it on that threads runq, and wake up that thread if
-  // it's not running. Otherwise, check and see which thread this
-  // process was last running on, and put it on that threads runq.
+  // it's not running.
+
+  // Worker threads push onto their own run queue (the process is
+  // likely to be related to the one that is currently running on
+  // this thread), everyone else spreads processes across the run
+  // queues in a round-robin fashion.
+  size_t index = __worker__ >= 0
+    ? static_cast<size_t>(__worker__)
+    : next_runq.fetch_add(1) % runqs.size();
 
-  synchronized (runq_mutex) {
-    CHECK(find(runq.begin(), runq.end(), process) == runq.end());
-    runq.push_back(process);
+  // Increment the pending count of processes in order to support the
+  // Clock::settle() operation (this must be done before the process
+  // can be dequeued and run by another thread).
+  pending.fetch_add(1);
+
+  RunQueue* runq = runqs[index].get();
+
+  synchronized (runq->mutex) {
+    runq->processes.push_back(process);
   }
 
-  // Wake up the processing thread if necessary.
-  gate->open();
+  // Wake up an idle processing thread if necessary. Note that idle
+  // workers increment 'idle_workers' _before_ they check the run
+  // queues for the last time, so if we don't see an idle worker here
+  // it's guaranteed to see the process we just enqueued.
+  if (idle_workers.load() > 0) {
+    gate->open(false);
+  }
 }
 
 
 ProcessBase* ProcessManager::dequeue()
 {
-  // TODO(benh): Remove a process from this thread's runq. If there
-  // are no processes to run, and this is not a dedicated thread, then
-  // steal one from another threads runq.
-
-  ProcessBase* process = nullptr;
-
-  synchronized (runq_mutex) {
-    if (!runq.empty()) {
-      process = runq.front();
-      runq.pop_front();
-      // Increment the running count of processes in order to support
-      // the Clock::settle() operation (this must be done atomically
-      // with removing the process from the runq).
-      running.fetch_add(1);
+  CHECK_GE(__worker__, 0) << "Only worker threads can dequeue processes";
+
+  // Remove a process from this thread's run queue. If there are no
+  // processes to run, steal one from another thread's run queue.
+  for (size_t i = 0; i < runqs.size(); i++) {
+    RunQueue* runq = runqs[(__worker__ + i) % runqs.size()].get();
+
+    synchronized (runq->mutex) {
+      if (!runq->processes.empty()) {
+        ProcessBase* process = runq->processes.front();
+        runq->processes.pop_front();
+        return process;
+      }
     }
   }
 
-  return process;
+  return nullptr;
 }
 
 
@@ -3113,23 +4101,63 @@ void ProcessManager::settle()
 
     done = true; // Assume to start that we are settled.
 
-    synchronized (runq_mutex) {
-      if (!runq.empty()) {
-        done = false;
-        continue;
-      }
+    if (pending.load() > 0) {
+      done = false;
+      continue;
+    }
 
-      if (running.load() > 0) {
-        done = false;
-        continue;
+    if (!Clock::settled()) {
+      done = false;
+      continue;
+    }
+
+    // Timers that fired between checking 'pending' and the clock
+    // might have enqueued processes, so we need to check again (any
+    // such process is enqueued before the clock considers itself
+    // settled).
+    if (pending.load() > 0) {
+      done = false;
+      continue;
+    }
+  } while (!done);
+}
+
+
+JSON::Array ProcessManager::statistics()
+{
+  map<string, JSON::Object> objects;
+
+  synchronized (processes_mutex) {
+    foreach (ProcessBase* process, processes.values()) {
+      if (process->statistics) {
+        JSON::Object object = process->statistics->json();
+        object.values["id"] = process->pid.id;
+        object.values["event_queue_size"] = process->eventQueueSize();
+        objects[process->pid.id] = object;
       }
+    }
+  }
 
-      if (!Clock::settled()) {
-        done = false;
-        continue;
+  JSON::Array array;
+  foreachvalue (const JSON::Object& object, objects) {
+    array.values.push_back(object);
+  }
+
+  return array;
+}
+
+
+void ProcessManager::statistics(ProcessStatistics* totals)
+{
+  synchronized (processes_mutex) {
+    totals->add(retired);
+
+    foreach (ProcessBase* process, processes.values()) {
+      if (process->statistics) {
+        totals->add(*process->statistics);
       }
     }
-  } while (!done);
+  }
 }
 
 
@@ -3138,7 +4166,7 @@ Future<Response> ProcessManager::__processes__(const Request&)
   JSON::Array array;
 
   synchronized (processes_mutex) {
-    foreachvalue (ProcessBase* process, process_manager->processes) {
+    foreach (ProcessBase* process, process_manager->processes.values()) {
       JSON::Object object;
       object.values["id"] = process->pid.id;
 
@@ -3200,13 +4228,10 @@ Future<Response> ProcessManager::__processes__(const Request&)
         JSON::Array* events;
       } visitor(&events);
 
-      synchronized (process->mutex) {
-        foreach (Event* event, process->events) {
-          event->visit(&visitor);
-        }
-      }
+      process->events->visit(&visitor);
 
       object.values["events"] = events;
+      object.values["event_queue_size"] = process->eventQueueSize();
       array.values.push_back(object);
     }
   }
@@ -3216,9 +4241,14 @@ Future<Response> ProcessManager::__processes__(const Request&)
 
 
 ProcessBase::ProcessBase(const string& id)
+  : events(new EventQueue())
 {
   process::initialize();
 
+  if (process_statistics) {
+    statistics.reset(new ProcessStatistics());
+  }
+
   state = ProcessBase::BOTTOM;
 
   refs = 0;
@@ -3242,29 +4272,66 @@ void ProcessBase::enqueue(Event* event, bool inject)
 {
   CHECK(event != nullptr);
 
-  synchronized (mutex) {
-    if (state != TERMINATING && state != TERMINATED) {
-      if (!inject) {
-        events.push_back(event);
-      } else {
-        events.push_front(event);
-      }
+  State current = state.load();
+  if (current == TERMINATING || current == TERMINATED) {
+    delete event;
+    return;
+  }
 
-      if (state == BLOCKED) {
-        state = READY;
-        process_manager->enqueue(this);
-      }
+  // A process that terminates itself would have dropped the functions
+  // that it had dispatched to itself before, since the terminate
+  // event would have been dequeued first.
+  if (inject && __process__ == this && event->is<TerminateEvent>()) {
+    continuations.clear();
+  }
 
-      CHECK(state == BOTTOM ||
-            state == READY ||
-            state == RUNNING);
-    } else {
-      delete event;
-    }
+  // Sample every so many of the events that this thread enqueues.
+  // Threads keep their own count so that sampling doesn't require
+  // any synchronization.
+  if (statistics && ++__unsampled__ >= process_statistics_sample_interval) {
+    __unsampled__ = 0;
+    event->enqueued = ProcessStatistics::now();
+  }
+
+  if (events->enqueue(event, inject)) {
+    // The process was blocked (there were no outstanding events) so
+    // we're responsible for scheduling it. Note that the process
+    // can't get scheduled by anyone else until it has processed the
+    // event we just enqueued.
+    CHECK(state == BLOCKED);
+    state = READY;
+    process_manager->enqueue(this);
   }
 }
 
 
+size_t ProcessBase::eventCount(bool (*predicate)(const Event*))
+{
+  return events->count(predicate);
+}
+
+
+size_t ProcessBase::eventQueueSize() const
+{
+  // NOTE: we don't include the outstanding initialization of a
+  // process that has not yet been initialized.
+  size_t size = events->size();
+  return state == BOTTOM && size > 0 ? size - 1 : size;
+}
+
+
+void ProcessBase::exposeEventQueueSize(const string& name)
+{
+  CHECK_NONE(eventQueueSizeGauge)
+    << "The event queue size of " << pid << " is already exposed";
+
+  eventQueueSizeGauge = name;
+
+  // TODO(dhamon): Check return value.
+  metrics::add(EventQueueSizeGauge(name, pid));
+}
+
+
 void ProcessBase::inject(
     const UPID& from,
     const string& name,
@@ -3317,6 +4384,46 @@ void ProcessBase::visit(const DispatchEvent& event)
 }
 
 
+// Returns the request in the form that the handler of an endpoint
+// expects (see ProcessBase::RouteOptions): reads the whole body of a
+// request that the DataDecoder streamed if the endpoint doesn't
+// stream requests, and streams the body of a request that got
+// buffered (e.g., a small one) if the endpoint does.
+static Future<Request> convert(const Request& request, bool streaming)
+{
+  if (request.type == Request::PIPE && !streaming) {
+    CHECK_SOME(request.reader);
+
+    Pipe::Reader reader = request.reader.get();
+
+    return reader.readAll()
+      .then([request](const string& body) {
+        Request result = request;
+        result.type = Request::BODY;
+        result.body = body;
+        result.reader = None();
+        return result;
+      });
+  }
+
+  if (request.type == Request::BODY && streaming) {
+    Pipe pipe;
+    Pipe::Writer writer = pipe.writer();
+
+    writer.write(request.body);
+    writer.close();
+
+    Request result = request;
+    result.type = Request::PIPE;
+    result.body.clear();
+    result.reader = pipe.reader();
+    return result;
+  }
+
+  return request;
+}
+
+
 void ProcessBase::visit(const HttpEvent& event)
 {
   VLOG(1) << "Handling HTTP event for process '" << pid.id << "'"
@@ -3356,11 +4463,20 @@ void ProcessBase::visit(const HttpEvent& event)
     }
 
     HttpEndpoint endpoint = handlers.http[name];
+
+    // NOTE: the body of a streamed request is only read (if the
+    // handler doesn't stream requests, see 'convert') once the
+    // request got authorized, so that a request whose body is slow to
+    // arrive doesn't hold up the requests sequenced behind it. The
+    // authenticator and the authorization callbacks therefore must
+    // not depend on the body of the request.
+    const Request request = *event.request;
+
     Future<Option<AuthenticationResult>> authentication = None();
 
     if (endpoint.realm.isSome()) {
       authentication = authenticator_manager->authenticate(
-          *event.request, endpoint.realm.get());
+          request, endpoint.realm.get());
     }
 
     // Sequence the authentication future to ensure the handlers
@@ -3368,12 +4484,14 @@ void ProcessBase::visit(const HttpEvent& event)
     authentication = handlers.httpSequence->add<Option<AuthenticationResult>>(
         [authentication]() { return authentication; });
 
-    Request request = *event.request;
     Promise<Response>* response = new Promise<Response>();
     event.response->associate(response->future());
 
+    const string path = event.request->url.path;
+
     authentication
-      .onAny(defer(self(), [this, endpoint, request, response, name, id](
+      .onAny(defer(self(),
+                   [this, endpoint, request, path, response, name, id](
           const Future<Option<AuthenticationResult>>& authentication) {
         if (!authentication.isReady()) {
           response->set(
@@ -3382,7 +4500,7 @@ void ProcessBase::visit(const HttpEvent& event)
                 : ServiceUnavailable());
 
           VLOG(1) << "Returning '" << response->future()->status << "'"
-                  << " for '" << request.url.path << "'"
+                  << " for '" << path << "'"
                   << " (authentication failed: "
                   << (authentication.isFailed()
                       ? authentication.failure()
@@ -3435,7 +4553,7 @@ void ProcessBase::visit(const HttpEvent& event)
 
         // Install a callback on the authorization result.
         authorization
-          .onAny(defer(self(), [endpoint, request, response, principal](
+          .onAny(defer(self(), [this, endpoint, request, response, principal](
               const Future<bool>& authorization) {
             if (!authorization.isReady()) {
               response->set(
@@ -3455,13 +4573,19 @@ void ProcessBase::visit(const HttpEvent& event)
             }
 
             if (authorization.get() == true) {
-              // Authorization succeeded, so forward request to the handler.
-              if (endpoint.realm.isNone()) {
-                response->associate(endpoint.handler.get()(request));
-              } else {
-                response->associate(endpoint.authenticatedHandler.get()(
-                    request, principal));
-              }
+              // Authorization succeeded, so forward request to the
+              // handler once it's in the form that the handler expects.
+              response->associate(
+                  convert(request, endpoint.options.requestStreaming)
+                    .then(defer(self(), [endpoint, principal](
+                        const Request& request) -> Future<Response> {
+                      if (endpoint.realm.isNone()) {
+                        return endpoint.handler.get()(request);
+                      }
+
+                      return endpoint.authenticatedHandler.get()(
+                          request, principal);
+                    })));
             } else {
               // Authorization failed, so return a `Forbidden` response.
               response->set(Forbidden());
@@ -3475,6 +4599,13 @@ void ProcessBase::visit(const HttpEvent& event)
     return;
   }
 
+  // Nothing is going to read the body of a streamed request, so we
+  // let the DataDecoder drop it.
+  if (event.request->reader.isSome()) {
+    Pipe::Reader reader = event.request->reader.get();
+    reader.close();
+  }
+
   // If no HTTP handler is found look in assets.
   name = tokens.size() > 1 ? tokens[1] : "";
 
@@ -3538,13 +4669,15 @@ UPID ProcessBase::link(const UPID& to, const RemoteConnection remote)
 void ProcessBase::route(
     const string& name,
     const Option<string>& help_,
-    const HttpRequestHandler& handler)
+    const HttpRequestHandler& handler,
+    const RouteOptions& options)
 {
   // Routes must start with '/'.
   CHECK(name.find('/') == 0);
 
   HttpEndpoint endpoint;
   endpoint.handler = handler;
+  endpoint.options = options;
 
   handlers.http[name.substr(1)] = endpoint;
 
@@ -3556,7 +4689,8 @@ void ProcessBase::route(
     const string& name,
     const string& realm,
     const Option<string>& help_,
-    const AuthenticatedHttpRequestHandler& handler)
+    const AuthenticatedHttpRequestHandler& handler,
+    const RouteOptions& options)
 {
   // Routes must start with '/'.
   CHECK(name.find('/') == 0);
@@ -3564,6 +4698,7 @@ void ProcessBase::route(
   HttpEndpoint endpoint;
   endpoint.realm = realm;
   endpoint.authenticatedHandler = handler;
+  endpoint.options = options;
 
   handlers.http[name.substr(1)] = endpoint;
 
@@ -3725,9 +4860,68 @@ void dispatch(
 {
   process::initialize();
 
+  if (process_manager->continuation(pid, f, functionType)) {
+    return;
+  }
+
   DispatchEvent* event = new DispatchEvent(pid, f, functionType);
   process_manager->deliver(pid, event, __process__);
 }
 
+
+void dispatch(
+    const UPID& pid,
+    const string& tag,
+    const std::shared_ptr<lambda::function<void(ProcessBase*)>>& f,
+    const Option<const std::type_info*>& functionType)
+{
+  process::initialize();
+
+  if (!process_manager->coalesce(pid, tag)) {
+    return;
+  }
+
+  // Clears the tag right before the function runs, so that a dispatch
+  // while it's running (e.g., by the function itself) runs it again
+  // rather than being coalesced with it, or otherwise once the
+  // function gets dropped (e.g., by a filter or since the process
+  // terminated) so that it doesn't swallow all later dispatches.
+  struct Tag
+  {
+    Tag(const UPID& _pid, const string& _tag)
+      : pid(_pid), tag(_tag), cleared(false) {}
+
+    ~Tag()
+    {
+      clear();
+    }
+
+    void clear()
+    {
+      // NOTE: the function might get dropped while libprocess is
+      // finalizing, after the process manager has been deleted.
+      if (!cleared && process_manager != nullptr) {
+        cleared = true;
+        process_manager->coalesced(pid, tag);
+      }
+    }
+
+    const UPID pid;
+    const string tag;
+    bool cleared;
+  };
+
+  std::shared_ptr<Tag> tag_(new Tag(pid, tag));
+
+  std::shared_ptr<lambda::function<void(ProcessBase*)>> f_(
+      new lambda::function<void(ProcessBase*)>(
+          [=](ProcessBase* process) {
+            tag_->clear();
+            (*f)(process);
+          }));
+
+  dispatch(pid, f_, functionType);
+}
+
 } // namespace internal {
 } // namespace process {
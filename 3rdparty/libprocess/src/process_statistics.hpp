@@ -0,0 +1,193 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __PROCESS_PROCESS_STATISTICS_HPP__
+#define __PROCESS_PROCESS_STATISTICS_HPP__
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#include <process/event.hpp>
+
+#include <stout/json.hpp>
+
+namespace process {
+
+// Statistics about the events that a process has handled, which are
+// recorded when LIBPROCESS_ENABLE_PROCESS_STATISTICS is set (see
+// ProcessManager::resume).
+//
+// Every event gets counted by type, but only a sample of the events
+// get timed: the events that were marked as sampled when they got
+// enqueued (see ProcessBase::enqueue) record how long they waited in
+// the event queue and how long the process took to handle them.
+//
+// The statistics are only updated by the thread that is running the
+// process (so updates don't need atomic read-modify-write operations)
+// but can be read from any thread.
+class ProcessStatistics
+{
+public:
+  ProcessStatistics()
+    : messages(0),
+      dispatches(0),
+      requests(0),
+      exits(0),
+      samples(0),
+      queued(0),
+      queuedMax(0),
+      handled(0),
+      handledMax(0) {}
+
+  // Returns the current time of a monotonic clock in nanoseconds,
+  // which is never 0 (an event's enqueue time of 0 means that the
+  // event was not sampled).
+  static int64_t now()
+  {
+    return std::max<int64_t>(
+        1,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+  }
+
+  void count(const Event& event)
+  {
+    struct CountVisitor : EventVisitor
+    {
+      explicit CountVisitor(ProcessStatistics* _statistics)
+        : statistics(_statistics) {}
+
+      virtual void visit(const MessageEvent&)
+      {
+        increment(&statistics->messages, 1);
+      }
+
+      virtual void visit(const DispatchEvent&)
+      {
+        increment(&statistics->dispatches, 1);
+      }
+
+      virtual void visit(const HttpEvent&)
+      {
+        increment(&statistics->requests, 1);
+      }
+
+      virtual void visit(const ExitedEvent&)
+      {
+        increment(&statistics->exits, 1);
+      }
+
+      ProcessStatistics* statistics;
+    } visitor(this);
+
+    event.visit(&visitor);
+  }
+
+  // Counts a function that was dispatched to the process while it was
+  // running, which does not go through the event queue.
+  void dispatched()
+  {
+    increment(&dispatches, 1);
+  }
+
+  // Records the time that a sampled event waited in the event queue
+  // and the time that the process took to handle it.
+  void sample(int64_t queue, int64_t handler)
+  {
+    increment(&samples, 1);
+    increment(&queued, queue);
+    increment(&handled, handler);
+    maximize(&queuedMax, queue);
+    maximize(&handledMax, handler);
+  }
+
+  // Adds the statistics of another process. Must not be called
+  // concurrently with any other updates.
+  void add(const ProcessStatistics& that)
+  {
+    increment(&messages, that.messages.load());
+    increment(&dispatches, that.dispatches.load());
+    increment(&requests, that.requests.load());
+    increment(&exits, that.exits.load());
+    increment(&samples, that.samples.load());
+    increment(&queued, that.queued.load());
+    increment(&handled, that.handled.load());
+    maximize(&queuedMax, that.queuedMax.load());
+    maximize(&handledMax, that.handledMax.load());
+  }
+
+  JSON::Object json() const
+  {
+    JSON::Object events;
+    events.values["message"] = messages.load();
+    events.values["dispatch"] = dispatches.load();
+    events.values["http"] = requests.load();
+    events.values["exited"] = exits.load();
+
+    const uint64_t sampled = samples.load();
+
+    JSON::Object queue;
+    queue.values["mean"] = sampled > 0 ? ms(queued.load()) / sampled : 0.0;
+    queue.values["max"] = ms(queuedMax.load());
+
+    JSON::Object handler;
+    handler.values["mean"] = sampled > 0 ? ms(handled.load()) / sampled : 0.0;
+    handler.values["max"] = ms(handledMax.load());
+
+    JSON::Object object;
+    object.values["events"] = events;
+    object.values["sampled_events"] = sampled;
+    object.values["queue_time_ms"] = queue;
+    object.values["handler_time_ms"] = handler;
+    return object;
+  }
+
+  std::atomic<uint64_t> messages;
+  std::atomic<uint64_t> dispatches;
+  std::atomic<uint64_t> requests;
+  std::atomic<uint64_t> exits;
+
+  // Number of sampled events and the total and maximum time in
+  // nanoseconds that they waited in the queue and took to handle.
+  std::atomic<uint64_t> samples;
+  std::atomic<uint64_t> queued;
+  std::atomic<uint64_t> queuedMax;
+  std::atomic<uint64_t> handled;
+  std::atomic<uint64_t> handledMax;
+
+private:
+  static double ms(uint64_t nanoseconds)
+  {
+    return nanoseconds / 1000000.0;
+  }
+
+  static void increment(std::atomic<uint64_t>* value, uint64_t amount)
+  {
+    value->store(
+        value->load(std::memory_order_relaxed) + amount,
+        std::memory_order_relaxed);
+  }
+
+  static void maximize(std::atomic<uint64_t>* value, uint64_t candidate)
+  {
+    if (candidate > value->load(std::memory_order_relaxed)) {
+      value->store(candidate, std::memory_order_relaxed);
+    }
+  }
+};
+
+} // namespace process {
+
+#endif // __PROCESS_PROCESS_STATISTICS_HPP__
@@ -0,0 +1,336 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __PROCESS_TABLE_HPP__
+#define __PROCESS_TABLE_HPP__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <process/process.hpp>
+
+#include <stout/foreach.hpp>
+
+namespace process {
+
+// The table of all spawned processes, keyed by their ID.
+//
+// The table is read-mostly: every message that gets delivered looks
+// up its receiver, but processes only get added and removed when they
+// are spawned and cleaned up. Lookups therefore never take a lock,
+// while mutations are expected to be serialized by the caller (the
+// 'ProcessManager' holds its 'processes_mutex').
+//
+// The table is split into shards, each of which is a hash table of
+// singly linked nodes that lookups traverse through atomic pointers.
+// A removed node (or a bucket array replaced when a shard grows) is
+// only deleted after a "grace period": each shard counts the lookups
+// in progress in one of two counters selected by the shard's epoch,
+// and a mutation bumps the epoch and waits for the lookups counted
+// under the previous epoch to finish, twice, so that both counters
+// have drained. Lookups that start after the epoch was bumped can no
+// longer see what was removed, so this wait is bounded. Sharding keeps concurrent lookups of different
+// processes from contending on the same counters.
+class ProcessTable
+{
+public:
+  ProcessTable()
+  {
+    foreach (Shard& shard, shards) {
+      shard.buckets.store(new Buckets(INITIAL_BUCKETS));
+      shard.size = 0;
+      shard.epoch.store(0);
+      shard.readers[0].store(0);
+      shard.readers[1].store(0);
+    }
+  }
+
+  ~ProcessTable()
+  {
+    foreach (Shard& shard, shards) {
+      destroy(shard.buckets.load());
+    }
+  }
+
+  // Invokes 'f' with the process with the specified ID (or nullptr
+  // if there is no such process) and returns its result. The process
+  // does not get removed (i.e., 'erase' does not return) while 'f' is
+  // running, which lets 'f' take a reference to the process. Can be
+  // called from any thread.
+  template <typename F>
+  auto find(const std::string& id, F&& f) const -> decltype(f(nullptr))
+  {
+    const size_t hash = hasher(id);
+    const Shard& shard = shards[hash % SHARDS];
+
+    // NOTE: the epoch might get bumped right after we read it, in
+    // which case we count ourselves in a counter that a concurrent
+    // mutation may already have drained. That mutation also drains
+    // the other counter after flipping the epoch a second time, and
+    // any later mutation waits on both (see 'synchronize').
+    std::atomic<size_t>& readers = shard.readers[shard.epoch.load() % 2];
+
+    readers.fetch_add(1);
+
+    Node* node = lookup(shard.buckets.load(), hash, id);
+
+    auto result = f(node != nullptr ? node->process : nullptr);
+
+    readers.fetch_sub(1);
+
+    return result;
+  }
+
+  // Adds the process, unless there already is a process with the
+  // same ID in which case this returns false. Must not be called
+  // concurrently with 'insert' or 'erase'.
+  bool insert(ProcessBase* process)
+  {
+    const std::string& id = process->self().id;
+    const size_t hash = hasher(id);
+    Shard& shard = shards[hash % SHARDS];
+
+    Buckets* buckets = shard.buckets.load();
+
+    if (lookup(buckets, hash, id) != nullptr) {
+      return false;
+    }
+
+    // Grow the shard once it has twice as many processes as buckets.
+    if (shard.size >= 2 * buckets->size) {
+      Buckets* grown = new Buckets(2 * buckets->size);
+
+      for (size_t i = 0; i < buckets->size; i++) {
+        for (Node* node = buckets->heads[i].load();
+             node != nullptr;
+             node = node->next.load()) {
+          link(grown, new Node(node->id, node->hash, node->process));
+        }
+      }
+
+      shard.buckets.store(grown);
+
+      synchronize(&shard);
+
+      destroy(buckets);
+
+      buckets = grown;
+    }
+
+    link(buckets, new Node(id, hash, process));
+
+    shard.size++;
+
+    return true;
+  }
+
+  // Removes the process with the specified ID and returns it, or
+  // returns nullptr if there is no such process. Once this returns
+  // no lookup can find the process anymore, and all of the lookups
+  // that found it have finished. Must not be called concurrently
+  // with 'insert' or 'erase'.
+  ProcessBase* erase(const std::string& id)
+  {
+    const size_t hash = hasher(id);
+    Shard& shard = shards[hash % SHARDS];
+
+    Buckets* buckets = shard.buckets.load();
+
+    std::atomic<Node*>* previous = &buckets->heads[index(buckets, hash)];
+
+    for (Node* node = previous->load();
+         node != nullptr;
+         node = previous->load()) {
+      if (node->hash == hash && node->id == id) {
+        // Concurrent lookups that are at 'node' can still move on to
+        // the rest of the chain, since we don't delete 'node' until
+        // after they have finished.
+        previous->store(node->next.load());
+
+        shard.size--;
+
+        synchronize(&shard);
+
+        ProcessBase* process = node->process;
+
+        delete node;
+
+        return process;
+      }
+
+      previous = &node->next;
+    }
+
+    return nullptr;
+  }
+
+  // Returns the process with the specified ID or nullptr. Unlike
+  // 'find' this does not protect against concurrent removals, so the
+  // caller must be serializing mutations.
+  ProcessBase* get(const std::string& id) const
+  {
+    const size_t hash = hasher(id);
+    Node* node = lookup(shards[hash % SHARDS].buckets.load(), hash, id);
+    return node != nullptr ? node->process : nullptr;
+  }
+
+  // Returns all processes (in no particular order). The caller must
+  // be serializing mutations.
+  std::vector<ProcessBase*> values() const
+  {
+    std::vector<ProcessBase*> processes;
+
+    foreach (const Shard& shard, shards) {
+      Buckets* buckets = shard.buckets.load();
+
+      for (size_t i = 0; i < buckets->size; i++) {
+        for (Node* node = buckets->heads[i].load();
+             node != nullptr;
+             node = node->next.load()) {
+          processes.push_back(node->process);
+        }
+      }
+    }
+
+    return processes;
+  }
+
+private:
+  // Number of shards, which keeps lookups of different processes
+  // from contending on the same counters unless there are a lot of
+  // threads.
+  static const size_t SHARDS = 64;
+
+  static const size_t INITIAL_BUCKETS = 16;
+
+  struct Node
+  {
+    Node(const std::string& _id, size_t _hash, ProcessBase* _process)
+      : id(_id), hash(_hash), process(_process), next(nullptr) {}
+
+    const std::string id;
+    const size_t hash;
+    ProcessBase* const process;
+    std::atomic<Node*> next;
+  };
+
+  struct Buckets
+  {
+    explicit Buckets(size_t _size)
+      : size(_size), heads(new std::atomic<Node*>[_size])
+    {
+      for (size_t i = 0; i < size; i++) {
+        heads[i].store(nullptr);
+      }
+    }
+
+    const size_t size;
+    std::unique_ptr<std::atomic<Node*>[]> heads;
+  };
+
+  struct Shard
+  {
+    std::atomic<Buckets*> buckets;
+
+    // Number of processes in this shard (only accessed by mutations).
+    size_t size;
+
+    // Lookups in progress, counted in 'readers[epoch % 2]'. These are
+    // mutable since lookups are logically const.
+    std::atomic<uint64_t> epoch;
+    mutable std::atomic<size_t> readers[2];
+
+    // Keeps the counters of adjacent shards on separate cache lines.
+    char padding[64];
+  };
+
+  static size_t index(const Buckets* buckets, size_t hash)
+  {
+    // The low bits select the shard so we use the higher bits for
+    // the bucket. Bucket counts are always a power of two.
+    return (hash / SHARDS) & (buckets->size - 1);
+  }
+
+  static Node* lookup(
+      const Buckets* buckets,
+      size_t hash,
+      const std::string& id)
+  {
+    Node* node = buckets->heads[index(buckets, hash)].load();
+
+    while (node != nullptr && (node->hash != hash || node->id != id)) {
+      node = node->next.load();
+    }
+
+    return node;
+  }
+
+  static void link(Buckets* buckets, Node* node)
+  {
+    std::atomic<Node*>& head = buckets->heads[index(buckets, node->hash)];
+    node->next.store(head.load());
+    head.store(node);
+  }
+
+  static void destroy(Buckets* buckets)
+  {
+    for (size_t i = 0; i < buckets->size; i++) {
+      Node* node = buckets->heads[i].load();
+      while (node != nullptr) {
+        Node* next = node->next.load();
+        delete node;
+        node = next;
+      }
+    }
+
+    delete buckets;
+  }
+
+  // Waits for all lookups in the shard that might have seen the state
+  // from before the caller's last change to finish.
+  //
+  // NOTE: waiting only on the counter of the previous epoch is not
+  // enough: a lookup can read the previous epoch, stall, and only
+  // increment that counter after we've seen it drop to zero. It is
+  // then counted under the *current* epoch's parity as far as the
+  // next mutation is concerned, which would flip the epoch and wait
+  // on the other counter, missing the lookup altogether while it
+  // still holds a node that mutation removes. So, like userspace
+  // RCU, we flip and drain twice, which waits on both counters and
+  // leaves no lookup that started before our change unaccounted for.
+  static void synchronize(Shard* shard)
+  {
+    for (int i = 0; i < 2; i++) {
+      const uint64_t epoch = shard->epoch.fetch_add(1);
+
+      while (shard->readers[epoch % 2].load() > 0) {
+#if defined(__i386__) || defined(__x86_64__)
+        asm ("pause");
+#endif
+      }
+    }
+  }
+
+  std::hash<std::string> hasher;
+
+  Shard shards[SHARDS];
+};
+
+} // namespace process {
+
+#endif // __PROCESS_TABLE_HPP__
@@ -10,6 +10,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License
 
+#include <memory>
 #include <string>
 
 #include <glog/logging.h>
@@ -18,22 +19,34 @@
 #include <gperftools/profiler.h>
 #endif
 
+#include "process/clock.hpp"
+#include "process/defer.hpp"
 #include "process/future.hpp"
 #include "process/help.hpp"
 #include "process/http.hpp"
 #include "process/profiler.hpp"
 
+#include "stout/duration.hpp"
 #include "stout/format.hpp"
+#include "stout/numify.hpp"
 #include "stout/option.hpp"
 #include "stout/os.hpp"
 #include "stout/os/strerror.hpp"
 
+#include "sampler.hpp"
+
 namespace process {
 
 namespace {
 
 const char PROFILE_FILE[] = "perftools.out";
 
+const Duration DEFAULT_SAMPLE_DURATION = Seconds(10);
+const Duration MAX_SAMPLE_DURATION = Minutes(5);
+
+const int DEFAULT_SAMPLE_FREQUENCY = 100;
+const int MAX_SAMPLE_FREQUENCY = 1000;
+
 }  // namespace {
 
 const std::string Profiler::START_HELP()
@@ -58,6 +71,104 @@ const std::string Profiler::STOP_HELP()
 }
 
 
+const std::string Profiler::SAMPLE_HELP()
+{
+  return HELP(
+    TLDR(
+        "Samples the stacks of the running threads."),
+    DESCRIPTION(
+        "Samples the stacks of the threads that consume CPU for the",
+        "specified duration and returns them in the \"folded\" format",
+        "used by flame graph tools (e.g., flamegraph.pl): one line per",
+        "distinct stack, with the frames separated by ';' starting from",
+        "the ID of the libprocess process that the thread was running,",
+        "followed by the number of samples with that stack.",
+        "",
+        "Functions are only named if their symbols are exported (e.g.,",
+        "by linking with '-rdynamic'), otherwise they are shown as the",
+        "offset into their object file.",
+        "",
+        "Query parameters:",
+        "",
+        ">        duration=VALUE       How long to sample for,"
+        " at most 5mins (default: 10secs).",
+        ">        frequency=VALUE      Samples per second of CPU time,"
+        " at most 1000 (default: 100)."),
+    AUTHENTICATION(true));
+}
+
+
+Future<http::Response> Profiler::sample(
+    const http::Request& request,
+    const Option<std::string>& /* principal */)
+{
+  if (started || sampling) {
+    return http::Conflict("The profiler is already running.\n");
+  }
+
+  Duration duration = DEFAULT_SAMPLE_DURATION;
+
+  Option<std::string> parameter = request.url.query.get("duration");
+  if (parameter.isSome()) {
+    Try<Duration> parse = Duration::parse(parameter.get());
+    if (parse.isError() ||
+        parse.get() <= Duration::zero() ||
+        parse.get() > MAX_SAMPLE_DURATION) {
+      return http::BadRequest(
+          "Invalid duration '" + parameter.get() + "'.\n");
+    }
+
+    duration = parse.get();
+  }
+
+  int frequency = DEFAULT_SAMPLE_FREQUENCY;
+
+  parameter = request.url.query.get("frequency");
+  if (parameter.isSome()) {
+    Try<int> parse = numify<int>(parameter.get());
+    if (parse.isError() ||
+        parse.get() <= 0 ||
+        parse.get() > MAX_SAMPLE_FREQUENCY) {
+      return http::BadRequest(
+          "Invalid frequency '" + parameter.get() + "'.\n");
+    }
+
+    frequency = parse.get();
+  }
+
+  Try<Nothing> start = sampler::start(frequency);
+  if (start.isError()) {
+    LOG(ERROR) << "Failed to start sampling: " << start.error();
+    return http::InternalServerError(start.error() + ".\n");
+  }
+
+  LOG(INFO) << "Sampling for " << duration << " at " << frequency << " Hz";
+
+  sampling = true;
+
+  samples.reset(new Promise<http::Response>());
+
+  Clock::timer(duration, defer(self(), &Profiler::_sample));
+
+  return samples->future();
+}
+
+
+void Profiler::_sample()
+{
+  CHECK(sampling);
+  CHECK(samples);
+
+  sampling = false;
+
+  http::OK response(sampler::stop());
+  response.headers["Content-Type"] = "text/plain; charset=utf-8";
+
+  samples->set(response);
+  samples.reset();
+}
+
+
 Future<http::Response> Profiler::start(
     const http::Request& request,
     const Option<std::string>& /* principal */)
@@ -76,6 +187,10 @@ Future<http::Response> Profiler::start(
     return http::BadRequest("Profiler already started.\n");
   }
 
+  if (sampling) {
+    return http::BadRequest("The sampling profiler is running.\n");
+  }
+
   LOG(INFO) << "Starting Profiler";
 
   // WARNING: If using libunwind < 1.0.1, profiling should not be used, as
@@ -12,32 +12,47 @@
 
 #include <glog/logging.h>
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif // __linux__
 #include <sys/types.h>
 #ifndef __WINDOWS__
 #include <sys/wait.h>
 #endif
 
+#include <vector>
+
+#include <process/defer.hpp>
 #include <process/delay.hpp>
 #include <process/future.hpp>
 #include <process/id.hpp>
+#include <process/io.hpp>
 #include <process/once.hpp>
 #include <process/owned.hpp>
 #include <process/reap.hpp>
 
 #include <stout/check.hpp>
 #include <stout/foreach.hpp>
+#include <stout/hashset.hpp>
+#include <stout/lambda.hpp>
 #include <stout/multihashmap.hpp>
 #include <stout/none.hpp>
+#include <stout/option.hpp>
 #include <stout/os.hpp>
 #include <stout/result.hpp>
 #include <stout/try.hpp>
 
+#include <stout/os/close.hpp>
+
 namespace process {
 
 
-// TODO(bmahler): This can be optimized to use a thread per pid, where
-// each thread makes a blocking call to waitpid. This eliminates the
-// unfortunate poll delay.
+// NOTE: Where the kernel supports it (Linux 5.3+), we learn about the
+// termination of a pid from a "pidfd" (see pidfd_open(2)), which
+// becomes readable when the process terminates and which we watch in
+// the event loop like any other file descriptor, so no polling is
+// needed. Otherwise (or if opening the pidfd fails) we fall back to
+// polling the pid.
 //
 // Simple bounded linear model for computing the poll interval.
 // Values were chosen such that at (50 pids, 100 ms) the CPU usage is
@@ -61,16 +76,39 @@ const size_t HIGH_PID_COUNT = 500;
 Duration MAX_REAP_INTERVAL() { return Seconds(1); }
 
 
+// Returns a file descriptor that becomes readable when the process
+// with the specified pid terminates, or None if that's not supported.
+static Option<int> pidfd(pid_t pid)
+{
+#if defined(__linux__) && defined(SYS_pidfd_open)
+  // NOTE: The pidfd is always close-on-exec.
+  const int fd = ::syscall(SYS_pidfd_open, pid, 0);
+  if (fd >= 0) {
+    return fd;
+  }
+#endif // __linux__ && SYS_pidfd_open
+
+  return None();
+}
+
+
 class ReaperProcess : public Process<ReaperProcess>
 {
 public:
-  ReaperProcess() : ProcessBase(ID::generate("reaper")) {}
+  ReaperProcess()
+    : ProcessBase(ID::generate("reaper")),
+      polling(false) {}
 
   Future<Option<int> > reap(pid_t pid)
   {
     // Check to see if this pid exists.
     if (os::exists(pid)) {
       Owned<Promise<Option<int> > > promise(new Promise<Option<int> >());
+
+      if (!promises.contains(pid)) {
+        watch(pid);
+      }
+
       promises.put(pid, promise);
       return promise->future();
     } else {
@@ -79,7 +117,57 @@ public:
   }
 
 protected:
-  virtual void initialize() { wait(); }
+  void watch(pid_t pid)
+  {
+    Option<int> fd = pidfd(pid);
+
+    if (fd.isNone()) {
+      poll(pid);
+      return;
+    }
+
+    io::poll(fd.get(), io::READ)
+      .onAny(defer(self(), &Self::terminated, pid, fd.get(), lambda::_1));
+  }
+
+  void terminated(pid_t pid, int fd, const Future<short>& future)
+  {
+    os::close(fd);
+
+    if (!future.isReady()) {
+      LOG(WARNING) << "Failed to wait for the termination of pid " << pid
+                   << ": " << (future.isFailed() ? future.failure()
+                                                 : "discarded")
+                   << "; falling back to polling";
+      poll(pid);
+      return;
+    }
+
+    // The process terminated, so if it's our child it's a zombie that
+    // we reap now, and otherwise we can't know its exit status (see
+    // 'wait' below).
+    int status;
+    Result<pid_t> child_pid = os::waitpid(pid, &status, WNOHANG);
+    if (child_pid.isSome()) {
+      notify(pid, status);
+    } else if (child_pid.isNone()) {
+      // It's our child but it can't be reaped yet, so rather than
+      // losing its exit status we poll it until it can.
+      poll(pid);
+    } else {
+      notify(pid, None());
+    }
+  }
+
+  void poll(pid_t pid)
+  {
+    polled.insert(pid);
+
+    if (!polling) {
+      polling = true;
+      delay(interval(), self(), &ReaperProcess::wait);
+    }
+  }
 
   void wait()
   {
@@ -93,7 +181,9 @@ protected:
     // NOTE: A child can only be reaped by us, the parent. If a child exits
     // between waitpid and the (!exists) conditional it will still exist as a
     // zombie; it will be reaped by us on the next loop.
-    foreach (pid_t pid, promises.keys()) {
+    //
+    // NOTE: We copy the pids since 'notify' removes them from 'polled'.
+    foreach (pid_t pid, std::vector<pid_t>(polled.begin(), polled.end())) {
       int status;
       Result<pid_t> child_pid = os::waitpid(pid, &status, WNOHANG);
       if (child_pid.isSome()) {
@@ -105,7 +195,12 @@ protected:
       }
     }
 
-    delay(interval(), self(), &ReaperProcess::wait); // Reap forever!
+    // Keep polling only while there are pids to poll.
+    if (polled.empty()) {
+      polling = false;
+    } else {
+      delay(interval(), self(), &ReaperProcess::wait);
+    }
   }
 
   void notify(pid_t pid, Result<int> status)
@@ -120,12 +215,13 @@ protected:
       }
     }
     promises.remove(pid);
+    polled.erase(pid);
   }
 
 private:
   const Duration interval()
   {
-    size_t count = promises.size();
+    size_t count = polled.size();
 
     if (count <= LOW_PID_COUNT) {
       return MIN_REAP_INTERVAL();
@@ -142,6 +238,12 @@ private:
   }
 
   multihashmap<pid_t, Owned<Promise<Option<int> > > > promises;
+
+  // The pids that we poll since we can't watch them with a pidfd.
+  hashset<pid_t> polled;
+
+  // Whether a poll of the pids in 'polled' is scheduled.
+  bool polling;
 };
 
 
@@ -0,0 +1,313 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef __WINDOWS__
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <signal.h>
+
+#include <sys/time.h>
+#endif // __WINDOWS__
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include <glog/logging.h>
+
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/nothing.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+#include <stout/thread_local.hpp>
+#include <stout/try.hpp>
+
+#include <stout/os/strerror.hpp>
+
+#include "sampler.hpp"
+
+using std::map;
+using std::string;
+
+namespace process {
+namespace sampler {
+
+std::atomic_bool running(false);
+
+namespace {
+
+// Maximum number of frames recorded per sample.
+const int MAX_FRAMES = 64;
+
+// Maximum length of the label of a sample (longer process IDs get
+// truncated).
+const size_t MAX_LABEL = 64;
+
+// Number of samples that fit into the buffer, after which further
+// samples get dropped (e.g., 100 seconds of CPU time at 100 Hz).
+const size_t CAPACITY = 10000;
+
+
+struct Sample
+{
+  void* frames[MAX_FRAMES];
+  int depth;
+  char label[MAX_LABEL];
+};
+
+
+// The buffer of samples and the index of the next sample to take.
+Sample* samples = nullptr;
+std::atomic_size_t next(0);
+
+// Number of signal handlers that are taking a sample, which we wait
+// for before we read the buffer.
+std::atomic_long handlers(0);
+
+// The label of the calling thread and its length, which is 0 if the
+// thread is not labeled.
+THREAD_LOCAL char* __sample_label__ = nullptr;
+THREAD_LOCAL size_t __sample_label_length__ = 0;
+
+#ifndef __WINDOWS__
+bool installed = false;
+
+
+void handler(int signal, siginfo_t*, void*)
+{
+  // Preserve errno since we might have interrupted a system call
+  // whose caller is about to check it.
+  const int error = errno;
+
+  handlers.fetch_add(1);
+
+  if (running.load()) {
+    const size_t index = next.fetch_add(1);
+
+    if (index < CAPACITY) {
+      Sample* sample = &samples[index];
+
+      sample->depth = backtrace(sample->frames, MAX_FRAMES);
+
+      const size_t length = __sample_label_length__;
+      if (length > 0) {
+        memcpy(sample->label, __sample_label__, length);
+      }
+      sample->label[length] = '\0';
+    }
+  }
+
+  handlers.fetch_sub(1);
+
+  errno = error;
+}
+
+
+// Returns the name of the function containing 'address'.
+string symbolize(void* address)
+{
+  Dl_info info;
+  if (dladdr(address, &info) == 0) {
+    return stringify(address);
+  }
+
+  if (info.dli_sname != nullptr) {
+    int status = 0;
+    char* demangled =
+      abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+
+    if (demangled != nullptr) {
+      string name = demangled;
+      free(demangled);
+      return name;
+    }
+
+    return info.dli_sname;
+  }
+
+  // Fall back to the offset into the object (e.g., for functions that
+  // are not exported from the executable) so that the address can be
+  // resolved offline with 'addr2line'.
+  string object = info.dli_fname != nullptr ? info.dli_fname : "?";
+
+  const size_t slash = object.rfind('/');
+  if (slash != string::npos) {
+    object = object.substr(slash + 1);
+  }
+
+  std::ostringstream out;
+  out << object << "+0x" << std::hex
+      << (reinterpret_cast<uintptr_t>(address) -
+          reinterpret_cast<uintptr_t>(info.dli_fbase));
+  return out.str();
+}
+#endif // __WINDOWS__
+
+} // namespace {
+
+
+void label(const string& id)
+{
+  if (__sample_label__ == nullptr) {
+    __sample_label__ = new char[MAX_LABEL];
+  }
+
+  // NOTE: a signal handler that interrupts us must not see a partially
+  // copied label, so we only set the length once the label is copied.
+  __sample_label_length__ = 0;
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+
+  const size_t length = std::min(id.size(), MAX_LABEL - 1);
+  memcpy(__sample_label__, id.data(), length);
+
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+  __sample_label_length__ = length;
+}
+
+
+void unlabel()
+{
+  __sample_label_length__ = 0;
+}
+
+
+Try<Nothing> start(int frequency)
+{
+#ifdef __WINDOWS__
+  return Error("The sampling profiler is not supported on Windows");
+#else
+  CHECK(!running.load());
+  CHECK_GT(frequency, 0);
+
+  // NOTE: the first call to 'backtrace' might load the library that
+  // unwinds the stack, which must not happen in the signal handler.
+  void* frames[MAX_FRAMES];
+  backtrace(frames, MAX_FRAMES);
+
+  if (!installed) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = handler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+
+    // NOTE: we never uninstall the handler since a SIGPROF might still
+    // be pending when we stop, and the default action would terminate
+    // the process.
+    if (sigaction(SIGPROF, &action, nullptr) != 0) {
+      return ErrnoError("Failed to install the SIGPROF handler");
+    }
+
+    installed = true;
+  }
+
+  samples = new Sample[CAPACITY];
+  next.store(0);
+  running.store(true);
+
+  const long interval = std::max(1L, 1000000L / frequency);
+
+  struct itimerval timer;
+  timer.it_interval.tv_sec = interval / 1000000;
+  timer.it_interval.tv_usec = interval % 1000000;
+  timer.it_value = timer.it_interval;
+
+  if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+    ErrnoError error("Failed to start the profiling timer");
+    running.store(false);
+    delete[] samples;
+    samples = nullptr;
+    return error;
+  }
+
+  return Nothing();
+#endif // __WINDOWS__
+}
+
+
+string stop()
+{
+#ifdef __WINDOWS__
+  return "";
+#else
+  CHECK(running.load());
+
+  struct itimerval timer;
+  memset(&timer, 0, sizeof(timer));
+
+  if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+    PLOG(ERROR) << "Failed to stop the profiling timer";
+  }
+
+  running.store(false);
+
+  // Wait for the handlers that might have seen that we were running.
+  while (handlers.load() > 0) {}
+
+  const size_t taken = next.load();
+  const size_t count = std::min(taken, CAPACITY);
+
+  if (taken > CAPACITY) {
+    LOG(WARNING) << "Dropped " << taken - CAPACITY << " of " << taken
+                 << " samples that did not fit into the buffer";
+  }
+
+  hashmap<void*, string> symbols;
+  map<string, size_t> stacks;
+
+  for (size_t i = 0; i < count; i++) {
+    const Sample& sample = samples[i];
+
+    // NOTE: flame graph tools split the frames on ';' and the count
+    // off the end of the line, so we remove those from the label.
+    string stack = sample.label[0] != '\0' ? sample.label : "[none]";
+    stack = strings::replace(stack, ";", "_");
+    stack = strings::replace(stack, " ", "_");
+
+    // Skip the frames of the signal handler and of the trampoline that
+    // invoked it, and list the remaining frames from the outermost.
+    for (int j = sample.depth - 1; j >= 2; j--) {
+      void* address = sample.frames[j];
+
+      if (!symbols.contains(address)) {
+        symbols[address] = strings::replace(symbolize(address), ";", ":");
+      }
+
+      stack += ";" + symbols[address];
+    }
+
+    stacks[stack]++;
+  }
+
+  delete[] samples;
+  samples = nullptr;
+
+  std::ostringstream out;
+  foreachpair (const string& stack, size_t count, stacks) {
+    out << stack << " " << count << "\n";
+  }
+
+  return out.str();
+#endif // __WINDOWS__
+}
+
+} // namespace sampler {
+} // namespace process {
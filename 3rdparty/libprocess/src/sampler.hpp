@@ -0,0 +1,62 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#ifndef __PROCESS_SAMPLER_HPP__
+#define __PROCESS_SAMPLER_HPP__
+
+#include <atomic>
+#include <string>
+
+#include <stout/nothing.hpp>
+#include <stout/try.hpp>
+
+namespace process {
+namespace sampler {
+
+// A sampling profiler built into libprocess (see the /profiler/sample
+// endpoint). While it's running a SIGPROF interval timer interrupts
+// whichever threads are consuming CPU, and the signal handler records
+// the stack of the interrupted thread together with the ID of the
+// process that the thread was running (see 'label'), so the samples
+// can be attributed to processes. The samples are kept in a buffer
+// that's allocated when the profiler is started, so taking a sample
+// doesn't allocate memory or take any locks.
+
+// Whether the profiler is running.
+extern std::atomic_bool running;
+
+
+// Labels the samples that get taken on the calling thread with the ID
+// of the process that it's about to run. Only needs to be called
+// while the profiler is running (see ProcessManager::resume).
+void label(const std::string& id);
+
+
+// Removes the label of the calling thread.
+void unlabel();
+
+
+// Starts taking samples approximately 'frequency' times per second of
+// CPU time consumed by this OS process.
+Try<Nothing> start(int frequency);
+
+
+// Stops taking samples and returns them aggregated in the "folded"
+// format, one line per distinct stack with the label as its root
+// frame followed by the number of samples with that stack, which is
+// the input format of flame graph tools such as flamegraph.pl.
+std::string stop();
+
+} // namespace sampler {
+} // namespace process {
+
+#endif // __PROCESS_SAMPLER_HPP__
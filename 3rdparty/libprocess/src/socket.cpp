@@ -12,6 +12,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <boost/shared_array.hpp>
 
@@ -19,8 +20,11 @@
 #include <process/owned.hpp>
 #include <process/socket.hpp>
 
+#include <stout/foreach.hpp>
 #include <stout/os.hpp>
 
+#include "buffers.hpp"
+
 #ifdef USE_SSL_SOCKET
 #include "libevent_ssl_socket.hpp"
 #include "openssl.hpp"
@@ -28,6 +32,7 @@
 #include "poll_socket.hpp"
 
 using std::string;
+using std::vector;
 
 namespace process {
 namespace network {
@@ -202,7 +207,7 @@ Future<string> Socket::Impl::recv(const Option<ssize_t>& size)
     : size.get();
 
   Owned<string> buffer(new string());
-  boost::shared_array<char> data(new char[chunk]);
+  boost::shared_array<char> data = buffers::acquire(chunk);
 
   return recv(data.get(), chunk)
     .then(lambda::bind(&_recv,
@@ -244,5 +249,16 @@ Future<Nothing> Socket::Impl::send(const string& _data)
 }
 
 
+Future<size_t> Socket::Impl::send(const vector<Socket::Buffer>& buffers)
+{
+  foreach (const Socket::Buffer& buffer, buffers) {
+    if (buffer.size > 0) {
+      return send(buffer.data, buffer.size);
+    }
+  }
+
+  return 0u;
+}
+
 } // namespace network {
 } // namespace process {
@@ -18,32 +18,64 @@
 
 #include <gmock/gmock.h>
 
+#include <atomic>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include <process/clock.hpp>
 #include <process/collect.hpp>
+#include <process/defer.hpp>
+#include <process/dispatch.hpp>
 #include <process/future.hpp>
 #include <process/gmock.hpp>
 #include <process/gtest.hpp>
+#include <process/histogram.hpp>
 #include <process/owned.hpp>
 #include <process/process.hpp>
+#include <process/socket.hpp>
+#include <process/statistics.hpp>
+#include <process/timer.hpp>
+#include <process/timeseries.hpp>
 
 #include <stout/duration.hpp>
 #include <stout/gtest.hpp>
 #include <stout/hashset.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+#include <stout/os.hpp>
 #include <stout/stopwatch.hpp>
 
+#include "buffers.hpp"
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "framing.hpp"
+
+namespace framing = process::framing;
 namespace http = process::http;
 
+using process::Batch;
+using process::Clock;
+using process::DataDecoder;
 using process::Future;
+using process::Histogram;
+using process::Message;
+using process::MessageEncoder;
 using process::Owned;
+using process::PID;
 using process::Process;
 using process::ProcessBase;
 using process::Promise;
+using process::Statistics;
+using process::Time;
+using process::TimeSeries;
+using process::Timer;
 using process::UPID;
 
+using process::network::Address;
+using process::network::Socket;
+
 using std::cout;
 using std::endl;
 using std::list;
@@ -51,6 +83,8 @@ using std::ostringstream;
 using std::string;
 using std::vector;
 
+using testing::WithParamInterface;
+
 int main(int argc, char** argv)
 {
   // Initialize Google Mock/Test.
@@ -374,3 +408,634 @@ TEST(ProcessTest, Process_BENCHMARK_LargeNumberOfLinks)
     delete process;
   }
 }
+
+
+// Measures how fast messages to a remote process are encoded and
+// written out to the socket. The messages are sent (over a link, so
+// that they all go through the same persistent socket) to a socket
+// that we listen on ourselves since local messages don't go through
+// sockets, and we only count the bytes received.
+TEST(ProcessTest, Process_BENCHMARK_SendMessages)
+{
+  const size_t count = 100000;
+
+  foreach (const Bytes& size, vector<Bytes>({Bytes(10), Kilobytes(1)})) {
+    Try<Socket> create = Socket::create();
+    ASSERT_SOME(create);
+
+    Socket listener = create.get();
+
+    ASSERT_SOME(listener.bind(Address::LOCALHOST_ANY()));
+    ASSERT_SOME(listener.listen(1));
+
+    Try<Address> address = listener.address();
+    ASSERT_SOME(address);
+
+    const UPID to("receiver", address.get());
+    const string body(size.bytes(), '1');
+
+    LinkerProcess linker(to);
+    spawn(linker);
+
+    Future<Socket> accept = listener.accept();
+    AWAIT_READY(accept);
+
+    Socket socket = accept.get();
+
+    Message message;
+    message.name = "message";
+    message.to = to;
+    message.body = body;
+
+    // NOTE: The first message also offers the binary framing, which
+    // we don't accept here (see Process_BENCHMARK_MessageFraming).
+    const string offer =
+      string(framing::OFFER_HEADER) + ": " + framing::OFFER + "\r\n";
+
+    const size_t total =
+      count * MessageEncoder::encode(&message).size() + offer.size();
+
+    Stopwatch watch;
+    watch.start();
+
+    for (size_t i = 0; i < count; i++) {
+      process::post(to, "message", body.data(), body.size());
+    }
+
+    const size_t length = 64 * 1024;
+    std::unique_ptr<char[]> data(new char[length]);
+
+    size_t received = 0;
+    while (received < total) {
+      Future<size_t> recv = socket.recv(data.get(), length);
+      AWAIT_READY(recv);
+      ASSERT_NE(0u, recv.get());
+      received += recv.get();
+    }
+
+    Duration elapsed = watch.elapsed();
+
+    EXPECT_EQ(total, received);
+
+    cout << "Sent " << count << " messages of " << size << " in " << elapsed
+         << " (" << count / elapsed.secs() << " messages / sec)" << endl;
+
+    terminate(linker);
+    wait(linker);
+  }
+}
+
+
+// Measures the throughput of messages sent to a remote process with
+// the HTTP and with the binary framing, like the benchmark above but
+// including decoding the messages on the receiving end.
+TEST(ProcessTest, Process_BENCHMARK_MessageFraming)
+{
+  const size_t count = 100000;
+
+  foreach (bool binary, vector<bool>({false, true})) {
+    foreach (const Bytes& size, vector<Bytes>({Bytes(10), Kilobytes(1)})) {
+      Try<Socket> create = Socket::create();
+      ASSERT_SOME(create);
+
+      Socket listener = create.get();
+
+      ASSERT_SOME(listener.bind(Address::LOCALHOST_ANY()));
+      ASSERT_SOME(listener.listen(1));
+
+      Try<Address> address = listener.address();
+      ASSERT_SOME(address);
+
+      const UPID to("receiver", address.get());
+      const string body(size.bytes(), '1');
+
+      LinkerProcess linker(to);
+      spawn(linker);
+
+      Future<Socket> accept = listener.accept();
+      AWAIT_READY(accept);
+
+      Socket socket = accept.get();
+
+      DataDecoder decoder(socket);
+
+      const size_t length = 64 * 1024;
+      std::unique_ptr<char[]> data(new char[length]);
+
+      size_t received = 0; // Bytes.
+      size_t decoded = 0; // Messages, in either framing.
+      size_t framed = 0; // Messages in the binary framing.
+
+      auto receive = [&](size_t messages) {
+        while (decoded < messages) {
+          Future<size_t> recv = socket.recv(data.get(), length);
+          AWAIT_READY(recv);
+          ASSERT_NE(0u, recv.get());
+
+          received += recv.get();
+
+          foreach (http::Request* request,
+                   decoder.decode(data.get(), recv.get())) {
+            delete request;
+            decoded++;
+          }
+
+          foreach (Message* message, decoder.messages()) {
+            delete message;
+            decoded++;
+            framed++;
+          }
+
+          ASSERT_FALSE(decoder.failed());
+        }
+      };
+
+      // The first message makes the offer, after which we send
+      // messages until the sender has switched if we accept it.
+      process::post(to, "message", body.data(), body.size());
+      receive(1);
+
+      if (binary) {
+        decoder.upgrade();
+        const string accept(framing::ACCEPT, framing::ACCEPT_SIZE);
+        AWAIT_READY(socket.send(accept));
+
+        while (framed == 0) {
+          process::post(to, "message", body.data(), body.size());
+          receive(decoded + 1);
+        }
+      }
+
+      received = 0;
+      decoded = 0;
+
+      Stopwatch watch;
+      watch.start();
+
+      for (size_t i = 0; i < count; i++) {
+        process::post(to, "message", body.data(), body.size());
+      }
+
+      receive(count);
+
+      Duration elapsed = watch.elapsed();
+
+      EXPECT_EQ(count, decoded);
+
+      cout << "Received " << count << " messages of " << size
+           << " with the " << (binary ? "binary" : "HTTP") << " framing in "
+           << elapsed << " (" << count / elapsed.secs() << " messages / sec, "
+           << received / count << " bytes / message)" << endl;
+
+      terminate(linker);
+      wait(linker);
+    }
+  }
+}
+
+
+// A process with an endpoint that echoes the body of the requests.
+class EchoProcess : public Process<EchoProcess>
+{
+protected:
+  virtual void initialize()
+  {
+    route("/echo", None(), [](const http::Request& request) {
+      return http::OK(request.body);
+    });
+  }
+};
+
+
+// Measures how many of the buffers that the sockets of an HTTP
+// connection are read into get allocated, rather than reused from
+// the pool of read buffers (see buffers.hpp), per request.
+TEST(ProcessTest, Process_BENCHMARK_ReadBuffers)
+{
+  const size_t count = 10000;
+
+  EchoProcess process;
+  spawn(process);
+
+  const http::URL url(
+      "http",
+      process.self().address.ip,
+      process.self().address.port,
+      process.self().id + "/echo");
+
+  Future<http::Connection> connect = http::connect(url);
+  AWAIT_READY(connect);
+
+  http::Connection connection = connect.get();
+
+  http::Request request;
+  request.method = "POST";
+  request.url = url;
+  request.keepAlive = true;
+  request.body = string(1024, '1');
+
+  // Let the pools fill up first.
+  AWAIT_READY(connection.send(request));
+
+  const process::buffers::Statistics before = process::buffers::statistics();
+
+  Stopwatch watch;
+  watch.start();
+
+  for (size_t i = 0; i < count; i++) {
+    Future<http::Response> response = connection.send(request);
+    AWAIT_READY(response);
+    ASSERT_EQ(request.body, response->body);
+  }
+
+  Duration elapsed = watch.elapsed();
+
+  const process::buffers::Statistics after = process::buffers::statistics();
+
+  const uint64_t acquired = after.acquired - before.acquired;
+  const uint64_t allocated = acquired - (after.reused - before.reused);
+
+  cout << "Sent " << count << " requests in " << elapsed << ": "
+       << static_cast<double>(acquired) / count << " read buffers / request"
+       << " (previously all allocated), of which "
+       << static_cast<double>(allocated) / count << " allocated / request"
+       << endl;
+
+  AWAIT_READY(connection.disconnect());
+
+  terminate(process);
+  wait(process);
+}
+
+
+// A process that keeps bouncing a dispatch back and forth with its
+// peer until the given number of round trips has been made.
+class PingPongProcess : public Process<PingPongProcess>
+{
+public:
+  explicit PingPongProcess(Promise<Nothing>* _done) : done(_done) {}
+
+  void ping(const PID<PingPongProcess>& from, size_t remaining)
+  {
+    if (remaining == 0) {
+      done->set(Nothing());
+      return;
+    }
+
+    dispatch(from, &PingPongProcess::ping, self(), remaining - 1);
+  }
+
+private:
+  Promise<Nothing>* done;
+};
+
+
+class ProcessDispatch_BENCHMARK_Test : public ::testing::Test,
+                                       public WithParamInterface<size_t> {};
+
+
+// The number of process pairs that concurrently ping pong.
+INSTANTIATE_TEST_CASE_P(
+    ProcessPairs,
+    ProcessDispatch_BENCHMARK_Test,
+    ::testing::Values(1U, 2U, 4U, 8U, 16U, 32U, 64U));
+
+
+// Measures the dispatch throughput when an increasing number of
+// independent process pairs are dispatching to each other. Since
+// every dispatch wakes up a blocked process, this exercises the run
+// queues and shows how throughput scales with the number of workers
+// that are kept busy.
+//
+// NOTE: The number of worker threads is fixed once libprocess is
+// initialized, so to see how the throughput scales with the number
+// of workers run the benchmark with different values of
+// LIBPROCESS_NUM_WORKER_THREADS, e.g.:
+//
+//   filter='ProcessPairs/ProcessDispatch_BENCHMARK_Test.*'
+//   for w in 1 2 4 8 16; do
+//     LIBPROCESS_NUM_WORKER_THREADS=$w ./benchmarks --gtest_filter=$filter
+//   done
+TEST_P(ProcessDispatch_BENCHMARK_Test, Scalability)
+{
+  const size_t pairs = GetParam();
+  const size_t roundTrips = 20000;
+
+  vector<Owned<Promise<Nothing>>> promises;
+  vector<Owned<PingPongProcess>> processes;
+  list<Future<Nothing>> futures;
+
+  for (size_t i = 0; i < pairs; i++) {
+    promises.push_back(Owned<Promise<Nothing>>(new Promise<Nothing>()));
+    futures.push_back(promises.back()->future());
+
+    processes.push_back(
+        Owned<PingPongProcess>(new PingPongProcess(promises.back().get())));
+    spawn(processes.back().get());
+
+    processes.push_back(
+        Owned<PingPongProcess>(new PingPongProcess(promises.back().get())));
+    spawn(processes.back().get());
+  }
+
+  Stopwatch watch;
+  watch.start();
+
+  for (size_t i = 0; i < pairs; i++) {
+    dispatch(processes[2 * i]->self(),
+             &PingPongProcess::ping,
+             processes[2 * i + 1]->self(),
+             2 * roundTrips);
+  }
+
+  AWAIT_READY(collect(futures));
+
+  Duration elapsed = watch.elapsed();
+
+  const size_t dispatches = pairs * 2 * roundTrips;
+
+  const Option<string> workers = os::getenv("LIBPROCESS_NUM_WORKER_THREADS");
+
+  cout << "Performed " << dispatches << " dispatches across " << pairs
+       << " process pairs with " << workers.getOrElse("the default number of")
+       << " worker threads in " << elapsed << " ("
+       << dispatches / elapsed.secs() << " dispatches / sec)" << endl;
+
+  foreach (const Owned<PingPongProcess>& process, processes) {
+    terminate(process.get());
+    wait(process.get());
+  }
+}
+
+
+// A process that counts the dispatches it receives and completes a
+// promise once it has received the expected number.
+class CountingProcess : public Process<CountingProcess>
+{
+public:
+  explicit CountingProcess(size_t _expected)
+    : expected(_expected), received(0) {}
+
+  void receive(size_t)
+  {
+    if (++received == expected) {
+      done.set(Nothing());
+    }
+  }
+
+  const size_t expected;
+  size_t received;
+  Promise<Nothing> done;
+};
+
+
+// Measures how fast a large number of dispatches to a single process
+// get delivered and run when they are dispatched individually versus
+// in batches (see 'Batch' in dispatch.hpp), e.g., as when a process
+// dispatches to another process in a loop.
+TEST(ProcessTest, Process_BENCHMARK_BatchDispatch)
+{
+  const size_t count = 1000000;
+
+  foreach (size_t batchSize, vector<size_t>({1U, 10U, 100U, 1000U})) {
+    CountingProcess process(count);
+    spawn(process);
+
+    Stopwatch watch;
+    watch.start();
+
+    if (batchSize == 1) {
+      for (size_t i = 0; i < count; i++) {
+        dispatch(process.self(), &CountingProcess::receive, i);
+      }
+    } else {
+      Batch<CountingProcess> batch(process);
+
+      for (size_t i = 0; i < count; i++) {
+        batch.add(&CountingProcess::receive, i);
+
+        if (batch.size() == batchSize) {
+          batch.send();
+        }
+      }
+
+      batch.send();
+    }
+
+    AWAIT_READY(process.done.future());
+
+    Duration elapsed = watch.elapsed();
+
+    cout << "Dispatched " << count << " methods in batches of " << batchSize
+         << " in " << elapsed << " (" << count / elapsed.secs()
+         << " dispatches / sec)" << endl;
+
+    terminate(process);
+    wait(process);
+  }
+}
+
+
+// Measures the cost of creating, canceling, and expiring a large
+// number of timers, e.g., as done by the many timeouts (of futures,
+// delays, etc.) that a busy master or agent has pending.
+TEST(ClockTest, Clock_BENCHMARK_Timers)
+{
+  // To make sure the event loop is ready for the clock.
+  process::initialize();
+
+  const size_t count = 1000000;
+
+  vector<Timer> timers;
+  timers.reserve(count);
+
+  Stopwatch watch;
+  watch.start();
+
+  // Spread the timeouts over an hour so that the timers end up in
+  // many different slots.
+  for (size_t i = 0; i < count; i++) {
+    timers.push_back(
+        Clock::timer(Hours(1) + Milliseconds(i % 3600000), []() {}));
+  }
+
+  cout << "Created " << count << " timers in " << watch.elapsed() << endl;
+
+  watch.start();
+
+  foreach (const Timer& timer, timers) {
+    Clock::cancel(timer);
+  }
+
+  cout << "Canceled " << count << " timers in " << watch.elapsed() << endl;
+
+  timers.clear();
+
+  Clock::pause();
+
+  std::atomic_size_t expired(0);
+
+  for (size_t i = 0; i < count; i++) {
+    Clock::timer(
+        Milliseconds(i % 3600000),
+        [&expired]() { expired.fetch_add(1); });
+  }
+
+  watch.start();
+
+  Clock::advance(Hours(1));
+  Clock::settle();
+
+  cout << "Expired " << count << " timers in " << watch.elapsed() << endl;
+
+  EXPECT_EQ(count, expired.load());
+
+  Clock::resume();
+}
+
+
+// Measures the cost of chains of continuations on futures that are
+// completed by a non-libprocess thread, i.e., the cost of registering
+// and running the callbacks of each future in a chain.
+TEST(FutureTest, Future_BENCHMARK_Then)
+{
+  // NOTE: completing a chain runs the continuations recursively, so
+  // we use many short chains rather than a single long one.
+  const size_t chains = 10000;
+  const size_t length = 100;
+
+  vector<Promise<size_t>> promises(chains);
+  vector<Future<size_t>> futures;
+
+  Stopwatch watch;
+  watch.start();
+
+  for (size_t i = 0; i < chains; i++) {
+    Future<size_t> future = promises[i].future();
+
+    for (size_t j = 0; j < length; j++) {
+      future = future.then([](size_t value) { return value + 1; });
+    }
+
+    futures.push_back(future);
+  }
+
+  cout << "Chained " << chains * length << " continuations in "
+       << watch.elapsed() << endl;
+
+  watch.start();
+
+  for (size_t i = 0; i < chains; i++) {
+    promises[i].set(0);
+  }
+
+  cout << "Ran " << chains * length << " continuations in "
+       << watch.elapsed() << endl;
+
+  foreach (const Future<size_t>& future, futures) {
+    ASSERT_TRUE(future.isReady());
+    EXPECT_EQ(length, future.get());
+  }
+}
+
+
+class ChainProcess : public Process<ChainProcess>
+{
+public:
+  Future<size_t> run(size_t steps)
+  {
+    this->steps = steps;
+    step(0);
+    return promise.future();
+  }
+
+private:
+  // Each step continues on this process once the future of the step
+  // before is ready, e.g., like the steps of a task launch.
+  void step(size_t current)
+  {
+    if (current == steps) {
+      promise.set(current);
+      return;
+    }
+
+    Future<size_t>(current + 1)
+      .onReady(defer(self(), &Self::step, lambda::_1));
+  }
+
+  size_t steps;
+  Promise<size_t> promise;
+};
+
+
+// Measures the cost of a long chain of continuations that are all
+// deferred to the process that runs the chain.
+TEST(ProcessTest, Process_BENCHMARK_DeferChain)
+{
+  const size_t steps = 1000000;
+
+  ChainProcess process;
+  spawn(process);
+
+  Stopwatch watch;
+  watch.start();
+
+  Future<size_t> future = dispatch(process, &ChainProcess::run, steps);
+
+  AWAIT_READY(future);
+
+  Duration elapsed = watch.elapsed();
+
+  cout << "Ran " << steps << " deferred continuations in " << elapsed
+       << " (" << steps / elapsed.secs() << " continuations / sec)" << endl;
+
+  EXPECT_EQ(steps, future.get());
+
+  terminate(process);
+  wait(process);
+}
+
+
+// Compares computing the Statistics of a window of values (as done
+// for every windowed metric when /metrics/snapshot is scraped) from a
+// TimeSeries, which copies and sorts the values, with computing them
+// from a Histogram.
+TEST(StatisticsTest, Statistics_BENCHMARK_Histogram)
+{
+  const size_t values = process::TIME_SERIES_CAPACITY;
+  const size_t snapshots = 1000;
+
+  TimeSeries<double> timeseries;
+  Histogram histogram;
+
+  Time time = Clock::now();
+
+  for (size_t i = 0; i < values; i++) {
+    // Spread the values over a few orders of magnitude.
+    const double value = (i * 7919) % 100000 / 10.0;
+
+    time += Milliseconds(1);
+    timeseries.set(value, time);
+
+    histogram.record(value);
+  }
+
+  Stopwatch watch;
+  watch.start();
+
+  for (size_t i = 0; i < snapshots; i++) {
+    EXPECT_SOME(Statistics<double>::from(timeseries));
+  }
+
+  cout << "Computed " << snapshots << " statistics of " << values
+       << " values from a time series in " << watch.elapsed() << endl;
+
+  watch.start();
+
+  for (size_t i = 0; i < snapshots; i++) {
+    EXPECT_SOME(histogram.statistics());
+  }
+
+  cout << "Computed " << snapshots << " statistics of " << values
+       << " values from a histogram in " << watch.elapsed() << endl;
+}
@@ -15,6 +15,7 @@
 #include <deque>
 #include <string>
 
+#include <process/gtest.hpp>
 #include <process/socket.hpp>
 
 #include <stout/gtest.hpp>
@@ -122,6 +123,142 @@ TEST(DecoderTest, RequestHeaderCaseInsensitive)
 }
 
 
+// Checks that a request gets decoded when its URL is split across
+// the data passed to the decoder.
+TEST(DecoderTest, RequestSplitURL)
+{
+  Try<Socket> socket = Socket::create();
+  ASSERT_SOME(socket);
+  DataDecoder decoder = DataDecoder(socket.get());
+
+  const string data =
+    "GET /path/file.json?key1=value1#fragment HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "\r\n";
+
+  const size_t split = data.find("file");
+
+  deque<http::Request*> requests = decoder.decode(data.data(), split);
+  ASSERT_FALSE(decoder.failed());
+  ASSERT_TRUE(requests.empty());
+
+  requests = decoder.decode(data.data() + split, data.length() - split);
+  ASSERT_FALSE(decoder.failed());
+  ASSERT_EQ(1, requests.size());
+
+  http::Request* request = requests[0];
+  EXPECT_EQ("/path/file.json", request->url.path);
+  EXPECT_SOME_EQ("fragment", request->url.fragment);
+  EXPECT_SOME_EQ("value1", request->url.query.get("key1"));
+
+  delete request;
+}
+
+
+// Checks that the body of a chunked request gets streamed, and that
+// the requests that follow it are decoded as usual.
+TEST(DecoderTest, StreamingRequest)
+{
+  Try<Socket> socket = Socket::create();
+  ASSERT_SOME(socket);
+  DataDecoder decoder(socket.get(), true);
+
+  const string headers =
+    "POST /path?key=value HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "\r\n";
+
+  deque<http::Request*> requests =
+    decoder.decode(headers.data(), headers.length());
+
+  ASSERT_FALSE(decoder.failed());
+  ASSERT_EQ(1u, requests.size());
+
+  http::Request* request = requests[0];
+
+  EXPECT_EQ("/path", request->url.path);
+  EXPECT_SOME_EQ("value", request->url.query.get("key"));
+
+  ASSERT_EQ(http::Request::PIPE, request->type);
+  ASSERT_SOME(request->reader);
+
+  http::Pipe::Reader reader = request->reader.get();
+  delete request;
+
+  Future<string> read = reader.read();
+  EXPECT_TRUE(read.isPending());
+
+  const string chunk = "5\r\nhello\r\n";
+
+  requests = decoder.decode(chunk.data(), chunk.length());
+  ASSERT_FALSE(decoder.failed());
+  EXPECT_TRUE(requests.empty());
+
+  AWAIT_EXPECT_EQ("hello", read);
+
+  read = reader.read();
+  EXPECT_TRUE(read.isPending());
+
+  const string data =
+    "0\r\n"
+    "\r\n"
+    "POST /path HTTP/1.1\r\n"
+    "Content-Length: 5\r\n"
+    "\r\n"
+    "small";
+
+  requests = decoder.decode(data.data(), data.length());
+  ASSERT_FALSE(decoder.failed());
+  ASSERT_EQ(1u, requests.size());
+
+  AWAIT_EXPECT_EQ("", read);
+
+  // Small requests are not streamed.
+  request = requests[0];
+
+  EXPECT_EQ(http::Request::BODY, request->type);
+  EXPECT_EQ("small", request->body);
+
+  delete request;
+}
+
+
+// Checks that the reader of a streamed request gets a failure if the
+// rest of the body doesn't arrive.
+TEST(DecoderTest, StreamingRequestFailure)
+{
+  Try<Socket> socket = Socket::create();
+  ASSERT_SOME(socket);
+
+  Option<http::Pipe::Reader> reader;
+
+  {
+    DataDecoder decoder(socket.get(), true);
+
+    const string data =
+      "POST /path HTTP/1.1\r\n"
+      "Content-Length: 1000000\r\n"
+      "\r\n"
+      "partial";
+
+    deque<http::Request*> requests = decoder.decode(data.data(), data.size());
+
+    ASSERT_FALSE(decoder.failed());
+    ASSERT_EQ(1u, requests.size());
+    ASSERT_EQ(http::Request::PIPE, requests[0]->type);
+
+    reader = requests[0]->reader;
+    delete requests[0];
+  }
+
+  ASSERT_SOME(reader);
+
+  AWAIT_EXPECT_EQ("partial", reader->read());
+  AWAIT_EXPECT_FAILED(reader->read());
+}
+
+
 TEST(DecoderTest, Response)
 {
   ResponseDecoder decoder;
@@ -16,18 +16,33 @@
 #include <string>
 #include <vector>
 
+#include <process/gtest.hpp>
 #include <process/http.hpp>
+#include <process/pid.hpp>
+#include <process/process.hpp>
 #include <process/socket.hpp>
 
+#include <stout/foreach.hpp>
 #include <stout/gtest.hpp>
 
 #include "encoder.hpp"
 #include "decoder.hpp"
 
+namespace framing = process::framing;
 namespace http = process::http;
 
+using process::DataDecoder;
+using process::Future;
 using process::HttpResponseEncoder;
+using process::Message;
+using process::MessageEncoder;
+using process::MessageFraming;
+using process::Process;
 using process::ResponseDecoder;
+using process::UPID;
+
+using process::network::Address;
+using process::network::Socket;
 
 using std::deque;
 using std::string;
@@ -113,3 +128,326 @@ TEST(EncoderTest, AcceptableEncodings)
       << gzipRequest.headers.get("Accept-Encoding").get() << "'";
   }
 }
+
+
+TEST(EncoderTest, Message)
+{
+  Try<Socket> socket = Socket::create();
+  ASSERT_SOME(socket);
+
+  Message* message = new Message();
+  message->name = "name";
+  message->from = UPID("from@127.0.0.1:5050");
+  message->to = UPID("to@127.0.0.1:5051");
+  message->body = "body";
+
+  const string encoded = MessageEncoder::encode(message);
+
+  // NOTE: The encoder takes ownership of the message.
+  MessageEncoder encoder(socket.get(), message);
+
+  // The header, the body and the trailer of the chunked body.
+  vector<Socket::Buffer> buffers;
+  EXPECT_EQ(encoded.size(), encoder.next(&buffers));
+  ASSERT_EQ(3u, buffers.size());
+  EXPECT_EQ(message->body.data(), buffers[1].data);
+  EXPECT_EQ(0u, encoder.remaining());
+
+  string data;
+  foreach (const Socket::Buffer& buffer, buffers) {
+    data.append(buffer.data, buffer.size);
+  }
+
+  EXPECT_EQ(encoded, data);
+
+  // Back up into the body as if only part of the data was sent.
+  encoder.backup(10);
+  EXPECT_EQ(10u, encoder.remaining());
+
+  buffers.clear();
+  encoder.next(&buffers);
+  ASSERT_EQ(2u, buffers.size());
+
+  data.clear();
+  foreach (const Socket::Buffer& buffer, buffers) {
+    data.append(buffer.data, buffer.size);
+  }
+
+  EXPECT_EQ(encoded.substr(encoded.size() - 10), data);
+}
+
+
+// Sends messages through a MessageFraming, from before the receiver
+// accepts the binary framing to after, and decodes them.
+TEST(EncoderTest, MessageFraming)
+{
+  Try<Socket> socket = Socket::create();
+  ASSERT_SOME(socket);
+
+  MessageFraming framing;
+
+  string data;
+
+  auto encode = [&](const string& name, const string& body) {
+    Message* message = new Message();
+    message->name = name;
+    message->from = UPID("from@127.0.0.1:5050");
+    message->to = UPID("to@127.0.0.1:5051");
+    message->body = body;
+
+    MessageEncoder encoder(socket.get(), message);
+
+    vector<Socket::Buffer> buffers;
+    const size_t size = encoder.next(&buffers, &framing);
+
+    foreach (const Socket::Buffer& buffer, buffers) {
+      data.append(buffer.data, buffer.size);
+    }
+
+    return size;
+  };
+
+  // The first message makes the offer.
+  encode("first", "1");
+
+  DataDecoder decoder(socket.get());
+
+  deque<http::Request*> requests = decoder.decode(data.data(), data.size());
+  ASSERT_FALSE(decoder.failed());
+  ASSERT_EQ(1u, requests.size());
+  EXPECT_SOME_EQ(
+      framing::OFFER,
+      requests[0]->headers.get(framing::OFFER_HEADER));
+
+  delete requests[0];
+
+  decoder.upgrade();
+
+  data.clear();
+
+  // Until the acknowledgement arrives the messages are still sent
+  // over HTTP, without repeating the offer.
+  const size_t http = encode("second", "2");
+
+  const string accept(framing::ACCEPT, framing::ACCEPT_SIZE);
+
+  EXPECT_TRUE(framing.received(accept.data(), 10));
+  EXPECT_FALSE(framing.binary());
+
+  EXPECT_FALSE(framing.received(accept.data() + 10, accept.size() - 10));
+  EXPECT_TRUE(framing.binary());
+
+  // The first binary message defines the symbols, which the ones
+  // after it then refer to.
+  encode("third", "3");
+  const size_t binary = encode("third", "4");
+  encode("fourth", "");
+
+  EXPECT_EQ(
+      framing::HEADER_SIZE + framing::MESSAGE_SYMBOLS_SIZE + 1,
+      binary);
+
+  EXPECT_LT(binary, http);
+
+  // Decode the HTTP message along with the start of the first frame
+  // to make sure that the decoder picks up the frame right after the
+  // HTTP message, and then the rest a byte at a time to make sure
+  // that it puts the frames back together.
+  requests = decoder.decode(data.data(), http + 3);
+  ASSERT_FALSE(decoder.failed());
+  ASSERT_EQ(1u, requests.size());
+  EXPECT_EQ("/to/second", requests[0]->url.path);
+  EXPECT_EQ("2", requests[0]->body);
+  EXPECT_NONE(requests[0]->headers.get(framing::OFFER_HEADER));
+
+  delete requests[0];
+
+  for (size_t i = http + 3; i < data.size(); i++) {
+    EXPECT_TRUE(decoder.decode(data.data() + i, 1).empty());
+    ASSERT_FALSE(decoder.failed());
+  }
+
+  deque<Message*> messages = decoder.messages();
+  ASSERT_EQ(3u, messages.size());
+
+  EXPECT_EQ("third", messages[0]->name);
+  EXPECT_EQ("3", messages[0]->body);
+  EXPECT_EQ("third", messages[1]->name);
+  EXPECT_EQ("4", messages[1]->body);
+  EXPECT_EQ("fourth", messages[2]->name);
+  EXPECT_EQ("", messages[2]->body);
+
+  foreach (Message* message, messages) {
+    EXPECT_EQ(UPID("from@127.0.0.1:5050"), message->from);
+    EXPECT_EQ("to", message->to.id);
+    delete message;
+  }
+
+  // Anything that's neither a frame nor an HTTP request fails.
+  decoder.decode("\0", 1);
+  EXPECT_TRUE(decoder.failed());
+}
+
+
+// Checks that the decoder fails on a frame that is declared to be
+// larger than the receiver accepts, rather than buffering it.
+TEST(EncoderTest, MessageFramingOversizedFrame)
+{
+  Try<Socket> socket = Socket::create();
+  ASSERT_SOME(socket);
+
+  string header;
+  header.push_back(framing::MESSAGE);
+  framing::append(framing::MAX_FRAME_SIZE + 1, &header);
+
+  // The whole header at once.
+  DataDecoder decoder(socket.get());
+  decoder.upgrade();
+
+  EXPECT_TRUE(decoder.decode(header.data(), header.size()).empty());
+  EXPECT_TRUE(decoder.failed());
+
+  // The header a byte at a time, so that it gets buffered first.
+  DataDecoder partial(socket.get());
+  partial.upgrade();
+
+  for (size_t i = 0; i < header.size(); i++) {
+    ASSERT_FALSE(partial.failed());
+    EXPECT_TRUE(partial.decode(header.data() + i, 1).empty());
+  }
+
+  EXPECT_TRUE(partial.failed());
+}
+
+
+// Checks that a message encoder knows how much data it has to send
+// before the message gets encoded.
+TEST(EncoderTest, MessageEncoderRemaining)
+{
+  Try<Socket> socket = Socket::create();
+  ASSERT_SOME(socket);
+
+  Message* message = new Message();
+  message->name = "name";
+  message->from = UPID("from@127.0.0.1:5050");
+  message->to = UPID("to@127.0.0.1:5051");
+  message->body = "body";
+
+  MessageEncoder encoder(socket.get(), message);
+
+  const size_t remaining = encoder.remaining();
+
+  vector<Socket::Buffer> buffers;
+  EXPECT_EQ(remaining, encoder.next(&buffers));
+  EXPECT_EQ(0u, encoder.remaining());
+
+  encoder.backup(remaining);
+  EXPECT_EQ(remaining, encoder.remaining());
+}
+
+
+class LinkerProcess : public Process<LinkerProcess>
+{
+public:
+  explicit LinkerProcess(const UPID& _to) : to(_to) {}
+
+  virtual void initialize()
+  {
+    link(to);
+  }
+
+private:
+  const UPID to;
+};
+
+
+// Checks that libprocess offers the binary framing when it sends
+// messages, and switches to it once the receiver accepts it.
+TEST(EncoderTest, MessageFramingNegotiation)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  Try<Socket> create = Socket::create();
+  ASSERT_SOME(create);
+
+  Socket listener = create.get();
+
+  ASSERT_SOME(listener.bind(Address::LOCALHOST_ANY()));
+  ASSERT_SOME(listener.listen(1));
+
+  Try<Address> address = listener.address();
+  ASSERT_SOME(address);
+
+  const UPID to("receiver", address.get());
+
+  // Link so that all of the messages go through the same socket.
+  LinkerProcess linker(to);
+  spawn(linker);
+
+  Future<Socket> accept = listener.accept();
+  AWAIT_READY(accept);
+
+  Socket socket = accept.get();
+
+  DataDecoder decoder(socket);
+
+  post(to, "offer");
+
+  deque<http::Request*> requests;
+  while (requests.empty()) {
+    Future<string> data = socket.recv();
+    AWAIT_READY(data);
+    ASSERT_FALSE(data->empty());
+
+    requests = decoder.decode(data->data(), data->size());
+    ASSERT_FALSE(decoder.failed());
+  }
+
+  ASSERT_EQ(1u, requests.size());
+  EXPECT_EQ("/receiver/offer", requests[0]->url.path);
+  EXPECT_SOME_EQ(
+      framing::OFFER,
+      requests[0]->headers.get(framing::OFFER_HEADER));
+
+  delete requests[0];
+
+  decoder.upgrade();
+
+  AWAIT_READY(socket.send(string(framing::ACCEPT, framing::ACCEPT_SIZE)));
+
+  // The messages that get sent before the acknowledgement is read
+  // are still sent over HTTP, so keep sending until one of them
+  // arrives in a binary frame.
+  deque<Message*> messages;
+  while (messages.empty()) {
+    post(to, "message", "body", 4);
+
+    requests.clear();
+    while (requests.empty() && messages.empty()) {
+      Future<string> data = socket.recv();
+      AWAIT_READY(data);
+      ASSERT_FALSE(data->empty());
+
+      requests = decoder.decode(data->data(), data->size());
+      ASSERT_FALSE(decoder.failed());
+
+      messages = decoder.messages();
+    }
+
+    foreach (http::Request* request, requests) {
+      EXPECT_EQ("/receiver/message", request->url.path);
+      EXPECT_NONE(request->headers.get(framing::OFFER_HEADER));
+      delete request;
+    }
+  }
+
+  ASSERT_EQ(1u, messages.size());
+  EXPECT_EQ("receiver", messages[0]->to.id);
+  EXPECT_EQ("message", messages[0]->name);
+  EXPECT_EQ("body", messages[0]->body);
+
+  delete messages[0];
+
+  terminate(linker);
+  wait(linker);
+}
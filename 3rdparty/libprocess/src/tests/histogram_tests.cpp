@@ -0,0 +1,157 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#include <gtest/gtest.h>
+
+#include <limits>
+
+#include <process/histogram.hpp>
+#include <process/statistics.hpp>
+
+#include <stout/gtest.hpp>
+
+using process::Histogram;
+using process::Statistics;
+
+TEST(HistogramTest, Empty)
+{
+  Histogram histogram;
+
+  EXPECT_NONE(histogram.statistics());
+}
+
+
+TEST(HistogramTest, Single)
+{
+  Histogram histogram;
+
+  histogram.record(1);
+
+  EXPECT_NONE(histogram.statistics());
+}
+
+
+// Infinite and NaN values are ignored.
+TEST(HistogramTest, NonFinite)
+{
+  Histogram histogram;
+
+  histogram.record(std::numeric_limits<double>::infinity());
+  histogram.record(-std::numeric_limits<double>::infinity());
+  histogram.record(std::numeric_limits<double>::quiet_NaN());
+
+  EXPECT_EQ(0u, histogram.size());
+
+  histogram.record(1);
+  histogram.record(std::numeric_limits<double>::infinity());
+  histogram.record(2);
+
+  Option<Statistics<double>> statistics = histogram.statistics();
+
+  ASSERT_SOME(statistics);
+
+  EXPECT_EQ(2u, statistics.get().count);
+  EXPECT_FLOAT_EQ(1.0, statistics.get().min);
+  EXPECT_FLOAT_EQ(2.0, statistics.get().max);
+  EXPECT_FLOAT_EQ(1.5, statistics.get().p50);
+}
+
+
+TEST(HistogramTest, Statistics)
+{
+  // Record a distribution of 1000 values from 1 to 1000.
+  Histogram histogram;
+
+  for (int i = 1; i <= 1000; ++i) {
+    histogram.record(i);
+  }
+
+  Option<Statistics<double>> statistics = histogram.statistics();
+
+  ASSERT_SOME(statistics);
+
+  // The count, minimum and maximum are exact.
+  EXPECT_EQ(1000u, statistics.get().count);
+
+  EXPECT_FLOAT_EQ(1.0, statistics.get().min);
+  EXPECT_FLOAT_EQ(1000.0, statistics.get().max);
+
+  // The percentiles are within the relative error of the buckets.
+  const double error = 1.0 / (2 * Histogram::SUB_BUCKETS);
+
+  EXPECT_NEAR(500.5, statistics.get().p50, 500.5 * error);
+  EXPECT_NEAR(900.1, statistics.get().p90, 900.1 * error);
+  EXPECT_NEAR(950.05, statistics.get().p95, 950.05 * error);
+  EXPECT_NEAR(990.01, statistics.get().p99, 990.01 * error);
+  EXPECT_NEAR(999.001, statistics.get().p999, 999.001 * error);
+  EXPECT_NEAR(999.9001, statistics.get().p9999, 999.9001 * error);
+}
+
+
+TEST(HistogramTest, Merge)
+{
+  Histogram histogram;
+  Histogram odd;
+  Histogram even;
+
+  for (int i = 1; i <= 1000; ++i) {
+    histogram.record(i);
+    (i % 2 == 0 ? even : odd).record(i);
+  }
+
+  Histogram merged;
+  merged.merge(odd);
+  merged.merge(even);
+
+  Option<Statistics<double>> expected = histogram.statistics();
+  Option<Statistics<double>> statistics = merged.statistics();
+
+  ASSERT_SOME(expected);
+  ASSERT_SOME(statistics);
+
+  EXPECT_EQ(expected.get().count, statistics.get().count);
+  EXPECT_EQ(expected.get().min, statistics.get().min);
+  EXPECT_EQ(expected.get().max, statistics.get().max);
+  EXPECT_EQ(expected.get().p50, statistics.get().p50);
+  EXPECT_EQ(expected.get().p90, statistics.get().p90);
+  EXPECT_EQ(expected.get().p95, statistics.get().p95);
+  EXPECT_EQ(expected.get().p99, statistics.get().p99);
+  EXPECT_EQ(expected.get().p999, statistics.get().p999);
+  EXPECT_EQ(expected.get().p9999, statistics.get().p9999);
+}
+
+
+// Values outside of the range of the buckets are accounted for as the
+// minimum or maximum.
+TEST(HistogramTest, Range)
+{
+  Histogram histogram;
+
+  for (int i = 0; i < 10; ++i) {
+    histogram.record(0);
+  }
+
+  histogram.record(1e30);
+
+  Option<Statistics<double>> statistics = histogram.statistics();
+
+  ASSERT_SOME(statistics);
+
+  EXPECT_EQ(11u, statistics.get().count);
+
+  EXPECT_FLOAT_EQ(0.0, statistics.get().min);
+  EXPECT_FLOAT_EQ(1e30, statistics.get().max);
+
+  EXPECT_FLOAT_EQ(0.0, statistics.get().p50);
+  EXPECT_FLOAT_EQ(0.0, statistics.get().p90);
+  EXPECT_FLOAT_EQ(0.999e30, statistics.get().p9999);
+}
@@ -82,6 +82,7 @@ public:
   MOCK_METHOD1(requestDelete, Future<http::Response>(const http::Request&));
   MOCK_METHOD1(a, Future<http::Response>(const http::Request&));
   MOCK_METHOD1(abc, Future<http::Response>(const http::Request&));
+  MOCK_METHOD1(streaming, Future<http::Response>(const http::Request&));
 
   MOCK_METHOD2(
       authenticated,
@@ -98,6 +99,11 @@ protected:
     route("/delete", None(), &HttpProcess::requestDelete);
     route("/a", None(), &HttpProcess::a);
     route("/a/b/c", None(), &HttpProcess::abc);
+
+    RouteOptions options;
+    options.requestStreaming = true;
+
+    route("/streaming", None(), &HttpProcess::streaming, options);
     route("/authenticated", "realm", None(), &HttpProcess::authenticated);
   }
 };
@@ -345,6 +351,35 @@ TEST(HTTPTest, PipeEOF)
 }
 
 
+TEST(HTTPTest, PipeReadAll)
+{
+  http::Pipe pipe;
+  http::Pipe::Reader reader = pipe.reader();
+  http::Pipe::Writer writer = pipe.writer();
+
+  Future<string> read = reader.readAll();
+  EXPECT_TRUE(read.isPending());
+
+  EXPECT_TRUE(writer.write("hello"));
+  EXPECT_TRUE(writer.write(" "));
+  EXPECT_TRUE(read.isPending());
+
+  EXPECT_TRUE(writer.write("world"));
+  EXPECT_TRUE(writer.close());
+
+  AWAIT_EQ("hello world", read);
+
+  // A failure of the writer fails the whole read.
+  http::Pipe failing;
+  read = failing.reader().readAll();
+
+  EXPECT_TRUE(failing.writer().write("hello"));
+  EXPECT_TRUE(failing.writer().fail("disconnected"));
+
+  AWAIT_EXPECT_FAILED(read);
+}
+
+
 TEST(HTTPTest, PipeFailure)
 {
   http::Pipe pipe;
@@ -716,6 +751,72 @@ TEST(HTTPTest, Post)
 }
 
 
+// Returns the size of the body of a streamed request.
+Future<http::Response> readStreamingBody(const http::Request& request)
+{
+  EXPECT_EQ(http::Request::PIPE, request.type);
+  EXPECT_TRUE(request.body.empty());
+
+  if (request.reader.isNone()) {
+    return http::InternalServerError("Missing reader");
+  }
+
+  http::Pipe::Reader reader = request.reader.get();
+
+  return reader.readAll()
+    .then([](const string& body) -> http::Response {
+      return http::OK(stringify(body.size()));
+    });
+}
+
+
+http::Response validateLargeBody(const http::Request& request)
+{
+  EXPECT_EQ(http::Request::BODY, request.type);
+  EXPECT_NONE(request.reader);
+
+  return http::OK(stringify(request.body.size()));
+}
+
+
+// Checks that the endpoints that are routed with request streaming
+// get the body of the requests from a pipe, while the others still
+// get the whole body.
+TEST(HTTPTest, StreamingRequest)
+{
+  Http http;
+
+  const string large(1024 * 1024, 'x');
+
+  EXPECT_CALL(*http.process, streaming(_))
+    .WillOnce(Invoke(readStreamingBody))
+    .WillOnce(Invoke(readStreamingBody));
+
+  Future<http::Response> response = http::post(
+      http.process->self(), "streaming", None(), large, "text/plain");
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(http::OK().status, response);
+  AWAIT_EXPECT_RESPONSE_BODY_EQ(stringify(large.size()), response);
+
+  // Small requests get buffered by the decoder but still get
+  // streamed to the handler.
+  response = http::post(
+      http.process->self(), "streaming", None(), "small", "text/plain");
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(http::OK().status, response);
+  AWAIT_EXPECT_RESPONSE_BODY_EQ("5", response);
+
+  EXPECT_CALL(*http.process, body(_))
+    .WillOnce(Invoke(validateLargeBody));
+
+  response = http::post(
+      http.process->self(), "body", None(), large, "text/plain");
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(http::OK().status, response);
+  AWAIT_EXPECT_RESPONSE_BODY_EQ(stringify(large.size()), response);
+}
+
+
 http::Response validateDelete(const http::Request& request)
 {
   EXPECT_EQ("DELETE", request.method);
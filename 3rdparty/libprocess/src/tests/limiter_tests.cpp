@@ -121,3 +121,96 @@ TEST(LimiterTest, DiscardLast)
   Clock::advance(interval);
   AWAIT_READY(acquire3);
 }
+
+
+// In this test a permit becomes available while an acquisition that
+// had to wait for it might not have been queued by the process of the
+// limiter yet. The next acquisition must not take the permit directly,
+// i.e., the acquisitions must complete in the order they were made.
+TEST(LimiterTest, AcquireInOrder)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  int permits = 2;
+  Duration duration = Milliseconds(5);
+
+  RateLimiter limiter(permits, duration);
+  Milliseconds interval = duration / permits;
+
+  Clock::pause();
+
+  Future<Nothing> acquire1 = limiter.acquire();
+  EXPECT_TRUE(acquire1.isReady());
+
+  // This acquisition is throttled, so it gets dispatched.
+  Future<Nothing> acquire2 = limiter.acquire();
+
+  Clock::advance(interval);
+
+  // There is a permit now, but it's for 'acquire2'.
+  Future<Nothing> acquire3 = limiter.acquire();
+  EXPECT_TRUE(acquire3.isPending());
+
+  AWAIT_READY(acquire2);
+
+  Clock::settle();
+  EXPECT_TRUE(acquire3.isPending());
+
+  Clock::advance(interval);
+  AWAIT_READY(acquire3);
+}
+
+
+// In this test the limiter allows a burst of 3 permits, which are
+// acquired right away (without waiting for the process of the
+// limiter), after which the permits are acquired at the rate limit
+// until the bucket gets refilled while the limiter is idle.
+TEST(LimiterTest, Burst)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  int permits = 2;
+  Duration duration = Milliseconds(5);
+
+  RateLimiter limiter(permits, duration, 3);
+  Milliseconds interval = duration / permits;
+
+  Clock::pause();
+
+  Future<Nothing> acquire1 = limiter.acquire();
+  Future<Nothing> acquire2 = limiter.acquire();
+  Future<Nothing> acquire3 = limiter.acquire();
+  Future<Nothing> acquire4 = limiter.acquire();
+  Future<Nothing> acquire5 = limiter.acquire();
+
+  EXPECT_TRUE(acquire1.isReady());
+  EXPECT_TRUE(acquire2.isReady());
+  EXPECT_TRUE(acquire3.isReady());
+
+  Clock::settle();
+  EXPECT_TRUE(acquire4.isPending());
+
+  Clock::advance(interval);
+  AWAIT_READY(acquire4);
+
+  Clock::settle();
+  EXPECT_TRUE(acquire5.isPending());
+
+  Clock::advance(interval);
+  AWAIT_READY(acquire5);
+
+  // Once the bucket is full again a burst of 3 is allowed again.
+  Clock::advance(interval * 3);
+
+  EXPECT_TRUE(limiter.acquire().isReady());
+  EXPECT_TRUE(limiter.acquire().isReady());
+  EXPECT_TRUE(limiter.acquire().isReady());
+
+  Future<Nothing> acquire6 = limiter.acquire();
+
+  Clock::settle();
+  EXPECT_TRUE(acquire6.isPending());
+
+  Clock::advance(interval);
+  AWAIT_READY(acquire6);
+}
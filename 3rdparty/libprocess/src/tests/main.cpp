@@ -23,6 +23,8 @@
 #include <process/gtest.hpp>
 #include <process/process.hpp>
 
+#include <stout/os.hpp>
+
 #ifdef __WINDOWS__
 #include <process/windows/winsock.hpp>
 #else
@@ -50,6 +52,10 @@ int main(int argc, char** argv)
   // Initialize Google Mock/Test.
   testing::InitGoogleMock(&argc, argv);
 
+  // Record the process statistics so that they get exercised by all
+  // of the tests (unless they are explicitly disabled).
+  os::setenv("LIBPROCESS_ENABLE_PROCESS_STATISTICS", "1", false);
+
   // Initialize libprocess.
   process::initialize(None(), process::DEFAULT_HTTP_AUTHENTICATION_REALM);
 
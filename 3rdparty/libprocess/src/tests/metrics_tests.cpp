@@ -30,6 +30,7 @@
 
 #include <process/metrics/counter.hpp>
 #include <process/metrics/gauge.hpp>
+#include <process/metrics/histogram.hpp>
 #include <process/metrics/metrics.hpp>
 #include <process/metrics/timer.hpp>
 
@@ -47,6 +48,8 @@ using http::Unauthorized;
 
 using metrics::Counter;
 using metrics::Gauge;
+using metrics::Histogram;
+using metrics::PushGauge;
 using metrics::Timer;
 
 using process::Clock;
@@ -64,6 +67,13 @@ using std::string;
 class GaugeProcess : public Process<GaugeProcess>
 {
 public:
+  GaugeProcess() : evaluations(0) {}
+
+  double count()
+  {
+    return ++evaluations;
+  }
+
   double get()
   {
     return 42.0;
@@ -78,6 +88,9 @@ public:
   {
     return Future<double>();
   }
+
+private:
+  int evaluations;
 };
 
 
@@ -167,6 +180,60 @@ TEST_F(MetricsTest, Gauge)
 }
 
 
+// Tests that a gauge with a staleness bound reuses its last value
+// until it's older than the bound.
+TEST_F(MetricsTest, GaugeStaleness)
+{
+  GaugeProcess process;
+  PID<GaugeProcess> pid = spawn(&process);
+
+  Clock::pause();
+
+  Gauge gauge("test/gauge", defer(pid, &GaugeProcess::count), Seconds(10));
+
+  AWAIT_READY(metrics::add(gauge));
+
+  AWAIT_EXPECT_EQ(1.0, gauge.value());
+
+  Clock::advance(Seconds(10));
+
+  AWAIT_EXPECT_EQ(1.0, gauge.value());
+
+  Clock::advance(Seconds(1));
+
+  AWAIT_EXPECT_EQ(2.0, gauge.value());
+  AWAIT_EXPECT_EQ(2.0, gauge.value());
+
+  AWAIT_READY(metrics::remove(gauge));
+
+  terminate(process);
+  wait(process);
+}
+
+
+TEST_F(MetricsTest, PushGauge)
+{
+  PushGauge gauge("test/gauge");
+
+  AWAIT_READY(metrics::add(gauge));
+
+  AWAIT_EXPECT_EQ(0.0, gauge.value());
+
+  gauge = 42;
+  AWAIT_EXPECT_EQ(42.0, gauge.value());
+
+  gauge += 8;
+  AWAIT_EXPECT_EQ(50.0, gauge.value());
+
+  gauge -= 50;
+  AWAIT_EXPECT_EQ(0.0, gauge.value());
+
+  EXPECT_NONE(gauge.statistics());
+
+  AWAIT_READY(metrics::remove(gauge));
+}
+
+
 TEST_F(MetricsTest, Statistics)
 {
   Counter counter("test/counter", process::TIME_SERIES_WINDOW);
@@ -441,6 +508,39 @@ TEST_F(MetricsTest, SnapshotStatistics)
 }
 
 
+// Ensures that a metric that is named like a statistic of another
+// metric does not lead to a duplicate key in the snapshot.
+TEST_F(MetricsTest, SnapshotDuplicateKeys)
+{
+  UPID upid("metrics", process::address());
+
+  Clock::pause();
+
+  Counter counter("test/counter", process::TIME_SERIES_WINDOW);
+  Counter max("test/counter/max");
+
+  AWAIT_READY(metrics::add(counter));
+  AWAIT_READY(metrics::add(max));
+
+  Clock::advance(Seconds(1));
+  ++counter;
+
+  Future<Response> response = http::get(upid, "snapshot");
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(OK().status, response);
+
+  const string& body = response->body;
+  const string key = "\"test/counter/max\"";
+
+  size_t position = body.find(key);
+  ASSERT_NE(string::npos, position);
+  EXPECT_EQ(string::npos, body.find(key, position + key.size()));
+
+  AWAIT_READY(metrics::remove(counter));
+  AWAIT_READY(metrics::remove(max));
+}
+
+
 TEST_F(MetricsTest, Timer)
 {
   metrics::Timer<Nanoseconds> timer("test/timer");
@@ -501,6 +601,70 @@ TEST_F(MetricsTest, AsyncTimer)
 }
 
 
+TEST_F(MetricsTest, Histogram)
+{
+  UPID upid("metrics", process::address());
+
+  Clock::pause();
+
+  Histogram histogram("test/histogram", Seconds(4));
+
+  AWAIT_READY(metrics::add(histogram));
+
+  for (int i = 1; i <= 100; ++i) {
+    histogram.record(i);
+  }
+
+  Future<Response> response = http::get(upid, "snapshot");
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(OK().status, response);
+
+  Try<JSON::Object> responseJSON =
+      JSON::parse<JSON::Object>(response.get().body);
+
+  ASSERT_SOME(responseJSON);
+
+  // The value is the last recorded value, the count, minimum and
+  // maximum are exact and the percentiles are approximate.
+  map<string, double> expected;
+
+  expected["test/histogram"] = 100.0;
+  expected["test/histogram/count"] = 100;
+  expected["test/histogram/min"] = 1.0;
+  expected["test/histogram/max"] = 100.0;
+
+  foreachpair (const string& key, double value, expected) {
+    Result<JSON::Number> number = responseJSON->find<JSON::Number>(key);
+    ASSERT_SOME(number) << key;
+    EXPECT_FLOAT_EQ(value, number->as<double>()) << key;
+  }
+
+  Result<JSON::Number> p50 =
+    responseJSON->find<JSON::Number>("test/histogram/p50");
+
+  ASSERT_SOME(p50);
+  EXPECT_NEAR(50.5, p50->as<double>(), 1.0);
+
+  ASSERT_SOME(responseJSON->find<JSON::Number>("test/histogram/p9999"));
+
+  // Once the window has passed only the new values are covered.
+  Clock::advance(Seconds(5));
+
+  histogram.record(7);
+  histogram.record(7);
+
+  Option<Statistics<double>> statistics = histogram.statistics();
+  ASSERT_SOME(statistics);
+
+  EXPECT_EQ(2u, statistics.get().count);
+  EXPECT_FLOAT_EQ(7.0, statistics.get().min);
+  EXPECT_FLOAT_EQ(7.0, statistics.get().p50);
+  EXPECT_FLOAT_EQ(7.0, statistics.get().max);
+
+  AWAIT_READY(metrics::remove(histogram));
+}
+
+
 // Tests that the `/metrics/snapshot` endpoint rejects unauthenticated requests
 // when HTTP authentication is enabled.
 TEST_F(MetricsTest, SnapshotAuthenticationEnabled)
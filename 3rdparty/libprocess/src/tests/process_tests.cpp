@@ -21,8 +21,10 @@
 #include <netinet/tcp.h>
 
 #include <atomic>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <vector>
 
@@ -37,6 +39,7 @@
 #include <process/gc.hpp>
 #include <process/gmock.hpp>
 #include <process/gtest.hpp>
+#include <process/http.hpp>
 #include <process/network.hpp>
 #include <process/owned.hpp>
 #include <process/process.hpp>
@@ -46,28 +49,35 @@
 #include <process/subprocess.hpp>
 #include <process/time.hpp>
 
+#include <process/metrics/metrics.hpp>
+
 #include <stout/duration.hpp>
 #include <stout/gtest.hpp>
 #include <stout/hashmap.hpp>
 #include <stout/hashset.hpp>
+#include <stout/json.hpp>
 #include <stout/lambda.hpp>
 #include <stout/nothing.hpp>
 #include <stout/os.hpp>
 #include <stout/stopwatch.hpp>
 #include <stout/stringify.hpp>
+#include <stout/synchronized.hpp>
 #include <stout/try.hpp>
 
 #include <stout/os/killtree.hpp>
 
 #include "encoder.hpp"
 
+namespace framing = process::framing;
 namespace http = process::http;
 namespace inject = process::inject;
 
 using process::async;
+using process::Batch;
 using process::Clock;
 using process::defer;
 using process::Deferred;
+using process::DispatchEvent;
 using process::Event;
 using process::Executor;
 using process::ExitedEvent;
@@ -75,10 +85,12 @@ using process::Future;
 using process::Message;
 using process::MessageEncoder;
 using process::MessageEvent;
+using process::MessageFraming;
 using process::Owned;
 using process::PID;
 using process::Process;
 using process::ProcessBase;
+using process::Promise;
 using process::run;
 using process::Subprocess;
 using process::TerminateEvent;
@@ -597,6 +609,76 @@ TEST(ProcessTest, Delay)
 }
 
 
+// Tests that timers spread across very different timeouts (and thus
+// across the different wheels of the clock's timer wheel) fire in the
+// order of their timeouts, and only once their timeouts have elapsed.
+TEST(ProcessTest, Timers)
+{
+  Clock::pause();
+
+  std::mutex mutex;
+  vector<int> fired;
+
+  auto record = [&mutex, &fired](int index) {
+    synchronized (mutex) {
+      fired.push_back(index);
+    }
+  };
+
+  auto timer = [&record](const Duration& duration, int index) {
+    return Clock::timer(duration, lambda::bind(record, index));
+  };
+
+  timer(Days(400), 8);
+  timer(Milliseconds(1), 1);
+  timer(Hours(2), 6);
+  timer(Milliseconds(50), 3);
+  timer(Seconds(70), 5);
+  timer(Milliseconds(5), 2);
+  timer(Days(3), 7);
+  timer(Seconds(1), 4);
+
+  // Add another timer with the same timeout which should fire after
+  // the timer that was added first.
+  timer(Seconds(70), 9);
+
+  process::Timer canceled = timer(Seconds(30), 0);
+
+  EXPECT_TRUE(Clock::cancel(canceled));
+  EXPECT_FALSE(Clock::cancel(canceled));
+
+  Clock::advance(Milliseconds(1));
+  Clock::settle();
+
+  synchronized (mutex) {
+    EXPECT_EQ(vector<int>({1}), fired);
+  }
+
+  Clock::advance(Seconds(70) - Milliseconds(2));
+  Clock::settle();
+
+  synchronized (mutex) {
+    EXPECT_EQ(vector<int>({1, 2, 3, 4}), fired);
+  }
+
+  Clock::advance(Milliseconds(1));
+  Clock::settle();
+
+  synchronized (mutex) {
+    EXPECT_EQ(vector<int>({1, 2, 3, 4, 5, 9}), fired);
+  }
+
+  Clock::advance(Days(400));
+  Clock::settle();
+
+  synchronized (mutex) {
+    EXPECT_EQ(vector<int>({1, 2, 3, 4, 5, 9, 6, 7, 8}), fired);
+  }
+
+  Clock::resume();
+}
+
+
 class OrderProcess : public Process<OrderProcess>
 {
 public:
@@ -677,6 +759,509 @@ TEST(ProcessTest, Donate)
 }
 
 
+class BlockingProcess : public Process<BlockingProcess>
+{
+public:
+  explicit BlockingProcess(const Future<Nothing>& _released)
+    : released(_released) {}
+
+  void block(Promise<Nothing>* blocked)
+  {
+    blocked->set(Nothing());
+    released.await();
+  }
+
+  void noop() {}
+
+  void expose(const string& name) { exposeEventQueueSize(name); }
+
+  size_t dispatches() { return eventCount<DispatchEvent>(); }
+
+private:
+  Future<Nothing> released;
+};
+
+
+// Verifies that the event queue size accounts for the event that is
+// being processed as well as the events that are queued behind it.
+TEST(ProcessTest, EventQueueSize)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  Promise<Nothing> released;
+
+  BlockingProcess process(released.future());
+
+  // NOTE: we settle so that the process is done with its
+  // initialization, which is an event in its queue too.
+  Clock::pause();
+
+  spawn(process);
+
+  Clock::settle();
+  Clock::resume();
+
+  EXPECT_EQ(0u, process.eventQueueSize());
+
+  Promise<Nothing> blocked;
+  dispatch(process, &BlockingProcess::block, &blocked);
+
+  AWAIT_READY(blocked.future());
+
+  EXPECT_EQ(1u, process.eventQueueSize());
+
+  dispatch(process, &BlockingProcess::noop);
+  dispatch(process, &BlockingProcess::noop);
+  dispatch(process, &BlockingProcess::noop);
+
+  EXPECT_EQ(4u, process.eventQueueSize());
+  EXPECT_EQ(3u, process.dispatches());
+
+  released.set(Nothing());
+
+  terminate(process, false);
+  wait(process);
+}
+
+
+// Verifies that the event queue size of a process can be exposed as
+// a metric which can be read while the process is blocked, and that
+// it's removed when the process terminates.
+TEST(ProcessTest, EventQueueSizeGauge)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  Promise<Nothing> released;
+
+  BlockingProcess process(released.future());
+  spawn(process);
+
+  dispatch(process, &BlockingProcess::expose, "test/event_queue_size");
+
+  Promise<Nothing> blocked;
+  dispatch(process, &BlockingProcess::block, &blocked);
+
+  AWAIT_READY(blocked.future());
+
+  dispatch(process, &BlockingProcess::noop);
+  dispatch(process, &BlockingProcess::noop);
+  dispatch(process, &BlockingProcess::noop);
+
+  Future<hashmap<string, double>> snapshot =
+    process::metrics::snapshot(None());
+
+  AWAIT_READY(snapshot);
+
+  ASSERT_TRUE(snapshot->contains("test/event_queue_size"));
+  EXPECT_EQ(4.0, snapshot->at("test/event_queue_size"));
+
+  released.set(Nothing());
+
+  terminate(process);
+  wait(process);
+
+  snapshot = process::metrics::snapshot(None());
+
+  AWAIT_READY(snapshot);
+  EXPECT_FALSE(snapshot->contains("test/event_queue_size"));
+}
+
+
+class CountingProcess : public Process<CountingProcess>
+{
+public:
+  CountingProcess() : count(0) {}
+
+  void increment() { count++; }
+
+  size_t get() { return count; }
+
+private:
+  size_t count;
+};
+
+
+// Verifies that processes can be looked up (e.g., to dispatch to
+// them) from many threads while other processes are being spawned
+// and cleaned up concurrently.
+TEST(ProcessTest, ConcurrentLookups)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  const size_t threads = 4;
+  const size_t dispatches = 10000;
+
+  CountingProcess target;
+  spawn(target);
+
+  std::atomic_bool done(false);
+  vector<std::thread> dispatchers;
+
+  for (size_t i = 0; i < threads; i++) {
+    dispatchers.emplace_back([&]() {
+      for (size_t j = 0; j < dispatches; j++) {
+        dispatch(target, &CountingProcess::increment);
+      }
+    });
+  }
+
+  // Keep spawning and terminating processes, which adds and removes
+  // entries (and grows the table) while the lookups are happening.
+  std::thread spawner([&]() {
+    while (!done.load()) {
+      vector<UPID> pids;
+
+      for (size_t i = 0; i < 100; i++) {
+        pids.push_back(spawn(new ProcessBase(), true));
+      }
+
+      foreach (const UPID& pid, pids) {
+        terminate(pid);
+      }
+    }
+  });
+
+  foreach (std::thread& dispatcher, dispatchers) {
+    dispatcher.join();
+  }
+
+  done.store(true);
+  spawner.join();
+
+  Future<size_t> count = dispatch(target, &CountingProcess::get);
+
+  AWAIT_EXPECT_EQ(threads * dispatches, count);
+
+  terminate(target);
+  wait(target);
+}
+
+
+class ContinuationProcess : public Process<ContinuationProcess>
+{
+public:
+  virtual void initialize()
+  {
+    install("message", &Self::message);
+  }
+
+  // Dispatches to itself around sending itself a message, which
+  // must not change the order in which these get handled.
+  void interleave()
+  {
+    dispatch(self(), &Self::record, "dispatch 1");
+    send(self(), "message");
+    dispatch(self(), &Self::record, "dispatch 2");
+  }
+
+  // Continues on itself once a future it satisfies itself is ready,
+  // which must not run the continuation before this returns.
+  void chain()
+  {
+    Promise<Nothing> promise;
+
+    promise.future()
+      .onReady(defer(self(), &Self::record, "continuation"));
+
+    promise.set(Nothing());
+
+    record("chain");
+  }
+
+  void suicide()
+  {
+    dispatch(self(), &Self::record, "dispatch");
+    terminate(self());
+  }
+
+  vector<string> records() { return events; }
+
+  void record(const string& event) { events.push_back(event); }
+
+private:
+  void message(const UPID&, const string&) { record("message"); }
+
+  vector<string> events;
+};
+
+
+// Verifies that functions dispatched by a process to itself keep
+// their order with respect to its other events.
+TEST(ProcessTest, ContinuationOrder)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  Clock::pause();
+
+  ContinuationProcess process;
+  spawn(process);
+
+  // NOTE: we settle so that the process has no other events queued
+  // when it dispatches to itself.
+  Clock::settle();
+
+  dispatch(process, &ContinuationProcess::interleave);
+
+  Clock::settle();
+
+  dispatch(process, &ContinuationProcess::chain);
+
+  Clock::settle();
+
+  Future<vector<string>> records =
+    dispatch(process, &ContinuationProcess::records);
+
+  AWAIT_READY(records);
+
+  vector<string> expected = {
+    "dispatch 1", "message", "dispatch 2", "chain", "continuation"};
+
+  EXPECT_EQ(expected, records.get());
+
+  terminate(process);
+  wait(process);
+  Clock::resume();
+}
+
+
+// Verifies that the functions that a process dispatched to itself
+// before terminating itself don't get run.
+TEST(ProcessTest, ContinuationTerminate)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  ContinuationProcess process;
+  spawn(process);
+
+  dispatch(process, &ContinuationProcess::suicide);
+
+  wait(process);
+
+  EXPECT_TRUE(process.records().empty());
+}
+
+
+class BatchProcess : public Process<BatchProcess>
+{
+public:
+  void append(int value) { values.push_back(value); }
+
+  vector<int> values;
+};
+
+
+// Verifies that the dispatches of a batch run in order once the
+// batch is sent.
+TEST(ProcessTest, Batch)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  BatchProcess process;
+  spawn(process);
+
+  {
+    Batch<BatchProcess> batch(process);
+
+    for (int i = 0; i < 10; i++) {
+      batch.add(&BatchProcess::append, i);
+    }
+
+    EXPECT_EQ(10u, batch.size());
+
+    batch.send();
+
+    EXPECT_EQ(0u, batch.size());
+
+    batch.add(&BatchProcess::append, 10);
+    batch.add([&process]() { process.append(11); });
+
+    // The batch gets sent when it goes out of scope.
+  }
+
+  Future<vector<int>> values = dispatch(process.self(), [&process]() {
+    return process.values;
+  });
+
+  AWAIT_READY(values);
+
+  EXPECT_EQ(vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}), values.get());
+
+  terminate(process);
+  wait(process);
+}
+
+
+// Verifies that a batch can run a callable object that can only be
+// called when it's not const.
+TEST(ProcessTest, BatchMutable)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  BatchProcess process;
+  spawn(process);
+
+  {
+    Batch<BatchProcess> batch(process);
+
+    int value = 0;
+
+    batch.add([&process, value]() mutable {
+      process.append(value++);
+      process.append(value);
+    });
+  }
+
+  Future<vector<int>> values = dispatch(process.self(), [&process]() {
+    return process.values;
+  });
+
+  AWAIT_READY(values);
+
+  EXPECT_EQ(vector<int>({0, 1}), values.get());
+
+  terminate(process);
+  wait(process);
+}
+
+
+class CoalesceProcess : public Process<CoalesceProcess>
+{
+public:
+  CoalesceProcess() : calls(0) {}
+
+  void increment() { calls++; }
+
+  void coalesceIncrements(int count)
+  {
+    for (int i = 0; i < count; i++) {
+      coalesce(self(), "increment", &CoalesceProcess::increment);
+    }
+  }
+
+  int count() { return calls; }
+
+private:
+  int calls;
+};
+
+
+// Verifies that coalesced dispatches that are queued together run
+// once, and that a dropped dispatch doesn't swallow later ones.
+TEST(ProcessTest, Coalesce)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  Clock::pause();
+
+  CoalesceProcess process;
+  spawn(process);
+
+  // NOTE: we settle since the increments get queued behind any other
+  // dispatches that are queued when they're coalesced.
+  dispatch(process, &CoalesceProcess::coalesceIncrements, 3);
+
+  Clock::settle();
+
+  AWAIT_EXPECT_EQ(1, dispatch(process, &CoalesceProcess::count));
+
+  dispatch(process, &CoalesceProcess::coalesceIncrements, 3);
+
+  Clock::settle();
+
+  AWAIT_EXPECT_EQ(2, dispatch(process, &CoalesceProcess::count));
+
+  Future<Nothing> dropped =
+    DROP_DISPATCH(process.self(), &CoalesceProcess::increment);
+
+  coalesce(process, "increment", &CoalesceProcess::increment);
+
+  AWAIT_READY(dropped);
+
+  coalesce(process, "increment", &CoalesceProcess::increment);
+
+  AWAIT_EXPECT_EQ(3, dispatch(process, &CoalesceProcess::count));
+
+  terminate(process);
+  wait(process);
+  Clock::resume();
+}
+
+
+class StatisticsProcess : public Process<StatisticsProcess>
+{
+public:
+  Nothing handle() { return Nothing(); }
+};
+
+
+// Verifies that the process statistics (which the tests enable, see
+// main.cpp) count the events of a process and time a sample of them.
+TEST(ProcessTest, Statistics)
+{
+  StatisticsProcess process;
+  spawn(process);
+
+  Future<Nothing> handled;
+  for (int i = 0; i < 100; i++) {
+    handled = dispatch(process, &StatisticsProcess::handle);
+  }
+
+  AWAIT_READY(handled);
+
+  Future<http::Response> response =
+    http::get(UPID("__process_statistics__", process::address()));
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(http::OK().status, response);
+
+  Try<JSON::Array> array = JSON::parse<JSON::Array>(response->body);
+  ASSERT_SOME(array);
+
+  Option<JSON::Object> statistics;
+  foreach (const JSON::Value& value, array->values) {
+    const JSON::Object& object = value.as<JSON::Object>();
+    Result<JSON::String> id = object.find<JSON::String>("id");
+    if (id.isSome() && id->value == process.self().id) {
+      statistics = object;
+    }
+  }
+
+  ASSERT_SOME(statistics);
+
+  EXPECT_SOME_EQ(
+      JSON::Number(100),
+      statistics->find<JSON::Number>("events.dispatch"));
+
+  EXPECT_SOME_EQ(
+      JSON::Number(0),
+      statistics->find<JSON::Number>("events.message"));
+
+  // Every thread times at least one in so many of the events that it
+  // enqueues (see LIBPROCESS_PROCESS_STATISTICS_SAMPLE_INTERVAL).
+  Result<JSON::Number> sampled =
+    statistics->find<JSON::Number>("sampled_events");
+
+  ASSERT_SOME(sampled);
+  EXPECT_LT(0u, sampled->as<uint64_t>());
+
+  // The metrics sum up the statistics of all processes.
+  response = http::get(UPID("metrics", process::address()), "snapshot");
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(http::OK().status, response);
+
+  Try<JSON::Object> snapshot = JSON::parse<JSON::Object>(response->body);
+  ASSERT_SOME(snapshot);
+
+  ASSERT_EQ(1u, snapshot->values.count("libprocess/events/dispatches"));
+  EXPECT_LE(
+      100.0,
+      snapshot->values["libprocess/events/dispatches"]
+        .as<JSON::Number>().as<double>());
+
+  terminate(process);
+  wait(process);
+}
+
+
 class ExitedProcess : public Process<ExitedProcess>
 {
 public:
@@ -958,6 +1543,10 @@ namespace process {
 // to programatically mess with "link" FDs during tests.
 Option<int> get_persistent_socket(const UPID& to);
 
+// Forward declare the `set_sockets_per_peer` function since we want
+// to send messages on multiple sockets during tests.
+void set_sockets_per_peer(size_t count);
+
 } // namespace process {
 
 
@@ -1271,6 +1860,109 @@ TEST(ProcessTest, Remote)
 }
 
 
+// Checks that a small message gets sent ahead of a large message
+// between other processes that is queued on the same socket.
+TEST(ProcessTest, MessagePriority)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  Try<Socket> create = Socket::create();
+  ASSERT_SOME(create);
+
+  Socket listener = create.get();
+
+  ASSERT_SOME(listener.bind(Address::LOCALHOST_ANY()));
+  ASSERT_SOME(listener.listen(1));
+
+  Try<Address> address = listener.address();
+  ASSERT_SOME(address);
+
+  const UPID to("receiver", address.get());
+
+  // Link so that all of the messages go through the same socket.
+  ExitedProcess linker(to);
+  spawn(linker);
+
+  Future<Socket> accept = listener.accept();
+  AWAIT_READY(accept);
+
+  Socket socket = accept.get();
+
+  // Since we don't read from the socket yet, the first message can't
+  // be sent completely and the others get queued behind it.
+  const string bulk1(32 * 1024 * 1024, 'x');
+  const string bulk2(32 * 1024, 'y');
+
+  const UPID sender1("sender1", address.get());
+  const UPID sender2("sender2", address.get());
+  const UPID sender3("sender3", address.get());
+
+  post(sender1, to, "bulk1", bulk1.data(), bulk1.size());
+  post(sender2, to, "bulk2", bulk2.data(), bulk2.size());
+  post(sender3, to, "small", "small", 5);
+
+  string data;
+  while (data.find("/receiver/bulk2") == string::npos ||
+         data.find("/receiver/small") == string::npos) {
+    Future<string> received = socket.recv();
+    AWAIT_READY(received);
+    ASSERT_FALSE(received->empty());
+
+    data += received.get();
+  }
+
+  EXPECT_LT(data.find("/receiver/bulk1"), data.find("/receiver/small"));
+  EXPECT_LT(data.find("/receiver/small"), data.find("/receiver/bulk2"));
+
+  terminate(linker);
+  wait(linker);
+}
+
+
+// Checks that the messages to a peer get sent on multiple sockets
+// when there are multiple sockets per peer.
+TEST(ProcessTest, SocketsPerPeer)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  process::set_sockets_per_peer(4);
+
+  Try<Socket> create = Socket::create();
+  ASSERT_SOME(create);
+
+  Socket listener = create.get();
+
+  ASSERT_SOME(listener.bind(Address::LOCALHOST_ANY()));
+  ASSERT_SOME(listener.listen(8));
+
+  Try<Address> address = listener.address();
+  ASSERT_SOME(address);
+
+  const UPID to("receiver", address.get());
+
+  ExitedProcess linker(to);
+  spawn(linker);
+
+  Future<Socket> accept = listener.accept();
+  AWAIT_READY(accept);
+
+  // The messages from different senders are spread over the sockets
+  // (the one of the link and the parallel ones), so with enough
+  // senders at least one of them uses another socket.
+  for (int i = 0; i < 32; i++) {
+    const UPID sender("sender" + stringify(i), address.get());
+    post(sender, to, "message", nullptr, 0);
+  }
+
+  AWAIT_READY(listener.accept());
+
+  terminate(linker);
+  wait(linker);
+
+  process::set_sockets_per_peer(1);
+}
+
+
 // Like the 'remote' test but uses http::connect.
 TEST(ProcessTest, Http1)
 {
@@ -1390,6 +2082,74 @@ TEST(ProcessTest, Http2)
 }
 
 
+// Checks that libprocess accepts the binary framing when a peer
+// offers it, and then receives messages in binary frames.
+TEST(ProcessTest, BinaryFramingReceive)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  RemoteProcess process;
+  spawn(process);
+
+  Future<string> body1;
+  Future<string> body2;
+  Future<string> body3;
+  EXPECT_CALL(process, handler(_, _))
+    .WillOnce(FutureArg<1>(&body1))
+    .WillOnce(FutureArg<1>(&body2))
+    .WillOnce(FutureArg<1>(&body3));
+
+  Try<Socket> create = Socket::create();
+  ASSERT_SOME(create);
+
+  Socket socket = create.get();
+
+  AWAIT_READY(socket.connect(process.self().address));
+
+  MessageFraming framing;
+
+  auto send = [&](const string& body) {
+    Message* message = new Message();
+    message->name = "handler";
+    message->from = UPID();
+    message->to = process.self();
+    message->body = body;
+
+    MessageEncoder encoder(socket, message);
+
+    vector<Socket::Buffer> buffers;
+    encoder.next(&buffers, &framing);
+
+    string data;
+    foreach (const Socket::Buffer& buffer, buffers) {
+      data.append(buffer.data, buffer.size);
+    }
+
+    return socket.send(data);
+  };
+
+  // The first message makes the offer.
+  AWAIT_READY(send("1"));
+  AWAIT_EXPECT_EQ("1", body1);
+
+  const string accept(framing::ACCEPT, framing::ACCEPT_SIZE);
+
+  AWAIT_EXPECT_EQ(accept, socket.recv(accept.size()));
+
+  EXPECT_FALSE(framing.received(accept.data(), accept.size()));
+  ASSERT_TRUE(framing.binary());
+
+  AWAIT_READY(send("2"));
+  AWAIT_READY(send("3"));
+
+  AWAIT_EXPECT_EQ("2", body2);
+  AWAIT_EXPECT_EQ("3", body3);
+
+  terminate(process);
+  wait(process);
+}
+
+
 static int foo()
 {
   return 1;
@@ -16,8 +16,12 @@
 
 #include <stout/duration.hpp>
 #include <stout/gtest.hpp>
+#include <stout/nothing.hpp>
+#include <stout/stopwatch.hpp>
+#include <stout/strings.hpp>
 
 #include <process/authenticator.hpp>
+#include <process/dispatch.hpp>
 #include <process/future.hpp>
 #include <process/gtest.hpp>
 #include <process/http.hpp>
@@ -37,6 +41,7 @@ using http::Unauthorized;
 
 using process::DEFAULT_HTTP_AUTHENTICATION_REALM;
 using process::Future;
+using process::Process;
 using process::UPID;
 
 using std::string;
@@ -115,6 +120,57 @@ TEST_F(ProfilerTest, StartAndStop)
 }
 
 
+class SpinProcess : public Process<SpinProcess>
+{
+public:
+  Nothing spin(const Duration& duration)
+  {
+    Stopwatch stopwatch;
+    stopwatch.start();
+
+    while (stopwatch.elapsed() < duration) {}
+
+    return Nothing();
+  }
+};
+
+
+// Tests that the sampling profiler attributes the samples of a busy
+// process to that process.
+TEST_F(ProfilerTest, Sample)
+{
+  SpinProcess process;
+  spawn(process);
+
+  UPID upid("profiler", process::address());
+
+  Future<Response> response =
+    http::get(upid, "sample", "duration=1secs&frequency=1000");
+
+  // Keep the process busy until we get the samples.
+  while (response.isPending()) {
+    AWAIT_READY(process::dispatch(
+        process, &SpinProcess::spin, Milliseconds(10)));
+  }
+
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(OK().status, response);
+
+  // Each line of the folded stacks starts with the ID of the process
+  // that the sampled thread was running.
+  EXPECT_TRUE(strings::contains(response->body, process.self().id + ";"))
+    << response->body;
+
+  response = http::get(upid, "sample", "duration=1days");
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(BadRequest().status, response);
+
+  response = http::get(upid, "sample", "frequency=0");
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(BadRequest().status, response);
+
+  terminate(process);
+  wait(process);
+}
+
+
 // Tests that the profiler's HTTP endpoints reject unauthenticated
 // requests when HTTP authentication is enabled.
 TEST_F(ProfilerTest, StartAndStopAuthenticationEnabled)
@@ -133,4 +189,7 @@ TEST_F(ProfilerTest, StartAndStopAuthenticationEnabled)
 
   response = http::get(upid, "stop");
   AWAIT_EXPECT_RESPONSE_STATUS_EQ(Unauthorized({}).status, response);
+
+  response = http::get(upid, "sample");
+  AWAIT_EXPECT_RESPONSE_STATUS_EQ(Unauthorized({}).status, response);
 }
@@ -14,6 +14,11 @@
 #include <unistd.h>
 
 #include <sys/wait.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif // __linux__
+
+#include <glog/logging.h>
 
 #include <gtest/gtest.h>
 
@@ -25,6 +30,7 @@
 
 #include <stout/exit.hpp>
 #include <stout/gtest.hpp>
+#include <stout/os/close.hpp>
 #include <stout/os/fork.hpp>
 #include <stout/os/pstree.hpp>
 #include <stout/try.hpp>
@@ -191,3 +197,49 @@ TEST(ReapTest, TerminatedChildProcess)
 
   Clock::resume();
 }
+
+
+#if defined(__linux__) && defined(SYS_pidfd_open)
+// Check that the termination of a child process is noticed without
+// polling (i.e., without advancing the clock) where the kernel
+// supports pidfds.
+TEST(ReapTest, WithoutPolling)
+{
+  ASSERT_TRUE(GTEST_IS_THREADSAFE);
+
+  const int fd = ::syscall(SYS_pidfd_open, ::getpid(), 0);
+  if (fd < 0) {
+    LOG(WARNING) << "Skipping test since pidfds are not supported";
+    return;
+  }
+
+  os::close(fd);
+
+  Try<ProcessTree> tree = Fork(None(),
+                               Exec("sleep 10"))();
+
+  ASSERT_SOME(tree);
+  pid_t child = tree.get();
+
+  // Pause the clock so that a poll would never happen.
+  Clock::pause();
+
+  Future<Option<int> > status = process::reap(child);
+
+  // Make sure the reaper watches the child before it terminates.
+  Clock::settle();
+
+  EXPECT_TRUE(status.isPending());
+
+  EXPECT_EQ(0, kill(child, SIGKILL));
+
+  AWAIT_READY(status);
+
+  ASSERT_SOME(status.get());
+  int status_ = status.get().get();
+  ASSERT_TRUE(WIFSIGNALED(status_));
+  ASSERT_EQ(SIGKILL, WTERMSIG(status_));
+
+  Clock::resume();
+}
+#endif // __linux__ && SYS_pidfd_open
@@ -0,0 +1,118 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <iostream>
+#include <list>
+#include <vector>
+
+#include <process/collect.hpp>
+#include <process/future.hpp>
+#include <process/gtest.hpp>
+#include <process/subprocess.hpp>
+
+#include <stout/bytes.hpp>
+#include <stout/duration.hpp>
+#include <stout/foreach.hpp>
+#include <stout/gtest.hpp>
+#include <stout/lambda.hpp>
+#include <stout/option.hpp>
+#include <stout/stopwatch.hpp>
+#include <stout/try.hpp>
+
+// NOTE: These benchmarks are linked into the 'benchmarks' binary but
+// live in their own file since 'process/subprocess.hpp' (which uses
+// stout's 'flags' namespace) can't be included together with the
+// http-parser headers (which declare an 'enum flags').
+
+using process::Future;
+using process::Subprocess;
+
+using std::cout;
+using std::endl;
+using std::list;
+using std::vector;
+
+using testing::WithParamInterface;
+
+
+class Subprocess_BENCHMARK_Test : public ::testing::Test,
+                                  public WithParamInterface<Bytes> {};
+
+
+// The resident memory of the parent.
+INSTANTIATE_TEST_CASE_P(
+    ResidentMemory,
+    Subprocess_BENCHMARK_Test,
+    ::testing::Values(Bytes(0), Megabytes(256), Gigabytes(1), Gigabytes(2)));
+
+
+// Measures how many subprocesses per second can be launched by a
+// parent with an increasing amount of resident memory, with 'fork'
+// (whose cost grows with the page tables it copies) and with the
+// default way of launching them, which shares the memory of the
+// parent with the child instead on Linux.
+TEST_P(Subprocess_BENCHMARK_Test, Launch)
+{
+  const Bytes resident = GetParam();
+  const size_t launches = 200;
+
+  // Touch every page so that it's resident (and mapped).
+  vector<char> memory(resident.bytes(), 1);
+
+  const lambda::function<pid_t(const lambda::function<int()>&)> fork =
+    [](const lambda::function<int()>& func) {
+      pid_t pid = ::fork();
+      if (pid == 0) {
+        ::_exit(func());
+      }
+      return pid;
+    };
+
+  const vector<Option<lambda::function<
+      pid_t(const lambda::function<int()>&)>>> clones = {fork, None()};
+
+  foreach (const auto& clone, clones) {
+    list<Future<Option<int>>> statuses;
+
+    Stopwatch watch;
+    watch.start();
+
+    for (size_t i = 0; i < launches; i++) {
+      Try<Subprocess> s = process::subprocess(
+          "true",
+          {"true"},
+          Subprocess::FD(STDIN_FILENO),
+          Subprocess::FD(STDOUT_FILENO),
+          Subprocess::FD(STDERR_FILENO),
+          process::NO_SETSID,
+          None(),
+          None(),
+          clone);
+
+      ASSERT_SOME(s);
+      statuses.push_back(s->status());
+    }
+
+    const Duration elapsed = watch.elapsed();
+
+    cout << "Launched " << launches << " subprocesses with "
+         << (clone.isSome() ? "fork" : "the default") << " and " << resident
+         << " resident in " << elapsed << " ("
+         << launches / elapsed.secs() << " launches / sec)" << endl;
+
+    AWAIT_READY_FOR(process::collect(statuses), Seconds(60));
+  }
+}
@@ -697,6 +697,108 @@ TEST_F(SubprocessTest, Default)
   EXPECT_TRUE(WIFEXITED(status));
   EXPECT_EQ(0, WEXITSTATUS(status));
 }
+
+
+// Ensures that launching a subprocess with its own environment (and
+// signal mask) doesn't change the ones of the parent, which shares its
+// memory with the child when it doesn't need to fork (see
+// `internal::vforkClone`).
+TEST_F(SubprocessTest, EnvironmentParent)
+{
+  os::setenv("MESSAGE", "hello");
+
+  sigset_t before;
+  ASSERT_EQ(0, pthread_sigmask(SIG_SETMASK, nullptr, &before));
+
+  map<string, string> environment;
+  environment["MESSAGE"] = "goodbye";
+
+  Try<Subprocess> s = subprocess(
+      "echo $MESSAGE",
+      Subprocess::FD(STDIN_FILENO),
+      Subprocess::PIPE(),
+      Subprocess::FD(STDERR_FILENO),
+      process::NO_SETSID,
+      environment);
+
+  ASSERT_SOME(s);
+  ASSERT_SOME(s.get().out());
+  AWAIT_EXPECT_EQ("goodbye\n", io::read(s.get().out().get()));
+
+  EXPECT_SOME_EQ("hello", os::getenv("MESSAGE"));
+
+  sigset_t after;
+  ASSERT_EQ(0, pthread_sigmask(SIG_SETMASK, nullptr, &after));
+
+  for (int signal = 1; signal < NSIG; signal++) {
+    EXPECT_EQ(sigismember(&before, signal), sigismember(&after, signal));
+  }
+
+  // Advance time until the internal reaper reaps the subprocess.
+  Clock::pause();
+  while (s.get().status().isPending()) {
+    Clock::advance(MAX_REAP_INTERVAL());
+    Clock::settle();
+  }
+  Clock::resume();
+
+  AWAIT_ASSERT_READY(s.get().status());
+  ASSERT_SOME(s.get().status().get());
+
+  int status = s.get().status().get().get();
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+
+  os::unsetenv("MESSAGE");
+}
+
+
+// Ensures that the executable of a subprocess is searched for in the
+// PATH of its own environment, rather than the one of the parent.
+TEST_F(SubprocessTest, EnvironmentPath)
+{
+  const string name = "mesos-test-" + UUID::random().toString();
+  const string executable = path::join(os::getcwd(), name);
+
+  ASSERT_SOME(os::write(executable, "#!/bin/sh\necho hello\n"));
+  ASSERT_SOME(os::chmod(executable, S_IRWXU));
+
+  Option<string> path = os::getenv("PATH");
+
+  map<string, string> environment;
+  environment["PATH"] = os::getcwd();
+
+  Try<Subprocess> s = subprocess(
+      name,
+      {name},
+      Subprocess::FD(STDIN_FILENO),
+      Subprocess::PIPE(),
+      Subprocess::FD(STDERR_FILENO),
+      process::NO_SETSID,
+      None(),
+      environment);
+
+  ASSERT_SOME(s);
+  ASSERT_SOME(s.get().out());
+  AWAIT_EXPECT_EQ("hello\n", io::read(s.get().out().get()));
+
+  EXPECT_EQ(path, os::getenv("PATH"));
+
+  // Advance time until the internal reaper reaps the subprocess.
+  Clock::pause();
+  while (s.get().status().isPending()) {
+    Clock::advance(MAX_REAP_INTERVAL());
+    Clock::settle();
+  }
+  Clock::resume();
+
+  AWAIT_ASSERT_READY(s.get().status());
+  ASSERT_SOME(s.get().status().get());
+
+  int status = s.get().status().get().get();
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+}
 #endif // __WINDOWS__
 
 
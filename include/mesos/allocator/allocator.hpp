@@ -41,6 +41,28 @@
 namespace mesos {
 namespace allocator {
 
+/**
+ * Optional settings that the master passes to an allocator when it
+ * initializes it, see `Allocator::initialize`. An allocator may ignore
+ * the settings that it does not support.
+ */
+struct Options
+{
+  /**
+   * The number of threads the allocator may use to perform an
+   * allocation run.
+   */
+  size_t allocationParallelism = 1;
+
+  /**
+   * How long the values of the allocator's metrics that are expensive
+   * to compute may be reused by metrics snapshots. If not set, they are
+   * computed for every snapshot.
+   */
+  Option<Duration> metricsStaleness;
+};
+
+
 /**
  * Basic model of an allocator: resources are allocated to a framework
  * in the form of offers. A framework can refuse some resources in
@@ -83,6 +105,8 @@ public:
    *     allocations from the frameworks.
    * @param weights Configured per-role weights. Any roles that do not
    *     appear in this map will be assigned the default weight of 1.
+   * @param fairnessExcludeResourceNames Resources (by name) that are
+   *     excluded from the fair sharing between roles and frameworks.
    */
   virtual void initialize(
       const Duration& allocationInterval,
@@ -97,6 +121,36 @@ public:
       const Option<std::set<std::string>>&
         fairnessExcludeResourceNames = None()) = 0;
 
+  /**
+   * An overload of `initialize` that also passes optional settings to
+   * the allocator. This is the overload that the master invokes. The
+   * default implementation ignores the options and invokes the other
+   * overload, so allocators that do not support any options only need
+   * to implement that one.
+   *
+   * @param options Optional settings of the allocator.
+   */
+  virtual void initialize(
+      const Duration& allocationInterval,
+      const lambda::function<
+          void(const FrameworkID&,
+               const hashmap<SlaveID, Resources>&)>& offerCallback,
+      const lambda::function<
+          void(const FrameworkID&,
+               const hashmap<SlaveID, UnavailableResources>&)>&
+        inverseOfferCallback,
+      const hashmap<std::string, double>& weights,
+      const Option<std::set<std::string>>& fairnessExcludeResourceNames,
+      const Options& options)
+  {
+    initialize(
+        allocationInterval,
+        offerCallback,
+        inverseOfferCallback,
+        weights,
+        fairnessExcludeResourceNames);
+  }
+
   /**
    * Informs the allocator of the recovered state from the master.
    *
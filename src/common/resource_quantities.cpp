@@ -0,0 +1,289 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <mesos/resources.hpp>
+
+#include <stout/foreach.hpp>
+
+#include "common/resource_quantities.hpp"
+
+using std::ostream;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace mesos {
+namespace internal {
+
+// NOTE: These match the fixed point conversions in `common/values.cpp`,
+// so that the quantities add up exactly like `Value::Scalar`s do.
+static int64_t convertToFixed(double floatValue)
+{
+  return std::llround(floatValue * 1000);
+}
+
+
+static double convertToFloating(int64_t fixedValue)
+{
+  double quotient = static_cast<double>(fixedValue / 1000);
+  double remainder = static_cast<double>(fixedValue % 1000) / 1000.0;
+
+  return quotient + remainder;
+}
+
+
+ResourceQuantities ResourceQuantities::fromScalarResources(
+    const Resources& resources)
+{
+  ResourceQuantities result;
+
+  foreach (const Resource& resource, resources) {
+    if (resource.type() == Value::SCALAR) {
+      result.add({resource.name(),
+                  resource.role(),
+                  resource.has_revocable(),
+                  convertToFixed(resource.scalar().value())});
+    }
+  }
+
+  return result;
+}
+
+
+set<string> ResourceQuantities::names() const
+{
+  set<string> result;
+
+  foreach (const Quantity& quantity, quantities) {
+    result.insert(quantity.name);
+  }
+
+  return result;
+}
+
+
+double ResourceQuantities::get(const string& name) const
+{
+  int64_t value = 0;
+
+  // The quantities of a resource are adjacent since they are
+  // sorted by name first.
+  auto it = std::lower_bound(
+      quantities.begin(),
+      quantities.end(),
+      name,
+      [](const Quantity& quantity, const string& name) {
+        return quantity.name < name;
+      });
+
+  for (; it != quantities.end() && it->name == name; ++it) {
+    value += it->value;
+  }
+
+  return convertToFloating(value);
+}
+
+
+ResourceQuantities ResourceQuantities::flatten(const string& role) const
+{
+  ResourceQuantities result;
+
+  foreach (Quantity quantity, quantities) {
+    quantity.role = role;
+    result.add(quantity);
+  }
+
+  return result;
+}
+
+
+bool ResourceQuantities::contains(const ResourceQuantities& that) const
+{
+  // Both vectors are sorted, so we can walk them in lockstep.
+  auto it = quantities.begin();
+
+  foreach (const Quantity& quantity, that.quantities) {
+    while (it != quantities.end() && less(*it, quantity)) {
+      ++it;
+    }
+
+    if (it == quantities.end() ||
+        less(quantity, *it) ||
+        it->value < quantity.value) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+bool ResourceQuantities::operator==(const ResourceQuantities& that) const
+{
+  if (quantities.size() != that.quantities.size()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < quantities.size(); i++) {
+    if (less(quantities[i], that.quantities[i]) ||
+        less(that.quantities[i], quantities[i]) ||
+        quantities[i].value != that.quantities[i].value) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+bool ResourceQuantities::operator!=(const ResourceQuantities& that) const
+{
+  return !(*this == that);
+}
+
+
+ResourceQuantities ResourceQuantities::operator+(
+    const ResourceQuantities& that) const
+{
+  ResourceQuantities result = *this;
+  result += that;
+  return result;
+}
+
+
+ResourceQuantities& ResourceQuantities::operator+=(
+    const ResourceQuantities& that)
+{
+  vector<Quantity> result;
+  result.reserve(quantities.size() + that.quantities.size());
+
+  auto left = quantities.begin();
+  auto right = that.quantities.begin();
+
+  while (left != quantities.end() || right != that.quantities.end()) {
+    if (right == that.quantities.end() ||
+        (left != quantities.end() && less(*left, *right))) {
+      result.push_back(*left++);
+    } else if (left == quantities.end() || less(*right, *left)) {
+      result.push_back(*right++);
+    } else {
+      result.push_back(*left++);
+      result.back().value += (right++)->value;
+    }
+  }
+
+  quantities = std::move(result);
+
+  return *this;
+}
+
+
+ResourceQuantities ResourceQuantities::operator-(
+    const ResourceQuantities& that) const
+{
+  ResourceQuantities result = *this;
+  result -= that;
+  return result;
+}
+
+
+ResourceQuantities& ResourceQuantities::operator-=(
+    const ResourceQuantities& that)
+{
+  auto right = that.quantities.begin();
+
+  // Subtract in place and only keep the quantities that stay positive.
+  auto end = std::remove_if(
+      quantities.begin(),
+      quantities.end(),
+      [&](Quantity& quantity) {
+        while (right != that.quantities.end() && less(*right, quantity)) {
+          ++right;
+        }
+
+        if (right != that.quantities.end() && !less(quantity, *right)) {
+          quantity.value -= right->value;
+        }
+
+        return quantity.value <= 0;
+      });
+
+  quantities.erase(end, quantities.end());
+
+  return *this;
+}
+
+
+bool ResourceQuantities::less(const Quantity& left, const Quantity& right)
+{
+  return std::tie(left.name, left.role, left.revocable) <
+         std::tie(right.name, right.role, right.revocable);
+}
+
+
+void ResourceQuantities::add(const Quantity& quantity)
+{
+  if (quantity.value <= 0) {
+    return;
+  }
+
+  auto it = std::lower_bound(
+      quantities.begin(), quantities.end(), quantity, less);
+
+  if (it != quantities.end() && !less(quantity, *it)) {
+    it->value += quantity.value;
+  } else {
+    quantities.insert(it, quantity);
+  }
+}
+
+
+ostream& operator<<(ostream& stream, const ResourceQuantities& quantities)
+{
+  bool first = true;
+
+  foreach (const ResourceQuantities::Quantity& quantity,
+           quantities.quantities) {
+    if (!first) {
+      stream << "; ";
+    }
+
+    first = false;
+
+    stream << quantity.name << "(" << quantity.role << ")";
+
+    if (quantity.revocable) {
+      stream << "{REV}";
+    }
+
+    stream << ":" << convertToFloating(quantity.value);
+  }
+
+  return stream;
+}
+
+} // namespace internal {
+} // namespace mesos {
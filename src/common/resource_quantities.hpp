@@ -0,0 +1,108 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __RESOURCE_QUANTITIES_HPP__
+#define __RESOURCE_QUANTITIES_HPP__
+
+#include <stdint.h>
+
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <mesos/resources.hpp>
+
+namespace mesos {
+namespace internal {
+
+// The quantities of scalar resources, e.g., the total amount of cpus
+// and memory in a cluster. These are the same quantities as the ones
+// of `Resources::createStrippedScalarQuantity`, i.e., only the name,
+// role and revocability of the scalar resources are kept. However,
+// rather than in protobufs, the quantities are kept in a small sorted
+// vector with fixed-point values, which makes adding, subtracting and
+// comparing them a lot cheaper.
+class ResourceQuantities
+{
+public:
+  // Returns the quantities of the scalar resources in `resources`.
+  static ResourceQuantities fromScalarResources(const Resources& resources);
+
+  ResourceQuantities() {}
+
+  bool empty() const { return quantities.empty(); }
+
+  // Returns the names of the resources.
+  std::set<std::string> names() const;
+
+  // Returns the total quantity of the named resource across all roles,
+  // like `Resources::get<Value::Scalar>`, or 0 if there is none.
+  double get(const std::string& name) const;
+
+  // Returns the quantities with all of their roles set to `role`,
+  // which adds up the quantities that only differ by role.
+  ResourceQuantities flatten(const std::string& role = "*") const;
+
+  // Checks if each quantity in `that` is contained in these quantities.
+  bool contains(const ResourceQuantities& that) const;
+
+  bool operator==(const ResourceQuantities& that) const;
+  bool operator!=(const ResourceQuantities& that) const;
+
+  ResourceQuantities operator+(const ResourceQuantities& that) const;
+  ResourceQuantities& operator+=(const ResourceQuantities& that);
+
+  // NOTE: Like for `Resources`, quantities that would become zero
+  // or negative are removed.
+  ResourceQuantities operator-(const ResourceQuantities& that) const;
+  ResourceQuantities& operator-=(const ResourceQuantities& that);
+
+private:
+  friend std::ostream& operator<<(
+      std::ostream& stream,
+      const ResourceQuantities& quantities);
+
+  struct Quantity
+  {
+    std::string name;
+    std::string role;
+    bool revocable;
+
+    // The value in thousandths, which is the precision that the
+    // arithmetic of `Value::Scalar` uses as well.
+    int64_t value;
+  };
+
+  // Returns true if `left` sorts before `right`.
+  static bool less(const Quantity& left, const Quantity& right);
+
+  // Adds a quantity while keeping `quantities` sorted.
+  void add(const Quantity& quantity);
+
+  // Sorted by name, role and revocability, each of which is unique.
+  std::vector<Quantity> quantities;
+};
+
+
+std::ostream& operator<<(
+    std::ostream& stream,
+    const ResourceQuantities& quantities);
+
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __RESOURCE_QUANTITIES_HPP__
@@ -59,6 +59,19 @@ public:
       const Option<std::set<std::string>>&
         fairnessExcludeResourceNames = None());
 
+  void initialize(
+      const Duration& allocationInterval,
+      const lambda::function<
+          void(const FrameworkID&,
+               const hashmap<SlaveID, Resources>&)>& offerCallback,
+      const lambda::function<
+          void(const FrameworkID&,
+               const hashmap<SlaveID, UnavailableResources>&)>&
+        inverseOfferCallback,
+      const hashmap<std::string, double>& weights,
+      const Option<std::set<std::string>>& fairnessExcludeResourceNames,
+      const mesos::allocator::Options& options);
+
   void recover(
       const int expectedAgentCount,
       const hashmap<std::string, Quota>& quotas);
@@ -186,8 +199,8 @@ public:
                const hashmap<SlaveID, UnavailableResources>&)>&
         inverseOfferCallback,
       const hashmap<std::string, double>& weights,
-      const Option<std::set<std::string>>&
-        fairnessExcludeResourceNames = None()) = 0;
+      const Option<std::set<std::string>>& fairnessExcludeResourceNames,
+      const mesos::allocator::Options& options) = 0;
 
   virtual void recover(
       const int expectedAgentCount,
@@ -325,6 +338,30 @@ inline void MesosAllocator<AllocatorProcess>::initialize(
       inverseOfferCallback,
     const hashmap<std::string, double>& weights,
     const Option<std::set<std::string>>& fairnessExcludeResourceNames)
+{
+  initialize(
+      allocationInterval,
+      offerCallback,
+      inverseOfferCallback,
+      weights,
+      fairnessExcludeResourceNames,
+      mesos::allocator::Options());
+}
+
+
+template <typename AllocatorProcess>
+inline void MesosAllocator<AllocatorProcess>::initialize(
+    const Duration& allocationInterval,
+    const lambda::function<
+        void(const FrameworkID&,
+             const hashmap<SlaveID, Resources>&)>& offerCallback,
+    const lambda::function<
+        void(const FrameworkID&,
+              const hashmap<SlaveID, UnavailableResources>&)>&
+      inverseOfferCallback,
+    const hashmap<std::string, double>& weights,
+    const Option<std::set<std::string>>& fairnessExcludeResourceNames,
+    const mesos::allocator::Options& options)
 {
   process::dispatch(
       process,
@@ -333,7 +370,8 @@ inline void MesosAllocator<AllocatorProcess>::initialize(
       offerCallback,
       inverseOfferCallback,
       weights,
-      fairnessExcludeResourceNames);
+      fairnessExcludeResourceNames,
+      options);
 }
 
 
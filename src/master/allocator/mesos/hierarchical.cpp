@@ -17,15 +17,21 @@
 #include "master/allocator/mesos/hierarchical.hpp"
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <mesos/resources.hpp>
 #include <mesos/type_utils.hpp>
 
+#include <process/clock.hpp>
 #include <process/event.hpp>
 #include <process/delay.hpp>
+#include <process/dispatch.hpp>
 #include <process/id.hpp>
 #include <process/timeout.hpp>
 
@@ -35,6 +41,7 @@
 #include <stout/stringify.hpp>
 
 #include "common/protobuf_utils.hpp"
+#include "common/resource_quantities.hpp"
 
 using std::set;
 using std::string;
@@ -42,9 +49,11 @@ using std::vector;
 
 using mesos::allocator::InverseOfferStatus;
 
+using process::Clock;
 using process::Failure;
 using process::Future;
 using process::Owned;
+using process::Time;
 using process::Timeout;
 
 namespace mesos {
@@ -53,6 +62,11 @@ namespace master {
 namespace allocator {
 namespace internal {
 
+// Only every N-th offer filter check of an allocation run is timed, so
+// that the timing doesn't add much to the cost of the checks.
+static const size_t OFFER_FILTER_CHECK_SAMPLING = 16;
+
+
 // Used to represent "filters" for resources unused in offers.
 class OfferFilter
 {
@@ -83,6 +97,20 @@ private:
 };
 
 
+// Returns the number of offer filters that are installed on all slaves.
+static size_t offerFilterCount(
+    const hashmap<SlaveID, hashset<OfferFilter*>>& offerFilters)
+{
+  size_t result = 0;
+
+  foreachvalue (const hashset<OfferFilter*>& filters, offerFilters) {
+    result += filters.size();
+  }
+
+  return result;
+}
+
+
 // Used to represent "filters" for inverse offers.
 //
 // NOTE: Since this specific allocator implementation only sends inverse offers
@@ -120,6 +148,121 @@ private:
 };
 
 
+// A fixed set of threads that is used to run the shards of a
+// computation in parallel, so that the threads don't need to be
+// created for every allocation run.
+class WorkerPool
+{
+public:
+  explicit WorkerPool(size_t size) : pending(0), stopping(false)
+  {
+    threads.reserve(size);
+
+    for (size_t i = 0; i < size; i++) {
+      threads.emplace_back(&WorkerPool::loop, this);
+    }
+  }
+
+  ~WorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+
+    work.notify_all();
+
+    foreach (std::thread& thread, threads) {
+      thread.join();
+    }
+  }
+
+  // Runs the tasks on the threads of the pool and the calling thread,
+  // and returns once all of them are done.
+  void run(const vector<lambda::function<void()>>& tasks)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      foreach (const lambda::function<void()>& task, tasks) {
+        queue.push_back(task);
+      }
+
+      pending += tasks.size();
+    }
+
+    work.notify_all();
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // Help with the tasks rather than just waiting for them.
+    while (!queue.empty()) {
+      lambda::function<void()> task = std::move(queue.front());
+      queue.pop_front();
+
+      lock.unlock();
+      task();
+      lock.lock();
+
+      pending--;
+    }
+
+    done.wait(lock, [this]() { return pending == 0; });
+  }
+
+private:
+  void loop()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+      work.wait(lock, [this]() { return stopping || !queue.empty(); });
+
+      if (queue.empty()) {
+        return; // Stopping.
+      }
+
+      lambda::function<void()> task = std::move(queue.front());
+      queue.pop_front();
+
+      lock.unlock();
+      task();
+      lock.lock();
+
+      if (--pending == 0) {
+        done.notify_all();
+      }
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable work;
+  std::condition_variable done;
+
+  std::deque<lambda::function<void()>> queue;
+
+  // The number of tasks that were queued but are not done yet.
+  size_t pending;
+
+  bool stopping;
+
+  vector<std::thread> threads;
+};
+
+
+HierarchicalAllocatorProcess::~HierarchicalAllocatorProcess()
+{
+  // The offer filters that have not expired yet are only owned by
+  // `offerFilterExpiries`, see `expireOfferFilters()`.
+  foreachvalue (const vector<ExpiringOfferFilter>& expiring,
+                offerFilterExpiries) {
+    foreach (const ExpiringOfferFilter& filter, expiring) {
+      delete filter.offerFilter;
+    }
+  }
+}
+
+
 void HierarchicalAllocatorProcess::initialize(
     const Duration& _allocationInterval,
     const lambda::function<
@@ -130,16 +273,23 @@ void HierarchicalAllocatorProcess::initialize(
              const hashmap<SlaveID, UnavailableResources>&)>&
       _inverseOfferCallback,
     const hashmap<string, double>& _weights,
-    const Option<set<std::string>>& _fairnessExcludeResourceNames)
+    const Option<set<std::string>>& _fairnessExcludeResourceNames,
+    const mesos::allocator::Options& options)
 {
   allocationInterval = _allocationInterval;
   offerCallback = _offerCallback;
   inverseOfferCallback = _inverseOfferCallback;
   weights = _weights;
   fairnessExcludeResourceNames = _fairnessExcludeResourceNames;
+  allocationParallelism = std::max<size_t>(options.allocationParallelism, 1);
   initialized = true;
   paused = false;
 
+  // The calling thread computes a shard as well, see `computeAvailable()`.
+  if (allocationParallelism > 1) {
+    workers.reset(new WorkerPool(allocationParallelism - 1));
+  }
+
   // Resources for quota'ed roles are allocated separately and prior to
   // non-quota'ed roles, hence a dedicated sorter for quota'ed roles is
   // necessary.
@@ -148,6 +298,10 @@ void HierarchicalAllocatorProcess::initialize(
   quotaRoleSorter.reset(quotaRoleSorterFactory());
   quotaRoleSorter->initialize(fairnessExcludeResourceNames);
 
+  metrics.initialize(options.metricsStaleness);
+
+  exposeEventQueueSize("allocator/mesos/event_queue_size");
+
   VLOG(1) << "Initialized hierarchical allocator process";
 
   delay(allocationInterval, self(), &Self::batch);
@@ -327,7 +481,10 @@ void HierarchicalAllocatorProcess::removeFramework(
   // Do not delete the filters contained in this
   // framework's `offerFilters` hashset yet, see comments in
   // HierarchicalAllocatorProcess::reviveOffers and
-  // HierarchicalAllocatorProcess::expire.
+  // HierarchicalAllocatorProcess::expireOfferFilters.
+  metrics.offer_filters_active_total -=
+    offerFilterCount(frameworks[frameworkId].offerFilters);
+
   frameworks.erase(frameworkId);
 
   LOG(INFO) << "Removed framework " << frameworkId;
@@ -371,7 +528,10 @@ void HierarchicalAllocatorProcess::deactivateFramework(
   // Do not delete the filters contained in this
   // framework's `offerFilters` hashset yet, see comments in
   // HierarchicalAllocatorProcess::reviveOffers and
-  // HierarchicalAllocatorProcess::expire.
+  // HierarchicalAllocatorProcess::expireOfferFilters.
+  metrics.offer_filters_active_total -=
+    offerFilterCount(frameworks[frameworkId].offerFilters);
+
   frameworks[frameworkId].offerFilters.clear();
   frameworks[frameworkId].inverseOfferFilters.clear();
 
@@ -501,10 +661,11 @@ void HierarchicalAllocatorProcess::removeSlave(
   quotaRoleSorter->remove(slaveId, slaves[slaveId].total.nonRevocable());
 
   slaves.erase(slaveId);
+  allocationCandidates.erase(slaveId);
 
   // Note that we DO NOT actually delete any filters associated with
-  // this slave, that will occur when the delayed
-  // HierarchicalAllocatorProcess::expire gets invoked (or the framework
+  // this slave, that will occur when the filters expire in
+  // HierarchicalAllocatorProcess::expireOfferFilters (or the framework
   // that applied the filters gets removed).
 
   LOG(INFO) << "Removed agent " << slaveId;
@@ -966,12 +1127,7 @@ void HierarchicalAllocatorProcess::recoverResources(
     OfferFilter* offerFilter = new RefusedOfferFilter(resources);
     frameworks[frameworkId].offerFilters[slaveId].insert(offerFilter);
 
-    // We need to disambiguate the function call to pick the correct
-    // expire() overload.
-    void (Self::*expireOffer)(
-              const FrameworkID&,
-              const SlaveID&,
-              OfferFilter*) = &Self::expire;
+    metrics.offer_filters_active_total += 1;
 
     // Expire the filter after both an `allocationInterval` and the
     // `timeout` have elapsed. This ensures that the filter does not
@@ -982,12 +1138,16 @@ void HierarchicalAllocatorProcess::recoverResources(
     // (MESOS-3078), we would not need to increase the timeout here.
     timeout = std::max(allocationInterval, timeout.get());
 
-    delay(timeout.get(),
-          self(),
-          expireOffer,
-          frameworkId,
-          slaveId,
-          offerFilter);
+    const Time expiry = Clock::now() + timeout.get();
+
+    offerFilterExpiries[expiry].push_back({frameworkId, slaveId, offerFilter});
+
+    // Only the earliest expiry needs a timer, the timer of a later
+    // expiry gets set once the earlier filters have expired.
+    if (offerFilterExpiry.isNone() || expiry < offerFilterExpiry.get()) {
+      offerFilterExpiry = expiry;
+      delay(timeout.get(), self(), &Self::expireOfferFilters);
+    }
   }
 }
 
@@ -1008,16 +1168,19 @@ void HierarchicalAllocatorProcess::reviveOffers(
 {
   CHECK(initialized);
 
+  metrics.offer_filters_active_total -=
+    offerFilterCount(frameworks[frameworkId].offerFilters);
+
   frameworks[frameworkId].offerFilters.clear();
   frameworks[frameworkId].inverseOfferFilters.clear();
   frameworks[frameworkId].suppressed = false;
 
-  // We delete each actual `OfferFilter` when
-  // `HierarchicalAllocatorProcess::expire` gets invoked. If we delete the
+  // We delete each actual `OfferFilter` when it expires in
+  // `HierarchicalAllocatorProcess::expireOfferFilters`. If we delete the
   // `OfferFilter` here it's possible that the same `OfferFilter` (i.e., same
-  // address) could get reused and `HierarchicalAllocatorProcess::expire`
-  // would expire that filter too soon. Note that this only works
-  // right now because ALL Filter types "expire".
+  // address) could get reused and `expireOfferFilters` would expire
+  // that filter too soon. Note that this only works right now because
+  // ALL Filter types "expire".
 
   LOG(INFO) << "Removed offer filters for framework " << frameworkId;
 
@@ -1147,12 +1310,37 @@ void HierarchicalAllocatorProcess::resume()
 
 void HierarchicalAllocatorProcess::batch()
 {
-  allocate();
+  // NOTE: Rather than being coalesced, the batch allocation runs right
+  // away (and performs any allocation run that is pending) so that the
+  // offer filters that expire at the same time still get applied, see
+  // MESOS-4302.
+  if (!paused) {
+    ++metrics.allocation_requests;
+  }
+
+  allocationCandidates = slaves.keys();
+  _allocate();
+
   delay(allocationInterval, self(), &Self::batch);
 }
 
 
 void HierarchicalAllocatorProcess::allocate()
+{
+  allocate(slaves.keys());
+}
+
+
+void HierarchicalAllocatorProcess::allocate(
+    const SlaveID& slaveId)
+{
+  hashset<SlaveID> slaveIds({slaveId});
+  allocate(slaveIds);
+}
+
+
+void HierarchicalAllocatorProcess::allocate(
+    const hashset<SlaveID>& slaveIds)
 {
   if (paused) {
     VLOG(1) << "Skipped allocation because the allocator is paused";
@@ -1160,49 +1348,68 @@ void HierarchicalAllocatorProcess::allocate()
     return;
   }
 
-  Stopwatch stopwatch;
-  stopwatch.start();
-
-  metrics.allocation_run.start();
+  ++metrics.allocation_requests;
 
-  allocate(slaves.keys());
+  allocationCandidates.insert(slaveIds.begin(), slaveIds.end());
 
-  metrics.allocation_run.stop();
+  if (!allocationPending) {
+    allocationPending = true;
+    metrics.allocation_run_latency.start();
+  }
 
-  VLOG(1) << "Performed allocation for " << slaves.size() << " agents in "
-            << stopwatch.elapsed();
+  // NOTE: The allocation run gets queued behind the events that are
+  // already queued, so any allocations that they request are done by
+  // the same run.
+  coalesce(self(), "allocate", &Self::_allocate);
 }
 
 
-void HierarchicalAllocatorProcess::allocate(
-    const SlaveID& slaveId)
+void HierarchicalAllocatorProcess::_allocate()
 {
+  if (allocationPending) {
+    allocationPending = false;
+    metrics.allocation_run_latency.stop();
+  } else if (allocationCandidates.empty()) {
+    // A batch allocation has already performed the allocation run
+    // that was requested, see 'batch'.
+    return;
+  }
+
+  // NOTE: The allocator might have been paused since the allocation
+  // was requested.
   if (paused) {
     VLOG(1) << "Skipped allocation because the allocator is paused";
 
+    allocationCandidates.clear();
     return;
   }
 
   Stopwatch stopwatch;
   stopwatch.start();
+
   metrics.allocation_run.start();
 
-  hashset<SlaveID> slaves({slaveId});
-  allocate(slaves);
+  hashset<SlaveID> slaveIds;
+  std::swap(slaveIds, allocationCandidates);
+
+  __allocate(slaveIds);
 
   metrics.allocation_run.stop();
 
-  VLOG(1) << "Performed allocation for agent " << slaveId << " in "
+  VLOG(1) << "Performed allocation for " << slaveIds.size() << " agents in "
           << stopwatch.elapsed();
 }
 
 
 // TODO(alexr): Consider factoring out the quota allocation logic.
-void HierarchicalAllocatorProcess::allocate(
+void HierarchicalAllocatorProcess::__allocate(
     const hashset<SlaveID>& slaveIds_)
 {
   ++metrics.allocation_runs;
 
+  offerFilterCheckTime = Duration::zero();
+  offerFilterChecks = 0;
+
   // Compute the offerable resources, per framework:
   //   (1) For reserved resources on the slave, allocate these to a
   //       framework having the corresponding role.
@@ -1230,6 +1437,10 @@ void HierarchicalAllocatorProcess::allocate(
   // TODO(vinod): Implement a smarter sorting algorithm.
   std::random_shuffle(slaveIds.begin(), slaveIds.end());
 
+  // The available resources of each slave in `slaveIds`, which are
+  // updated as the resources get allocated.
+  vector<Available> available = computeAvailable(slaveIds);
+
   // Returns the __quantity__ of resources allocated to a quota role. Since we
   // account for reservations and persistent volumes toward quota, we strip
   // reservation and persistent volume related information for comparability.
@@ -1243,24 +1454,15 @@ void HierarchicalAllocatorProcess::allocate(
 
     // NOTE: `allocationScalarQuantities` omits dynamic reservation and
     // persistent volume info, but we additionally strip `role` here.
-    Resources resources;
-
-    foreach (Resource resource,
-             quotaRoleSorter->allocationScalarQuantities(role)) {
-      CHECK(!resource.has_reservation());
-      CHECK(!resource.has_disk());
-
-      resource.set_role("*");
-      resources += resource;
-    }
-
-    return resources;
+    return quotaRoleSorter->allocationScalarQuantities(role).flatten();
   };
 
   // Quota comes first and fair share second. Here we process only those
   // roles, for which quota is set (quota'ed roles). Such roles form a
   // special allocation group with a dedicated sorter.
-  foreach (const SlaveID& slaveId, slaveIds) {
+  for (size_t i = 0; i < slaveIds.size(); i++) {
+    const SlaveID& slaveId = slaveIds[i];
+
     foreach (const string& role, quotaRoleSorter->sort()) {
       CHECK(quotas.contains(role));
 
@@ -1272,7 +1474,8 @@ void HierarchicalAllocatorProcess::allocate(
 
       // Get the total quantity of resources allocated to a quota role. The
       // value omits role, reservation, and persistence info.
-      Resources roleConsumedResources = getQuotaRoleAllocatedResources(role);
+      ResourceQuantities roleConsumedResources =
+        getQuotaRoleAllocatedResources(role);
 
       // If quota for the role is satisfied, we do not need to do any further
       // allocations for this role, at least at this stage.
@@ -1281,7 +1484,9 @@ void HierarchicalAllocatorProcess::allocate(
       // alternatives are:
       //   * A custom sorter that is aware of quotas and sorts accordingly.
       //   * Removing satisfied roles from the sorter.
-      if (roleConsumedResources.contains(quotas[role].info.guarantee())) {
+      if (roleConsumedResources.contains(
+              ResourceQuantities::fromScalarResources(
+                  quotas[role].info.guarantee()))) {
         continue;
       }
 
@@ -1299,14 +1504,10 @@ void HierarchicalAllocatorProcess::allocate(
         // Only offer resources from slaves that have GPUs to
         // frameworks that are capable of receiving GPUs.
         // See MESOS-5634.
-        if (!frameworks[frameworkId].gpuAware &&
-            slaves[slaveId].total.gpus().getOrElse(0) > 0) {
+        if (!frameworks[frameworkId].gpuAware && available[i].gpus) {
           continue;
         }
 
-        // Calculate the currently available resources on the slave.
-        Resources available = slaves[slaveId].total - slaves[slaveId].allocated;
-
         // The resources we offer are the unreserved resources as well as the
         // reserved resources for this particular role. This is necessary to
         // ensure that we don't offer resources that are reserved for another
@@ -1321,7 +1522,9 @@ void HierarchicalAllocatorProcess::allocate(
         // were to rely on stage 2 to offer them out, they would not be checked
         // against the quota guarantee.
         Resources resources =
-          (available.unreserved() + available.reserved(role)).nonRevocable();
+          (available[i].unreserved +
+           available[i].reserved.get(role).getOrElse(Resources()))
+          .nonRevocable();
 
         // It is safe to break here, because all frameworks under a role would
         // consider the same resources, so in case we don't have allocatable
@@ -1350,6 +1553,8 @@ void HierarchicalAllocatorProcess::allocate(
         // quota. This is fine since quota currently represents a guarantee.
         offerable[frameworkId][slaveId] += resources;
         slaves[slaveId].allocated += resources;
+        available[i].unreserved -= resources.unreserved();
+        available[i].reserved[role] -= resources.reserved(role);
 
         // Resources allocated as part of the quota count towards the
         // role's and the framework's fair share.
@@ -1375,21 +1580,23 @@ void HierarchicalAllocatorProcess::allocate(
   // agents participating in the current allocation (i.e. provided as an
   // argument to the `allocate()` call) so that frameworks in roles without
   // quota are not unnecessarily deprived of resources.
-  Resources remainingClusterResources = roleSorter->totalScalarQuantities();
+  ResourceQuantities remainingClusterResources =
+    roleSorter->totalScalarQuantities();
   foreachkey (const string& role, activeRoles) {
     remainingClusterResources -= roleSorter->allocationScalarQuantities(role);
   }
 
   // Frameworks in a quota'ed role may temporarily reject resources by
   // filtering or suppressing offers. Hence quotas may not be fully allocated.
-  Resources unallocatedQuotaResources;
+  ResourceQuantities unallocatedQuotaResources;
   foreachpair (const string& name, const Quota& quota, quotas) {
     // Compute the amount of quota that the role does not have allocated.
     //
     // NOTE: Revocable resources are excluded in `quotaRoleSorter`.
     // NOTE: Only scalars are considered for quota.
-    Resources allocated = getQuotaRoleAllocatedResources(name);
-    const Resources required = quota.info.guarantee();
+    const ResourceQuantities allocated = getQuotaRoleAllocatedResources(name);
+    const ResourceQuantities required =
+      ResourceQuantities::fromScalarResources(quota.info.guarantee());
     unallocatedQuotaResources += (required - allocated);
   }
 
@@ -1412,12 +1619,14 @@ void HierarchicalAllocatorProcess::allocate(
   // information about dynamic reservations and persistent volumes for
   // performance reasons. This invariant is preserved because we only add
   // resources to it that have also had this metadata stripped from them
-  // (typically by using `Resources::createStrippedScalarQuantity`).
-  Resources allocatedStage2;
+  // (by using `ResourceQuantities::fromScalarResources`).
+  ResourceQuantities allocatedStage2;
 
   // At this point resources for quotas are allocated or accounted for.
   // Proceed with allocating the remaining free pool.
-  foreach (const SlaveID& slaveId, slaveIds) {
+  for (size_t i = 0; i < slaveIds.size(); i++) {
+    const SlaveID& slaveId = slaveIds[i];
+
     // If there are no resources available for the second stage, stop.
     if (!allocatable(remainingClusterResources - allocatedStage2)) {
       break;
@@ -1437,14 +1646,10 @@ void HierarchicalAllocatorProcess::allocate(
         // Only offer resources from slaves that have GPUs to
         // frameworks that are capable of receiving GPUs.
         // See MESOS-5634.
-        if (!frameworks[frameworkId].gpuAware &&
-            slaves[slaveId].total.gpus().getOrElse(0) > 0) {
+        if (!frameworks[frameworkId].gpuAware && available[i].gpus) {
           continue;
         }
 
-        // Calculate the currently available resources on the slave.
-        Resources available = slaves[slaveId].total - slaves[slaveId].allocated;
-
         // The resources we offer are the unreserved resources as well as the
         // reserved resources for this particular role. This is necessary to
         // ensure that we don't offer resources that are reserved for another
@@ -1459,9 +1664,11 @@ void HierarchicalAllocatorProcess::allocate(
         // allocation algorithm in stage 1.
         //
         // TODO(mpark): Offer unreserved resources as revocable beyond quota.
-        Resources resources = available.reserved(role);
+        Resources resources =
+          available[i].reserved.get(role).getOrElse(Resources());
+
         if (!quotas.contains(role)) {
-          resources += available.unreserved();
+          resources += available[i].unreserved;
         }
 
         // It is safe to break here, because all frameworks under a role would
@@ -1500,8 +1707,8 @@ void HierarchicalAllocatorProcess::allocate(
         // stage to use more than `remainingClusterResources`, move along.
         // We do not terminate early, as offers generated further in the
         // loop may be small enough to fit within `remainingClusterResources`.
-        const Resources scalarQuantity =
-          resources.createStrippedScalarQuantity();
+        const ResourceQuantities scalarQuantity =
+          ResourceQuantities::fromScalarResources(resources);
 
         if (!remainingClusterResources.contains(
                 allocatedStage2 + scalarQuantity)) {
@@ -1519,6 +1726,8 @@ void HierarchicalAllocatorProcess::allocate(
         offerable[frameworkId][slaveId] += resources;
         allocatedStage2 += scalarQuantity;
         slaves[slaveId].allocated += resources;
+        available[i].unreserved -= resources.unreserved();
+        available[i].reserved[role] -= resources.reserved(role);
 
         frameworkSorters[role]->add(slaveId, resources);
         frameworkSorters[role]->allocated(frameworkId_, slaveId, resources);
@@ -1533,6 +1742,18 @@ void HierarchicalAllocatorProcess::allocate(
     }
   }
 
+  // Extrapolate the time of the sampled checks to all the checks.
+  if (offerFilterChecks > 0) {
+    const size_t sampled =
+      (offerFilterChecks + OFFER_FILTER_CHECK_SAMPLING - 1) /
+      OFFER_FILTER_CHECK_SAMPLING;
+
+    metrics.offer_filter_check_time =
+      offerFilterCheckTime.ms() * offerFilterChecks / sampled;
+  } else {
+    metrics.offer_filter_check_time = 0;
+  }
+
   if (offerable.empty()) {
     VLOG(1) << "No allocations performed";
   } else {
@@ -1549,6 +1770,54 @@ void HierarchicalAllocatorProcess::allocate(
 }
 
 
+vector<HierarchicalAllocatorProcess::Available>
+HierarchicalAllocatorProcess::computeAvailable(
+    const vector<SlaveID>& slaveIds)
+{
+  vector<Available> result(slaveIds.size());
+
+  // Computes the available resources of the slaves in [begin, end).
+  auto compute = [this, &slaveIds, &result](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const Slave& slave = slaves.at(slaveIds[i]);
+
+      const Resources available = slave.total - slave.allocated;
+
+      result[i].unreserved = available.unreserved();
+      result[i].reserved = available.reservations();
+      result[i].gpus = slave.total.gpus().getOrElse(0) > 0;
+    }
+  };
+
+  const size_t shards = std::min(allocationParallelism, slaveIds.size());
+
+  if (shards <= 1) {
+    compute(0, slaveIds.size());
+    metrics.allocation_run_shards = 1;
+    return result;
+  }
+
+  const size_t shardSize = (slaveIds.size() + shards - 1) / shards;
+
+  // Each shard only writes its own entries of `result`.
+  vector<lambda::function<void()>> tasks;
+  tasks.reserve(shards);
+
+  for (size_t shard = 0; shard < shards; shard++) {
+    const size_t begin = std::min(shard * shardSize, slaveIds.size());
+    const size_t end = std::min(begin + shardSize, slaveIds.size());
+
+    tasks.push_back([&compute, begin, end]() { compute(begin, end); });
+  }
+
+  workers->run(tasks);
+
+  metrics.allocation_run_shards = shards;
+
+  return result;
+}
+
+
 void HierarchicalAllocatorProcess::deallocate(
     const hashset<SlaveID>& slaveIds_)
 {
@@ -1639,26 +1908,53 @@ void HierarchicalAllocatorProcess::deallocate(
 }
 
 
-void HierarchicalAllocatorProcess::expire(
-    const FrameworkID& frameworkId,
-    const SlaveID& slaveId,
-    OfferFilter* offerFilter)
+void HierarchicalAllocatorProcess::expireOfferFilters()
 {
-  // The filter might have already been removed (e.g., if the
-  // framework no longer exists or in
-  // HierarchicalAllocatorProcess::reviveOffers) but not yet deleted (to
-  // keep the address from getting reused possibly causing premature
-  // expiration).
-  if (frameworks.contains(frameworkId) &&
-      frameworks[frameworkId].offerFilters.contains(slaveId) &&
-      frameworks[frameworkId].offerFilters[slaveId].contains(offerFilter)) {
-    frameworks[frameworkId].offerFilters[slaveId].erase(offerFilter);
-    if (frameworks[frameworkId].offerFilters[slaveId].empty()) {
-      frameworks[frameworkId].offerFilters.erase(slaveId);
+  const Time now = Clock::now();
+
+  // NOTE: A timer that got superseded by the timer of an earlier expiry
+  // still fires, in which case it removes whatever has expired by then.
+  if (offerFilterExpiry.isSome() && offerFilterExpiry.get() <= now) {
+    offerFilterExpiry = None();
+  }
+
+  while (!offerFilterExpiries.empty() &&
+         offerFilterExpiries.begin()->first <= now) {
+    foreach (const ExpiringOfferFilter& expiring,
+             offerFilterExpiries.begin()->second) {
+      const FrameworkID& frameworkId = expiring.frameworkId;
+      const SlaveID& slaveId = expiring.slaveId;
+
+      // The filter might have already been removed (e.g., if the
+      // framework no longer exists or in
+      // HierarchicalAllocatorProcess::reviveOffers) but not yet deleted
+      // (to keep the address from getting reused possibly causing
+      // premature expiration).
+      if (frameworks.contains(frameworkId) &&
+          frameworks[frameworkId].offerFilters.contains(slaveId) &&
+          frameworks[frameworkId].offerFilters[slaveId]
+            .contains(expiring.offerFilter)) {
+        frameworks[frameworkId].offerFilters[slaveId]
+          .erase(expiring.offerFilter);
+
+        if (frameworks[frameworkId].offerFilters[slaveId].empty()) {
+          frameworks[frameworkId].offerFilters.erase(slaveId);
+        }
+
+        metrics.offer_filters_active_total -= 1;
+      }
+
+      delete expiring.offerFilter;
     }
+
+    offerFilterExpiries.erase(offerFilterExpiries.begin());
   }
 
-  delete offerFilter;
+  if (!offerFilterExpiries.empty() && offerFilterExpiry.isNone()) {
+    offerFilterExpiry = offerFilterExpiries.begin()->first;
+
+    delay(offerFilterExpiry.get() - now, self(), &Self::expireOfferFilters);
+  }
 }
 
 
@@ -1716,20 +2012,40 @@ bool HierarchicalAllocatorProcess::isFiltered(
   CHECK(frameworks.contains(frameworkId));
   CHECK(slaves.contains(slaveId));
 
-  if (frameworks[frameworkId].offerFilters.contains(slaveId)) {
-    foreach (
-      OfferFilter* offerFilter, frameworks[frameworkId].offerFilters[slaveId]) {
+  const bool sampled =
+    offerFilterChecks++ % OFFER_FILTER_CHECK_SAMPLING == 0;
+
+  Stopwatch stopwatch;
+
+  if (sampled) {
+    stopwatch.start();
+  }
+
+  bool filtered = false;
+
+  const hashmap<SlaveID, hashset<OfferFilter*>>& offerFilters =
+    frameworks[frameworkId].offerFilters;
+
+  auto filters = offerFilters.find(slaveId);
+
+  if (filters != offerFilters.end()) {
+    foreach (OfferFilter* offerFilter, filters->second) {
       if (offerFilter->filter(resources)) {
         VLOG(1) << "Filtered offer with " << resources
                 << " on agent " << slaveId
                 << " for framework " << frameworkId;
 
-        return true;
+        filtered = true;
+        break;
       }
     }
   }
 
-  return false;
+  if (sampled) {
+    offerFilterCheckTime += stopwatch.elapsed();
+  }
+
+  return filtered;
 }
 
 
@@ -1768,6 +2084,14 @@ bool HierarchicalAllocatorProcess::allocatable(
 }
 
 
+bool HierarchicalAllocatorProcess::allocatable(
+    const ResourceQuantities& quantities)
+{
+  return quantities.get("cpus") >= MIN_CPUS ||
+         Megabytes(static_cast<uint64_t>(quantities.get("mem"))) >= MIN_MEM;
+}
+
+
 double HierarchicalAllocatorProcess::_resources_offered_or_allocated(
     const string& resource)
 {
@@ -1789,11 +2113,7 @@ double HierarchicalAllocatorProcess::_resources_offered_or_allocated(
 double HierarchicalAllocatorProcess::_resources_total(
     const string& resource)
 {
-  Option<Value::Scalar> total =
-    roleSorter->totalScalarQuantities()
-      .get<Value::Scalar>(resource);
-
-  return total.isSome() ? total->value() : 0;
+  return roleSorter->totalScalarQuantities().get(resource);
 }
 
 
@@ -1801,11 +2121,7 @@ double HierarchicalAllocatorProcess::_quota_allocated(
     const string& role,
     const string& resource)
 {
-  Option<Value::Scalar> used =
-    quotaRoleSorter->allocationScalarQuantities(role)
-      .get<Value::Scalar>(resource);
-
-  return used.isSome() ? used->value() : 0;
+  return quotaRoleSorter->allocationScalarQuantities(role).get(resource);
 }
 
 
@@ -1819,9 +2135,7 @@ double HierarchicalAllocatorProcess::_offer_filters_active(
       continue;
     }
 
-    foreachkey (const SlaveID& slaveId, framework.offerFilters) {
-      result += framework.offerFilters.get(slaveId)->size();
-    }
+    result += offerFilterCount(framework.offerFilters);
   }
 
   return result;
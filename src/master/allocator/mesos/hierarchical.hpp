@@ -17,14 +17,17 @@
 #ifndef __MASTER_ALLOCATOR_MESOS_HIERARCHICAL_HPP__
 #define __MASTER_ALLOCATOR_MESOS_HIERARCHICAL_HPP__
 
+#include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include <mesos/mesos.hpp>
 
 #include <process/future.hpp>
 #include <process/id.hpp>
 #include <process/owned.hpp>
+#include <process/time.hpp>
 
 #include <stout/duration.hpp>
 #include <stout/hashmap.hpp>
@@ -32,6 +35,8 @@
 #include <stout/lambda.hpp>
 #include <stout/option.hpp>
 
+#include "common/resource_quantities.hpp"
+
 #include "master/allocator/mesos/allocator.hpp"
 #include "master/allocator/mesos/metrics.hpp"
 
@@ -64,6 +69,7 @@ namespace internal {
 // Forward declarations.
 class OfferFilter;
 class InverseOfferFilter;
+class WorkerPool;
 
 
 // Implements the basic allocator algorithm - first pick a role by
@@ -78,6 +84,9 @@ public:
     : ProcessBase(process::ID::generate("hierarchical-allocator")),
       initialized(false),
       paused(true),
+      allocationPending(false),
+      allocationParallelism(1),
+      offerFilterChecks(0),
       metrics(*this),
       roleSorter(nullptr),
       quotaRoleSorter(nullptr),
@@ -85,7 +94,7 @@ public:
       frameworkSorterFactory(_frameworkSorterFactory),
       quotaRoleSorterFactory(_quotaRoleSorterFactory) {}
 
-  virtual ~HierarchicalAllocatorProcess() {}
+  virtual ~HierarchicalAllocatorProcess();
 
   process::PID<HierarchicalAllocatorProcess> self() const
   {
@@ -102,8 +111,8 @@ public:
                const hashmap<SlaveID, UnavailableResources>&)>&
         inverseOfferCallback,
       const hashmap<std::string, double>& weights,
-      const Option<std::set<std::string>>&
-        fairnessExcludeResourceNames = None());
+      const Option<std::set<std::string>>& fairnessExcludeResourceNames,
+      const mesos::allocator::Options& options);
 
   void recover(
       const int _expectedAgentCount,
@@ -219,17 +228,46 @@ protected:
   // Allocate resources just from the specified slave.
   void allocate(const SlaveID& slaveId);
 
-  // Allocate resources from the specified slaves.
+  // Allocate resources from the specified slaves. Rather than running
+  // the allocation algorithm right away, the slaves are added to the
+  // allocation candidates and a single allocation run gets dispatched
+  // for all the allocations that are requested until it runs (e.g.,
+  // by a burst of slaves re-registering after a master failover).
   void allocate(const hashset<SlaveID>& slaveIds);
 
+  // Runs the allocation algorithm for the allocation candidates.
+  void _allocate();
+
+  // Allocation algorithm for the specified slaves.
+  void __allocate(const hashset<SlaveID>& slaveIds);
+
+  // The resources that are available on a slave during an allocation
+  // run, split into the unreserved and the reserved resources of each
+  // role so that they don't need to be computed again for every role
+  // and framework that is considered for the slave.
+  struct Available
+  {
+    Resources unreserved;
+    hashmap<std::string, Resources> reserved;
+
+    // Whether the slave has GPUs, see MESOS-5634.
+    bool gpus;
+  };
+
+  // Computes the available resources of the specified slaves. The
+  // slaves are split into `allocationParallelism` shards which are
+  // computed on the calling thread and the threads of `workers`.
+  //
+  // NOTE: This only reads the allocator's state, which is not modified
+  // until all the shards are done.
+  std::vector<Available> computeAvailable(
+      const std::vector<SlaveID>& slaveIds);
+
   // Send inverse offers from the specified slaves.
   void deallocate(const hashset<SlaveID>& slaveIds);
 
-  // Remove an offer filter for the specified framework.
-  void expire(
-      const FrameworkID& frameworkId,
-      const SlaveID& slaveId,
-      OfferFilter* offerFilter);
+  // Remove the offer filters that have expired by now.
+  void expireOfferFilters();
 
   // Remove an inverse offer filter for the specified framework.
   void expire(
@@ -257,15 +295,55 @@ protected:
       const SlaveID& slaveID);
 
   bool allocatable(const Resources& resources);
+  bool allocatable(const ResourceQuantities& quantities);
 
   bool initialized;
   bool paused;
 
+  // Slaves to allocate resources from in the next allocation run.
+  hashset<SlaveID> allocationCandidates;
+
+  // Whether an allocation run has been requested but not run yet.
+  bool allocationPending;
+
   // Recovery data.
   Option<int> expectedAgentCount;
 
   Duration allocationInterval;
 
+  // Number of threads used to compute the available resources of the
+  // slaves in an allocation run.
+  size_t allocationParallelism;
+
+  // The threads that compute all but one of the shards in
+  // `computeAvailable()`, if the allocation parallelism is above 1.
+  process::Owned<WorkerPool> workers;
+
+  // An offer filter that is installed for a framework on a slave.
+  struct ExpiringOfferFilter
+  {
+    FrameworkID frameworkId;
+    SlaveID slaveId;
+    OfferFilter* offerFilter;
+  };
+
+  // The offer filters by the time that they expire. Rather than having
+  // a timer for each filter, there is a timer for the earliest expiry
+  // only, which removes all the filters that have expired by then.
+  //
+  // NOTE: The filters are deleted once they expire, even if they were
+  // removed from their framework before, see `reviveOffers()`.
+  std::map<process::Time, std::vector<ExpiringOfferFilter>>
+    offerFilterExpiries;
+
+  // The time of the earliest pending timer to expire offer filters.
+  Option<process::Time> offerFilterExpiry;
+
+  // Time spent in the sampled offer filter checks of the current
+  // allocation run, and the number of all the checks in the run.
+  Duration offerFilterCheckTime;
+  size_t offerFilterChecks;
+
   lambda::function<
       void(const FrameworkID&,
            const hashmap<SlaveID, Resources>&)> offerCallback;
@@ -45,12 +45,28 @@ Metrics::Metrics(const HierarchicalAllocatorProcess& _allocator)
         process::defer(
             allocator, &HierarchicalAllocatorProcess::_event_queue_dispatches)),
     allocation_runs("allocator/mesos/allocation_runs"),
-    allocation_run("allocator/mesos/allocation_run", Hours(1))
+    allocation_requests("allocator/mesos/allocation_requests"),
+    allocation_run("allocator/mesos/allocation_run", Hours(1)),
+    allocation_run_latency("allocator/mesos/allocation_run_latency", Hours(1)),
+    offer_filters_active_total("allocator/mesos/offer_filters/active"),
+    offer_filter_check_time("allocator/mesos/offer_filters/check_time_ms"),
+    allocation_run_shards("allocator/mesos/allocation_run_shards")
 {
   process::metrics::add(event_queue_dispatches);
   process::metrics::add(event_queue_dispatches_);
   process::metrics::add(allocation_runs);
+  process::metrics::add(allocation_requests);
   process::metrics::add(allocation_run);
+  process::metrics::add(allocation_run_latency);
+  process::metrics::add(offer_filters_active_total);
+  process::metrics::add(offer_filter_check_time);
+  process::metrics::add(allocation_run_shards);
+}
+
+
+void Metrics::initialize(const Option<Duration>& _staleness)
+{
+  staleness = _staleness;
 
   // Create and install gauges for the total and allocated
   // amount of standard scalar resources.
@@ -66,13 +82,15 @@ Metrics::Metrics(const HierarchicalAllocatorProcess& _allocator)
         "allocator/mesos/resources/" + resource + "/total",
         defer(allocator,
               &HierarchicalAllocatorProcess::_resources_total,
-              resource));
+              resource),
+        staleness);
 
     Gauge offered_or_allocated(
         "allocator/mesos/resources/" + resource + "/offered_or_allocated",
         defer(allocator,
               &HierarchicalAllocatorProcess::_resources_offered_or_allocated,
-              resource));
+              resource),
+        staleness);
 
     resources_total.push_back(total);
     resources_offered_or_allocated.push_back(offered_or_allocated);
@@ -88,7 +106,12 @@ Metrics::~Metrics()
   process::metrics::remove(event_queue_dispatches);
   process::metrics::remove(event_queue_dispatches_);
   process::metrics::remove(allocation_runs);
+  process::metrics::remove(allocation_requests);
   process::metrics::remove(allocation_run);
+  process::metrics::remove(allocation_run_latency);
+  process::metrics::remove(offer_filters_active_total);
+  process::metrics::remove(offer_filter_check_time);
+  process::metrics::remove(allocation_run_shards);
 
   foreach (const Gauge& gauge, resources_total) {
     process::metrics::remove(gauge);
@@ -142,7 +165,8 @@ void Metrics::setQuota(const string& role, const Quota& quota)
         defer(allocator,
               &HierarchicalAllocatorProcess::_quota_allocated,
               role,
-              resource.name()));
+              resource.name()),
+        staleness);
 
     guarantees.put(resource.name(), guarantee);
     allocated.put(resource.name(), offered_or_allocated);
@@ -176,7 +200,8 @@ void Metrics::addRole(const string& role)
       "allocator/mesos/offer_filters/roles/" + role + "/active",
       defer(allocator,
             &HierarchicalAllocatorProcess::_offer_filters_active,
-            role));
+            role),
+      staleness);
 
   offer_filters_active.put(role, gauge);
 
@@ -26,7 +26,9 @@
 
 #include <process/pid.hpp>
 
+#include <stout/duration.hpp>
 #include <stout/hashmap.hpp>
+#include <stout/option.hpp>
 
 namespace mesos {
 namespace internal {
@@ -45,6 +47,11 @@ struct Metrics
 
   ~Metrics();
 
+  // Installs the gauges of the resources in the cluster. The gauges
+  // that are expensive to compute, including the per-role gauges that
+  // are installed afterwards, reuse their values for `staleness`.
+  void initialize(const Option<Duration>& staleness);
+
   void setQuota(const std::string& role, const Quota& quota);
   void removeQuota(const std::string& role);
 
@@ -53,6 +60,8 @@ struct Metrics
 
   const process::PID<HierarchicalAllocatorProcess> allocator;
 
+  Option<Duration> staleness;
+
   // Number of dispatch events currently waiting in the allocator process.
   process::metrics::Gauge event_queue_dispatches;
 
@@ -64,9 +73,16 @@ struct Metrics
   // Number of times the allocation algorithm has run.
   process::metrics::Counter allocation_runs;
 
+  // Number of allocations that have been requested, which get
+  // coalesced into fewer allocation runs.
+  process::metrics::Counter allocation_requests;
+
   // Latency of the allocation algorithm.
   process::metrics::Timer<Milliseconds> allocation_run;
 
+  // Time from the first request for an allocation run until it runs.
+  process::metrics::Timer<Milliseconds> allocation_run_latency;
+
   // Gauges for the total amount of each resource in the cluster.
   std::vector<process::metrics::Gauge> resources_total;
 
@@ -83,6 +99,17 @@ struct Metrics
 
   // Gauges for the per-role count of active offer filters.
   hashmap<std::string, process::metrics::Gauge> offer_filters_active;
+
+  // Total count of active offer filters.
+  process::metrics::PushGauge offer_filters_active_total;
+
+  // Time spent checking offer filters in the last allocation run,
+  // estimated from a sample of the checks.
+  process::metrics::PushGauge offer_filter_check_time;
+
+  // Number of shards that the last allocation run computed the
+  // available resources in (see `--allocation_parallelism`).
+  process::metrics::PushGauge allocation_run_shards;
 };
 
 } // namespace internal {
@@ -15,9 +15,10 @@
 // limitations under the License.
 
 #include <algorithm>
-#include <list>
+#include <iterator>
 #include <set>
 #include <string>
+#include <vector>
 
 #include <mesos/mesos.hpp>
 #include <mesos/resources.hpp>
@@ -32,9 +33,9 @@
 
 #include "master/allocator/sorter/drf/sorter.hpp"
 
-using std::list;
 using std::set;
 using std::string;
+using std::vector;
 
 using process::UPID;
 
@@ -73,7 +74,7 @@ void DRFSorter::add(const string& name, double weight)
   CHECK(!contains(name));
 
   Client client(name, 0, 0);
-  clients.insert(client);
+  insert(client);
 
   allocations[name] = Allocation();
   weights[name] = weight;
@@ -103,7 +104,7 @@ void DRFSorter::remove(const string& name)
   set<Client, DRFComparator>::iterator it = find(name);
 
   if (it != clients.end()) {
-    clients.erase(it);
+    erase(it);
   }
 
   allocations.erase(name);
@@ -122,7 +123,7 @@ void DRFSorter::activate(const string& name)
   set<Client, DRFComparator>::iterator it = find(name);
   if (it == clients.end()) {
     Client client(name, calculateShare(name), 0);
-    clients.insert(client);
+    insert(client);
   }
 }
 
@@ -136,7 +137,7 @@ void DRFSorter::deactivate(const string& name)
     // because we lose information such as the number of allocations
     // for this client which means the fairness can be gamed by a
     // framework disconnecting and reconnecting.
-    clients.erase(it);
+    erase(it);
   }
 }
 
@@ -155,14 +156,12 @@ void DRFSorter::allocated(
     // Update the 'allocations' to reflect the allocator decision.
     client.allocations++;
 
-    // Remove and reinsert it to update the ordering appropriately.
-    clients.erase(it);
-    clients.insert(client);
+    reposition(it, client);
   }
 
   allocations[name].resources[slaveId] += resources;
   allocations[name].scalarQuantities +=
-    resources.createStrippedScalarQuantity();
+    ResourceQuantities::fromScalarResources(resources);
 
   // If the total resources have changed, we're going to
   // recalculate all the shares, so don't bother just
@@ -186,10 +185,10 @@ void DRFSorter::update(
   // Otherwise, we need to ensure we re-calculate the shares, as
   // is being currently done, for safety.
 
-  const Resources oldAllocationQuantity =
-    oldAllocation.createStrippedScalarQuantity();
-  const Resources newAllocationQuantity =
-    newAllocation.createStrippedScalarQuantity();
+  const ResourceQuantities oldAllocationQuantity =
+    ResourceQuantities::fromScalarResources(oldAllocation);
+  const ResourceQuantities newAllocationQuantity =
+    ResourceQuantities::fromScalarResources(newAllocation);
 
   CHECK(allocations[name].resources[slaveId].contains(oldAllocation));
   CHECK(allocations[name].scalarQuantities.contains(oldAllocationQuantity));
@@ -213,7 +212,8 @@ const hashmap<SlaveID, Resources>& DRFSorter::allocation(const string& name)
 }
 
 
-const Resources& DRFSorter::allocationScalarQuantities(const string& name)
+const ResourceQuantities& DRFSorter::allocationScalarQuantities(
+    const string& name)
 {
   CHECK(contains(name));
 
@@ -253,7 +253,7 @@ Resources DRFSorter::allocation(const string& name, const SlaveID& slaveId)
 }
 
 
-const Resources& DRFSorter::totalScalarQuantities() const
+const ResourceQuantities& DRFSorter::totalScalarQuantities() const
 {
   return total_.scalarQuantities;
 }
@@ -264,7 +264,8 @@ void DRFSorter::unallocated(
     const SlaveID& slaveId,
     const Resources& resources)
 {
-  const Resources resourcesQuantity = resources.createStrippedScalarQuantity();
+  const ResourceQuantities resourcesQuantity =
+    ResourceQuantities::fromScalarResources(resources);
 
   CHECK(allocations[name].resources[slaveId].contains(resources));
   CHECK(allocations[name].scalarQuantities.contains(resourcesQuantity));
@@ -285,7 +286,8 @@ void DRFSorter::unallocated(
 void DRFSorter::add(const SlaveID& slaveId, const Resources& resources)
 {
   if (!resources.empty()) {
-    total_.scalarQuantities += resources.createStrippedScalarQuantity();
+    total_.scalarQuantities +=
+      ResourceQuantities::fromScalarResources(resources);
 
     // We have to recalculate all shares when the total resources
     // change, but we put it off until sort is called so that if
@@ -299,8 +301,8 @@ void DRFSorter::add(const SlaveID& slaveId, const Resources& resources)
 void DRFSorter::remove(const SlaveID& slaveId, const Resources& resources)
 {
   if (!resources.empty()) {
-    const Resources resourcesQuantity =
-      resources.createStrippedScalarQuantity();
+    const ResourceQuantities resourcesQuantity =
+      ResourceQuantities::fromScalarResources(resources);
 
     CHECK(total_.scalarQuantities.contains(resourcesQuantity));
     total_.scalarQuantities -= resourcesQuantity;
@@ -310,7 +312,7 @@ void DRFSorter::remove(const SlaveID& slaveId, const Resources& resources)
 }
 
 
-list<string> DRFSorter::sort()
+const vector<string>& DRFSorter::sort()
 {
   if (dirty) {
     set<Client, DRFComparator> temp;
@@ -327,19 +329,31 @@ list<string> DRFSorter::sort()
 
     clients = temp;
 
+    index.clear();
+    for (it = clients.begin(); it != clients.end(); it++) {
+      index[(*it).name] = it;
+    }
+
     // Reset dirty to false so as not to re-calculate *all*
     // shares unless another dirtying operation occurs.
     dirty = false;
+    reordered = true;
   }
 
-  list<string> result;
+  if (reordered) {
+    // NOTE: We assign the names in place rather than rebuilding
+    // 'sorted' so that the strings can reuse their storage.
+    sorted.resize(clients.size());
 
-  set<Client, DRFComparator>::iterator it;
-  for (it = clients.begin(); it != clients.end(); it++) {
-    result.push_back((*it).name);
+    size_t i = 0;
+    foreach (const Client& client, clients) {
+      sorted[i++] = client.name;
+    }
+
+    reordered = false;
   }
 
-  return result;
+  return sorted;
 }
 
 
@@ -365,9 +379,7 @@ void DRFSorter::update(const string& name)
     // Update the 'share' to get proper sorting.
     client.share = calculateShare(client.name);
 
-    // Remove and reinsert it to update the ordering appropriately.
-    clients.erase(it);
-    clients.insert(client);
+    reposition(it, client);
   }
 }
 
@@ -387,35 +399,13 @@ double DRFSorter::calculateShare(const string& name)
       continue;
     }
 
-    // We collect the scalar accumulated total value from the
-    // `Resources` object.
-    //
-    // NOTE: Although in principle scalar resources may be spread
-    // across multiple `Resource` objects (e.g., persistent volumes),
-    // we currently strip persistence and reservation metadata from
-    // the resources in `scalarQuantities`.
-    Option<Value::Scalar> __total =
-      total_.scalarQuantities.get<Value::Scalar>(scalar);
-
-    CHECK_SOME(__total);
-    const double _total = __total.get().value();
+    // NOTE: The quantities of a resource may still be spread across
+    // roles and revocability, `get` adds them up.
+    const double _total = total_.scalarQuantities.get(scalar);
 
     if (_total > 0.0) {
-      double allocation = 0.0;
-
-      // We collect the scalar accumulated allocation value from the
-      // `Resources` object.
-      //
-      // NOTE: Although in principle scalar resources may be spread
-      // across multiple `Resource` objects (e.g., persistent volumes),
-      // we currently strip persistence and reservation metadata from
-      // the resources in `scalarQuantities`.
-      Option<Value::Scalar> _allocation =
-        allocations[name].scalarQuantities.get<Value::Scalar>(scalar);
-
-      if (_allocation.isSome()) {
-        allocation = _allocation.get().value();
-      }
+      const double allocation =
+        allocations[name].scalarQuantities.get(scalar);
 
       share = std::max(share, allocation / _total);
     }
@@ -427,14 +417,50 @@ double DRFSorter::calculateShare(const string& name)
 
 set<Client, DRFComparator>::iterator DRFSorter::find(const string& name)
 {
-  set<Client, DRFComparator>::iterator it;
-  for (it = clients.begin(); it != clients.end(); it++) {
-    if (name == (*it).name) {
-      break;
-    }
+  Option<set<Client, DRFComparator>::iterator> it = index.get(name);
+
+  if (it.isNone()) {
+    return clients.end();
   }
 
-  return it;
+  return it.get();
+}
+
+
+void DRFSorter::insert(const Client& client)
+{
+  index[client.name] = clients.insert(client).first;
+
+  reordered = true;
+}
+
+
+void DRFSorter::erase(set<Client, DRFComparator>::iterator it)
+{
+  index.erase((*it).name);
+  clients.erase(it);
+
+  reordered = true;
+}
+
+
+void DRFSorter::reposition(
+    set<Client, DRFComparator>::iterator it,
+    const Client& client)
+{
+  // The client keeps its position if it ends up in front of the same
+  // client as before, in which case the order hasn't changed.
+  set<Client, DRFComparator>::iterator next = std::next(it);
+
+  // Remove and reinsert it to update the ordering appropriately.
+  clients.erase(it);
+  it = clients.insert(client).first;
+
+  index[client.name] = it;
+
+  if (std::next(it) != next) {
+    reordered = true;
+  }
 }
 
 } // namespace allocator {
@@ -19,6 +19,7 @@
 
 #include <set>
 #include <string>
+#include <vector>
 
 #include <mesos/mesos.hpp>
 #include <mesos/resources.hpp>
@@ -26,6 +27,8 @@
 #include <stout/hashmap.hpp>
 #include <stout/option.hpp>
 
+#include "common/resource_quantities.hpp"
+
 #include "master/allocator/sorter/drf/metrics.hpp"
 
 #include "master/allocator/sorter/sorter.hpp"
@@ -105,19 +108,20 @@ public:
   virtual const hashmap<SlaveID, Resources>& allocation(
       const std::string& name);
 
-  virtual const Resources& allocationScalarQuantities(const std::string& name);
+  virtual const ResourceQuantities& allocationScalarQuantities(
+      const std::string& name);
 
   virtual hashmap<std::string, Resources> allocation(const SlaveID& slaveId);
 
   virtual Resources allocation(const std::string& name, const SlaveID& slaveId);
 
-  virtual const Resources& totalScalarQuantities() const;
+  virtual const ResourceQuantities& totalScalarQuantities() const;
 
   virtual void add(const SlaveID& slaveId, const Resources& resources);
 
   virtual void remove(const SlaveID& slaveId, const Resources& resources);
 
-  virtual std::list<std::string> sort();
+  virtual const std::vector<std::string>& sort();
 
   virtual bool contains(const std::string& name);
 
@@ -138,12 +142,35 @@ private:
   // it exists in this Sorter.
   std::set<Client, DRFComparator>::iterator find(const std::string& name);
 
+  // Inserts the client into 'clients'.
+  void insert(const Client& client);
+
+  // Removes the client from 'clients'.
+  void erase(std::set<Client, DRFComparator>::iterator it);
+
+  // Replaces the client with the updated one, which moves it in
+  // 'clients' if its position in the sort order changed.
+  void reposition(
+      std::set<Client, DRFComparator>::iterator it,
+      const Client& client);
+
   // If true, sort() will recalculate all shares.
   bool dirty = false;
 
   // A set of Clients (names and shares) sorted by share.
   std::set<Client, DRFComparator> clients;
 
+  // Maps client names to their entries in 'clients', so that a client
+  // can be found without going through all of them.
+  hashmap<std::string, std::set<Client, DRFComparator>::iterator> index;
+
+  // The names of the clients in 'clients' as of the last call to
+  // sort(), which only rebuilds them if the order has changed since.
+  std::vector<std::string> sorted;
+
+  // If true, sort() will rebuild 'sorted'.
+  bool reordered = false;
+
   // Maps client names to the weights that should be applied to their shares.
   hashmap<std::string, double> weights;
 
@@ -156,7 +183,7 @@ private:
     // NOTE: We omit information about dynamic reservations and persistent
     // volumes here to enable resources to be aggregated across slaves
     // more effectively. See MESOS-4833 for more information.
-    Resources scalarQuantities;
+    ResourceQuantities scalarQuantities;
   } total_;
 
   // Allocation for a client.
@@ -165,7 +192,7 @@ private:
 
     // Similarly, we aggregate scalars across slaves and omit information
     // about dynamic reservations and persistent volumes. See notes above.
-    Resources scalarQuantities;
+    ResourceQuantities scalarQuantities;
   };
 
   // Maps client names to the resources they have been allocated.
@@ -18,14 +18,16 @@
 #define __MASTER_ALLOCATOR_SORTER_SORTER_HPP__
 
 #include <functional>
-#include <list>
 #include <string>
+#include <vector>
 
 #include <mesos/resources.hpp>
 #include <mesos/type_utils.hpp>
 
 #include <process/pid.hpp>
 
+#include "common/resource_quantities.hpp"
+
 namespace mesos {
 namespace internal {
 namespace master {
@@ -103,7 +105,7 @@ public:
   // Returns the total scalar resource quantities that are allocated to
   // this client. This omits metadata about dynamic reservations and
   // persistent volumes; see `Resources::createStrippedScalarQuantity`.
-  virtual const Resources& allocationScalarQuantities(
+  virtual const ResourceQuantities& allocationScalarQuantities(
       const std::string& client) = 0;
 
   // Returns the clients that have allocations on this slave.
@@ -119,7 +121,7 @@ public:
   // Returns the total scalar resource quantities in this sorter. This
   // omits metadata about dynamic reservations and persistent volumes; see
   // `Resources::createStrippedScalarQuantity`.
-  virtual const Resources& totalScalarQuantities() const = 0;
+  virtual const ResourceQuantities& totalScalarQuantities() const = 0;
 
   // Add resources to the total pool of resources this
   // Sorter should consider.
@@ -128,9 +130,14 @@ public:
   // Remove resources from the total pool.
   virtual void remove(const SlaveID& slaveId, const Resources& resources) = 0;
 
-  // Returns a list of all clients, in the order that they
-  // should be allocated to, according to this Sorter's policy.
-  virtual std::list<std::string> sort() = 0;
+  // Returns all clients, in the order that they should be allocated
+  // to, according to this Sorter's policy.
+  //
+  // NOTE: The clients are returned by reference so that they don't
+  // need to be copied every time, and they are only updated by the
+  // next call to `sort()`. This means it's safe to allocate to the
+  // clients (or otherwise update the sorter) while iterating them.
+  virtual const std::vector<std::string>& sort() = 0;
 
   // Returns true if this Sorter contains the specified client,
   // either active or deactivated.
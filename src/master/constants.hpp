@@ -118,6 +118,9 @@ constexpr char DEFAULT_ALLOCATOR[] = "HierarchicalDRF";
 // The default interval between allocations.
 constexpr Duration DEFAULT_ALLOCATION_INTERVAL = Seconds(1);
 
+// The default number of threads used to prepare an allocation run.
+constexpr size_t DEFAULT_ALLOCATION_PARALLELISM = 1;
+
 // Name of the default, local authorizer.
 constexpr char DEFAULT_AUTHORIZER[] = "local";
 
@@ -187,6 +187,15 @@ mesos::internal::master::Flags::Flags()
       " (batch) allocations (e.g., 500ms, 1sec, etc).",
       DEFAULT_ALLOCATION_INTERVAL);
 
+  add(&Flags::allocation_parallelism,
+      "allocation_parallelism",
+      "Number of threads the allocator uses to compute the resources\n"
+      "available on the agents at the start of an allocation run. The\n"
+      "agents are split into that many shards which are computed in\n"
+      "parallel, before the resources are allocated to the roles and\n"
+      "frameworks in a single pass.",
+      DEFAULT_ALLOCATION_PARALLELISM);
+
   add(&Flags::cluster,
       "cluster",
       "Human readable name for the cluster, displayed in the webui.");
@@ -359,6 +368,14 @@ mesos::internal::master::Flags::Flags()
       "or frameworks that accidentally drop offers.\n"
       "If not set, offers do not timeout.");
 
+  add(&Flags::metrics_staleness,
+      "metrics_staleness",
+      "Duration for which the value of a master or allocator metric that\n"
+      "is expensive to compute (e.g., the task counts or the resource\n"
+      "totals) is reused by metrics snapshots, rather than computed again\n"
+      "by the busy master or allocator for every snapshot (e.g., 5secs).\n"
+      "If not set, these metrics are computed for every snapshot.");
+
   // This help message for --modules flag is the same for
   // {master,slave,sched,tests}/flags.[ch]pp and should always be kept in
   // sync.
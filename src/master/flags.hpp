@@ -61,6 +61,7 @@ public:
   std::string user_sorter;
   std::string framework_sorter;
   Duration allocation_interval;
+  size_t allocation_parallelism;
   Option<std::string> cluster;
   Option<std::string> roles;
   Option<std::string> weights;
@@ -73,6 +74,7 @@ public:
   Option<Firewall> firewall_rules;
   Option<RateLimits> rate_limits;
   Option<Duration> offer_timeout;
+  Option<Duration> metrics_staleness;
   Option<Modules> modules;
   Option<std::string> modulesDir;
   std::string authenticators;
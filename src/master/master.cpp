@@ -822,12 +822,17 @@ void Master::initialize()
   }
 
   // Initialize the allocator.
+  mesos::allocator::Options options;
+  options.allocationParallelism = flags.allocation_parallelism;
+  options.metricsStaleness = flags.metrics_staleness;
+
   allocator->initialize(
       flags.allocation_interval,
       defer(self(), &Master::offer, lambda::_1, lambda::_2),
       defer(self(), &Master::inverseOffer, lambda::_1, lambda::_2),
       weights,
-      flags.fair_sharing_excluded_resource_names);
+      flags.fair_sharing_excluded_resource_names,
+      options);
 
   // Parse the whitelist. Passing Allocator::updateWhitelist()
   // callback is safe because we shut down the whitelistWatcher in
@@ -963,6 +968,11 @@ void Master::initialize()
       &Master::authenticate,
       &AuthenticateMessage::pid);
 
+  // Unlike the 'master/event_queue_*' gauges, this can be read
+  // without dispatching to the master, i.e., also while it is
+  // backed up.
+  exposeEventQueueSize("master/event_queue_size");
+
   // Setup HTTP routes.
   route("/api/v1",
         // TODO(benh): Is this authentication realm sufficient or do
@@ -36,6 +36,9 @@ namespace master {
 
 // Message counters are named with "messages_" prefix so they can
 // be grouped together alphabetically in the output.
+//
+// NOTE: The gauges that need to iterate over the agents, frameworks
+// or tasks reuse their values for `--metrics_staleness`, if set.
 // TODO(alexandra.sava): Add metrics for registered and removed slaves.
 Metrics::Metrics(const Master& master)
   : uptime_secs(
@@ -46,43 +49,55 @@ Metrics::Metrics(const Master& master)
         defer(master, &Master::_elected)),
     slaves_connected(
         "master/slaves_connected",
-        defer(master, &Master::_slaves_connected)),
+        defer(master, &Master::_slaves_connected),
+        master.flags.metrics_staleness),
     slaves_disconnected(
         "master/slaves_disconnected",
-        defer(master, &Master::_slaves_disconnected)),
+        defer(master, &Master::_slaves_disconnected),
+        master.flags.metrics_staleness),
     slaves_active(
         "master/slaves_active",
-        defer(master, &Master::_slaves_active)),
+        defer(master, &Master::_slaves_active),
+        master.flags.metrics_staleness),
     slaves_inactive(
         "master/slaves_inactive",
-        defer(master, &Master::_slaves_inactive)),
+        defer(master, &Master::_slaves_inactive),
+        master.flags.metrics_staleness),
     frameworks_connected(
         "master/frameworks_connected",
-        defer(master, &Master::_frameworks_connected)),
+        defer(master, &Master::_frameworks_connected),
+        master.flags.metrics_staleness),
     frameworks_disconnected(
         "master/frameworks_disconnected",
-        defer(master, &Master::_frameworks_disconnected)),
+        defer(master, &Master::_frameworks_disconnected),
+        master.flags.metrics_staleness),
     frameworks_active(
         "master/frameworks_active",
-        defer(master, &Master::_frameworks_active)),
+        defer(master, &Master::_frameworks_active),
+        master.flags.metrics_staleness),
     frameworks_inactive(
         "master/frameworks_inactive",
-        defer(master, &Master::_frameworks_inactive)),
+        defer(master, &Master::_frameworks_inactive),
+        master.flags.metrics_staleness),
     outstanding_offers(
         "master/outstanding_offers",
         defer(master, &Master::_outstanding_offers)),
     tasks_staging(
         "master/tasks_staging",
-        defer(master, &Master::_tasks_staging)),
+        defer(master, &Master::_tasks_staging),
+        master.flags.metrics_staleness),
     tasks_starting(
         "master/tasks_starting",
-        defer(master, &Master::_tasks_starting)),
+        defer(master, &Master::_tasks_starting),
+        master.flags.metrics_staleness),
     tasks_running(
         "master/tasks_running",
-        defer(master, &Master::_tasks_running)),
+        defer(master, &Master::_tasks_running),
+        master.flags.metrics_staleness),
     tasks_killing(
         "master/tasks_killing",
-        defer(master, &Master::_tasks_killing)),
+        defer(master, &Master::_tasks_killing),
+        master.flags.metrics_staleness),
     tasks_finished(
         "master/tasks_finished"),
     tasks_failed(
@@ -275,15 +290,18 @@ Metrics::Metrics(const Master& master)
   foreach (const string& resource, resources) {
     Gauge total(
         "master/" + resource + "_total",
-        defer(master, &Master::_resources_total, resource));
+        defer(master, &Master::_resources_total, resource),
+        master.flags.metrics_staleness);
 
     Gauge used(
         "master/" + resource + "_used",
-        defer(master, &Master::_resources_used, resource));
+        defer(master, &Master::_resources_used, resource),
+        master.flags.metrics_staleness);
 
     Gauge percent(
         "master/" + resource + "_percent",
-        defer(master, &Master::_resources_percent, resource));
+        defer(master, &Master::_resources_percent, resource),
+        master.flags.metrics_staleness);
 
     resources_total.push_back(total);
     resources_used.push_back(used);
@@ -297,15 +315,18 @@ Metrics::Metrics(const Master& master)
   foreach (const string& resource, resources) {
     Gauge total(
         "master/" + resource + "_revocable_total",
-        defer(master, &Master::_resources_revocable_total, resource));
+        defer(master, &Master::_resources_revocable_total, resource),
+        master.flags.metrics_staleness);
 
     Gauge used(
         "master/" + resource + "_revocable_used",
-        defer(master, &Master::_resources_revocable_used, resource));
+        defer(master, &Master::_resources_revocable_used, resource),
+        master.flags.metrics_staleness);
 
     Gauge percent(
         "master/" + resource + "_revocable_percent",
-        defer(master, &Master::_resources_revocable_percent, resource));
+        defer(master, &Master::_resources_revocable_percent, resource),
+        master.flags.metrics_staleness);
 
     resources_revocable_total.push_back(total);
     resources_revocable_used.push_back(used);
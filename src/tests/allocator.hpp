@@ -45,7 +45,8 @@ namespace tests {
 
 ACTION_P(InvokeInitialize, allocator)
 {
-  allocator->real->initialize(arg0, arg1, arg2, arg3, arg4);
+  allocator->real->initialize(
+      arg0, arg1, arg2, arg3, arg4, allocator->options);
 }
 
 
@@ -357,6 +358,33 @@ public:
 
   virtual ~TestAllocator() {}
 
+  // The master invokes the overload of 'initialize' that takes
+  // options. We keep the options for the real allocator (see
+  // 'InvokeInitialize') and invoke the mocked overload below, so that
+  // tests can keep setting their expectations on that one.
+  virtual void initialize(
+      const Duration& allocationInterval,
+      const lambda::function<
+          void(const FrameworkID&,
+               const hashmap<SlaveID, Resources>&)>& offerCallback,
+      const lambda::function<
+          void(const FrameworkID&,
+               const hashmap<SlaveID, UnavailableResources>&)>&
+        inverseOfferCallback,
+      const hashmap<std::string, double>& weights,
+      const Option<std::set<std::string>>& fairnessExcludeResourceNames,
+      const mesos::allocator::Options& _options)
+  {
+    options = _options;
+
+    initialize(
+        allocationInterval,
+        offerCallback,
+        inverseOfferCallback,
+        weights,
+        fairnessExcludeResourceNames);
+  }
+
   MOCK_METHOD5(initialize, void(
       const Duration&,
       const lambda::function<
@@ -465,6 +493,9 @@ public:
       const std::vector<WeightInfo>&));
 
   process::Owned<mesos::allocator::Allocator> real;
+
+  // The options that the real allocator gets initialized with.
+  mesos::allocator::Options options;
 };
 
 } // namespace tests {
@@ -15,6 +15,7 @@
 // limitations under the License.
 
 #include <atomic>
+#include <cstdlib>
 #include <iostream>
 #include <set>
 #include <string>
@@ -60,6 +61,7 @@ using mesos::allocator::Allocator;
 
 using process::Clock;
 using process::Future;
+using process::Promise;
 
 using std::atomic;
 using std::cout;
@@ -177,12 +179,17 @@ protected:
         };
     }
 
+    mesos::allocator::Options options;
+    options.allocationParallelism = flags.allocation_parallelism;
+    options.metricsStaleness = flags.metrics_staleness;
+
     allocator->initialize(
         flags.allocation_interval,
         offerCallback.get(),
         inverseOfferCallback.get(),
         {},
-        flags.fair_sharing_excluded_resource_names);
+        flags.fair_sharing_excluded_resource_names,
+        options);
   }
 
   SlaveInfo createSlaveInfo(const string& resources)
@@ -2010,6 +2017,195 @@ TEST_F(HierarchicalAllocatorTest, DRFWithQuota)
 }
 
 
+// This test checks that an allocation run whose agents are split into
+// shards, which are computed on separate threads, still satisfies quota
+// first and then allocates the free pool according to DRF.
+TEST_F(HierarchicalAllocatorTest, ParallelAllocation)
+{
+  Clock::pause();
+
+  const string QUOTA_ROLE{"quota-role"};
+  const string NO_QUOTA_ROLE{"no-quota-role"};
+
+  master::Flags flags;
+  flags.allocation_parallelism = 4;
+
+  initialize(flags);
+
+  // Recovering with quota pauses the allocations until 80% of the
+  // expected agents have been added, so that a single allocation run
+  // allocates most of the agents.
+  const size_t agentCount = 10;
+
+  const Quota quota = createQuota(QUOTA_ROLE, "cpus:2;mem:1024");
+  allocator->recover(agentCount, {{QUOTA_ROLE, quota}});
+
+  FrameworkInfo framework1 = createFrameworkInfo(QUOTA_ROLE);
+  allocator->addFramework(framework1.id(), framework1, {});
+
+  FrameworkInfo framework2 = createFrameworkInfo(NO_QUOTA_ROLE);
+  allocator->addFramework(framework2.id(), framework2, {});
+
+  FrameworkInfo framework3 = createFrameworkInfo(NO_QUOTA_ROLE);
+  allocator->addFramework(framework3.id(), framework3, {});
+
+  // NOTE: The allocator resumes once 8 (80% of 10) agents have been
+  // added, and allocates the agent that resumed it. No further agents
+  // are added.
+  const size_t resumeCount = 8;
+
+  for (size_t i = 0; i < resumeCount; i++) {
+    SlaveInfo agent = createSlaveInfo("cpus:1;mem:512;disk:0");
+    allocator->addSlave(agent.id(), agent, None(), agent.resources(), {});
+  }
+
+  Clock::settle();
+
+  // Trigger a batch allocation for the 7 agents that were added
+  // while the allocator was paused.
+  Clock::advance(flags.allocation_interval);
+  Clock::settle();
+
+  hashmap<FrameworkID, size_t> offered;
+  size_t total = 0;
+
+  while (total < resumeCount) {
+    Future<Allocation> allocation = allocations.get();
+    AWAIT_READY(allocation);
+
+    offered[allocation->frameworkId] += allocation->resources.size();
+    total += allocation->resources.size();
+  }
+
+  EXPECT_EQ(resumeCount, total);
+
+  // Total cluster resources (8 agents): cpus=8, mem=4096.
+  // QUOTA_ROLE share = 0.25 (cpus=2, mem=1024) [quota: cpus=2, mem=1024]
+  //   framework1 share = 1
+  // NO_QUOTA_ROLE share = 0.75 (cpus=6, mem=3072)
+  //   framework2 share = 0.5
+  //   framework3 share = 0.5
+  EXPECT_EQ(2u, offered[framework1.id()]);
+  EXPECT_EQ(3u, offered[framework2.id()]);
+  EXPECT_EQ(3u, offered[framework3.id()]);
+}
+
+
+// This test ensures that an allocation run that computes the available
+// resources in parallel makes the same offers as one that doesn't.
+TEST_F(HierarchicalAllocatorTest, ParallelAllocationEquivalence)
+{
+  Clock::pause();
+
+  const string QUOTA_ROLE{"quota-role"};
+  const string NO_QUOTA_ROLE{"no-quota-role"};
+  const string RESERVED_ROLE{"reserved-role"};
+
+  const Quota quota = createQuota(QUOTA_ROLE, "cpus:4;mem:2048");
+
+  vector<FrameworkInfo> frameworks = {
+    createFrameworkInfo(QUOTA_ROLE),
+    createFrameworkInfo(NO_QUOTA_ROLE),
+    createFrameworkInfo(NO_QUOTA_ROLE),
+    createFrameworkInfo(RESERVED_ROLE)
+  };
+
+  // The agents differ in size and some of them have resources
+  // reserved for a role.
+  vector<SlaveInfo> agents;
+
+  for (size_t i = 0; i < 16; i++) {
+    string resources =
+      "cpus:" + stringify(1 + i % 3) + ";" +
+      "mem:" + stringify(512 * (1 + i % 2)) + ";disk:0";
+
+    if (i % 4 == 0) {
+      resources += ";cpus(" + RESERVED_ROLE + "):1;" +
+                   "mem(" + RESERVED_ROLE + "):256";
+    }
+
+    agents.push_back(createSlaveInfo(resources));
+  }
+
+  // Returns all the offers that are made by a single allocation run
+  // for all the agents.
+  auto allocate = [&](size_t parallelism)
+      -> hashmap<FrameworkID, hashmap<SlaveID, Resources>> {
+    hashmap<FrameworkID, hashmap<SlaveID, Resources>> offers;
+
+    master::Flags flags;
+
+    mesos::allocator::Options options;
+    options.allocationParallelism = parallelism;
+
+    process::Owned<Allocator> allocator(
+        createAllocator<HierarchicalDRFAllocator>());
+
+    allocator->initialize(
+        flags.allocation_interval,
+        [&offers](const FrameworkID& frameworkId,
+                  const hashmap<SlaveID, Resources>& resources) {
+          foreachpair (const SlaveID& slaveId,
+                       const Resources& offered,
+                       resources) {
+            offers[frameworkId][slaveId] += offered;
+          }
+        },
+        [](const FrameworkID&, const hashmap<SlaveID, UnavailableResources>&) {
+        },
+        {},
+        None(),
+        options);
+
+    // Expect more agents than are added, so that the allocator stays
+    // paused until the recovery times out.
+    allocator->recover(agents.size() * 2, {{QUOTA_ROLE, quota}});
+
+    foreach (const FrameworkInfo& framework, frameworks) {
+      allocator->addFramework(framework.id(), framework, {});
+    }
+
+    foreach (const SlaveInfo& agent, agents) {
+      allocator->addSlave(agent.id(), agent, None(), agent.resources(), {});
+    }
+
+    Clock::settle();
+
+    // The allocation run shuffles the agents, so use the same seed
+    // for every allocator.
+    std::srand(0);
+
+    // Resume the allocator and trigger a batch allocation, which
+    // allocates all the agents in a single run.
+    Clock::advance(Minutes(10));
+    Clock::settle();
+
+    Clock::advance(flags.allocation_interval);
+    Clock::settle();
+
+    // Make sure that the allocation run actually computed the
+    // available resources in as many shards as were requested, up to
+    // one per agent.
+    JSON::Object metrics = Metrics();
+
+    EXPECT_EQ(
+        static_cast<int64_t>(std::min(parallelism, agents.size())),
+        metrics.values["allocator/mesos/allocation_run_shards"]
+          .as<JSON::Number>().as<int64_t>());
+
+    return offers;
+  };
+
+  hashmap<FrameworkID, hashmap<SlaveID, Resources>> expected = allocate(1);
+
+  // All the frameworks get offers.
+  EXPECT_EQ(frameworks.size(), expected.size());
+
+  EXPECT_EQ(expected, allocate(4));
+  EXPECT_EQ(expected, allocate(agents.size() * 2));
+}
+
+
 // This tests addresses a so-called "starvation" case. Suppose there are
 // several frameworks below their fair share: they decline any offers they
 // get. There is also a framework which fully utilizes its share and would
@@ -2574,6 +2770,55 @@ TEST_F(HierarchicalAllocatorTest, ResourceMetrics)
 }
 
 
+// This test checks that the resource metrics reuse their values
+// for the configured staleness.
+TEST_F(HierarchicalAllocatorTest, ResourceMetricsStaleness)
+{
+  Clock::pause();
+
+  master::Flags flags;
+  flags.metrics_staleness = Seconds(5);
+
+  initialize(flags);
+
+  SlaveInfo agent1 = createSlaveInfo("cpus:2;mem:1024;disk:0");
+  allocator->addSlave(agent1.id(), agent1, None(), agent1.resources(), {});
+  Clock::settle();
+
+  JSON::Object expected;
+
+  expected.values = {
+      {"allocator/mesos/resources/cpus/total",   2},
+      {"allocator/mesos/resources/mem/total", 1024},
+  };
+
+  JSON::Value metrics = Metrics();
+
+  EXPECT_TRUE(metrics.contains(expected));
+
+  SlaveInfo agent2 = createSlaveInfo("cpus:2;mem:1024;disk:0");
+  allocator->addSlave(agent2.id(), agent2, None(), agent2.resources(), {});
+  Clock::settle();
+
+  // The values of the last snapshot are not stale yet.
+  metrics = Metrics();
+
+  EXPECT_TRUE(metrics.contains(expected));
+
+  // Once the values are stale, they are computed again.
+  Clock::advance(flags.metrics_staleness.get() + Milliseconds(1));
+
+  expected.values = {
+      {"allocator/mesos/resources/cpus/total",   4},
+      {"allocator/mesos/resources/mem/total", 2048},
+  };
+
+  metrics = Metrics();
+
+  EXPECT_TRUE(metrics.contains(expected));
+}
+
+
 // This test checks that the number of times the allocation
 // algorithm has run is correctly reflected in the metric.
 TEST_F(HierarchicalAllocatorTest, AllocationRunsMetric)
@@ -2599,6 +2844,10 @@ TEST_F(HierarchicalAllocatorTest, AllocationRunsMetric)
   allocator->addSlave(agent.id(), agent, None(), agent.resources(), {});
   ++allocations; // Adding an agent triggers allocations.
 
+  // Let the allocation run before adding the framework, otherwise
+  // both allocations might be coalesced into a single run.
+  Clock::settle();
+
   FrameworkInfo framework = createFrameworkInfo("role");
   allocator->addFramework(framework.id(), framework, {});
   ++allocations; // Adding a framework triggers allocations.
@@ -2613,6 +2862,93 @@ TEST_F(HierarchicalAllocatorTest, AllocationRunsMetric)
 }
 
 
+// This test checks that the allocations that are requested while an
+// allocation is running get coalesced into a single allocation run.
+TEST_F(HierarchicalAllocatorTest, CoalescedAllocations)
+{
+  Clock::pause();
+
+  // Block the allocator in the offer callback of the first allocation
+  // until all the other agents have been added.
+  Promise<Nothing> offered;
+  atomic<bool> released(false);
+
+  auto offerCallback =
+    [this, &offered, &released](
+        const FrameworkID& frameworkId,
+        const hashmap<SlaveID, Resources>& resources) {
+      offered.set(Nothing());
+
+      while (!released.load()) {
+        os::sleep(Milliseconds(1));
+      }
+
+      Allocation allocation;
+      allocation.frameworkId = frameworkId;
+      allocation.resources = resources;
+
+      allocations.put(allocation);
+    };
+
+  // Make sure that no batch allocation runs during the test.
+  master::Flags flags;
+  flags.allocation_interval = Hours(1);
+
+  initialize(flags, offerCallback);
+
+  FrameworkInfo framework = createFrameworkInfo("role");
+  allocator->addFramework(framework.id(), framework, {});
+
+  Clock::settle();
+
+  // NOTE: We can't settle the clock while the allocator is blocked, so
+  // we resume it until the allocations are done.
+  Clock::resume();
+
+  SlaveInfo agent1 = createSlaveInfo("cpus:1;mem:512;disk:0");
+  allocator->addSlave(agent1.id(), agent1, None(), agent1.resources(), {});
+
+  AWAIT_READY(offered.future());
+
+  const size_t agentCount = 9;
+
+  for (size_t i = 0; i < agentCount; i++) {
+    SlaveInfo agent = createSlaveInfo("cpus:1;mem:512;disk:0");
+    allocator->addSlave(agent.id(), agent, None(), agent.resources(), {});
+  }
+
+  released.store(true);
+
+  Future<Allocation> allocation = allocations.get();
+  AWAIT_READY(allocation);
+  EXPECT_EQ(framework.id(), allocation->frameworkId);
+  EXPECT_EQ(1u, allocation->resources.size());
+  EXPECT_TRUE(allocation->resources.contains(agent1.id()));
+
+  // All the agents that were added while the allocator was blocked
+  // are allocated by a single allocation run.
+  allocation = allocations.get();
+  AWAIT_READY(allocation);
+  EXPECT_EQ(framework.id(), allocation->frameworkId);
+  EXPECT_EQ(agentCount, allocation->resources.size());
+  EXPECT_FALSE(allocation->resources.contains(agent1.id()));
+
+  Clock::pause();
+  Clock::settle();
+
+  // Adding the framework and each of the agents requested an
+  // allocation, which took three allocation runs.
+  JSON::Object expected;
+  expected.values = {
+      {"allocator/mesos/allocation_requests", 2 + agentCount},
+      {"allocator/mesos/allocation_runs", 3},
+  };
+
+  JSON::Value metrics = Metrics();
+  EXPECT_TRUE(metrics.contains(expected));
+}
+
+
 // This test checks that the allocation run timer
 // metrics are reported in the metrics endpoint.
 TEST_F(HierarchicalAllocatorTest, AllocationRunTimerMetrics)
@@ -2653,6 +2989,12 @@ TEST_F(HierarchicalAllocatorTest, AllocationRunTimerMetrics)
   SlaveInfo agent = createSlaveInfo("cpus:2;mem:1024;disk:0");
   allocator->addSlave(agent.id(), agent, None(), agent.resources(), {});
 
+  // Let the allocation run before adding the framework, otherwise
+  // both allocations might be coalesced into a single run.
+  Clock::pause();
+  Clock::settle();
+  Clock::resume();
+
   FrameworkInfo framework = createFrameworkInfo("role1");
   allocator->addFramework(framework.id(), framework, {});
 
@@ -2778,6 +3120,90 @@ TEST_F(HierarchicalAllocatorTest, ActiveOfferFiltersMetrics)
 }
 
 
+// This test checks that the offer filters which expire at the same
+// time are removed together, and that the total count of active
+// offer filters is reported in the metrics endpoint.
+TEST_F(HierarchicalAllocatorTest, OfferFiltersExpireTogether)
+{
+  // Pausing the clock is not necessary, but ensures that the test
+  // doesn't rely on the batch allocation in the allocator, which
+  // would slow down the test.
+  Clock::pause();
+
+  initialize();
+
+  SlaveInfo agent1 = createSlaveInfo("cpus:1;mem:512;disk:0");
+  allocator->addSlave(agent1.id(), agent1, None(), agent1.resources(), {});
+
+  SlaveInfo agent2 = createSlaveInfo("cpus:1;mem:512;disk:0");
+  allocator->addSlave(agent2.id(), agent2, None(), agent2.resources(), {});
+
+  FrameworkInfo framework = createFrameworkInfo("role");
+  allocator->addFramework(framework.id(), framework, {});
+
+  Future<Allocation> allocation = allocations.get();
+  AWAIT_READY(allocation);
+  EXPECT_EQ(framework.id(), allocation->frameworkId);
+  EXPECT_EQ(2u, allocation->resources.size());
+
+  // Decline both agents with an offer filter that expires
+  // after two allocation intervals.
+  Duration filterTimeout = flags.allocation_interval * 2;
+  Filters offerFilter;
+  offerFilter.set_refuse_seconds(filterTimeout.secs());
+
+  foreachpair (const SlaveID& slaveId,
+               const Resources& resources,
+               allocation->resources) {
+    allocator->recoverResources(
+        framework.id(), slaveId, resources, offerFilter);
+  }
+
+  // NOTE: The active offer filters are published by the allocator,
+  // so we settle the clock to make sure the filters got installed.
+  Clock::settle();
+
+  JSON::Object expected;
+  expected.values = {
+      {"allocator/mesos/offer_filters/active", 2},
+      {"allocator/mesos/offer_filters/roles/role/active", 2},
+  };
+
+  JSON::Value metrics = Metrics();
+  EXPECT_TRUE(metrics.contains(expected));
+
+  // Trigger a batch allocation.
+  Clock::advance(flags.allocation_interval);
+  Clock::settle();
+
+  // There should be no allocation due to the offer filters.
+  allocation = allocations.get();
+  ASSERT_TRUE(allocation.isPending());
+
+  metrics = Metrics();
+  EXPECT_TRUE(metrics.contains(expected));
+
+  // Both offer filters expire before the next batch allocation.
+  Clock::advance(flags.allocation_interval);
+  Clock::settle();
+
+  AWAIT_READY(allocation);
+  EXPECT_EQ(framework.id(), allocation->frameworkId);
+  EXPECT_EQ(2u, allocation->resources.size());
+
+  expected.values = {
+      {"allocator/mesos/offer_filters/active", 0},
+      {"allocator/mesos/offer_filters/roles/role/active", 0},
+  };
+
+  metrics = Metrics();
+  EXPECT_TRUE(metrics.contains(expected));
+
+  EXPECT_EQ(1u, metrics.as<JSON::Object>().values.count(
+      "allocator/mesos/offer_filters/check_time_ms"));
+}
+
+
 // Verifies that per-role dominant share metrics are correctly reported.
 TEST_F(HierarchicalAllocatorTest, DominantShareMetrics)
 {
@@ -2967,6 +3393,10 @@ TEST_F(HierarchicalAllocatorTest, UpdateWeight)
   FrameworkInfo framework1 = createFrameworkInfo("role1");
   allocator->addFramework(framework1.id(), framework1, {});
 
+  // Let the allocation run before framework2 registers, otherwise
+  // both frameworks would be considered by the same allocation run.
+  Clock::settle();
+
   // Framework2 registers with 'role2' which also uses the default weight.
   // It will not get any offers due to all resources having outstanding offers
   // to framework1 when it registered.
@@ -3193,7 +3623,7 @@ INSTANTIATE_TEST_CASE_P(
     HierarchicalAllocator_BENCHMARK_Test,
     ::testing::Combine(
       ::testing::Values(1000U, 5000U, 10000U, 20000U, 30000U, 50000U),
-      ::testing::Values(1U, 50U, 100U, 200U, 500U, 1000U))
+      ::testing::Values(1U, 50U, 100U, 200U, 500U, 1000U, 2000U))
     );
 
 
@@ -3223,14 +3653,18 @@ TEST_P(HierarchicalAllocator_BENCHMARK_Test, AddAndUpdateSlave)
 
   Clock::pause();
 
-  // Number of allocations. This is used to determine
-  // the termination condition.
+  // Number of agents that have been allocated. This is used to
+  // determine the termination condition.
+  //
+  // NOTE: The allocations that are triggered by the `addSlave` (and
+  // `updateSlave`) operations might be coalesced, so a single offer
+  // may contain the resources of several agents.
   atomic<size_t> finished(0);
 
   auto offerCallback = [&finished](
       const FrameworkID& frameworkId,
       const hashmap<SlaveID, Resources>& resources) {
-    finished++;
+    finished += resources.size();
   };
 
   initialize(master::Flags(), offerCallback);
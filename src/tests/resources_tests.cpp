@@ -25,6 +25,9 @@
 #include <stout/gtest.hpp>
 #include <stout/json.hpp>
 #include <stout/protobuf.hpp>
+#include <stout/stopwatch.hpp>
+
+#include "common/resource_quantities.hpp"
 
 #include "master/master.hpp"
 
@@ -32,6 +35,8 @@
 
 using namespace mesos::internal::master;
 
+using std::cout;
+using std::endl;
 using std::map;
 using std::ostringstream;
 using std::pair;
@@ -2405,6 +2410,198 @@ TEST(RevocableResourceTest, Filter)
   EXPECT_EQ(r2, (r1 + r2).nonRevocable());
 }
 
+
+// This test verifies that quantities are kept per name, role and
+// revocability, like the stripped scalar quantities of `Resources`.
+TEST(ResourceQuantitiesTest, FromScalarResources)
+{
+  Resources resources = Resources::parse(
+      "cpus(*):1;cpus(role):2;mem(*):512;ports(*):[1-10]").get();
+
+  resources += createRevocableResource("cpus", "0.5", "*", true);
+
+  ResourceQuantities quantities =
+    ResourceQuantities::fromScalarResources(resources);
+
+  EXPECT_EQ(set<string>({"cpus", "mem"}), quantities.names());
+  EXPECT_DOUBLE_EQ(3.5, quantities.get("cpus"));
+  EXPECT_DOUBLE_EQ(512, quantities.get("mem"));
+  EXPECT_DOUBLE_EQ(0, quantities.get("ports"));
+  EXPECT_DOUBLE_EQ(0, quantities.get("disk"));
+
+  // Reservations and persistent volumes are stripped.
+  Resource volume = Resources::parse("disk", "64", "role").get();
+  volume.mutable_reservation()->CopyFrom(
+      createReservationInfo("principal"));
+  volume.mutable_disk()->CopyFrom(createDiskInfo("id", "path"));
+
+  EXPECT_EQ(
+      ResourceQuantities::fromScalarResources(
+          Resources::parse("disk(role):64").get()),
+      ResourceQuantities::fromScalarResources(volume));
+
+  EXPECT_TRUE(ResourceQuantities::fromScalarResources(
+      Resources::parse("ports(*):[1-10]").get()).empty());
+}
+
+
+TEST(ResourceQuantitiesTest, Arithmetic)
+{
+  ResourceQuantities q1 = ResourceQuantities::fromScalarResources(
+      Resources::parse("cpus(*):1;mem(*):512;cpus(role):2").get());
+  ResourceQuantities q2 = ResourceQuantities::fromScalarResources(
+      Resources::parse("cpus(*):0.1;disk(*):1024").get());
+
+  EXPECT_EQ(ResourceQuantities::fromScalarResources(
+                Resources::parse(
+                    "cpus(*):1.1;mem(*):512;cpus(role):2;disk(*):1024").get()),
+            q1 + q2);
+
+  EXPECT_EQ(q1, (q1 + q2) - q2);
+
+  // Quantities that become zero or negative are removed, and
+  // quantities that are not present are not subtracted.
+  EXPECT_EQ(ResourceQuantities::fromScalarResources(
+                Resources::parse("cpus(*):0.9;mem(*):512;cpus(role):2").get()),
+            q1 - q2);
+
+  EXPECT_EQ(ResourceQuantities::fromScalarResources(
+                Resources::parse("disk(*):1024").get()),
+            q2 - q1);
+
+  EXPECT_TRUE((q1 - q1).empty());
+
+  // The fixed point arithmetic does not accumulate rounding errors.
+  ResourceQuantities sum;
+  for (int i = 0; i < 10; i++) {
+    sum += ResourceQuantities::fromScalarResources(
+        Resources::parse("cpus(*):0.1").get());
+  }
+
+  EXPECT_EQ(ResourceQuantities::fromScalarResources(
+                Resources::parse("cpus(*):1").get()),
+            sum);
+}
+
+
+TEST(ResourceQuantitiesTest, Contains)
+{
+  ResourceQuantities q1 = ResourceQuantities::fromScalarResources(
+      Resources::parse("cpus(*):2;mem(*):512;cpus(role):2").get());
+  ResourceQuantities q2 = ResourceQuantities::fromScalarResources(
+      Resources::parse("cpus(*):2;mem(*):256").get());
+
+  EXPECT_TRUE(q1.contains(q2));
+  EXPECT_FALSE(q2.contains(q1));
+  EXPECT_TRUE(q1.contains(ResourceQuantities()));
+
+  // The roles of the quantities have to match.
+  ResourceQuantities q3 = ResourceQuantities::fromScalarResources(
+      Resources::parse("cpus(*):3").get());
+
+  EXPECT_FALSE(q1.contains(q3));
+  EXPECT_TRUE(q1.flatten().contains(q3));
+
+  // So does the revocability.
+  ResourceQuantities q4 = ResourceQuantities::fromScalarResources(
+      createRevocableResource("cpus", "1", "*", true));
+
+  EXPECT_FALSE(q1.contains(q4));
+  EXPECT_TRUE((q1 + q4).contains(q4));
+}
+
+
+TEST(ResourceQuantitiesTest, Flatten)
+{
+  ResourceQuantities quantities = ResourceQuantities::fromScalarResources(
+      Resources::parse("cpus(*):1;cpus(role1):2;cpus(role2):3;mem(*):4").get());
+
+  EXPECT_EQ(ResourceQuantities::fromScalarResources(
+                Resources::parse("cpus(*):6;mem(*):4").get()),
+            quantities.flatten());
+
+  EXPECT_EQ(ResourceQuantities::fromScalarResources(
+                Resources::parse("cpus(role):6;mem(role):4").get()),
+            quantities.flatten("role"));
+}
+
+
+class ResourceQuantities_BENCHMARK_Test
+  : public ::testing::Test,
+    public ::testing::WithParamInterface<size_t> {};
+
+
+// The benchmark is parameterized by the number of agents.
+INSTANTIATE_TEST_CASE_P(
+    AgentCount,
+    ResourceQuantities_BENCHMARK_Test,
+    ::testing::Values(1000U, 5000U, 10000U, 20000U));
+
+
+// This benchmark mirrors how the allocator accumulates the totals of
+// the agents' resources, first with the stripped scalar quantities of
+// `Resources` and then with `ResourceQuantities`.
+TEST_P(ResourceQuantities_BENCHMARK_Test, Arithmetic)
+{
+  const size_t agentCount = GetParam();
+
+  Resources agent = Resources::parse(
+      "cpus(*):1.5;mem(*):512;disk(*):2048;cpus(role):0.5;mem(role):128;"
+      "ports(*):[31000-32000]").get();
+
+  agent += createRevocableResource("cpus", "1", "*", true);
+
+  cout << "Using " << agentCount << " agents" << endl;
+
+  Stopwatch watch;
+
+  watch.start();
+  {
+    Resources total;
+    for (size_t i = 0; i < agentCount; i++) {
+      total += agent.createStrippedScalarQuantity();
+    }
+
+    Resources allocated;
+    for (size_t i = 0; i < agentCount; i++) {
+      allocated += agent.createStrippedScalarQuantity();
+      CHECK(total.contains(allocated));
+    }
+
+    for (size_t i = 0; i < agentCount; i++) {
+      total -= agent.createStrippedScalarQuantity();
+    }
+
+    CHECK(total.empty());
+  }
+  watch.stop();
+
+  cout << "Resources arithmetic took " << watch.elapsed() << endl;
+
+  watch.start();
+  {
+    ResourceQuantities total;
+    for (size_t i = 0; i < agentCount; i++) {
+      total += ResourceQuantities::fromScalarResources(agent);
+    }
+
+    ResourceQuantities allocated;
+    for (size_t i = 0; i < agentCount; i++) {
+      allocated += ResourceQuantities::fromScalarResources(agent);
+      CHECK(total.contains(allocated));
+    }
+
+    for (size_t i = 0; i < agentCount; i++) {
+      total -= ResourceQuantities::fromScalarResources(agent);
+    }
+
+    CHECK(total.empty());
+  }
+  watch.stop();
+
+  cout << "ResourceQuantities arithmetic took " << watch.elapsed() << endl;
+}
+
 } // namespace tests {
 } // namespace internal {
 } // namespace mesos {
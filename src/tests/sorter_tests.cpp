@@ -17,13 +17,14 @@
 #include <stdarg.h>
 #include <stdint.h>
 
-#include <list>
 #include <string>
+#include <vector>
 
 #include <gmock/gmock.h>
 
 #include <mesos/resources.hpp>
 
+#include <stout/foreach.hpp>
 #include <stout/gtest.hpp>
 
 #include "master/allocator/sorter/drf/sorter.hpp"
@@ -32,8 +33,8 @@
 
 using mesos::internal::master::allocator::DRFSorter;
 
-using std::list;
 using std::string;
+using std::vector;
 
 namespace mesos {
 namespace internal {
@@ -59,7 +60,7 @@ TEST(SorterTest, DRFSorter)
   sorter.allocated("b", slaveId, bResources);
 
   // shares: a = .05, b = .06
-  EXPECT_EQ(list<string>({"a", "b"}), sorter.sort());
+  EXPECT_EQ(vector<string>({"a", "b"}), sorter.sort());
 
   Resources cResources = Resources::parse("cpus:1;mem:1").get();
   sorter.add("c");
@@ -70,14 +71,14 @@ TEST(SorterTest, DRFSorter)
   sorter.allocated("d", slaveId, dResources);
 
   // shares: a = .05, b = .06, c = .01, d = .03
-  EXPECT_EQ(list<string>({"c", "d", "a", "b"}), sorter.sort());
+  EXPECT_EQ(vector<string>({"c", "d", "a", "b"}), sorter.sort());
 
   sorter.remove("a");
   Resources bUnallocated = Resources::parse("cpus:4;mem:4").get();
   sorter.unallocated("b", slaveId, bUnallocated);
 
   // shares: b = .02, c = .01, d = .03
-  EXPECT_EQ(list<string>({"c", "b", "d"}), sorter.sort());
+  EXPECT_EQ(vector<string>({"c", "b", "d"}), sorter.sort());
 
   Resources eResources = Resources::parse("cpus:1;mem:5").get();
   sorter.add("e");
@@ -88,7 +89,7 @@ TEST(SorterTest, DRFSorter)
   // total resources is now cpus = 50, mem = 100
 
   // shares: b = .04, c = .02, d = .06, e = .05
-  EXPECT_EQ(list<string>({"c", "b", "e", "d"}), sorter.sort());
+  EXPECT_EQ(vector<string>({"c", "b", "e", "d"}), sorter.sort());
 
   Resources addedResources = Resources::parse("cpus:0;mem:100").get();
   sorter.add(slaveId, addedResources);
@@ -102,7 +103,7 @@ TEST(SorterTest, DRFSorter)
   sorter.allocated("c", slaveId, cResources2);
 
   // shares: b = .04, c = .08, d = .06, e = .025, f = .1
-  EXPECT_EQ(list<string>({"e", "b", "d", "c", "f"}), sorter.sort());
+  EXPECT_EQ(vector<string>({"e", "b", "d", "c", "f"}), sorter.sort());
 
   EXPECT_TRUE(sorter.contains("b"));
 
@@ -114,13 +115,59 @@ TEST(SorterTest, DRFSorter)
 
   EXPECT_TRUE(sorter.contains("d"));
 
-  EXPECT_EQ(list<string>({"e", "b", "c", "f"}), sorter.sort());
+  EXPECT_EQ(vector<string>({"e", "b", "c", "f"}), sorter.sort());
 
   EXPECT_EQ(5, sorter.count());
 
   sorter.activate("d");
 
-  EXPECT_EQ(list<string>({"e", "b", "d", "c", "f"}), sorter.sort());
+  EXPECT_EQ(vector<string>({"e", "b", "d", "c", "f"}), sorter.sort());
+}
+
+
+// This test checks that the clients returned by `sort()` are only
+// updated by the next call to `sort()`, so that the allocator can
+// allocate to the clients while iterating them.
+TEST(SorterTest, AllocateWhileSorted)
+{
+  DRFSorter sorter;
+
+  SlaveID slaveId;
+  slaveId.set_value("agentId");
+
+  sorter.add(slaveId, Resources::parse("cpus:100;mem:100").get());
+
+  sorter.add("a");
+  sorter.add("b");
+  sorter.add("c");
+
+  const vector<string>& sorted = sorter.sort();
+  EXPECT_EQ(vector<string>({"a", "b", "c"}), sorted);
+
+  Resources resources = Resources::parse("cpus:1;mem:1").get();
+
+  vector<string> allocated;
+  foreach (const string& name, sorted) {
+    sorter.allocated(name, slaveId, resources);
+    allocated.push_back(name);
+  }
+
+  EXPECT_EQ(vector<string>({"a", "b", "c"}), allocated);
+
+  // shares: a = .02, b = .01, c = .01
+  sorter.allocated("a", slaveId, resources);
+
+  EXPECT_EQ(vector<string>({"a", "b", "c"}), sorted);
+  EXPECT_EQ(vector<string>({"b", "c", "a"}), sorter.sort());
+
+  // shares: a = .02, b = .01, c = .02
+  sorter.allocated("c", slaveId, resources);
+
+  EXPECT_EQ(vector<string>({"b", "a", "c"}), sorter.sort());
+
+  sorter.deactivate("a");
+
+  EXPECT_EQ(vector<string>({"b", "c"}), sorter.sort());
 }
 
 
@@ -141,38 +188,38 @@ TEST(SorterTest, WDRFSorter)
   sorter.allocated("b", slaveId, Resources::parse("cpus:6;mem:6").get());
 
   // shares: a = .05, b = .03
-  EXPECT_EQ(list<string>({"b", "a"}), sorter.sort());
+  EXPECT_EQ(vector<string>({"b", "a"}), sorter.sort());
 
   sorter.add("c");
   sorter.allocated("c", slaveId, Resources::parse("cpus:4;mem:4").get());
 
   // shares: a = .05, b = .03, c = .04
-  EXPECT_EQ(list<string>({"b", "c", "a"}), sorter.sort());
+  EXPECT_EQ(vector<string>({"b", "c", "a"}), sorter.sort());
 
   sorter.add("d", 10);
   sorter.allocated("d", slaveId, Resources::parse("cpus:10;mem:20").get());
 
   // shares: a = .05, b = .03, c = .04, d = .02
-  EXPECT_EQ(list<string>({"d", "b", "c", "a"}), sorter.sort());
+  EXPECT_EQ(vector<string>({"d", "b", "c", "a"}), sorter.sort());
 
   sorter.remove("b");
 
-  EXPECT_EQ(list<string>({"d", "c", "a"}), sorter.sort());
+  EXPECT_EQ(vector<string>({"d", "c", "a"}), sorter.sort());
 
   sorter.allocated("d", slaveId, Resources::parse("cpus:10;mem:25").get());
 
   // shares: a = .05, c = .04, d = .045
-  EXPECT_EQ(list<string>({"c", "d", "a"}), sorter.sort());
+  EXPECT_EQ(vector<string>({"c", "d", "a"}), sorter.sort());
 
   sorter.add("e", .1);
   sorter.allocated("e", slaveId, Resources::parse("cpus:1;mem:1").get());
 
   // shares: a = .05, c = .04, d = .045, e = .1
-  EXPECT_EQ(list<string>({"c", "d", "a", "e"}), sorter.sort());
+  EXPECT_EQ(vector<string>({"c", "d", "a", "e"}), sorter.sort());
 
   sorter.remove("a");
 
-  EXPECT_EQ(list<string>({"c", "d", "e"}), sorter.sort());
+  EXPECT_EQ(vector<string>({"c", "d", "e"}), sorter.sort());
 }
 
 
@@ -194,13 +241,13 @@ TEST(SorterTest, WDRFSorterUpdateWeight)
   sorter.allocated("b", slaveId, Resources::parse("cpus:6;mem:6").get());
 
   // shares: a = .05, b = .06
-  EXPECT_EQ(list<string>({"a", "b"}), sorter.sort());
+  EXPECT_EQ(vector<string>({"a", "b"}), sorter.sort());
 
   // Increase b's  weight to flip the sort order.
   sorter.update("b", 2);
 
   // shares: a = .05, b = .03
-  EXPECT_EQ(list<string>({"b", "a"}), sorter.sort());
+  EXPECT_EQ(vector<string>({"b", "a"}), sorter.sort());
 }
 
 
@@ -236,7 +283,7 @@ TEST(SorterTest, SplitResourceShares)
   sorter.allocated(
       "b", slaveId, Resources::parse("cpus:9;mem:9").get() + disk1 + disk2);
 
-  EXPECT_EQ(list<string>({"a", "b"}), sorter.sort());
+  EXPECT_EQ(vector<string>({"a", "b"}), sorter.sort());
 }
 
 
@@ -374,7 +421,7 @@ TEST(SorterTest, UpdateTotal)
   sorter.allocated(
       "b", slaveId, Resources::parse("cpus:1;mem:2").get());
 
-  list<string> sorted = sorter.sort();
+  vector<string> sorted = sorter.sort();
   ASSERT_EQ(2u, sorted.size());
   EXPECT_EQ("b", sorted.front());
   EXPECT_EQ("a", sorted.back());
@@ -419,7 +466,7 @@ TEST(SorterTest, MultipleSlavesUpdateTotal)
   sorter.allocated(
       "b", slaveB, Resources::parse("cpus:1;mem:3").get());
 
-  list<string> sorted = sorter.sort();
+  vector<string> sorted = sorter.sort();
   ASSERT_EQ(2u, sorted.size());
   EXPECT_EQ("b", sorted.front());
   EXPECT_EQ("a", sorted.back());
@@ -473,7 +520,7 @@ TEST(SorterTest, RevocableResources)
   ASSERT_EQ(b, sorter.allocation("b", slaveId));
 
   // Check that the sort is correct.
-  list<string> sorted = sorter.sort();
+  vector<string> sorted = sorter.sort();
   ASSERT_EQ(2u, sorted.size());
   EXPECT_EQ("a", sorted.front());
   EXPECT_EQ("b", sorted.back());